@@ -0,0 +1,203 @@
+#!/usr/bin/env python
+# gorilla_reader.py: reads the files written by collectd's gorilla plugin.
+#
+# Copyright (C) 2026  agent <agent at local>
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; only version 2 of the License is applicable.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# Usage:
+#   gorilla_reader.py <DataDir> [<identifier>]
+#
+# Prints one line per value in the format used by the PUTVAL command, i.e.
+#   <identifier> <time>:<value>[:<value>...]
+# If an identifier is given, only that series is printed.
+#
+# The module can also be imported; read_index() and read_segment() return the
+# series and the decoded blocks respectively.
+
+import os
+import re
+import struct
+import sys
+
+INDEX_MAGIC = b'CDGIDX01'
+SEGMENT_MAGIC = b'CDGSEG01'
+BLOCK_MAGIC = 0x47424c4b
+IDENT_LEN = 6 * 64
+COLUMN_TIME = 0xff
+
+DS_TYPE_COUNTER = 0
+DS_TYPE_GAUGE = 1
+DS_TYPE_DERIVE = 2
+DS_TYPE_ABSOLUTE = 3
+
+
+class BitReader(object):
+    def __init__(self, data, bits):
+        self.data = bytearray(data)
+        self.bits = bits
+        self.pos = 0
+
+    def read(self, n):
+        if self.pos + n > self.bits:
+            raise ValueError('column is truncated')
+        value = 0
+        for _ in range(n):
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+    def at_end(self):
+        return self.pos >= self.bits
+
+
+def _sign_extend(value, bits):
+    if value & (1 << (bits - 1)):
+        return value - (1 << bits)
+    return value
+
+
+def decode_times(data, bits):
+    r = BitReader(data, bits)
+    if r.at_end():
+        return []
+    prev = r.read(64)
+    delta = 0
+    times = [prev]
+    while not r.at_end():
+        prefix = 0
+        while prefix < 4 and r.read(1) == 1:
+            prefix += 1
+        if prefix == 0:
+            dod = 0
+        elif prefix == 4:
+            dod = _sign_extend(r.read(64), 64)
+        else:
+            width = (7, 9, 12)[prefix - 1]
+            dod = _sign_extend(r.read(width), width)
+        delta += dod
+        prev = (prev + delta) & 0xffffffffffffffff
+        times.append(prev)
+    return times
+
+
+def decode_values(data, bits):
+    r = BitReader(data, bits)
+    if r.at_end():
+        return []
+    prev = r.read(64)
+    values = [prev]
+    leading = trailing = -1
+    while not r.at_end():
+        if r.read(1) == 0:
+            values.append(prev)
+            continue
+        if r.read(1) == 1:
+            leading = r.read(5)
+            significant = r.read(6) or 64
+            trailing = 64 - leading - significant
+        elif leading < 0:
+            raise ValueError('column is corrupt')
+        significant = 64 - leading - trailing
+        prev ^= r.read(significant) << trailing
+        values.append(prev)
+    return values
+
+
+def convert_value(ds_type, bits):
+    if ds_type == DS_TYPE_GAUGE:
+        return struct.unpack('>d', struct.pack('>Q', bits))[0]
+    if ds_type == DS_TYPE_DERIVE:
+        return _sign_extend(bits, 64)
+    return bits
+
+
+def read_index(datadir):
+    """Returns a dict mapping series IDs to (identifier, ds_num) tuples."""
+    with open(os.path.join(datadir, 'index.gor'), 'rb') as f:
+        data = f.read()
+    if data[0:8] != INDEX_MAGIC:
+        raise ValueError('not a gorilla index file')
+    (num,) = struct.unpack('>I', data[8:12])
+    series = {}
+    offset = 16
+    for _ in range(num):
+        ident = data[offset:offset + IDENT_LEN].split(b'\0', 1)[0]
+        (series_id, ds_num) = struct.unpack(
+            '>II', data[offset + IDENT_LEN:offset + IDENT_LEN + 8])
+        series[series_id] = (ident.decode('utf-8', 'replace'), ds_num)
+        offset += IDENT_LEN + 8
+    return series
+
+
+def read_segment(path):
+    """Yields (series_id, times, [values per data source]) for each block.
+    Times are in seconds since the epoch."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[0:8] != SEGMENT_MAGIC:
+        raise ValueError('%s is not a gorilla segment file' % path)
+    offset = 8
+    while offset + 16 <= len(data):
+        (magic, series_id, _, columns) = struct.unpack(
+            '>IIII', data[offset:offset + 16])
+        if magic != BLOCK_MAGIC:
+            raise ValueError('%s: bad block at offset %d' % (path, offset))
+        columns >>= 16
+        offset += 16
+        headers = []
+        for _ in range(columns):
+            (ctype, _, _, _, bits) = struct.unpack(
+                '>BBBBI', data[offset:offset + 8])
+            headers.append((ctype, bits))
+            offset += 8
+        if offset + sum((b + 7) // 8 for (_, b) in headers) > len(data):
+            break  # Incomplete block at the end of the segment.
+        times = None
+        values = []
+        for (ctype, bits) in headers:
+            size = (bits + 7) // 8
+            chunk = data[offset:offset + size]
+            offset += size
+            if ctype == COLUMN_TIME:
+                times = [t / 1000.0 for t in decode_times(chunk, bits)]
+            else:
+                values.append([convert_value(ctype, v)
+                               for v in decode_values(chunk, bits)])
+        yield (series_id, times, values)
+
+
+def list_segments(datadir):
+    names = [n for n in os.listdir(datadir)
+             if re.match(r'^segment-\d+\.gor$', n)]
+    return [os.path.join(datadir, n) for n in sorted(names)]
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write('Usage: %s <DataDir> [<identifier>]\n' % argv[0])
+        return 1
+    datadir = argv[1]
+    wanted = argv[2] if len(argv) > 2 else None
+    series = read_index(datadir)
+    for path in list_segments(datadir):
+        for (series_id, times, values) in read_segment(path):
+            (ident, _) = series.get(series_id, ('unknown-%d' % series_id, 0))
+            if wanted is not None and ident != wanted:
+                continue
+            for (i, t) in enumerate(times):
+                fields = ['%.3f' % t] + [str(v[i]) for v in values]
+                sys.stdout.write('%s %s\n' % (ident, ':'.join(fields)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -33,12 +33,23 @@
 #include "configfile.h"
 #include "meta_data.h"
 #include "utils_cache.h" /* for uc_get_rate() */
+#include "utils_sketch.h"
 #include "utils_subst.h"
 #include "utils_vl_lookup.h"
 
 #define AGG_MATCHES_ALL(str) (strcmp ("/.*/", str) == 0)
 #define AGG_FUNC_PLACEHOLDER "%{aggregation}"
 
+/* Number of accumulators per instance. Write threads are spread over the
+ * accumulators, so that they rarely wait for each other. Each accumulator
+ * has its own sketch, so keep the documented memory use of PercentileBuckets
+ * in collectd.conf(5) in sync when changing this. */
+#define AGG_SHARDS 8
+
+/* Defaults for the sketches used to calculate percentiles. */
+#define AGG_PERCENTILE_ACCURACY 0.01
+#define AGG_PERCENTILE_BUCKETS 1024
+
 struct aggregation_s /* {{{ */
 {
   identifier_t ident;
@@ -57,17 +68,18 @@ struct aggregation_s /* {{{ */
   _Bool calc_min;
   _Bool calc_max;
   _Bool calc_stddev;
+
+  /* Percentiles to calculate, in the range (0, 100]. */
+  double *percentiles;
+  size_t percentiles_num;
+  double percentile_accuracy;
+  int percentile_buckets;
 }; /* }}} */
 typedef struct aggregation_s aggregation_t;
 
-struct agg_instance_s;
-typedef struct agg_instance_s agg_instance_t;
-struct agg_instance_s /* {{{ */
+struct agg_accumulator_s /* {{{ */
 {
   pthread_mutex_t lock;
-  identifier_t ident;
-
-  int ds_type;
 
   derive_t num;
   gauge_t sum;
@@ -76,6 +88,21 @@ struct agg_instance_s /* {{{ */
   gauge_t min;
   gauge_t max;
 
+  sketch_t *sketch; /* NULL unless percentiles are calculated */
+}; /* }}} */
+typedef struct agg_accumulator_s agg_accumulator_t;
+
+struct agg_instance_s;
+typedef struct agg_instance_s agg_instance_t;
+struct agg_instance_s /* {{{ */
+{
+  identifier_t ident;
+
+  int ds_type;
+
+  /* Updated by the write threads, merged and reset by agg_instance_read(). */
+  agg_accumulator_t acc[AGG_SHARDS];
+
   rate_to_value_state_t *state_num;
   rate_to_value_state_t *state_sum;
   rate_to_value_state_t *state_average;
@@ -83,6 +110,13 @@ struct agg_instance_s /* {{{ */
   rate_to_value_state_t *state_max;
   rate_to_value_state_t *state_stddev;
 
+  /* The percentiles are owned by the aggregation_t. `sketch' holds the
+   * merged sketches of all accumulators while reading. */
+  double const *percentiles;
+  size_t percentiles_num;
+  sketch_t *sketch;
+  rate_to_value_state_t *state_percentiles;
+
   agg_instance_t *next;
 }; /* }}} */
 
@@ -91,6 +125,58 @@ static lookup_t *lookup = NULL;
 static pthread_mutex_t agg_instance_list_lock = PTHREAD_MUTEX_INITIALIZER;
 static agg_instance_t *agg_instance_list_head = NULL;
 
+static pthread_key_t agg_shard_key;
+static pthread_once_t agg_shard_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t agg_shard_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t agg_shard_next = 0;
+
+static void agg_shard_key_create (void) /* {{{ */
+{
+  pthread_key_create (&agg_shard_key, /* destructor = */ free);
+} /* }}} void agg_shard_key_create */
+
+/* Returns the accumulator the calling thread uses. Threads are assigned
+ * accumulators round-robin when they first call this function. */
+static size_t agg_shard_index (void) /* {{{ */
+{
+  size_t *index;
+
+  pthread_once (&agg_shard_once, agg_shard_key_create);
+
+  index = pthread_getspecific (agg_shard_key);
+  if (index != NULL)
+    return (*index);
+
+  index = malloc (sizeof (*index));
+  if (index == NULL)
+    return (0);
+
+  pthread_mutex_lock (&agg_shard_lock);
+  *index = agg_shard_next % AGG_SHARDS;
+  agg_shard_next++;
+  pthread_mutex_unlock (&agg_shard_lock);
+
+  if (pthread_setspecific (agg_shard_key, index) != 0)
+  {
+    size_t tmp = *index;
+    sfree (index);
+    return (tmp);
+  }
+
+  return (*index);
+} /* }}} size_t agg_shard_index */
+
+static void agg_accumulator_reset (agg_accumulator_t *acc) /* {{{ */
+{
+  acc->num = 0;
+  acc->sum = 0.0;
+  acc->squares_sum = 0.0;
+  acc->min = NAN;
+  acc->max = NAN;
+  if (acc->sketch != NULL)
+    sketch_reset (acc->sketch);
+} /* }}} void agg_accumulator_reset */
+
 static _Bool agg_is_regex (char const *str) /* {{{ */
 {
   size_t len;
@@ -110,12 +196,18 @@ static _Bool agg_is_regex (char const *str) /* {{{ */
 
 static void agg_destroy (aggregation_t *agg) /* {{{ */
 {
+  if (agg == NULL)
+    return;
+
+  sfree (agg->percentiles);
   sfree (agg);
 } /* }}} void agg_destroy */
 
 /* Frees all dynamically allocated memory within the instance. */
 static void agg_instance_destroy (agg_instance_t *inst) /* {{{ */
 {
+  size_t i;
+
   if (inst == NULL)
     return;
 
@@ -139,11 +231,17 @@ static void agg_instance_destroy (agg_instance_t *inst) /* {{{ */
   sfree (inst->state_min);
   sfree (inst->state_max);
   sfree (inst->state_stddev);
+  sfree (inst->state_percentiles);
+  sketch_destroy (inst->sketch);
+
+  for (i = 0; i < AGG_SHARDS; i++)
+  {
+    sketch_destroy (inst->acc[i].sketch);
+    pthread_mutex_destroy (&inst->acc[i].lock);
+  }
 
   memset (inst, 0, sizeof (*inst));
   inst->ds_type = -1;
-  inst->min = NAN;
-  inst->max = NAN;
 } /* }}} void agg_instance_destroy */
 
 static int agg_instance_create_name (agg_instance_t *inst, /* {{{ */
@@ -237,6 +335,7 @@ static agg_instance_t *agg_instance_create (data_set_t const *ds, /* {{{ */
     value_list_t const *vl, aggregation_t *agg)
 {
   agg_instance_t *inst;
+  size_t i;
 
   DEBUG ("aggregation plugin: Creating new instance.");
 
@@ -247,15 +346,16 @@ static agg_instance_t *agg_instance_create (data_set_t const *ds, /* {{{ */
     return (NULL);
   }
   memset (inst, 0, sizeof (*inst));
-  pthread_mutex_init (&inst->lock, /* attr = */ NULL);
+  for (i = 0; i < AGG_SHARDS; i++)
+  {
+    pthread_mutex_init (&inst->acc[i].lock, /* attr = */ NULL);
+    agg_accumulator_reset (&inst->acc[i]);
+  }
 
   inst->ds_type = ds->ds[0].type;
 
   agg_instance_create_name (inst, vl, agg);
 
-  inst->min = NAN;
-  inst->max = NAN;
-
 #define INIT_STATE(field) do { \
   inst->state_ ## field = NULL; \
   if (agg->calc_ ## field) { \
@@ -278,6 +378,35 @@ static agg_instance_t *agg_instance_create (data_set_t const *ds, /* {{{ */
 
 #undef INIT_STATE
 
+  if (agg->percentiles_num > 0)
+  {
+    _Bool failed;
+
+    inst->percentiles = agg->percentiles;
+    inst->percentiles_num = agg->percentiles_num;
+    inst->state_percentiles = calloc (agg->percentiles_num,
+        sizeof (*inst->state_percentiles));
+    inst->sketch = sketch_create (agg->percentile_accuracy,
+        (size_t) agg->percentile_buckets);
+    failed = (inst->state_percentiles == NULL) || (inst->sketch == NULL);
+
+    for (i = 0; i < AGG_SHARDS; i++)
+    {
+      inst->acc[i].sketch = sketch_create (agg->percentile_accuracy,
+          (size_t) agg->percentile_buckets);
+      if (inst->acc[i].sketch == NULL)
+        failed = 1;
+    }
+
+    if (failed)
+    {
+      agg_instance_destroy (inst);
+      ERROR ("aggregation plugin: Allocating the percentile sketches "
+          "failed.");
+      return (NULL);
+    }
+  }
+
   pthread_mutex_lock (&agg_instance_list_lock);
   inst->next = agg_instance_list_head;
   agg_instance_list_head = inst;
@@ -293,6 +422,7 @@ static agg_instance_t *agg_instance_create (data_set_t const *ds, /* {{{ */
 static int agg_instance_update (agg_instance_t *inst, /* {{{ */
     data_set_t const *ds, value_list_t const *vl)
 {
+  agg_accumulator_t *acc;
   gauge_t *rate;
 
   if (ds->ds_num != 1)
@@ -319,18 +449,22 @@ static int agg_instance_update (agg_instance_t *inst, /* {{{ */
     return (0);
   }
 
-  pthread_mutex_lock (&inst->lock);
+  acc = inst->acc + agg_shard_index ();
+  pthread_mutex_lock (&acc->lock);
+
+  acc->num++;
+  acc->sum += rate[0];
+  acc->squares_sum += (rate[0] * rate[0]);
 
-  inst->num++;
-  inst->sum += rate[0];
-  inst->squares_sum += (rate[0] * rate[0]);
+  if (isnan (acc->min) || (acc->min > rate[0]))
+    acc->min = rate[0];
+  if (isnan (acc->max) || (acc->max < rate[0]))
+    acc->max = rate[0];
 
-  if (isnan (inst->min) || (inst->min > rate[0]))
-    inst->min = rate[0];
-  if (isnan (inst->max) || (inst->max < rate[0]))
-    inst->max = rate[0];
+  if (acc->sketch != NULL)
+    sketch_add (acc->sketch, rate[0]);
 
-  pthread_mutex_unlock (&inst->lock);
+  pthread_mutex_unlock (&acc->lock);
 
   sfree (rate);
   return (0);
@@ -378,6 +512,39 @@ static int agg_instance_read_func (agg_instance_t *inst, /* {{{ */
 static int agg_instance_read (agg_instance_t *inst, cdtime_t t) /* {{{ */
 {
   value_list_t vl = VALUE_LIST_INIT;
+  agg_accumulator_t total;
+  size_t i;
+
+  /* Merge and reset the accumulators. Only one accumulator is locked at a
+   * time and no lock is held while dispatching. */
+  total.sketch = NULL;
+  agg_accumulator_reset (&total);
+  if (inst->sketch != NULL)
+    sketch_reset (inst->sketch);
+
+  for (i = 0; i < AGG_SHARDS; i++)
+  {
+    agg_accumulator_t *acc = inst->acc + i;
+
+    pthread_mutex_lock (&acc->lock);
+    if (acc->num > 0)
+    {
+      total.num += acc->num;
+      total.sum += acc->sum;
+      total.squares_sum += acc->squares_sum;
+
+      if (isnan (total.min) || (total.min > acc->min))
+        total.min = acc->min;
+      if (isnan (total.max) || (total.max < acc->max))
+        total.max = acc->max;
+
+      if ((inst->sketch != NULL) && (acc->sketch != NULL))
+        sketch_merge (inst->sketch, acc->sketch);
+
+      agg_accumulator_reset (acc);
+    }
+    pthread_mutex_unlock (&acc->lock);
+  }
 
   /* Pre-set all the fields in the value list that will not change per
    * aggregation type (sum, average, ...). The struct will be re-used and must
@@ -407,30 +574,29 @@ static int agg_instance_read (agg_instance_t *inst, cdtime_t t) /* {{{ */
   } \
 } while (0)
 
-  pthread_mutex_lock (&inst->lock);
-
-  READ_FUNC (num, (gauge_t) inst->num);
+  READ_FUNC (num, (gauge_t) total.num);
 
   /* All other aggregations are only defined when there have been any values
    * at all. */
-  if (inst->num > 0)
-  {
-    READ_FUNC (sum, inst->sum);
-    READ_FUNC (average, (inst->sum / ((gauge_t) inst->num)));
-    READ_FUNC (min, inst->min);
-    READ_FUNC (max, inst->max);
-    READ_FUNC (stddev, sqrt((((gauge_t) inst->num) * inst->squares_sum)
-          - (inst->sum * inst->sum)) / ((gauge_t) inst->num));
-  }
-
-  /* Reset internal state. */
-  inst->num = 0;
-  inst->sum = 0.0;
-  inst->squares_sum = 0.0;
-  inst->min = NAN;
-  inst->max = NAN;
+  if (total.num > 0)
+  {
+    READ_FUNC (sum, total.sum);
+    READ_FUNC (average, (total.sum / ((gauge_t) total.num)));
+    READ_FUNC (min, total.min);
+    READ_FUNC (max, total.max);
+    READ_FUNC (stddev, sqrt((((gauge_t) total.num) * total.squares_sum)
+          - (total.sum * total.sum)) / ((gauge_t) total.num));
+
+    for (i = 0; (inst->sketch != NULL) && (i < inst->percentiles_num); i++)
+    {
+      char func[DATA_MAX_NAME_LEN];
 
-  pthread_mutex_unlock (&inst->lock);
+      ssnprintf (func, sizeof (func), "percentile-%g", inst->percentiles[i]);
+      agg_instance_read_func (inst, func,
+          sketch_quantile (inst->sketch, inst->percentiles[i] / 100.0),
+          inst->state_percentiles + i, &vl, inst->ident.plugin_instance, t);
+    }
+  }
 
   meta_data_destroy (vl.meta);
   vl.meta = NULL;
@@ -521,6 +687,56 @@ static int agg_config_handle_group_by (oconfig_item_t const *ci, /* {{{ */
   return (0);
 } /* }}} int agg_config_handle_group_by */
 
+/* Handles "CalculatePercentile 50 90 99". The option may be given multiple
+ * times. */
+static int agg_config_handle_percentile (oconfig_item_t const *ci, /* {{{ */
+    aggregation_t *agg)
+{
+  double *tmp;
+  int i;
+
+  if (ci->values_num < 1)
+  {
+    ERROR ("aggregation plugin: The \"%s\" option requires at least one "
+        "argument.", ci->key);
+    return (-1);
+  }
+
+  tmp = realloc (agg->percentiles,
+      (agg->percentiles_num + ci->values_num) * sizeof (*tmp));
+  if (tmp == NULL)
+  {
+    ERROR ("aggregation plugin: realloc failed.");
+    return (-1);
+  }
+  agg->percentiles = tmp;
+
+  for (i = 0; i < ci->values_num; i++)
+  {
+    double percent;
+
+    if (ci->values[i].type != OCONFIG_TYPE_NUMBER)
+    {
+      WARNING ("aggregation plugin: The arguments to the \"%s\" option "
+          "must be numbers. Argument %i will be ignored.", ci->key, i + 1);
+      continue;
+    }
+
+    percent = ci->values[i].value.number;
+    if ((percent <= 0.0) || (percent > 100.0))
+    {
+      WARNING ("aggregation plugin: The percentile %g is not in the range "
+          "(0, 100] and will be ignored.", percent);
+      continue;
+    }
+
+    agg->percentiles[agg->percentiles_num] = percent;
+    agg->percentiles_num++;
+  }
+
+  return (0);
+} /* }}} int agg_config_handle_percentile */
+
 static int agg_config_aggregation (oconfig_item_t *ci) /* {{{ */
 {
   aggregation_t *agg;
@@ -544,6 +760,9 @@ static int agg_config_aggregation (oconfig_item_t *ci) /* {{{ */
   sstrncpy (agg->ident.type_instance, "/.*/",
       sizeof (agg->ident.type_instance));
 
+  agg->percentile_accuracy = AGG_PERCENTILE_ACCURACY;
+  agg->percentile_buckets = AGG_PERCENTILE_BUCKETS;
+
   for (i = 0; i < ci->children_num; i++)
   {
     oconfig_item_t *child = ci->children + i;
@@ -585,6 +804,12 @@ static int agg_config_aggregation (oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean (child, &agg->calc_max);
     else if (strcasecmp ("CalculateStddev", child->key) == 0)
       cf_util_get_boolean (child, &agg->calc_stddev);
+    else if (strcasecmp ("CalculatePercentile", child->key) == 0)
+      agg_config_handle_percentile (child, agg);
+    else if (strcasecmp ("PercentileAccuracy", child->key) == 0)
+      cf_util_get_double (child, &agg->percentile_accuracy);
+    else if (strcasecmp ("PercentileBuckets", child->key) == 0)
+      cf_util_get_int (child, &agg->percentile_buckets);
     else
       WARNING ("aggregation plugin: The \"%s\" key is not allowed inside "
           "<Aggregation /> blocks and will be ignored.", child->key);
@@ -646,8 +871,23 @@ static int agg_config_aggregation (oconfig_item_t *ci) /* {{{ */
     is_valid = 0;
   } /* }}} */
 
+  if ((agg->percentiles_num > 0) /* {{{ */
+      && ((agg->percentile_accuracy <= 0.0)
+        || (agg->percentile_accuracy >= 1.0)
+        || (agg->percentile_buckets < 1)))
+  {
+    ERROR ("aggregation plugin: \"PercentileAccuracy\" must be between zero "
+        "and one and \"PercentileBuckets\" must be positive. "
+        "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
+        "Type \"%s\", TypeInstance \"%s\")",
+        agg->ident.host, agg->ident.plugin, agg->ident.plugin_instance,
+        agg->ident.type, agg->ident.type_instance);
+    is_valid = 0;
+  } /* }}} */
+
   if (!agg->calc_num && !agg->calc_sum && !agg->calc_average /* {{{ */
-      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev)
+      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev
+      && (agg->percentiles_num == 0))
   {
     ERROR ("aggregation plugin: No aggregation function has been specified. "
         "Without this, I don't know what I should be calculating. "
@@ -660,7 +900,7 @@ static int agg_config_aggregation (oconfig_item_t *ci) /* {{{ */
 
   if (!is_valid) /* {{{ */
   {
-    sfree (agg);
+    agg_destroy (agg);
     return (-1);
   } /* }}} */
 
@@ -668,7 +908,7 @@ static int agg_config_aggregation (oconfig_item_t *ci) /* {{{ */
   if (status != 0)
   {
     ERROR ("aggregation plugin: lookup_add failed with status %i.", status);
-    sfree (agg);
+    agg_destroy (agg);
     return (-1);
   }
 
@@ -718,6 +958,7 @@ static int agg_config (oconfig_item_t *ci) /* {{{ */
 
 static int agg_read (void) /* {{{ */
 {
+  agg_instance_t *head;
   agg_instance_t *this;
   cdtime_t t;
   int success;
@@ -725,7 +966,13 @@ static int agg_read (void) /* {{{ */
   t = cdtime ();
   success = 0;
 
+  /* New instances are only ever prepended to the list and instances are not
+   * removed while the daemon is running. It is therefore safe to walk the
+   * list without holding the lock, so that write threads creating new
+   * instances are not blocked while the values are being dispatched. */
   pthread_mutex_lock (&agg_instance_list_lock);
+  head = agg_instance_list_head;
+  pthread_mutex_unlock (&agg_instance_list_lock);
 
   /* agg_instance_list_head only holds data, after the "write" callback has
    * been called with a matching value list at least once. So on startup,
@@ -733,13 +980,10 @@ static int agg_read (void) /* {{{ */
    * the read() callback is called first, agg_instance_list_head is NULL and
    * "success" may be zero. This is expected and should not result in an error.
    * Therefore we need to handle this case separately. */
-  if (agg_instance_list_head == NULL)
-  {
-    pthread_mutex_unlock (&agg_instance_list_lock);
+  if (head == NULL)
     return (0);
-  }
 
-  for (this = agg_instance_list_head; this != NULL; this = this->next)
+  for (this = head; this != NULL; this = this->next)
   {
     int status;
 
@@ -751,8 +995,6 @@ static int agg_read (void) /* {{{ */
       success++;
   }
 
-  pthread_mutex_unlock (&agg_instance_list_lock);
-
   return ((success > 0) ? 0 : -1);
 } /* }}} int agg_read */
 
@@ -47,6 +47,7 @@ kstat_ctl_t *kc;
 #endif /* HAVE_LIBKSTAT */
 
 static int loop = 0;
+static int reload = 0;
 
 static void *do_flush (void __attribute__((unused)) *arg)
 {
@@ -69,6 +70,11 @@ static void sig_term_handler (int __attribute__((unused)) signal)
 	loop++;
 }
 
+static void sig_hup_handler (int __attribute__((unused)) signal)
+{
+	reload++;
+}
+
 static void sig_usr1_handler (int __attribute__((unused)) signal)
 {
 	pthread_t      thread;
@@ -307,6 +313,17 @@ static int do_init (void)
 } /* int do_init () */
 
 
+/* The configuration is reloaded in the main thread, so that plugins are
+ * configured and initialized the same way as when starting up. */
+static void do_reload (void)
+{
+	if (reload == 0)
+		return;
+
+	reload = 0;
+	cf_reload ();
+} /* void do_reload */
+
 static int do_loop (void)
 {
 	cdtime_t interval = cf_get_default_interval ();
@@ -319,6 +336,9 @@ static int do_loop (void)
 		struct timespec ts_wait = { 0, 0 };
 		cdtime_t now;
 
+		/* The signal may have been delivered to another thread. */
+		do_reload ();
+
 #if HAVE_LIBKSTAT
 		update_kstat ();
 #endif
@@ -349,6 +369,8 @@ static int do_loop (void)
 							sizeof (errbuf)));
 				return (-1);
 			}
+
+			do_reload ();
 		}
 	} /* while (loop == 0) */
 
@@ -395,6 +417,7 @@ int main (int argc, char **argv)
 	struct sigaction sig_int_action;
 	struct sigaction sig_term_action;
 	struct sigaction sig_usr1_action;
+	struct sigaction sig_hup_action;
 	struct sigaction sig_pipe_action;
 	char *configfile = CONFIGFILE;
 	int test_config  = 0;
@@ -578,6 +601,15 @@ int main (int argc, char **argv)
 		return (1);
 	}
 
+	memset (&sig_hup_action, '\0', sizeof (sig_hup_action));
+	sig_hup_action.sa_handler = sig_hup_handler;
+	if (0 != sigaction (SIGHUP, &sig_hup_action, NULL)) {
+		char errbuf[1024];
+		ERROR ("Error: Failed to install a signal handler for signal HUP: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (1);
+	}
+
 	memset (&sig_usr1_action, '\0', sizeof (sig_usr1_action));
 	sig_usr1_action.sa_handler = sig_usr1_handler;
 	if (0 != sigaction (SIGUSR1, &sig_usr1_action, NULL)) {
@@ -1231,6 +1231,101 @@ counter_t counter_diff (counter_t old_value, counter_t new_value)
 	return (diff);
 } /* counter_t counter_diff */
 
+/* Converts one value to a rate. Called with a constant `ds_type' from
+ * values_to_rates(), so that the compiler can drop the switch from the
+ * type-specific loops. */
+static inline int value_to_rate (gauge_t *ret_rate, value_t *raw, /* {{{ */
+		value_t const *value, int ds_type, gauge_t interval)
+{
+	switch (ds_type)
+	{
+		case DS_TYPE_COUNTER:
+			*ret_rate = ((gauge_t) counter_diff (raw->counter,
+						value->counter)) / interval;
+			raw->counter = value->counter;
+			return (0);
+
+		case DS_TYPE_GAUGE:
+			*ret_rate = value->gauge;
+			raw->gauge = value->gauge;
+			return (0);
+
+		case DS_TYPE_DERIVE:
+			*ret_rate = ((gauge_t) (value->derive - raw->derive))
+				/ interval;
+			raw->derive = value->derive;
+			return (0);
+
+		case DS_TYPE_ABSOLUTE:
+			*ret_rate = ((gauge_t) value->absolute) / interval;
+			raw->absolute = value->absolute;
+			return (0);
+	}
+
+	return (EINVAL);
+} /* }}} int value_to_rate */
+
+int values_to_rates (gauge_t *ret_rates, value_t *raw, /* {{{ */
+		value_t const *values, data_set_t const *ds, cdtime_t interval)
+{
+	gauge_t interval_gauge = CDTIME_T_TO_DOUBLE (interval);
+	int ds_type;
+	int status;
+	int i;
+
+	if (ds->ds_num < 1)
+		return (0);
+
+	/* Most data sets have only one type of data source. */
+	ds_type = ds->ds[0].type;
+	for (i = 1; i < ds->ds_num; i++)
+	{
+		if (ds->ds[i].type != ds_type)
+		{
+			ds_type = -1;
+			break;
+		}
+	}
+
+	switch (ds_type)
+	{
+		case DS_TYPE_COUNTER:
+			for (i = 0; i < ds->ds_num; i++)
+				value_to_rate (ret_rates + i, raw + i, values + i,
+						DS_TYPE_COUNTER, interval_gauge);
+			return (0);
+
+		case DS_TYPE_GAUGE:
+			for (i = 0; i < ds->ds_num; i++)
+				value_to_rate (ret_rates + i, raw + i, values + i,
+						DS_TYPE_GAUGE, interval_gauge);
+			return (0);
+
+		case DS_TYPE_DERIVE:
+			for (i = 0; i < ds->ds_num; i++)
+				value_to_rate (ret_rates + i, raw + i, values + i,
+						DS_TYPE_DERIVE, interval_gauge);
+			return (0);
+
+		case DS_TYPE_ABSOLUTE:
+			for (i = 0; i < ds->ds_num; i++)
+				value_to_rate (ret_rates + i, raw + i, values + i,
+						DS_TYPE_ABSOLUTE, interval_gauge);
+			return (0);
+	}
+
+	/* Mixed (or unknown) types. */
+	for (i = 0; i < ds->ds_num; i++)
+	{
+		status = value_to_rate (ret_rates + i, raw + i, values + i,
+				ds->ds[i].type, interval_gauge);
+		if (status != 0)
+			return (status);
+	}
+
+	return (0);
+} /* }}} int values_to_rates */
+
 int rate_to_value (value_t *ret_value, gauge_t rate, /* {{{ */
 		rate_to_value_state_t *state,
 		int ds_type, cdtime_t t)
@@ -300,6 +300,15 @@ int read_file_contents (const char *filename, char *buf, int bufsize);
 
 counter_t counter_diff (counter_t old_value, counter_t new_value);
 
+/* Converts the values of a value list with the data set `ds' to rates.
+ * `raw' holds the previous values and is updated with `values'. `interval' is
+ * the time between the previous and the current values. Counters are checked
+ * for wrap-arounds, see counter_diff(). Returns zero on success and EINVAL if
+ * a data source has an unknown type; in that case, some values may already
+ * have been converted. */
+int values_to_rates (gauge_t *ret_rates, value_t *raw,
+		value_t const *values, data_set_t const *ds, cdtime_t interval);
+
 /* Convert a rate back to a value_t. When converting to a derive_t, counter_t
  * or absoltue_t, take fractional residuals into account. This is important
  * when scaling counters, for example.
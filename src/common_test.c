@@ -0,0 +1,330 @@
+/**
+ * collectd - src/common_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Tests for the rate conversion used by the value cache. values_to_rates() is
+ * compared with the per data source loop it replaced. Run with "-b" to
+ * benchmark both.
+ */
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_cache.h"
+
+#include <time.h>
+
+static int failures = 0;
+
+/*
+ * Stubs for the daemon functions used by common.c.
+ */
+void plugin_log (int level, const char *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  if (level >= LOG_DEBUG)
+    return;
+
+  va_start (ap, format);
+  printf ("[severity %i] ", level);
+  vprintf (format, ap);
+  printf ("\n");
+  va_end (ap);
+} /* }}} void plugin_log */
+
+gauge_t *uc_get_rate (const data_set_t __attribute__((unused)) *ds, /* {{{ */
+    const value_list_t __attribute__((unused)) *vl)
+{
+  return (NULL);
+} /* }}} gauge_t *uc_get_rate */
+
+/* The loop formerly found in uc_update(). */
+static int reference_to_rates (gauge_t *ret_rates, value_t *raw, /* {{{ */
+    value_t const *values, data_set_t const *ds, cdtime_t interval)
+{
+  int i;
+
+  for (i = 0; i < ds->ds_num; i++)
+  {
+    switch (ds->ds[i].type)
+    {
+      case DS_TYPE_COUNTER:
+        ret_rates[i] = ((double) counter_diff (raw[i].counter,
+              values[i].counter)) / (CDTIME_T_TO_DOUBLE (interval));
+        raw[i].counter = values[i].counter;
+        break;
+
+      case DS_TYPE_GAUGE:
+        raw[i].gauge = values[i].gauge;
+        ret_rates[i] = values[i].gauge;
+        break;
+
+      case DS_TYPE_DERIVE:
+        ret_rates[i] = ((double) (values[i].derive - raw[i].derive))
+          / (CDTIME_T_TO_DOUBLE (interval));
+        raw[i].derive = values[i].derive;
+        break;
+
+      case DS_TYPE_ABSOLUTE:
+        ret_rates[i] = ((double) values[i].absolute)
+          / (CDTIME_T_TO_DOUBLE (interval));
+        raw[i].absolute = values[i].absolute;
+        break;
+
+      default:
+        return (EINVAL);
+    }
+  }
+
+  return (0);
+} /* }}} int reference_to_rates */
+
+#define TEST_DS_MAX 8
+
+static void random_value (value_t *v, int ds_type) /* {{{ */
+{
+  uint64_t r = (((uint64_t) rand ()) << 31) ^ ((uint64_t) rand ());
+
+  switch (ds_type)
+  {
+    case DS_TYPE_COUNTER:
+      /* Half of the counters are 32 bit wide, so that both wrap-around
+       * cases are covered. */
+      v->counter = (r & 1) ? (r & 0xffffffffULL) : (r << 2);
+      break;
+    case DS_TYPE_GAUGE:
+      v->gauge = ((gauge_t) (r % 100000)) / 7.0;
+      break;
+    case DS_TYPE_DERIVE:
+      v->derive = (derive_t) (r % 2000000) - 1000000;
+      break;
+    case DS_TYPE_ABSOLUTE:
+      v->absolute = r % 1000000;
+      break;
+  }
+} /* }}} void random_value */
+
+static void check_data_set (char const *name, data_set_t const *ds) /* {{{ */
+{
+  value_t raw_a[TEST_DS_MAX];
+  value_t raw_b[TEST_DS_MAX];
+  value_t values[TEST_DS_MAX];
+  gauge_t rates_a[TEST_DS_MAX];
+  gauge_t rates_b[TEST_DS_MAX];
+  int round;
+  int i;
+
+  for (i = 0; i < ds->ds_num; i++)
+    random_value (raw_a + i, ds->ds[i].type);
+  memcpy (raw_b, raw_a, sizeof (raw_b));
+
+  for (round = 0; round < 1000; round++)
+  {
+    cdtime_t interval = DOUBLE_TO_CDTIME_T (0.1 + (double) (round % 20));
+    int status_a;
+    int status_b;
+
+    for (i = 0; i < ds->ds_num; i++)
+      random_value (values + i, ds->ds[i].type);
+
+    status_a = values_to_rates (rates_a, raw_a, values, ds, interval);
+    status_b = reference_to_rates (rates_b, raw_b, values, ds, interval);
+
+    if ((status_a != 0) || (status_b != 0))
+    {
+      printf ("%s: values_to_rates returned %i, expected %i\n",
+          name, status_a, status_b);
+      failures++;
+      return;
+    }
+
+    if ((memcmp (rates_a, rates_b, ds->ds_num * sizeof (gauge_t)) != 0)
+        || (memcmp (raw_a, raw_b, ds->ds_num * sizeof (value_t)) != 0))
+    {
+      printf ("%s: results differ in round %i\n", name, round);
+      failures++;
+      return;
+    }
+  }
+} /* }}} void check_data_set */
+
+static void test_counter_diff (void) /* {{{ */
+{
+  struct {
+    counter_t old_value;
+    counter_t new_value;
+    counter_t diff;
+  } cases[] = {
+    { 0, 0, 0 },
+    { 10, 20, 10 },
+    { 4294967290ULL, 5, 10 },
+    { 18446744073709551610ULL, 5, 10 },
+    { 4294967295ULL, 4294967296ULL, 1 }
+  };
+  size_t i;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (cases); i++)
+  {
+    counter_t diff = counter_diff (cases[i].old_value, cases[i].new_value);
+    if (diff != cases[i].diff)
+    {
+      printf ("counter_diff (%llu, %llu) = %llu, expected %llu\n",
+          (unsigned long long) cases[i].old_value,
+          (unsigned long long) cases[i].new_value,
+          (unsigned long long) diff, (unsigned long long) cases[i].diff);
+      failures++;
+    }
+  }
+} /* }}} void test_counter_diff */
+
+static data_source_t ds_if_octets[] = {
+  { "rx", DS_TYPE_DERIVE, 0.0, NAN },
+  { "tx", DS_TYPE_DERIVE, 0.0, NAN }
+};
+
+static data_source_t ds_load[] = {
+  { "shortterm", DS_TYPE_GAUGE, 0.0, 100.0 },
+  { "midterm",   DS_TYPE_GAUGE, 0.0, 100.0 },
+  { "longterm",  DS_TYPE_GAUGE, 0.0, 100.0 }
+};
+
+static data_source_t ds_counters[] = {
+  { "a", DS_TYPE_COUNTER, 0.0, NAN },
+  { "b", DS_TYPE_COUNTER, 0.0, NAN },
+  { "c", DS_TYPE_COUNTER, 0.0, NAN },
+  { "d", DS_TYPE_COUNTER, 0.0, NAN }
+};
+
+static data_source_t ds_mixed[] = {
+  { "counter",  DS_TYPE_COUNTER,  0.0, NAN },
+  { "gauge",    DS_TYPE_GAUGE,    0.0, NAN },
+  { "derive",   DS_TYPE_DERIVE,   0.0, NAN },
+  { "absolute", DS_TYPE_ABSOLUTE, 0.0, NAN },
+  { "derive2",  DS_TYPE_DERIVE,   0.0, NAN }
+};
+
+static data_set_t data_sets[] = {
+  { "if_octets", STATIC_ARRAY_SIZE (ds_if_octets), ds_if_octets },
+  { "load",      STATIC_ARRAY_SIZE (ds_load),      ds_load },
+  { "counters",  STATIC_ARRAY_SIZE (ds_counters),  ds_counters },
+  { "mixed",     STATIC_ARRAY_SIZE (ds_mixed),     ds_mixed }
+};
+
+static void test_values_to_rates (void) /* {{{ */
+{
+  data_source_t bad = { "bad", 42, 0.0, NAN };
+  data_set_t ds_bad = { "bad", 1, &bad };
+  value_t raw = { .gauge = 0.0 };
+  value_t value = { .gauge = 1.0 };
+  gauge_t rate;
+  size_t i;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (data_sets); i++)
+    check_data_set (data_sets[i].type, data_sets + i);
+
+  if (values_to_rates (&rate, &raw, &value, &ds_bad, TIME_T_TO_CDTIME_T (1))
+      != EINVAL)
+  {
+    printf ("values_to_rates accepted an unknown data source type\n");
+    failures++;
+  }
+} /* }}} void test_values_to_rates */
+
+#define BENCH_ROUNDS 10000000
+
+/* Keeps the compiler from optimizing the benchmark loops away. */
+static volatile gauge_t bench_sink;
+
+static double bench_now (void) /* {{{ */
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1e9);
+} /* }}} double bench_now */
+
+static void benchmark (void) /* {{{ */
+{
+  size_t i;
+
+  printf ("%-10s %14s %14s\n", "data set", "reference/s", "vectorized/s");
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (data_sets); i++)
+  {
+    data_set_t const *ds = data_sets + i;
+    value_t raw[TEST_DS_MAX];
+    value_t values[2][TEST_DS_MAX];
+    gauge_t rates[TEST_DS_MAX];
+    double t_ref;
+    double t_vec;
+    int round;
+    int j;
+
+    for (j = 0; j < ds->ds_num; j++)
+    {
+      random_value (raw + j, ds->ds[j].type);
+      random_value (values[0] + j, ds->ds[j].type);
+      random_value (values[1] + j, ds->ds[j].type);
+    }
+
+    t_ref = bench_now ();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+      reference_to_rates (rates, raw, values[round & 1], ds,
+          TIME_T_TO_CDTIME_T (10));
+      bench_sink = rates[0];
+    }
+    t_ref = bench_now () - t_ref;
+
+    t_vec = bench_now ();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+      values_to_rates (rates, raw, values[round & 1], ds,
+          TIME_T_TO_CDTIME_T (10));
+      bench_sink = rates[0];
+    }
+    t_vec = bench_now () - t_vec;
+
+    printf ("%-10s %14.0f %14.0f\n", ds->type,
+        ((double) BENCH_ROUNDS) / t_ref, ((double) BENCH_ROUNDS) / t_vec);
+  }
+} /* }}} void benchmark */
+
+int main (int argc, char **argv) /* {{{ */
+{
+  srand (42);
+
+  test_counter_diff ();
+  test_values_to_rates ();
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  if ((argc > 1) && (strcmp ("-b", argv[1]) == 0))
+    benchmark ();
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
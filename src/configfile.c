@@ -108,8 +108,14 @@ static cf_global_option_t cf_global_options[] =
 	{"FQDNLookup",  NULL, "true"},
 	{"Interval",    NULL, NULL},
 	{"ReadThreads", NULL, "5"},
+	{"MaxReadThreads", NULL, NULL},
+	{"ReadTimeout", NULL, NULL},
+	{"ReadSchedule", NULL, "Immediate"},
+	{"Profiling",   NULL, "false"},
 	{"WriteThreads", NULL, "5"},
 	{"Timeout",     NULL, "2"},
+	{"CacheFile",   NULL, NULL},
+	{"CacheSaveInterval", NULL, "0"},
 	{"PreCacheChain",  NULL, "PreCache"},
 	{"PostCacheChain", NULL, "PostCache"}
 };
@@ -117,6 +123,11 @@ static int cf_global_options_num = STATIC_ARRAY_SIZE (cf_global_options);
 
 static int cf_default_typesdb = 1;
 
+/* The file passed to cf_read() and the configuration read from it, which is
+ * compared to the new configuration by cf_reload(). */
+static char *cf_filename = NULL;
+static oconfig_item_t *cf_config = NULL;
+
 /*
  * Functions to handle register/unregister, search, and other plugin related
  * stuff
@@ -305,6 +316,52 @@ static int dispatch_loadplugin (const oconfig_item_t *ci)
 
 			ctx.interval = DOUBLE_TO_CDTIME_T (interval);
 		}
+		else if (strcasecmp ("ReadThreadPool", ci->children[i].key) == 0) {
+			char *pool = NULL;
+			int status;
+
+			if (cf_util_get_string (ci->children + i, &pool) != 0)
+				continue;
+
+			status = plugin_read_pool_get (pool);
+			if (status < 0)
+				ERROR ("Creating the read thread pool \"%s\" "
+						"failed.", pool);
+			else
+				ctx.read_pool = status;
+			sfree (pool);
+		}
+		else if (strcasecmp ("ReadTimeout", ci->children[i].key) == 0) {
+			double timeout = 0.0;
+
+			if (cf_util_get_double (ci->children + i, &timeout) != 0) {
+				/* cf_util_get_double will log an error */
+				continue;
+			}
+
+			ctx.read_timeout = DOUBLE_TO_CDTIME_T (timeout);
+		}
+		else if (strcasecmp ("MinInterval", ci->children[i].key) == 0) {
+			double interval = 0.0;
+
+			if (cf_util_get_double (ci->children + i, &interval) != 0) {
+				/* cf_util_get_double will log an error */
+				continue;
+			}
+
+			ctx.min_interval = DOUBLE_TO_CDTIME_T (interval);
+		}
+		else if (strcasecmp ("ChangeThreshold", ci->children[i].key) == 0) {
+			if (cf_util_get_double (ci->children + i,
+						&ctx.change_threshold) != 0)
+				continue;
+
+			if (ctx.change_threshold <= 0.0) {
+				WARNING ("The ChangeThreshold of the %s plugin "
+						"must be greater than zero.", name);
+				ctx.change_threshold = 0.0;
+			}
+		}
 		else {
 			WARNING("Ignoring unknown LoadPlugin option \"%s\" "
 					"for plugin \"%s\"",
@@ -312,6 +369,12 @@ static int dispatch_loadplugin (const oconfig_item_t *ci)
 		}
 	}
 
+	if ((ctx.min_interval != 0) && (ctx.min_interval >= ctx.interval)) {
+		WARNING ("The MinInterval of the %s plugin is not smaller than "
+				"its Interval. Its interval will not adapt.", name);
+		ctx.min_interval = 0;
+	}
+
 	old_ctx = plugin_set_ctx (ctx);
 	ret_val = plugin_load (name, (uint32_t) flags);
 	/* reset to the "global" context */
@@ -430,6 +493,40 @@ static int dispatch_block_plugin (oconfig_item_t *ci)
 }
 
 
+static int dispatch_read_thread_pool (oconfig_item_t *ci)
+{
+	char *name = NULL;
+	int threads = 0;
+	int max_threads = 0;
+	int status;
+	int i;
+
+	if (cf_util_get_string (ci, &name) != 0)
+		return (-1);
+
+	for (i = 0; i < ci->children_num; i++)
+	{
+		oconfig_item_t *child = ci->children + i;
+
+		if (strcasecmp ("Threads", child->key) == 0)
+			cf_util_get_int (child, &threads);
+		else if (strcasecmp ("MaxThreads", child->key) == 0)
+			cf_util_get_int (child, &max_threads);
+		else
+			WARNING ("Ignoring unknown ReadThreadPool option "
+					"\"%s\" for pool \"%s\".",
+					child->key, name);
+	}
+
+	status = plugin_read_pool_configure (name, threads, max_threads);
+	if (status != 0)
+		ERROR ("Configuring the read thread pool \"%s\" failed "
+				"with status %i.", name, status);
+
+	sfree (name);
+	return (status);
+} /* int dispatch_read_thread_pool */
+
 static int dispatch_block (oconfig_item_t *ci)
 {
 	if (strcasecmp (ci->key, "LoadPlugin") == 0)
@@ -438,6 +535,8 @@ static int dispatch_block (oconfig_item_t *ci)
 		return (dispatch_block_plugin (ci));
 	else if (strcasecmp (ci->key, "Chain") == 0)
 		return (fc_configure (ci));
+	else if (strcasecmp (ci->key, "ReadThreadPool") == 0)
+		return (dispatch_read_thread_pool (ci));
 
 	return (0);
 }
@@ -978,6 +1077,45 @@ void cf_unregister_complex (const char *type)
 		}
 } /* void cf_unregister */
 
+void cf_unregister_plugin (const char *plugin) /* {{{ */
+{
+	cf_callback_t **cb_ptr;
+	cf_complex_callback_t **ccb_ptr;
+
+	cb_ptr = &first_callback;
+	while (*cb_ptr != NULL)
+	{
+		cf_callback_t *this = *cb_ptr;
+
+		if ((this->ctx.name == NULL)
+				|| (strcasecmp (this->ctx.name, plugin) != 0))
+		{
+			cb_ptr = &this->next;
+			continue;
+		}
+
+		*cb_ptr = this->next;
+		free (this);
+	}
+
+	ccb_ptr = &complex_callback_head;
+	while (*ccb_ptr != NULL)
+	{
+		cf_complex_callback_t *this = *ccb_ptr;
+
+		if ((this->ctx.name == NULL)
+				|| (strcasecmp (this->ctx.name, plugin) != 0))
+		{
+			ccb_ptr = &this->next;
+			continue;
+		}
+
+		*ccb_ptr = this->next;
+		sfree (this->type);
+		sfree (this);
+	}
+} /* }}} void cf_unregister_plugin */
+
 void cf_register (const char *type,
 		int (*callback) (const char *, const char *),
 		const char **keys, int keys_num)
@@ -1048,6 +1186,23 @@ int cf_read (char *filename)
 		return (-1);
 	}
 
+	/* Remember an absolute path, because the working directory is changed
+	 * to the `BaseDir' afterwards. */
+	sfree (cf_filename);
+	if (filename[0] == '/')
+		cf_filename = strdup (filename);
+	else
+	{
+		char cwd[PATH_MAX];
+		char path[PATH_MAX];
+
+		if (getcwd (cwd, sizeof (cwd)) != NULL)
+		{
+			ssnprintf (path, sizeof (path), "%s/%s", cwd, filename);
+			cf_filename = strdup (path);
+		}
+	}
+
 	for (i = 0; i < conf->children_num; i++)
 	{
 		if (conf->children[i].children == NULL)
@@ -1056,7 +1211,9 @@ int cf_read (char *filename)
 			dispatch_block (conf->children + i);
 	}
 
-	oconfig_free (conf);
+	if (cf_config != NULL)
+		oconfig_free (cf_config);
+	cf_config = conf;
 
 	/* Read the default types.db if no `TypesDB' option was given. */
 	if (cf_default_typesdb)
@@ -1065,6 +1222,499 @@ int cf_read (char *filename)
 	return (0);
 } /* int cf_read */
 
+/*
+ * Reloading the configuration
+ */
+#define CF_ITEM_OTHER  0
+#define CF_ITEM_PLUGIN 1
+#define CF_ITEM_CHAIN  2
+
+/* Returns zero if `a' and `b', including all children, are equal. */
+static int cf_ci_compare (const oconfig_item_t *a, /* {{{ */
+		const oconfig_item_t *b)
+{
+	int i;
+
+	if ((strcasecmp (a->key, b->key) != 0)
+			|| (a->values_num != b->values_num)
+			|| (a->children_num != b->children_num))
+		return (-1);
+
+	for (i = 0; i < a->values_num; i++)
+	{
+		const oconfig_value_t *va = a->values + i;
+		const oconfig_value_t *vb = b->values + i;
+
+		if (va->type != vb->type)
+			return (-1);
+
+		if ((va->type == OCONFIG_TYPE_STRING)
+				&& (strcmp (va->value.string, vb->value.string) != 0))
+			return (-1);
+		else if ((va->type == OCONFIG_TYPE_NUMBER)
+				&& (va->value.number != vb->value.number))
+			return (-1);
+		else if ((va->type == OCONFIG_TYPE_BOOLEAN)
+				&& (va->value.boolean != vb->value.boolean))
+			return (-1);
+	}
+
+	for (i = 0; i < a->children_num; i++)
+		if (cf_ci_compare (a->children + i, b->children + i) != 0)
+			return (-1);
+
+	return (0);
+} /* }}} int cf_ci_compare */
+
+/* Returns the name of the plugin a top level item belongs to, or NULL. */
+static const char *cf_ci_plugin (const oconfig_item_t *ci) /* {{{ */
+{
+	if ((strcasecmp ("LoadPlugin", ci->key) != 0)
+			&& (strcasecmp ("Plugin", ci->key) != 0))
+		return (NULL);
+
+	if ((ci->values_num < 1)
+			|| (ci->values[0].type != OCONFIG_TYPE_STRING))
+		return (NULL);
+
+	return (ci->values[0].value.string);
+} /* }}} const char *cf_ci_plugin */
+
+/* Returns true if the top level item `ci' belongs to `class' and, if
+ * `plugin' is not NULL, to that plugin. */
+static _Bool cf_ci_match (const oconfig_item_t *ci, /* {{{ */
+		int class, const char *plugin)
+{
+	const char *name = cf_ci_plugin (ci);
+
+	if (name != NULL)
+		return ((class == CF_ITEM_PLUGIN) && ((plugin == NULL)
+					|| (strcasecmp (name, plugin) == 0)));
+
+	if ((strcasecmp ("Chain", ci->key) == 0)
+			|| (strcasecmp ("PreCacheChain", ci->key) == 0)
+			|| (strcasecmp ("PostCacheChain", ci->key) == 0))
+		return (class == CF_ITEM_CHAIN);
+
+	return (class == CF_ITEM_OTHER);
+} /* }}} _Bool cf_ci_match */
+
+/* Returns zero if the top level items matching `class' and `plugin' are the
+ * same, and in the same order, in `old' and `new'. */
+static int cf_ci_compare_class (const oconfig_item_t *old, /* {{{ */
+		const oconfig_item_t *new, int class, const char *plugin)
+{
+	int i = 0;
+	int j = 0;
+
+	while (42)
+	{
+		while ((i < old->children_num)
+				&& !cf_ci_match (old->children + i, class, plugin))
+			i++;
+		while ((j < new->children_num)
+				&& !cf_ci_match (new->children + j, class, plugin))
+			j++;
+
+		if ((i >= old->children_num) || (j >= new->children_num))
+			break;
+
+		if (cf_ci_compare (old->children + i, new->children + j) != 0)
+			return (-1);
+		i++;
+		j++;
+	}
+
+	if ((i < old->children_num) || (j < new->children_num))
+		return (-1);
+	return (0);
+} /* }}} int cf_ci_compare_class */
+
+/* Returns true if `root' has an item equal to `ci'. */
+static _Bool cf_ci_contains (const oconfig_item_t *root, /* {{{ */
+		const oconfig_item_t *ci)
+{
+	int i;
+
+	for (i = 0; i < root->children_num; i++)
+		if (cf_ci_compare (root->children + i, ci) == 0)
+			return (1);
+
+	return (0);
+} /* }}} _Bool cf_ci_contains */
+
+/* Sets the parent of `ci' to `parent' and fixes the parents of all items
+ * below `ci'. */
+static void cf_ci_set_parent (oconfig_item_t *ci, /* {{{ */
+		oconfig_item_t *parent)
+{
+	int i;
+
+	ci->parent = parent;
+	for (i = 0; i < ci->children_num; i++)
+		cf_ci_set_parent (ci->children + i, ci);
+} /* }}} void cf_ci_set_parent */
+
+/* Replaces the items of the plugin `plugin' in `new' with copies of its items
+ * in `old', so that a change which couldn't be applied is tried again by the
+ * next reload. */
+static int cf_ci_keep (oconfig_item_t *new, /* {{{ */
+		const oconfig_item_t *old, const char *plugin)
+{
+	oconfig_item_t *children;
+	int children_num;
+	int kept_num;
+	int i;
+
+	kept_num = 0;
+	for (i = 0; i < new->children_num; i++)
+		if (!cf_ci_match (new->children + i, CF_ITEM_PLUGIN, plugin))
+			kept_num++;
+
+	children_num = kept_num;
+	for (i = 0; i < old->children_num; i++)
+		if (cf_ci_match (old->children + i, CF_ITEM_PLUGIN, plugin))
+			children_num++;
+
+	children = calloc ((children_num > 0) ? children_num : 1,
+			sizeof (*children));
+	if (children == NULL)
+		return (ENOMEM);
+
+	/* Copy the old items first, so that `new' is left alone on failure. */
+	children_num = kept_num;
+	for (i = 0; i < old->children_num; i++)
+	{
+		oconfig_item_t *copy;
+
+		if (!cf_ci_match (old->children + i, CF_ITEM_PLUGIN, plugin))
+			continue;
+
+		copy = oconfig_clone (old->children + i);
+		if (copy == NULL)
+		{
+			while (children_num > kept_num)
+				oconfig_free (children + --children_num);
+			sfree (children);
+			return (ENOMEM);
+		}
+
+		children[children_num++] = *copy;
+		sfree (copy);
+	}
+
+	kept_num = 0;
+	for (i = 0; i < new->children_num; i++)
+	{
+		if (cf_ci_match (new->children + i, CF_ITEM_PLUGIN, plugin))
+			oconfig_free (new->children + i);
+		else
+			children[kept_num++] = new->children[i];
+	}
+
+	sfree (new->children);
+	new->children = children;
+	new->children_num = children_num;
+
+	for (i = 0; i < new->children_num; i++)
+		cf_ci_set_parent (new->children + i, new);
+
+	return (0);
+} /* }}} int cf_ci_keep */
+
+/* Global options, `TypesDB', `PluginDir' and `ReadThreadPool' blocks are only
+ * used while starting up. */
+static void cf_reload_other (const oconfig_item_t *old, /* {{{ */
+		const oconfig_item_t *new)
+{
+	int i;
+
+	for (i = 0; i < new->children_num; i++)
+	{
+		const oconfig_item_t *ci = new->children + i;
+
+		if (!cf_ci_match (ci, CF_ITEM_OTHER, NULL)
+				|| cf_ci_contains (old, ci))
+			continue;
+
+		WARNING ("cf_reload: The `%s' option has been added or changed. "
+				"Restart collectd to apply this change.", ci->key);
+	}
+
+	for (i = 0; i < old->children_num; i++)
+	{
+		const oconfig_item_t *ci = old->children + i;
+		int j;
+
+		if (!cf_ci_match (ci, CF_ITEM_OTHER, NULL)
+				|| cf_ci_contains (new, ci))
+			continue;
+
+		/* Changed options have been reported above. */
+		for (j = 0; j < new->children_num; j++)
+			if (strcasecmp (ci->key, new->children[j].key) == 0)
+				break;
+		if (j < new->children_num)
+			continue;
+
+		WARNING ("cf_reload: The `%s' option has been removed. "
+				"Restart collectd to apply this change.", ci->key);
+	}
+} /* }}} void cf_reload_other */
+
+/* Loads, configures and initializes the plugin `plugin' using the items of
+ * `new'. Returns EPERM if the plugin tried to register a callback which can't
+ * be added while collectd is running, see plugin_reload_begin(). The plugin
+ * has been unloaded again in that case. */
+static int cf_reload_plugin_load (oconfig_item_t *new, /* {{{ */
+		const char *plugin)
+{
+	int i;
+
+	for (i = 0; i < new->children_num; i++)
+	{
+		oconfig_item_t *ci = new->children + i;
+
+		if (cf_ci_match (ci, CF_ITEM_PLUGIN, plugin)
+				&& (strcasecmp ("LoadPlugin", ci->key) == 0))
+			dispatch_loadplugin (ci);
+	}
+
+	for (i = 0; i < new->children_num; i++)
+	{
+		oconfig_item_t *ci = new->children + i;
+
+		if (plugin_reload_refused (plugin))
+			break;
+
+		if (cf_ci_match (ci, CF_ITEM_PLUGIN, plugin)
+				&& (strcasecmp ("Plugin", ci->key) == 0))
+			dispatch_block_plugin (ci);
+	}
+
+	if (!plugin_reload_refused (plugin))
+		plugin_init_plugin (plugin);
+
+	if (plugin_reload_refused (plugin))
+	{
+		plugin_unload (plugin);
+		NOTICE ("cf_reload: The \"%s\" plugin provides write, flush, "
+				"log or notification callbacks or data sets and "
+				"can't be loaded while collectd is running. "
+				"Restart collectd to apply this change.", plugin);
+		return (EPERM);
+	}
+
+	return (0);
+} /* }}} int cf_reload_plugin_load */
+
+/* Applies changes to the configuration of the plugin `plugin'. Returns
+ * non-zero if the change couldn't be applied and the plugin is still running
+ * with (or without) its configuration in `old'. */
+static int cf_reload_plugin (oconfig_item_t *old, /* {{{ */
+		oconfig_item_t *new, const char *plugin)
+{
+	_Bool in_old = 0;
+	_Bool in_new = 0;
+	int status;
+	int i;
+
+	if (cf_ci_compare_class (old, new, CF_ITEM_PLUGIN, plugin) == 0)
+		return (0);
+
+	for (i = 0; i < old->children_num; i++)
+		if (cf_ci_match (old->children + i, CF_ITEM_PLUGIN, plugin))
+			in_old = 1;
+	for (i = 0; i < new->children_num; i++)
+		if (cf_ci_match (new->children + i, CF_ITEM_PLUGIN, plugin))
+			in_new = 1;
+
+	if (in_old)
+	{
+		status = plugin_unload (plugin);
+		if (status == EPERM)
+		{
+			NOTICE ("cf_reload: The configuration of the \"%s\" "
+					"plugin has changed, but the plugin can't "
+					"be reloaded. Restart collectd to apply "
+					"this change.", plugin);
+			return (status);
+		}
+		else if ((status != 0) && (status != ENOENT))
+			return (status);
+	}
+
+	if (!in_new)
+		return (0);
+
+	status = cf_reload_plugin_load (new, plugin);
+	if (status != 0)
+	{
+		/* Go back to the previous configuration of the plugin. */
+		if (in_old)
+			cf_reload_plugin_load (old, plugin);
+		return (status);
+	}
+
+	INFO ("cf_reload: The \"%s\" plugin has been %s.", plugin,
+			in_old ? "reloaded" : "loaded");
+	return (0);
+} /* }}} int cf_reload_plugin */
+
+/* Remembers that the change of the configuration of `plugin' couldn't be
+ * applied. */
+static void cf_reload_failed (char ***failed, size_t *failed_num, /* {{{ */
+		const char *plugin)
+{
+	char **tmp;
+
+	tmp = realloc (*failed, (*failed_num + 1) * sizeof (*tmp));
+	if (tmp == NULL)
+		return;
+	*failed = tmp;
+
+	tmp[*failed_num] = strdup (plugin);
+	if (tmp[*failed_num] != NULL)
+		(*failed_num)++;
+} /* }}} void cf_reload_failed */
+
+/* Replaces the filter chains. Plugins providing matches and targets must have
+ * been loaded before. */
+static void cf_reload_chains (oconfig_item_t *new) /* {{{ */
+{
+	fc_chain_t *old_chains;
+	int i;
+
+	old_chains = fc_chains_detach ();
+
+	global_option_set ("PreCacheChain", NULL);
+	global_option_set ("PostCacheChain", NULL);
+
+	for (i = 0; i < new->children_num; i++)
+	{
+		oconfig_item_t *ci = new->children + i;
+
+		if (!cf_ci_match (ci, CF_ITEM_CHAIN, NULL))
+			continue;
+
+		if (strcasecmp ("Chain", ci->key) == 0)
+			fc_configure (ci);
+		else
+			dispatch_global_option (ci);
+	}
+
+	plugin_reload_chains ();
+	fc_chains_free (old_chains);
+
+	INFO ("cf_reload: The filter chains have been replaced.");
+} /* }}} void cf_reload_chains */
+
+int cf_reload (void) /* {{{ */
+{
+	oconfig_item_t *new;
+	/* Plugins whose changes couldn't be applied. */
+	char **failed = NULL;
+	size_t failed_num = 0;
+	size_t k;
+	int i;
+
+	if ((cf_filename == NULL) || (cf_config == NULL))
+		return (-1);
+
+	INFO ("cf_reload: Reloading the configuration from %s.", cf_filename);
+
+	new = cf_read_generic (cf_filename, /* pattern = */ NULL,
+			/* depth = */ 0);
+	if (new == NULL)
+	{
+		ERROR ("cf_reload: Unable to read config file %s. Keeping the "
+				"current configuration.", cf_filename);
+		return (-1);
+	}
+
+	cf_reload_other (cf_config, new);
+
+	plugin_reload_begin ();
+
+	/* Plugins which are only in the old configuration have to be unloaded,
+	 * too. */
+	for (i = 0; i < cf_config->children_num; i++)
+	{
+		const char *plugin = cf_ci_plugin (cf_config->children + i);
+		int j;
+
+		if (plugin == NULL)
+			continue;
+
+		for (j = 0; j < i; j++)
+			if (cf_ci_match (cf_config->children + j,
+						CF_ITEM_PLUGIN, plugin))
+				break;
+		if (j < i)
+			continue;
+
+		if (cf_reload_plugin (cf_config, new, plugin) != 0)
+			cf_reload_failed (&failed, &failed_num, plugin);
+	}
+
+	for (i = 0; i < new->children_num; i++)
+	{
+		const char *plugin = cf_ci_plugin (new->children + i);
+		int j;
+
+		if (plugin == NULL)
+			continue;
+
+		for (j = 0; j < i; j++)
+			if (cf_ci_match (new->children + j,
+						CF_ITEM_PLUGIN, plugin))
+				break;
+		if (j < i)
+			continue;
+
+		/* Handled by the loop above. */
+		for (j = 0; j < cf_config->children_num; j++)
+			if (cf_ci_match (cf_config->children + j,
+						CF_ITEM_PLUGIN, plugin))
+				break;
+		if (j < cf_config->children_num)
+			continue;
+
+		if (cf_reload_plugin (cf_config, new, plugin) != 0)
+			cf_reload_failed (&failed, &failed_num, plugin);
+	}
+
+	/* Keep the previous configuration of these plugins, so that the
+	 * change is tried again by the next reload. */
+	for (k = 0; k < failed_num; k++)
+	{
+		cf_ci_keep (new, cf_config, failed[k]);
+		sfree (failed[k]);
+	}
+	sfree (failed);
+
+	if (cf_ci_compare_class (cf_config, new, CF_ITEM_CHAIN, NULL) != 0)
+		cf_reload_chains (new);
+
+	plugin_reload_end ();
+
+	oconfig_free (cf_config);
+	sfree (cf_config);
+	cf_config = new;
+
+	if (failed_num > 0)
+	{
+		WARNING ("cf_reload: The configuration has been reloaded "
+				"partially. The changes of %zu plugin%s couldn't "
+				"be applied.", failed_num,
+				(failed_num == 1) ? "" : "s");
+		return (1);
+	}
+
+	INFO ("cf_reload: Finished reloading the configuration.");
+	return (0);
+} /* }}} int cf_reload */
+
 /* Assures the config option is a string, duplicates it and returns the copy in
  * "ret_string". If necessary "*ret_string" is freed first. Returns zero upon
  * success. */
@@ -37,6 +37,9 @@
 void cf_unregister (const char *type);
 void cf_unregister_complex (const char *type);
 
+/* Removes all config callbacks registered by the plugin `plugin'. */
+void cf_unregister_plugin (const char *plugin);
+
 /*
  * DESCRIPTION
  *  `cf_register' is called by plugins that wish to receive config keys. The
@@ -84,6 +87,23 @@ int cf_register_complex (const char *type, int (*callback) (oconfig_item_t *));
  */
 int cf_read (char *filename);
 
+/*
+ * DESCRIPTION
+ *  `cf_reload' reads the config file passed to `cf_read' again and applies the
+ *  differences to the running daemon: Plugins whose configuration has changed
+ *  are unloaded, if possible, and loaded again with the new configuration, and
+ *  the filter chains are replaced. Changes which can't be applied without a
+ *  restart are logged.
+ *
+ * RETURN VALUE
+ *  Returns zero upon success and non-zero if the config file couldn't be
+ *  read or the changes of some plugins couldn't be applied. In the first case
+ *  the current configuration stays active; in the latter the previous
+ *  configuration of these plugins is kept, so that the next reload tries to
+ *  apply their changes again.
+ */
+int cf_reload (void);
+
 int global_option_set (const char *option, const char *value);
 const char *global_option_get (const char *option);
 
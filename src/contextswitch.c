@@ -24,6 +24,7 @@
 #include "collectd.h"
 #include "common.h"
 #include "plugin.h"
+#include "utils_procfs.h"
 
 #ifdef HAVE_SYS_SYSCTL_H
 # include <sys/sysctl.h>
@@ -46,7 +47,8 @@
 # error "No applicable input method."
 #endif
 
-static void cs_submit (derive_t context_switches)
+/* If `value_time' is zero, the current time is used. */
+static void cs_submit (derive_t context_switches, cdtime_t value_time)
 {
 	value_t values[1];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -55,6 +57,7 @@ static void cs_submit (derive_t context_switches)
 
 	vl.values = values;
 	vl.values_len = 1;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "contextswitch", sizeof (vl.plugin));
 	sstrncpy (vl.type, "contextswitch", sizeof (vl.type));
@@ -79,25 +82,29 @@ static int cs_read (void)
 		return (-1);
 	}
 
-	cs_submit (value);
+	cs_submit (value, /* value_time = */ 0);
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[64];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
 	int numfields;
 	char *fields[3];
 	derive_t result = 0;
+	cdtime_t value_time = 0;
 	int status = -2;
 
-	fh = fopen ("/proc/stat", "r");
-	if (fh == NULL) {
-		ERROR ("contextswitch plugin: unable to open /proc/stat: %s",
-				sstrerror (errno, buffer, sizeof (buffer)));
+	snapshot = procfs_snapshot ("/proc/stat", NULL, &value_time);
+	if (snapshot == NULL) {
+		char errbuf[1024];
+		ERROR ("contextswitch plugin: unable to read /proc/stat: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets(buffer, sizeof(buffer), fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		char *endptr;
 
@@ -118,11 +125,11 @@ static int cs_read (void)
 			break;
 		}
 
-		cs_submit(result);
+		cs_submit(result, value_time);
 		status = 0;
 		break;
 	}
-	fclose(fh);
+	sfree (snapshot);
 
 	if (status == -2)
 		ERROR ("contextswitch plugin: Unable to find context switch value.");
@@ -141,7 +148,7 @@ static int cs_read (void)
 		return (-1);
 	}
 
-	cs_submit(perfcputotal.pswitch);
+	cs_submit(perfcputotal.pswitch, /* value_time = */ 0);
 	status = 0;
 #endif /* defined(HAVE_PERFSTAT) */
 
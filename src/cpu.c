@@ -28,6 +28,7 @@
 #include "collectd.h"
 #include "common.h"
 #include "plugin.h"
+#include "utils_procfs.h"
 
 #ifdef HAVE_MACH_KERN_RETURN_H
 # include <mach/kern_return.h>
@@ -145,6 +146,9 @@ static int numcpu;
 static int pnumcpu;
 #endif /* HAVE_PERFSTAT */
 
+/* ID of the "cpu" type, resolved once by init(). */
+static int cpu_type_id = 0;
+
 static int init (void)
 {
 #if PROCESSOR_CPU_LOAD_INFO || PROCESSOR_TEMPERATURE
@@ -163,7 +167,8 @@ static int init (void)
 	DEBUG ("host_processors returned %i %s", (int) cpu_list_len, cpu_list_len == 1 ? "processor" : "processors");
 	INFO ("cpu plugin: Found %i processor%s.", (int) cpu_list_len, cpu_list_len == 1 ? "" : "s");
 
-	cpu_temp_retry_max = 86400 / CDTIME_T_TO_TIME_T (plugin_get_interval ());
+	cpu_temp_retry_max = (int) (86400.0
+			/ CDTIME_T_TO_DOUBLE (plugin_get_interval ()));
 /* #endif PROCESSOR_CPU_LOAD_INFO */
 
 #elif defined(HAVE_LIBKSTAT)
@@ -238,10 +243,14 @@ static int init (void)
 	/* nothing to initialize */
 #endif /* HAVE_PERFSTAT */
 
+	cpu_type_id = plugin_get_type_id ("cpu");
+
 	return (0);
 } /* int init */
 
-static void submit (int cpu_num, const char *type_instance, derive_t value)
+/* If `value_time' is zero, the current time is used. */
+static void submit (int cpu_num, const char *type_instance, derive_t value,
+		cdtime_t value_time)
 {
 	value_t values[1];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -250,11 +259,13 @@ static void submit (int cpu_num, const char *type_instance, derive_t value)
 
 	vl.values = values;
 	vl.values_len = 1;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "cpu", sizeof (vl.plugin));
 	ssnprintf (vl.plugin_instance, sizeof (vl.plugin_instance),
 			"%i", cpu_num);
 	sstrncpy (vl.type, "cpu", sizeof (vl.type));
+	vl.type_id = cpu_type_id;
 	sstrncpy (vl.type_instance, type_instance, sizeof (vl.type_instance));
 
 	plugin_dispatch_values (&vl);
@@ -298,10 +309,10 @@ static int cpu_read (void)
 			continue;
 		}
 
-		submit (cpu, "user", (derive_t) cpu_info.cpu_ticks[CPU_STATE_USER]);
-		submit (cpu, "nice", (derive_t) cpu_info.cpu_ticks[CPU_STATE_NICE]);
-		submit (cpu, "system", (derive_t) cpu_info.cpu_ticks[CPU_STATE_SYSTEM]);
-		submit (cpu, "idle", (derive_t) cpu_info.cpu_ticks[CPU_STATE_IDLE]);
+		submit (cpu, "user", (derive_t) cpu_info.cpu_ticks[CPU_STATE_USER], 0);
+		submit (cpu, "nice", (derive_t) cpu_info.cpu_ticks[CPU_STATE_NICE], 0);
+		submit (cpu, "system", (derive_t) cpu_info.cpu_ticks[CPU_STATE_SYSTEM], 0);
+		submit (cpu, "idle", (derive_t) cpu_info.cpu_ticks[CPU_STATE_IDLE], 0);
 #endif /* PROCESSOR_CPU_LOAD_INFO */
 #if PROCESSOR_TEMPERATURE
 		/*
@@ -352,21 +363,24 @@ static int cpu_read (void)
 	int cpu;
 	derive_t user, nice, syst, idle;
 	derive_t wait, intr, sitr; /* sitr == soft interrupt */
-	FILE *fh;
-	char buf[1024];
+	char *snapshot;
+	char *buf;
+	char *cursor;
+	cdtime_t value_time = 0;
 
 	char *fields[9];
 	int numfields;
 
-	if ((fh = fopen ("/proc/stat", "r")) == NULL)
+	if ((snapshot = procfs_snapshot ("/proc/stat", NULL, &value_time)) == NULL)
 	{
 		char errbuf[1024];
-		ERROR ("cpu plugin: fopen (/proc/stat) failed: %s",
+		ERROR ("cpu plugin: Reading /proc/stat failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buf, 1024, fh) != NULL)
+	cursor = snapshot;
+	while ((buf = procfs_next_line (&cursor)) != NULL)
 	{
 		if (strncmp (buf, "cpu", 3))
 			continue;
@@ -383,10 +397,10 @@ static int cpu_read (void)
 		syst = atoll (fields[3]);
 		idle = atoll (fields[4]);
 
-		submit (cpu, "user", user);
-		submit (cpu, "nice", nice);
-		submit (cpu, "system", syst);
-		submit (cpu, "idle", idle);
+		submit (cpu, "user", user, value_time);
+		submit (cpu, "nice", nice, value_time);
+		submit (cpu, "system", syst, value_time);
+		submit (cpu, "idle", idle, value_time);
 
 		if (numfields >= 8)
 		{
@@ -394,16 +408,16 @@ static int cpu_read (void)
 			intr = atoll (fields[6]);
 			sitr = atoll (fields[7]);
 
-			submit (cpu, "wait", wait);
-			submit (cpu, "interrupt", intr);
-			submit (cpu, "softirq", sitr);
+			submit (cpu, "wait", wait, value_time);
+			submit (cpu, "interrupt", intr, value_time);
+			submit (cpu, "softirq", sitr, value_time);
 
 			if (numfields >= 9)
-				submit (cpu, "steal", atoll (fields[8]));
+				submit (cpu, "steal", atoll (fields[8]), value_time);
 		}
 	}
 
-	fclose (fh);
+	sfree (snapshot);
 /* #endif defined(KERNEL_LINUX) */
 
 #elif defined(HAVE_LIBKSTAT)
@@ -424,10 +438,10 @@ static int cpu_read (void)
 		syst = (derive_t) cs.cpu_sysinfo.cpu[CPU_KERNEL];
 		wait = (derive_t) cs.cpu_sysinfo.cpu[CPU_WAIT];
 
-		submit (ksp[cpu]->ks_instance, "user", user);
-		submit (ksp[cpu]->ks_instance, "system", syst);
-		submit (ksp[cpu]->ks_instance, "idle", idle);
-		submit (ksp[cpu]->ks_instance, "wait", wait);
+		submit (ksp[cpu]->ks_instance, "user", user, 0);
+		submit (ksp[cpu]->ks_instance, "system", syst, 0);
+		submit (ksp[cpu]->ks_instance, "idle", idle, 0);
+		submit (ksp[cpu]->ks_instance, "wait", wait, 0);
 	}
 /* #endif defined(HAVE_LIBKSTAT) */
 
@@ -487,11 +501,11 @@ static int cpu_read (void)
 	}
 
 	for (i = 0; i < numcpu; i++) {
-		submit (i, "user",      cpuinfo[i][CP_USER]);
-		submit (i, "nice",      cpuinfo[i][CP_NICE]);
-		submit (i, "system",    cpuinfo[i][CP_SYS]);
-		submit (i, "idle",      cpuinfo[i][CP_IDLE]);
-		submit (i, "interrupt", cpuinfo[i][CP_INTR]);
+		submit (i, "user",      cpuinfo[i][CP_USER], 0);
+		submit (i, "nice",      cpuinfo[i][CP_NICE], 0);
+		submit (i, "system",    cpuinfo[i][CP_SYS], 0);
+		submit (i, "idle",      cpuinfo[i][CP_IDLE], 0);
+		submit (i, "interrupt", cpuinfo[i][CP_INTR], 0);
 	}
 /* #endif CAN_USE_SYSCTL */
 #elif defined(HAVE_SYSCTLBYNAME) && defined(HAVE_SYSCTL_KERN_CP_TIMES)
@@ -511,11 +525,11 @@ static int cpu_read (void)
 	}
 
 	for (i = 0; i < numcpu; i++) {
-		submit (i, "user", cpuinfo[i][CP_USER]);
-		submit (i, "nice", cpuinfo[i][CP_NICE]);
-		submit (i, "system", cpuinfo[i][CP_SYS]);
-		submit (i, "idle", cpuinfo[i][CP_IDLE]);
-		submit (i, "interrupt", cpuinfo[i][CP_INTR]);
+		submit (i, "user", cpuinfo[i][CP_USER], 0);
+		submit (i, "nice", cpuinfo[i][CP_NICE], 0);
+		submit (i, "system", cpuinfo[i][CP_SYS], 0);
+		submit (i, "idle", cpuinfo[i][CP_IDLE], 0);
+		submit (i, "interrupt", cpuinfo[i][CP_INTR], 0);
 	}
 /* #endif HAVE_SYSCTL_KERN_CP_TIMES */
 #elif defined(HAVE_SYSCTLBYNAME)
@@ -532,11 +546,11 @@ static int cpu_read (void)
 		return (-1);
 	}
 
-	submit (0, "user", cpuinfo[CP_USER]);
-	submit (0, "nice", cpuinfo[CP_NICE]);
-	submit (0, "system", cpuinfo[CP_SYS]);
-	submit (0, "idle", cpuinfo[CP_IDLE]);
-	submit (0, "interrupt", cpuinfo[CP_INTR]);
+	submit (0, "user", cpuinfo[CP_USER], 0);
+	submit (0, "nice", cpuinfo[CP_NICE], 0);
+	submit (0, "system", cpuinfo[CP_SYS], 0);
+	submit (0, "idle", cpuinfo[CP_IDLE], 0);
+	submit (0, "interrupt", cpuinfo[CP_INTR], 0);
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif defined(HAVE_LIBSTATGRAB)
@@ -549,12 +563,12 @@ static int cpu_read (void)
 		return (-1);
 	}
 
-	submit (0, "idle",   (derive_t) cs->idle);
-	submit (0, "nice",   (derive_t) cs->nice);
-	submit (0, "swap",   (derive_t) cs->swap);
-	submit (0, "system", (derive_t) cs->kernel);
-	submit (0, "user",   (derive_t) cs->user);
-	submit (0, "wait",   (derive_t) cs->iowait);
+	submit (0, "idle",   (derive_t) cs->idle, 0);
+	submit (0, "nice",   (derive_t) cs->nice, 0);
+	submit (0, "swap",   (derive_t) cs->swap, 0);
+	submit (0, "system", (derive_t) cs->kernel, 0);
+	submit (0, "user",   (derive_t) cs->user, 0);
+	submit (0, "wait",   (derive_t) cs->iowait, 0);
 /* #endif HAVE_LIBSTATGRAB */
 
 #elif defined(HAVE_PERFSTAT)
@@ -589,10 +603,10 @@ static int cpu_read (void)
 
 	for (i = 0; i < cpus; i++) 
 	{
-		submit (i, "idle",   (derive_t) perfcpu[i].idle);
-		submit (i, "system", (derive_t) perfcpu[i].sys);
-		submit (i, "user",   (derive_t) perfcpu[i].user);
-		submit (i, "wait",   (derive_t) perfcpu[i].wait);
+		submit (i, "idle",   (derive_t) perfcpu[i].idle, 0);
+		submit (i, "system", (derive_t) perfcpu[i].sys, 0);
+		submit (i, "user",   (derive_t) perfcpu[i].user, 0);
+		submit (i, "wait",   (derive_t) perfcpu[i].wait, 0);
 	}
 #endif /* HAVE_PERFSTAT */
 
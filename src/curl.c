@@ -25,6 +25,7 @@
 #include "common.h"
 #include "plugin.h"
 #include "configfile.h"
+#include "utils_curl_async.h"
 #include "utils_match.h"
 
 #include <curl/curl.h>
@@ -68,6 +69,11 @@ struct web_page_s /* {{{ */
   size_t buffer_size;
   size_t buffer_fill;
 
+  /* Result of the last finished transfer. Written by cc_page_done(), only
+   * read while the page isn't busy. */
+  CURLcode last_status;
+  long     last_response_code;
+
   web_match_t *matches;
 
   web_page_t *next;
@@ -76,7 +82,6 @@ struct web_page_s /* {{{ */
 /*
  * Global variables;
  */
-/* static CURLM *curl = NULL; */
 static web_page_t *pages_g = NULL;
 
 /*
@@ -138,7 +143,10 @@ static void cc_web_page_free (web_page_t *wp) /* {{{ */
     return;
 
   if (wp->curl != NULL)
+  {
+    curl_async_cancel (wp->curl);
     curl_easy_cleanup (wp->curl);
+  }
   wp->curl = NULL;
 
   sfree (wp->instance);
@@ -604,39 +612,43 @@ static void cc_submit_response_time (const web_page_t *wp, double seconds) /* {{
   plugin_dispatch_values (&vl);
 } /* }}} void cc_submit_response_time */
 
-static int cc_read_page (web_page_t *wp) /* {{{ */
+/* Called by the event loop thread when the transfer of `wp' has finished. */
+static void cc_page_done (CURL *curl, CURLcode status, /* {{{ */
+    void *user_data)
 {
+  web_page_t *wp = user_data;
   web_match_t *wm;
-  int status;
-  struct timeval start, end;
 
-  if (wp->response_time)
-    gettimeofday (&start, NULL);
+  wp->last_status = status;
+  wp->last_response_code = 0;
 
-  wp->buffer_fill = 0;
-  status = curl_easy_perform (wp->curl);
-  if (status != 0)
+  if (status != CURLE_OK)
   {
     ERROR ("curl plugin: curl_easy_perform failed with staus %i: %s",
-        status, wp->curl_errbuf);
-    return (-1);
+        (int) status, wp->curl_errbuf);
+    return;
   }
 
+  curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &wp->last_response_code);
+  if (wp->last_response_code >= 400)
+    WARNING ("curl plugin: The request for page \"%s\" failed with "
+        "response code %ld.", wp->instance, wp->last_response_code);
+
   if (wp->response_time)
   {
-    double secs = 0;
-    gettimeofday (&end, NULL);
-    secs += end.tv_sec - start.tv_sec;
-    secs += (end.tv_usec - start.tv_usec) / 1000000.0;
+    double secs = 0.0;
+
+    curl_easy_getinfo (curl, CURLINFO_TOTAL_TIME, &secs);
     cc_submit_response_time (wp, secs);
   }
 
   for (wm = wp->matches; wm != NULL; wm = wm->next)
   {
     cu_match_value_t *mv;
+    int match_status;
 
-    status = match_apply (wm->match, wp->buffer);
-    if (status != 0)
+    match_status = match_apply (wm->match, wp->buffer);
+    if (match_status != 0)
     {
       WARNING ("curl plugin: match_apply failed.");
       continue;
@@ -651,16 +663,54 @@ static int cc_read_page (web_page_t *wp) /* {{{ */
 
     cc_submit (wp, wm, mv);
   } /* for (wm = wp->matches; wm != NULL; wm = wm->next) */
+} /* }}} void cc_page_done */
 
-  return (0);
+/* Starts the request of `wp'. Returns non-zero if the request couldn't be
+ * started, or if the previous request is still in progress or has failed. */
+static int cc_read_page (web_page_t *wp) /* {{{ */
+{
+  _Bool failed;
+  int status;
+
+  if (curl_async_busy (wp->curl))
+  {
+    WARNING ("curl plugin: The previous request for page \"%s\" is still "
+        "in progress. Skipping this read.", wp->instance);
+    return (-1);
+  }
+
+  /* The transfer has finished, so its result may be read. */
+  failed = (wp->last_status != CURLE_OK) || (wp->last_response_code >= 400);
+
+  wp->buffer_fill = 0;
+  if (wp->buffer != NULL)
+    wp->buffer[0] = 0;
+
+  status = curl_async_submit (wp->curl, cc_page_done, wp);
+  if (status != 0)
+  {
+    ERROR ("curl plugin: curl_async_submit failed with status %i.", status);
+    return (-1);
+  }
+
+  return (failed ? -1 : 0);
 } /* }}} int cc_read_page */
 
+/* Starts the requests of all pages. They are performed concurrently and the
+ * values are dispatched when the responses arrive, so a failed request is
+ * reported by the following read. Fails if no page could be read, so that
+ * the read is retried with a back-off. */
 static int cc_read (void) /* {{{ */
 {
   web_page_t *wp;
+  int success = 0;
 
   for (wp = pages_g; wp != NULL; wp = wp->next)
-    cc_read_page (wp);
+    if (cc_read_page (wp) == 0)
+      success++;
+
+  if ((pages_g != NULL) && (success == 0))
+    return (-1);
 
   return (0);
 } /* }}} int cc_read */
@@ -670,6 +720,8 @@ static int cc_shutdown (void) /* {{{ */
   cc_web_page_free (pages_g);
   pages_g = NULL;
 
+  curl_async_shutdown ();
+
   return (0);
 } /* }}} int cc_shutdown */
 
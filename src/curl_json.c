@@ -27,6 +27,7 @@
 #include "configfile.h"
 #include "utils_avltree.h"
 #include "utils_complain.h"
+#include "utils_curl_async.h"
 
 #include <curl/curl.h>
 #include <yajl/yajl_parse.h>
@@ -70,6 +71,9 @@ struct cj_s /* {{{ */
 
   CURL *curl;
   char curl_errbuf[CURL_ERROR_SIZE];
+  /* The last finished transfer has failed. Written by cj_curl_done(), only
+   * read while the transfer isn't busy. */
+  _Bool failed;
 
   yajl_handle yajl;
   c_avl_tree_t *tree;
@@ -93,6 +97,7 @@ typedef unsigned int yajl_len_t;
 
 static int cj_read (user_data_t *ud);
 static int cj_curl_perform (cj_t *db, CURL *curl);
+static void cj_curl_done (CURL *curl, CURLcode status, void *user_data);
 static void cj_submit (cj_t *db, cj_key_t *key, value_t *value);
 
 static size_t cj_curl_callback (void *buf, /* {{{ */
@@ -359,9 +364,17 @@ static void cj_free (void *arg) /* {{{ */
     return;
 
   if (db->curl != NULL)
+  {
+    curl_async_cancel (db->curl);
     curl_easy_cleanup (db->curl);
+  }
   db->curl = NULL;
 
+  /* Left over if a transfer has been cancelled. */
+  if (db->yajl != NULL)
+    yajl_free (db->yajl);
+  db->yajl = NULL;
+
   if (db->tree != NULL)
     cj_tree_free (db->tree);
   db->tree = NULL;
@@ -745,12 +758,11 @@ static void cj_submit (cj_t *db, cj_key_t *key, value_t *value) /* {{{ */
   plugin_dispatch_values (&vl);
 } /* }}} int cj_submit */
 
+/* Starts the request of `db'. The response is parsed while it is being
+ * received; cj_curl_done() is called when the transfer has finished. */
 static int cj_curl_perform (cj_t *db, CURL *curl) /* {{{ */
 {
   int status;
-  long rc;
-  char *url;
-  yajl_handle yprev = db->yajl;
 
   db->yajl = yajl_alloc (&ycallbacks,
 #if HAVE_YAJL_V2
@@ -762,21 +774,43 @@ static int cj_curl_perform (cj_t *db, CURL *curl) /* {{{ */
   if (db->yajl == NULL)
   {
     ERROR ("curl_json plugin: yajl_alloc failed.");
-    db->yajl = yprev;
     return (-1);
   }
 
+  status = curl_async_submit (curl, cj_curl_done, db);
+  if (status != 0)
+  {
+    ERROR ("curl_json plugin: curl_async_submit failed with status %i.",
+        status);
+    yajl_free (db->yajl);
+    db->yajl = NULL;
+    return (-1);
+  }
+
+  return (0);
+} /* }}} int cj_curl_perform */
+
+/* Called by the event loop thread when the transfer of `db' has finished. */
+static void cj_curl_done (CURL *curl, CURLcode status, /* {{{ */
+    void *user_data)
+{
+  cj_t *db = user_data;
+  yajl_status parse_status;
+  long rc;
+  char *url;
+
   url = NULL;
   curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
 
-  status = curl_easy_perform (curl);
-  if (status != 0)
+  db->failed = 1;
+
+  if (status != CURLE_OK)
   {
     ERROR ("curl_json plugin: curl_easy_perform failed with status %i: %s (%s)",
-           status, db->curl_errbuf, (url != NULL) ? url : "<null>");
+           (int) status, db->curl_errbuf, (url != NULL) ? url : "<null>");
     yajl_free (db->yajl);
-    db->yajl = yprev;
-    return (-1);
+    db->yajl = NULL;
+    return;
   }
 
   curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &rc);
@@ -787,16 +821,16 @@ static int cj_curl_perform (cj_t *db, CURL *curl) /* {{{ */
     ERROR ("curl_json plugin: curl_easy_perform failed with "
         "response code %ld (%s)", rc, url);
     yajl_free (db->yajl);
-    db->yajl = yprev;
-    return (-1);
+    db->yajl = NULL;
+    return;
   }
 
 #if HAVE_YAJL_V2
-    status = yajl_complete_parse(db->yajl);
+    parse_status = yajl_complete_parse(db->yajl);
 #else
-    status = yajl_parse_complete(db->yajl);
+    parse_status = yajl_parse_complete(db->yajl);
 #endif
-  if (status != yajl_status_ok)
+  if (parse_status != yajl_status_ok)
   {
     unsigned char *errmsg;
 
@@ -805,19 +839,23 @@ static int cj_curl_perform (cj_t *db, CURL *curl) /* {{{ */
     ERROR ("curl_json plugin: yajl_parse_complete failed: %s",
         (char *) errmsg);
     yajl_free_error (db->yajl, errmsg);
-    yajl_free (db->yajl);
-    db->yajl = yprev;
-    return (-1);
   }
+  else
+    db->failed = 0;
 
   yajl_free (db->yajl);
-  db->yajl = yprev;
-  return (0);
-} /* }}} int cj_curl_perform */
+  db->yajl = NULL;
+} /* }}} void cj_curl_done */
 
+/* Starts the request of the instance. The response is parsed when it arrives,
+ * so a failed request is reported by the following read. A read is also
+ * reported as failed if the previous request is still in progress, so that
+ * a slow server is polled with a back-off. */
 static int cj_read (user_data_t *ud) /* {{{ */
 {
   cj_t *db;
+  _Bool failed;
+  int status;
 
   if ((ud == NULL) || (ud->data == NULL))
   {
@@ -827,17 +865,39 @@ static int cj_read (user_data_t *ud) /* {{{ */
 
   db = (cj_t *) ud->data;
 
+  /* The parser state belongs to the running transfer. */
+  if (curl_async_busy (db->curl))
+  {
+    WARNING ("curl_json plugin: The previous request for %s is still in "
+        "progress. Skipping this read.", db->url);
+    return (-1);
+  }
+
+  /* The transfer has finished, so its result may be read. */
+  failed = db->failed;
+
   db->depth = 0;
   memset (&db->state, 0, sizeof(db->state));
   db->state[db->depth].tree = db->tree;
   db->key = NULL;
 
-  return cj_curl_perform (db, db->curl);
+  status = cj_curl_perform (db, db->curl);
+  if (status != 0)
+    return (status);
+
+  return (failed ? -1 : 0);
 } /* }}} int cj_read */
 
+static int cj_shutdown (void) /* {{{ */
+{
+  curl_async_shutdown ();
+  return (0);
+} /* }}} int cj_shutdown */
+
 void module_register (void)
 {
   plugin_register_complex_config ("curl_json", cj_config);
+  plugin_register_shutdown ("curl_json", cj_shutdown);
 } /* void module_register */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -23,6 +23,7 @@
 #include "common.h"
 #include "plugin.h"
 #include "configfile.h"
+#include "utils_curl_async.h"
 #include "utils_llist.h"
 
 #include <libxml/parser.h>
@@ -169,7 +170,10 @@ static void cx_free (void *arg) /* {{{ */
     return;
 
   if (db->curl != NULL)
+  {
+    curl_async_cancel (db->curl);
     curl_easy_cleanup (db->curl);
+  }
   db->curl = NULL;
 
   if (db->list != NULL)
@@ -544,16 +548,15 @@ static int cx_parse_stats_xml(xmlChar* xml, cx_t *db) /* {{{ */
   return status;
 } /* }}} cx_parse_stats_xml */
 
-static int cx_curl_perform (cx_t *db, CURL *curl) /* {{{ */
+/* Called by the event loop thread when the transfer of `db' has finished. */
+static void cx_curl_done (CURL *curl, CURLcode status, /* {{{ */
+    void *user_data)
 {
-  int status;
+  cx_t *db = user_data;
   long rc;
   char *ptr;
   char *url;
 
-  db->buffer_fill = 0; 
-  status = curl_easy_perform (curl);
-
   curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
   curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &rc);
 
@@ -562,22 +565,43 @@ static int cx_curl_perform (cx_t *db, CURL *curl) /* {{{ */
   {
     ERROR ("curl_xml plugin: curl_easy_perform failed with response code %ld (%s)",
            rc, url);
-    return (-1);
+    return;
   }
 
-  if (status != 0)
+  if (status != CURLE_OK)
   {
     ERROR ("curl_xml plugin: curl_easy_perform failed with status %i: %s (%s)",
-           status, db->curl_errbuf, url);
-    return (-1);
+           (int) status, db->curl_errbuf, url);
+    return;
   }
 
   ptr = db->buffer;
 
-  status = cx_parse_stats_xml(BAD_CAST ptr, db);
+  cx_parse_stats_xml(BAD_CAST ptr, db);
   db->buffer_fill = 0;
+} /* }}} void cx_curl_done */
 
-  return status;
+static int cx_curl_perform (cx_t *db, CURL *curl) /* {{{ */
+{
+  int status;
+
+  if (curl_async_busy (curl))
+  {
+    WARNING ("curl_xml plugin: The previous request for %s is still in "
+        "progress. Skipping this read.", db->url);
+    return (0);
+  }
+
+  db->buffer_fill = 0; 
+  status = curl_async_submit (curl, cx_curl_done, db);
+  if (status != 0)
+  {
+    ERROR ("curl_xml plugin: curl_async_submit failed with status %i.",
+        status);
+    return (-1);
+  }
+
+  return (0);
 } /* }}} int cx_curl_perform */
 
 static int cx_read (user_data_t *ud) /* {{{ */
@@ -595,6 +619,12 @@ static int cx_read (user_data_t *ud) /* {{{ */
   return cx_curl_perform (db, db->curl);
 } /* }}} int cx_read */
 
+static int cx_shutdown (void) /* {{{ */
+{
+  curl_async_shutdown ();
+  return (0);
+} /* }}} int cx_shutdown */
+
 /* Configuration handling functions {{{ */
 
 static int cx_config_add_values (const char *name, cx_xpath_t *xpath, /* {{{ */
@@ -929,6 +959,7 @@ static int cx_config (oconfig_item_t *ci) /* {{{ */
 void module_register (void)
 {
   plugin_register_complex_config ("curl_xml", cx_config);
+  plugin_register_shutdown ("curl_xml", cx_shutdown);
 } /* void module_register */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
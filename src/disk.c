@@ -25,6 +25,7 @@
 #include "common.h"
 #include "plugin.h"
 #include "utils_ignorelist.h"
+#include "utils_procfs.h"
 
 #if HAVE_MACH_MACH_TYPES_H
 #  include <mach/mach_types.h>
@@ -223,9 +224,10 @@ static int disk_init (void)
 	return (0);
 } /* int disk_init */
 
+/* If `value_time' is zero, the current time is used. */
 static void disk_submit (const char *plugin_instance,
 		const char *type,
-		derive_t read, derive_t write)
+		derive_t read, derive_t write, cdtime_t value_time)
 {
 	value_t values[2];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -239,6 +241,7 @@ static void disk_submit (const char *plugin_instance,
 
 	vl.values = values;
 	vl.values_len = 2;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "disk", sizeof (vl.plugin));
 	sstrncpy (vl.plugin_instance, plugin_instance,
@@ -453,13 +456,13 @@ static int disk_read (void)
 		DEBUG ("disk plugin: disk_name = \"%s\"", disk_name);
 
 		if ((read_byt != -1LL) || (write_byt != -1LL))
-			disk_submit (disk_name, "disk_octets", read_byt, write_byt);
+			disk_submit (disk_name, "disk_octets", read_byt, write_byt, 0);
 		if ((read_ops != -1LL) || (write_ops != -1LL))
-			disk_submit (disk_name, "disk_ops", read_ops, write_ops);
+			disk_submit (disk_name, "disk_ops", read_ops, write_ops, 0);
 		if ((read_tme != -1LL) || (write_tme != -1LL))
 			disk_submit (disk_name, "disk_time",
 					read_tme / 1000,
-					write_tme / 1000);
+					write_tme / 1000, 0);
 
 		CFRelease (child_dict);
 		IOObjectRelease (disk_child);
@@ -470,9 +473,10 @@ static int disk_read (void)
 /* #endif HAVE_IOKIT_IOKITLIB_H */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
-	
+	char *snapshot;
+	char *buffer;
+	char *cursor;
+
 	char *fields[32];
 	int numfields;
 	int fieldshift = 0;
@@ -491,13 +495,15 @@ static int disk_read (void)
 	int is_disk = 0;
 
 	diskstats_t *ds, *pre_ds;
+	cdtime_t value_time = 0;
 
-	if ((fh = fopen ("/proc/diskstats", "r")) == NULL)
+	snapshot = procfs_snapshot ("/proc/diskstats", NULL, &value_time);
+	if (snapshot == NULL)
 	{
-		fh = fopen ("/proc/partitions", "r");
-		if (fh == NULL)
+		snapshot = procfs_snapshot ("/proc/partitions", NULL, &value_time);
+		if (snapshot == NULL)
 		{
-			ERROR ("disk plugin: fopen (/proc/{diskstats,partitions}) failed.");
+			ERROR ("disk plugin: Reading /proc/{diskstats,partitions} failed.");
 			return (-1);
 		}
 
@@ -505,7 +511,8 @@ static int disk_read (void)
 		fieldshift = 1;
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		char *disk_name;
 
@@ -661,24 +668,25 @@ static int disk_read (void)
 
 		if ((ds->read_bytes != 0) || (ds->write_bytes != 0))
 			disk_submit (disk_name, "disk_octets",
-					ds->read_bytes, ds->write_bytes);
+					ds->read_bytes, ds->write_bytes, value_time);
 
 		if ((ds->read_ops != 0) || (ds->write_ops != 0))
 			disk_submit (disk_name, "disk_ops",
-					read_ops, write_ops);
+					read_ops, write_ops, value_time);
 
 		if ((ds->avg_read_time != 0) || (ds->avg_write_time != 0))
 			disk_submit (disk_name, "disk_time",
-					ds->avg_read_time, ds->avg_write_time);
+					ds->avg_read_time, ds->avg_write_time,
+					value_time);
 
 		if (is_disk)
 		{
 			disk_submit (disk_name, "disk_merged",
-					read_merged, write_merged);
+					read_merged, write_merged, value_time);
 		} /* if (is_disk) */
-	} /* while (fgets (buffer, sizeof (buffer), fh) != NULL) */
+	} /* while ((buffer = procfs_next_line (&cursor)) != NULL) */
 
-	fclose (fh);
+	sfree (snapshot);
 /* #endif defined(KERNEL_LINUX) */
 
 #elif HAVE_LIBKSTAT
@@ -713,19 +721,19 @@ static int disk_read (void)
 		if (strncmp (ksp[i]->ks_class, "disk", 4) == 0)
 		{
 			disk_submit (ksp[i]->ks_name, "disk_octets",
-					kio.KIO_ROCTETS, kio.KIO_WOCTETS);
+					kio.KIO_ROCTETS, kio.KIO_WOCTETS, 0);
 			disk_submit (ksp[i]->ks_name, "disk_ops",
-					kio.KIO_ROPS, kio.KIO_WOPS);
+					kio.KIO_ROPS, kio.KIO_WOPS, 0);
 			/* FIXME: Convert this to microseconds if necessary */
 			disk_submit (ksp[i]->ks_name, "disk_time",
-					kio.KIO_RTIME, kio.KIO_WTIME);
+					kio.KIO_RTIME, kio.KIO_WTIME, 0);
 		}
 		else if (strncmp (ksp[i]->ks_class, "partition", 9) == 0)
 		{
 			disk_submit (ksp[i]->ks_name, "disk_octets",
-					kio.KIO_ROCTETS, kio.KIO_WOCTETS);
+					kio.KIO_ROCTETS, kio.KIO_WOCTETS, 0);
 			disk_submit (ksp[i]->ks_name, "disk_ops",
-					kio.KIO_ROPS, kio.KIO_WOPS);
+					kio.KIO_ROPS, kio.KIO_WOPS, 0);
 		}
 	}
 /* #endif defined(HAVE_LIBKSTAT) */
@@ -741,7 +749,7 @@ static int disk_read (void)
 	for (counter=0; counter < disks; counter++) {
 		strncpy(name, ds->disk_name, sizeof(name));
 		name[sizeof(name)-1] = '\0'; /* strncpy doesn't terminate longer strings */
-		disk_submit (name, "disk_octets", ds->read_bytes, ds->write_bytes);
+		disk_submit (name, "disk_octets", ds->read_bytes, ds->write_bytes, 0);
 		ds++;
 	}
 /* #endif defined(HAVE_LIBSTATGRAB) */
@@ -785,17 +793,17 @@ static int disk_read (void)
 	{
 		read_sectors = stat_disk[i].rblks*stat_disk[i].bsize;
 		write_sectors = stat_disk[i].wblks*stat_disk[i].bsize;
-		disk_submit (stat_disk[i].name, "disk_octets", read_sectors, write_sectors);
+		disk_submit (stat_disk[i].name, "disk_octets", read_sectors, write_sectors, 0);
 
 		read_ops = stat_disk[i].xrate;
 		write_ops = stat_disk[i].xfers - stat_disk[i].xrate;
-		disk_submit (stat_disk[i].name, "disk_ops", read_ops, write_ops);
+		disk_submit (stat_disk[i].name, "disk_ops", read_ops, write_ops, 0);
 
 		read_time = stat_disk[i].rserv;
 		read_time *= ((double)(_system_configuration.Xint)/(double)(_system_configuration.Xfrac)) / 1000000.0;
 		write_time = stat_disk[i].wserv;
 		write_time *= ((double)(_system_configuration.Xint)/(double)(_system_configuration.Xfrac)) / 1000000.0;
-		disk_submit (stat_disk[i].name, "disk_time", read_time, write_time);
+		disk_submit (stat_disk[i].name, "disk_time", read_time, write_time, 0);
 	}
 #endif /* defined(HAVE_PERFSTAT) */
 
@@ -23,9 +23,30 @@
 #include "configfile.h"
 #include "plugin.h"
 #include "utils_complain.h"
+#include "utils_avltree.h"
+#include "utils_profile.h"
 #include "common.h"
 #include "filter_chain.h"
 
+#include <pthread.h>
+
+/* Results of matches flagged with FC_MATCH_CACHEABLE are remembered per
+ * series, i.e. per identifier. At most FC_CACHE_MATCHES_MAX matches are
+ * cached, further matches are always evaluated. When the cache holds more
+ * than FC_CACHE_ENTRIES_MAX series, it is cleared and refilled. */
+#define FC_CACHE_MATCHES_MAX 256
+#define FC_CACHE_ENTRIES_MAX 262144
+#define FC_CACHE_KEY_SIZE (5 * DATA_MAX_NAME_LEN)
+
+/* Chains are indexed if at least this many rules require an exact value for
+ * one identifier field. */
+#define FC_PLAN_INDEX_MIN 4
+
+/* Two bits per match. */
+#define FC_CACHE_UNKNOWN  0
+#define FC_CACHE_NO_MATCH 1
+#define FC_CACHE_MATCHES  2
+
 /*
  * Data types
  */
@@ -38,6 +59,7 @@ struct fc_match_s
   char name[DATA_MAX_NAME_LEN];
   match_proc_t proc;
   void *user_data;
+  int cache_index; /* negative if the result must not be cached */
   fc_match_t *next;
 }; /* }}} */
 
@@ -64,15 +86,96 @@ struct fc_rule_s
   fc_rule_t *next;
 }; /* }}} */
 
+/* Compiled form of a chain, see fc_chain_compile(). Rules and targets are
+ * stored in arrays. If enough rules require an exact value for one
+ * identifier field, rules are also indexed by that value, so that rules which
+ * cannot match are skipped without calling their matches. */
+struct fc_plan_rule_s;
+typedef struct fc_plan_rule_s fc_plan_rule_t; /* {{{ */
+struct fc_plan_rule_s
+{
+  fc_rule_t *rule;
+  fc_match_t **matches;
+  size_t matches_num;
+  fc_target_t **targets;
+  size_t targets_num;
+}; /* }}} */
+
+/* Rules requiring `value' for the indexed field, in chain order. */
+struct fc_plan_bucket_s;
+typedef struct fc_plan_bucket_s fc_plan_bucket_t; /* {{{ */
+struct fc_plan_bucket_s
+{
+  char *value;
+  size_t *rules;
+  size_t rules_num;
+}; /* }}} */
+
+struct fc_plan_s;
+typedef struct fc_plan_s fc_plan_t; /* {{{ */
+struct fc_plan_s
+{
+  fc_plan_rule_t *rules;
+  size_t rules_num;
+  fc_target_t **targets;
+  size_t targets_num;
+
+  int index_field; /* negative if the rules are not indexed */
+  size_t *always; /* rules not requiring a value for `index_field' */
+  size_t always_num;
+  fc_plan_bucket_t *buckets; /* open addressing, size is a power of two */
+  size_t buckets_size;
+}; /* }}} */
+
 /* List of chains, used for `chain_list_head' */
 struct fc_chain_s /* {{{ */
 {
   char name[DATA_MAX_NAME_LEN];
   fc_rule_t   *rules;
   fc_target_t *targets;
+  fc_plan_t   *plan;
+  int          generation; /* `fc_cache_generation' when compiled */
   fc_chain_t  *next;
 }; /* }}} */
 
+/* User data of the built-in `jump' target. */
+struct fc_jump_s;
+typedef struct fc_jump_s fc_jump_t; /* {{{ */
+struct fc_jump_s
+{
+  char *chain_name;
+  fc_chain_t *chain; /* resolved when compiling */
+}; /* }}} */
+
+/* Cached match results of one series, stored in `fc_cache_tree'. `key' and
+ * `results' point into the same allocation as the struct itself. */
+struct fc_cache_entry_s;
+typedef struct fc_cache_entry_s fc_cache_entry_t; /* {{{ */
+struct fc_cache_entry_s
+{
+  int generation;
+  char *key;
+  size_t key_len;
+  unsigned char *results;
+  size_t results_size;
+}; /* }}} */
+
+/* The series currently being processed by fc_process_chain, including a
+ * private copy of its cached results. `check' is set whenever a target has
+ * been invoked, since targets may change the identifier. */
+struct fc_series_s;
+typedef struct fc_series_s fc_series_t; /* {{{ */
+struct fc_series_s
+{
+  int generation;
+  _Bool loaded;
+  _Bool dirty;
+  _Bool check;
+  char key[FC_CACHE_KEY_SIZE];
+  size_t key_len;
+  unsigned char results[FC_CACHE_MATCHES_MAX / 4];
+}; /* }}} */
+
 /*
  * Global variables
  */
@@ -80,6 +183,16 @@ static fc_match_t  *match_list_head;
 static fc_target_t *target_list_head;
 static fc_chain_t  *chain_list_head;
 
+static pthread_mutex_t fc_plan_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static c_avl_tree_t   *fc_cache_tree = NULL;
+static pthread_mutex_t fc_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static int             fc_cache_matches_num = 0;
+/* Incremented whenever the chains are compiled. Results evaluated by chains
+ * of another generation, which may still be in use while the chains are
+ * replaced, are neither used nor stored. */
+static int             fc_cache_generation = 0;
+
 /*
  * Private functions
  */
@@ -137,11 +250,38 @@ static void fc_free_rules (fc_rule_t *r) /* {{{ */
   free (r);
 } /* }}} void fc_free_rules */
 
+static void fc_free_plan (fc_plan_t *plan) /* {{{ */
+{
+  size_t i;
+
+  if (plan == NULL)
+    return;
+
+  for (i = 0; i < plan->rules_num; i++)
+  {
+    sfree (plan->rules[i].matches);
+    sfree (plan->rules[i].targets);
+  }
+  sfree (plan->rules);
+  sfree (plan->targets);
+
+  for (i = 0; i < plan->buckets_size; i++)
+  {
+    sfree (plan->buckets[i].value);
+    sfree (plan->buckets[i].rules);
+  }
+  sfree (plan->buckets);
+  sfree (plan->always);
+
+  sfree (plan);
+} /* }}} void fc_free_plan */
+
 static void fc_free_chains (fc_chain_t *c) /* {{{ */
 {
   if (c == NULL)
     return;
 
+  fc_free_plan (c->plan);
   fc_free_rules (c->rules);
   fc_free_targets (c->targets);
 
@@ -169,6 +309,253 @@ static char *fc_strdup (const char *orig) /* {{{ */
   return (dest);
 } /* }}} char *fc_strdup */
 
+/*
+ * Match cache
+ */
+static int fc_cache_compare (const void *a, const void *b) /* {{{ */
+{
+  const fc_cache_entry_t *e0 = a;
+  const fc_cache_entry_t *e1 = b;
+  int status;
+
+  status = memcmp (e0->key, e1->key,
+      (e0->key_len < e1->key_len) ? e0->key_len : e1->key_len);
+  if (status != 0)
+    return (status);
+
+  if (e0->key_len < e1->key_len)
+    return (-1);
+  else if (e0->key_len > e1->key_len)
+    return (1);
+  return (0);
+} /* }}} int fc_cache_compare */
+
+/* Removes all entries from the cache. The lock must be held. */
+static void fc_cache_clear_nolock (void) /* {{{ */
+{
+  void *key;
+  void *value;
+
+  if (fc_cache_tree == NULL)
+    return;
+
+  while (c_avl_pick (fc_cache_tree, &key, &value) == 0)
+    sfree (value);
+} /* }}} void fc_cache_clear_nolock */
+
+static void fc_cache_flush (void) /* {{{ */
+{
+  pthread_mutex_lock (&fc_cache_lock);
+  fc_cache_clear_nolock ();
+  pthread_mutex_unlock (&fc_cache_lock);
+} /* }}} void fc_cache_flush */
+
+/* Writes the identifier of `vl' to `buffer', which must hold at least
+ * FC_CACHE_KEY_SIZE bytes. The fields are separated by null bytes, so
+ * different identifiers never map to the same key. */
+static size_t fc_cache_key (char *buffer, const value_list_t *vl) /* {{{ */
+{
+  const char *fields[] = { vl->host, vl->plugin, vl->plugin_instance,
+    vl->type, vl->type_instance };
+  size_t len = 0;
+  size_t i;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (fields); i++)
+  {
+    size_t field_len = strlen (fields[i]) + 1;
+
+    memcpy (buffer + len, fields[i], field_len);
+    len += field_len;
+  }
+
+  return (len);
+} /* }}} size_t fc_cache_key */
+
+/* Copies the cached results of the series `s->key' into `s'. */
+static void fc_series_load (fc_series_t *s) /* {{{ */
+{
+  fc_cache_entry_t probe;
+  fc_cache_entry_t *e = NULL;
+
+  memset (&probe, 0, sizeof (probe));
+  probe.key = s->key;
+  probe.key_len = s->key_len;
+
+  memset (s->results, 0, sizeof (s->results));
+
+  pthread_mutex_lock (&fc_cache_lock);
+  if ((fc_cache_tree != NULL)
+      && (c_avl_get (fc_cache_tree, &probe, (void *) &e) == 0)
+      && (e->generation == s->generation))
+    memcpy (s->results, e->results, e->results_size);
+  pthread_mutex_unlock (&fc_cache_lock);
+
+  s->loaded = 1;
+  s->dirty = 0;
+  s->check = 0;
+} /* }}} void fc_series_load */
+
+/* Merges the results evaluated while processing `s' back into the cache. */
+static void fc_series_store (fc_series_t *s) /* {{{ */
+{
+  fc_cache_entry_t probe;
+  fc_cache_entry_t *e = NULL;
+  size_t i;
+
+  if (!s->loaded || !s->dirty)
+    return;
+  s->dirty = 0;
+
+  memset (&probe, 0, sizeof (probe));
+  probe.key = s->key;
+  probe.key_len = s->key_len;
+
+  pthread_mutex_lock (&fc_cache_lock);
+
+  if (s->generation != fc_cache_generation)
+  {
+    pthread_mutex_unlock (&fc_cache_lock);
+    return;
+  }
+
+  if (fc_cache_tree == NULL)
+  {
+    fc_cache_tree = c_avl_create (fc_cache_compare);
+    if (fc_cache_tree == NULL)
+    {
+      pthread_mutex_unlock (&fc_cache_lock);
+      return;
+    }
+  }
+
+  if (c_avl_get (fc_cache_tree, &probe, (void *) &e) == 0)
+  {
+    /* Results are deterministic, so bits set by other threads never
+     * conflict with ours. */
+    for (i = 0; i < e->results_size; i++)
+      e->results[i] |= s->results[i];
+    pthread_mutex_unlock (&fc_cache_lock);
+    return;
+  }
+
+  if (c_avl_size (fc_cache_tree) >= FC_CACHE_ENTRIES_MAX)
+  {
+    DEBUG ("Filter subsystem: The match cache is full, clearing it.");
+    fc_cache_clear_nolock ();
+  }
+
+  probe.results_size = (((size_t) fc_cache_matches_num) + 3) / 4;
+  e = malloc (sizeof (*e) + probe.results_size + s->key_len);
+  if (e == NULL)
+  {
+    pthread_mutex_unlock (&fc_cache_lock);
+    return;
+  }
+  e->generation = s->generation;
+  e->results = (unsigned char *) (e + 1);
+  e->results_size = probe.results_size;
+  e->key = (char *) (e->results + e->results_size);
+  e->key_len = s->key_len;
+  memcpy (e->results, s->results, e->results_size);
+  memcpy (e->key, s->key, s->key_len);
+
+  if (c_avl_insert (fc_cache_tree, e, e) != 0)
+    sfree (e);
+
+  pthread_mutex_unlock (&fc_cache_lock);
+} /* }}} void fc_series_store */
+
+static int fc_series_get (const fc_series_t *s, int index) /* {{{ */
+{
+  return ((s->results[index / 4] >> (2 * (index % 4))) & 0x03);
+} /* }}} int fc_series_get */
+
+static void fc_series_set (fc_series_t *s, int index, int value) /* {{{ */
+{
+  s->results[index / 4] |= (unsigned char) (value << (2 * (index % 4)));
+  s->dirty = 1;
+} /* }}} void fc_series_set */
+
+/* Calls the match callback of `m', timing it if profiling is enabled. */
+static int fc_match_call (const data_set_t *ds, /* {{{ */
+    const value_list_t *vl, fc_match_t *m)
+{
+  cdtime_t start;
+  int status;
+
+  /* FIXME: Pass the meta-data to match targets here (when implemented). */
+  if (!profile_is_enabled ())
+    return ((*m->proc.match) (ds, vl, /* meta = */ NULL, &m->user_data));
+
+  start = profile_clock ();
+  status = (*m->proc.match) (ds, vl, /* meta = */ NULL, &m->user_data);
+  profile_record (PROFILE_MATCH, m->name, profile_clock () - start,
+      (uint64_t) vl->values_len);
+
+  return (status);
+} /* }}} int fc_match_call */
+
+/* Calls the target callback of `t', timing it if profiling is enabled. */
+static int fc_target_call (const data_set_t *ds, /* {{{ */
+    value_list_t *vl, fc_target_t *t)
+{
+  cdtime_t start;
+  int status;
+
+  /* FIXME: Pass the meta-data to match targets here (when implemented). */
+  if (!profile_is_enabled ())
+    return ((*t->proc.invoke) (ds, vl, /* meta = */ NULL, &t->user_data));
+
+  start = profile_clock ();
+  status = (*t->proc.invoke) (ds, vl, /* meta = */ NULL, &t->user_data);
+  profile_record (PROFILE_TARGET, t->name, profile_clock () - start,
+      (uint64_t) vl->values_len);
+
+  return (status);
+} /* }}} int fc_target_call */
+
+/* Evaluates the match `m', using the result cached for the series of `vl'
+ * if possible. */
+static int fc_match_invoke (const data_set_t *ds, /* {{{ */
+    const value_list_t *vl, fc_match_t *m, fc_series_t *s)
+{
+  int status;
+
+  if (m->cache_index < 0)
+    return (fc_match_call (ds, vl, m));
+
+  if (!s->loaded || s->check)
+  {
+    char key[FC_CACHE_KEY_SIZE];
+    size_t key_len;
+
+    key_len = fc_cache_key (key, vl);
+    if (!s->loaded || (key_len != s->key_len)
+        || (memcmp (key, s->key, key_len) != 0))
+    {
+      fc_series_store (s);
+      memcpy (s->key, key, key_len);
+      s->key_len = key_len;
+      fc_series_load (s);
+    }
+    s->check = 0;
+  }
+
+  status = fc_series_get (s, m->cache_index);
+  if (status == FC_CACHE_MATCHES)
+    return (FC_MATCH_MATCHES);
+  else if (status == FC_CACHE_NO_MATCH)
+    return (FC_MATCH_NO_MATCH);
+
+  status = fc_match_call (ds, vl, m);
+  if (status == FC_MATCH_MATCHES)
+    fc_series_set (s, m->cache_index, FC_CACHE_MATCHES);
+  else if (status == FC_MATCH_NO_MATCH)
+    fc_series_set (s, m->cache_index, FC_CACHE_NO_MATCH);
+
+  return (status);
+} /* }}} int fc_match_invoke */
+
 /*
  * Configuration.
  *
@@ -246,6 +633,12 @@ static int fc_config_add_match (fc_match_t **matches_head, /* {{{ */
     }
   }
 
+  if (((m->proc.flags & FC_MATCH_CACHEABLE) != 0)
+      && (fc_cache_matches_num < FC_CACHE_MATCHES_MAX))
+    m->cache_index = fc_cache_matches_num++;
+  else
+    m->cache_index = -1;
+
   if (*matches_head != NULL)
   {
     ptr = *matches_head;
@@ -500,6 +893,9 @@ static int fc_config_add_chain (const oconfig_item_t *ci) /* {{{ */
     chain_list_head = chain;
   }
 
+  /* Cached results refer to the previous configuration. */
+  fc_cache_flush ();
+
   return (0);
 } /* }}} int fc_config_add_chain */
 
@@ -512,6 +908,7 @@ static int fc_bit_jump_create (const oconfig_item_t *ci, /* {{{ */
     void **user_data)
 {
   oconfig_item_t *ci_chain;
+  fc_jump_t *jump;
 
   if (ci->children_num != 1)
   {
@@ -537,21 +934,35 @@ static int fc_bit_jump_create (const oconfig_item_t *ci, /* {{{ */
     return (-1);
   }
 
-  *user_data = fc_strdup (ci_chain->values[0].value.string);
-  if (*user_data == NULL)
+  jump = (fc_jump_t *) malloc (sizeof (*jump));
+  if (jump == NULL)
+  {
+    ERROR ("fc_bit_jump_create: malloc failed.");
+    return (-1);
+  }
+  memset (jump, 0, sizeof (*jump));
+
+  jump->chain_name = fc_strdup (ci_chain->values[0].value.string);
+  if (jump->chain_name == NULL)
   {
     ERROR ("fc_bit_jump_create: fc_strdup failed.");
+    sfree (jump);
     return (-1);
   }
+  jump->chain = NULL;
 
+  *user_data = jump;
   return (0);
 } /* }}} int fc_bit_jump_create */
 
 static int fc_bit_jump_destroy (void **user_data) /* {{{ */
 {
-  if (user_data != NULL)
+  if ((user_data != NULL) && (*user_data != NULL))
   {
-    free (*user_data);
+    fc_jump_t *jump = *user_data;
+
+    sfree (jump->chain_name);
+    sfree (jump);
     *user_data = NULL;
   }
 
@@ -562,20 +973,20 @@ static int fc_bit_jump_invoke (const data_set_t *ds, /* {{{ */
     value_list_t *vl, notification_meta_t __attribute__((unused)) **meta,
     void **user_data)
 {
-  char *chain_name;
+  fc_jump_t *jump;
   fc_chain_t *chain;
   int status;
 
-  chain_name = *user_data;
-
-  for (chain = chain_list_head; chain != NULL; chain = chain->next)
-    if (strcasecmp (chain_name, chain->name) == 0)
-      break;
+  jump = *user_data;
 
+  /* The target chain is resolved by fc_chain_compile(), while holding
+   * `fc_plan_lock'. The list of chains must not be searched here, because it
+   * may be replaced concurrently when the configuration is reloaded. */
+  chain = jump->chain;
   if (chain == NULL)
   {
     ERROR ("Filter subsystem: Built-in target `jump': There is no chain "
-        "named `%s'.", chain_name);
+        "named `%s'.", jump->chain_name);
     return (-1);
   }
 
@@ -858,22 +1269,357 @@ fc_chain_t *fc_chain_get_by_name (const char *chain_name) /* {{{ */
   return (NULL);
 } /* }}} int fc_chain_get_by_name */
 
-int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
-    fc_chain_t *chain)
+static const char *fc_field_value (const value_list_t *vl, int field) /* {{{ */
 {
-  fc_rule_t *rule;
+  switch (field)
+  {
+    case FC_FIELD_HOST:            return (vl->host);
+    case FC_FIELD_PLUGIN:          return (vl->plugin);
+    case FC_FIELD_PLUGIN_INSTANCE: return (vl->plugin_instance);
+    case FC_FIELD_TYPE:            return (vl->type);
+    case FC_FIELD_TYPE_INSTANCE:   return (vl->type_instance);
+  }
+  return (NULL);
+} /* }}} const char *fc_field_value */
+
+static uint32_t fc_plan_hash (const char *str) /* {{{ */
+{
+  uint32_t hash = 2166136261U;
+
+  for (; *str != 0; str++)
+  {
+    hash ^= (uint32_t) ((unsigned char) *str);
+    hash *= 16777619U;
+  }
+
+  return (hash);
+} /* }}} uint32_t fc_plan_hash */
+
+static fc_plan_bucket_t *fc_plan_bucket_get (fc_plan_t *plan, /* {{{ */
+    const char *value)
+{
+  size_t mask;
+  size_t i;
+
+  if ((plan->buckets_size == 0) || (value == NULL))
+    return (NULL);
+
+  mask = plan->buckets_size - 1;
+  for (i = fc_plan_hash (value) & mask;
+      plan->buckets[i].value != NULL;
+      i = (i + 1) & mask)
+  {
+    if (strcmp (plan->buckets[i].value, value) == 0)
+      return (plan->buckets + i);
+  }
+
+  return (NULL);
+} /* }}} fc_plan_bucket_t *fc_plan_bucket_get */
+
+/* Returns the value `rule' requires for `field' or NULL if any value may
+ * match. */
+static const char *fc_rule_exact (fc_rule_t *rule, int field) /* {{{ */
+{
+  fc_match_t *m;
+
+  for (m = rule->matches; m != NULL; m = m->next)
+  {
+    const char *value;
+
+    if (m->proc.exact == NULL)
+      continue;
+
+    value = (*m->proc.exact) (field, &m->user_data);
+    if (value != NULL)
+      return (value);
+  }
+
+  return (NULL);
+} /* }}} const char *fc_rule_exact */
+
+static int fc_plan_add_rule (fc_plan_t *plan, /* {{{ */
+    const char *value, size_t rule_index)
+{
+  fc_plan_bucket_t *b;
+  size_t *tmp;
+
+  if (value == NULL)
+  {
+    plan->always[plan->always_num] = rule_index;
+    plan->always_num++;
+    return (0);
+  }
+
+  b = fc_plan_bucket_get (plan, value);
+  if (b == NULL)
+  {
+    size_t mask = plan->buckets_size - 1;
+    size_t i;
+
+    for (i = fc_plan_hash (value) & mask;
+        plan->buckets[i].value != NULL;
+        i = (i + 1) & mask)
+      /* do nothing */;
+
+    b = plan->buckets + i;
+    b->value = fc_strdup (value);
+    if (b->value == NULL)
+      return (-1);
+  }
+
+  tmp = realloc (b->rules, (b->rules_num + 1) * sizeof (*b->rules));
+  if (tmp == NULL)
+    return (-1);
+  b->rules = tmp;
+  b->rules[b->rules_num] = rule_index;
+  b->rules_num++;
+
+  return (0);
+} /* }}} int fc_plan_add_rule */
+
+/* Builds the index of `plan', choosing the identifier field for which most
+ * rules require an exact value. */
+static int fc_plan_index (fc_plan_t *plan) /* {{{ */
+{
+  size_t counts[FC_FIELD_NUM];
+  size_t best_count;
+  int field;
+  size_t i;
+
+  plan->index_field = -1;
+
+  memset (counts, 0, sizeof (counts));
+  for (i = 0; i < plan->rules_num; i++)
+    for (field = 0; field < FC_FIELD_NUM; field++)
+      if (fc_rule_exact (plan->rules[i].rule, field) != NULL)
+        counts[field]++;
+
+  best_count = 0;
+  for (field = 0; field < FC_FIELD_NUM; field++)
+  {
+    if (counts[field] > best_count)
+    {
+      best_count = counts[field];
+      plan->index_field = field;
+    }
+  }
+
+  if (best_count < FC_PLAN_INDEX_MIN)
+  {
+    plan->index_field = -1;
+    return (0);
+  }
+
+  plan->buckets_size = 1;
+  while (plan->buckets_size < (2 * best_count))
+    plan->buckets_size *= 2;
+
+  plan->buckets = calloc (plan->buckets_size, sizeof (*plan->buckets));
+  plan->always = calloc (plan->rules_num, sizeof (*plan->always));
+  if ((plan->buckets == NULL) || (plan->always == NULL))
+    return (-1);
+
+  for (i = 0; i < plan->rules_num; i++)
+  {
+    const char *value = fc_rule_exact (plan->rules[i].rule,
+        plan->index_field);
+
+    if (fc_plan_add_rule (plan, value, i) != 0)
+      return (-1);
+  }
+
+  return (0);
+} /* }}} int fc_plan_index */
+
+/* Copies the targets in the list `head' into an array and resolves the chains
+ * `jump' targets refer to. */
+static int fc_plan_targets (fc_target_t *head, /* {{{ */
+    fc_target_t ***ret_targets, size_t *ret_targets_num)
+{
+  fc_target_t *t;
+  size_t num;
+
+  num = 0;
+  for (t = head; t != NULL; t = t->next)
+    num++;
+
+  *ret_targets = NULL;
+  *ret_targets_num = 0;
+  if (num == 0)
+    return (0);
+
+  *ret_targets = calloc (num, sizeof (**ret_targets));
+  if (*ret_targets == NULL)
+    return (-1);
+
+  for (t = head; t != NULL; t = t->next)
+  {
+    if (t->proc.invoke == fc_bit_jump_invoke)
+    {
+      fc_jump_t *jump = t->user_data;
+
+      jump->chain = fc_chain_get_by_name (jump->chain_name);
+      if (jump->chain == NULL)
+        WARNING ("Filter subsystem: Built-in target `jump': There is no "
+            "chain named `%s'.", jump->chain_name);
+    }
+
+    (*ret_targets)[*ret_targets_num] = t;
+    (*ret_targets_num)++;
+  }
+
+  return (0);
+} /* }}} int fc_plan_targets */
+
+/* Translates the linked lists of `chain' into a fc_plan_t. */
+static int fc_chain_compile (fc_chain_t *chain) /* {{{ */
+{
+  fc_plan_t *plan;
+  fc_rule_t *r;
+  size_t i;
+  int status;
+
+  plan = calloc (1, sizeof (*plan));
+  if (plan == NULL)
+  {
+    ERROR ("fc_chain_compile: calloc failed.");
+    return (-1);
+  }
+  plan->index_field = -1;
+
+  for (r = chain->rules; r != NULL; r = r->next)
+    plan->rules_num++;
+
+  status = 0;
+  if (plan->rules_num > 0)
+  {
+    plan->rules = calloc (plan->rules_num, sizeof (*plan->rules));
+    if (plan->rules == NULL)
+      status = -1;
+  }
+
+  for (r = chain->rules, i = 0; (status == 0) && (r != NULL);
+      r = r->next, i++)
+  {
+    fc_plan_rule_t *pr = plan->rules + i;
+    fc_match_t *m;
+
+    pr->rule = r;
+
+    for (m = r->matches; m != NULL; m = m->next)
+      pr->matches_num++;
+    if (pr->matches_num > 0)
+    {
+      pr->matches = calloc (pr->matches_num, sizeof (*pr->matches));
+      if (pr->matches == NULL)
+      {
+        status = -1;
+        break;
+      }
+    }
+    pr->matches_num = 0;
+    for (m = r->matches; m != NULL; m = m->next)
+      pr->matches[pr->matches_num++] = m;
+
+    status = fc_plan_targets (r->targets, &pr->targets, &pr->targets_num);
+  }
+
+  if (status == 0)
+    status = fc_plan_targets (chain->targets,
+        &plan->targets, &plan->targets_num);
+
+  if (status == 0)
+    status = fc_plan_index (plan);
+
+  if (status != 0)
+  {
+    ERROR ("fc_chain_compile: Compiling chain `%s' failed.", chain->name);
+    fc_free_plan (plan);
+    return (-1);
+  }
+
+  if (plan->index_field >= 0)
+    DEBUG ("fc_chain_compile (%s): Indexed %zu rules by field %i, "
+        "%zu rules are always tested.", chain->name, plan->rules_num,
+        plan->index_field, plan->always_num);
+
+  fc_free_plan (chain->plan);
+  chain->plan = plan;
+  return (0);
+} /* }}} int fc_chain_compile */
+
+/* Returns the index of the next rule after `prev' that may match, or
+ * `plan->rules_num' if there is none. `prev' is `rules_num' before the first
+ * rule has been tested. `cursor' holds the positions in `plan->always' and
+ * `bucket'. */
+static size_t fc_plan_next (const fc_plan_t *plan, /* {{{ */
+    const fc_plan_bucket_t *bucket, size_t prev, size_t cursor[2])
+{
+  size_t next_always = plan->rules_num;
+  size_t next_bucket = plan->rules_num;
+
+  if (plan->index_field < 0)
+    return ((prev >= plan->rules_num) ? 0 : prev + 1);
+
+  while ((cursor[0] < plan->always_num)
+      && (prev < plan->rules_num) && (plan->always[cursor[0]] <= prev))
+    cursor[0]++;
+  if (cursor[0] < plan->always_num)
+    next_always = plan->always[cursor[0]];
+
+  if (bucket != NULL)
+  {
+    while ((cursor[1] < bucket->rules_num)
+        && (prev < plan->rules_num) && (bucket->rules[cursor[1]] <= prev))
+      cursor[1]++;
+    if (cursor[1] < bucket->rules_num)
+      next_bucket = bucket->rules[cursor[1]];
+  }
+
+  return ((next_always < next_bucket) ? next_always : next_bucket);
+} /* }}} size_t fc_plan_next */
+
+static int fc_process_chain_series (const data_set_t *ds, /* {{{ */
+    value_list_t *vl, fc_chain_t *chain, fc_series_t *series)
+{
+  fc_plan_t *plan;
+  fc_plan_bucket_t *bucket;
   fc_target_t *target;
+  size_t cursor[2] = { 0, 0 };
+  size_t rule_index;
+  size_t i;
   int status;
 
   if (chain == NULL)
     return (-1);
 
+  plan = chain->plan;
+  if (plan == NULL)
+  {
+    pthread_mutex_lock (&fc_plan_lock);
+    if (chain->plan == NULL)
+      fc_chain_compile (chain);
+    plan = chain->plan;
+    pthread_mutex_unlock (&fc_plan_lock);
+
+    if (plan == NULL)
+      return (-1);
+  }
+
   DEBUG ("fc_process_chain (chain = %s);", chain->name);
 
+  bucket = NULL;
+  if (plan->index_field >= 0)
+    bucket = fc_plan_bucket_get (plan,
+        fc_field_value (vl, plan->index_field));
+
   status = FC_TARGET_CONTINUE;
-  for (rule = chain->rules; rule != NULL; rule = rule->next)
+  for (rule_index = fc_plan_next (plan, bucket, plan->rules_num, cursor);
+      rule_index < plan->rules_num;
+      rule_index = fc_plan_next (plan, bucket, rule_index, cursor))
   {
-    fc_match_t *match;
+    fc_plan_rule_t *pr = plan->rules + rule_index;
+    fc_rule_t *rule = pr->rule;
 
     if (rule->name[0] != 0)
     {
@@ -881,12 +1627,10 @@ int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
           chain->name, rule->name);
     }
 
-    /* N. B.: rule->matches may be NULL. */
-    for (match = rule->matches; match != NULL; match = match->next)
+    /* N. B.: The rule may not have any matches. */
+    for (i = 0; i < pr->matches_num; i++)
     {
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status = (*match->proc.match) (ds, vl, /* meta = */ NULL,
-          &match->user_data);
+      status = fc_match_invoke (ds, vl, pr->matches[i], series);
       if (status < 0)
       {
         WARNING ("fc_process_chain (%s): A match failed.", chain->name);
@@ -897,7 +1641,7 @@ int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
     }
 
     /* for-loop has been aborted: Either error or no match. */
-    if (match != NULL)
+    if (i < pr->matches_num)
     {
       status = FC_TARGET_CONTINUE;
       continue;
@@ -909,13 +1653,14 @@ int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
           chain->name, rule->name);
     }
 
-    for (target = rule->targets; target != NULL; target = target->next)
+    for (i = 0; i < pr->targets_num; i++)
     {
+      target = pr->targets[i];
+
       /* If we get here, all matches have matched the value. Execute the
        * target. */
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status = (*target->proc.invoke) (ds, vl, /* meta = */ NULL,
-          &target->user_data);
+      status = fc_target_call (ds, vl, target);
+      series->check = 1;
       if (status < 0)
       {
         WARNING ("fc_process_chain (%s): A target failed.", chain->name);
@@ -951,28 +1696,33 @@ int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
     {
       status = FC_TARGET_CONTINUE;
     }
-  } /* for (rule) */
+
+    /* The targets may have changed the indexed field. */
+    if ((plan->index_field >= 0) && (pr->targets_num > 0))
+    {
+      bucket = fc_plan_bucket_get (plan,
+          fc_field_value (vl, plan->index_field));
+      cursor[1] = 0;
+    }
+  } /* for (rule_index) */
 
   if (status == FC_TARGET_STOP)
     return (FC_TARGET_STOP);
   else if (status == FC_TARGET_RETURN)
     return (FC_TARGET_CONTINUE);
 
-  /* for-loop has been aborted: A target returned `FC_TARGET_STOP' */
-  if (rule != NULL)
-    return (FC_TARGET_CONTINUE);
-
   DEBUG ("fc_process_chain (%s): Executing the default targets.",
       chain->name);
 
   status = FC_TARGET_CONTINUE;
-  for (target = chain->targets; target != NULL; target = target->next)
+  target = NULL;
+  for (i = 0; i < plan->targets_num; i++)
   {
+    target = plan->targets[i];
+
     /* If we get here, all matches have matched the value. Execute the
      * target. */
-    /* FIXME: Pass the meta-data to match targets here (when implemented). */
-    status = (*target->proc.invoke) (ds, vl, /* meta = */ NULL,
-        &target->user_data);
+    status = fc_target_call (ds, vl, target);
     if (status < 0)
     {
       WARNING ("fc_process_chain (%s): The default target failed.",
@@ -1010,8 +1760,77 @@ int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
       chain->name);
 
   return (FC_TARGET_CONTINUE);
+} /* }}} int fc_process_chain_series */
+
+
+int fc_process_chain (const data_set_t *ds, value_list_t *vl, /* {{{ */
+    fc_chain_t *chain)
+{
+  fc_series_t series;
+  int status;
+
+  if (chain == NULL)
+    return (-1);
+
+  series.generation = chain->generation;
+  series.loaded = 0;
+  series.dirty = 0;
+  series.check = 0;
+
+  status = fc_process_chain_series (ds, vl, chain, &series);
+  fc_series_store (&series);
+
+  return (status);
 } /* }}} int fc_process_chain */
 
+int fc_init (void) /* {{{ */
+{
+  fc_chain_t *chain;
+  int generation;
+  int status = 0;
+
+  pthread_mutex_lock (&fc_cache_lock);
+  fc_cache_generation++;
+  generation = fc_cache_generation;
+  fc_cache_clear_nolock ();
+  pthread_mutex_unlock (&fc_cache_lock);
+
+  pthread_mutex_lock (&fc_plan_lock);
+  for (chain = chain_list_head; chain != NULL; chain = chain->next)
+  {
+    chain->generation = generation;
+    if (fc_chain_compile (chain) != 0)
+      status = -1;
+  }
+  pthread_mutex_unlock (&fc_plan_lock);
+
+  return (status);
+} /* }}} int fc_init */
+
+fc_chain_t *fc_chains_detach (void) /* {{{ */
+{
+  fc_chain_t *chains;
+
+  pthread_mutex_lock (&fc_plan_lock);
+  chains = chain_list_head;
+  chain_list_head = NULL;
+  pthread_mutex_unlock (&fc_plan_lock);
+
+  /* The matches of the new chains are numbered from zero again. Results of
+   * the previous chains can't be mixed up with theirs, because fc_init()
+   * starts a new cache generation. */
+  pthread_mutex_lock (&fc_cache_lock);
+  fc_cache_matches_num = 0;
+  pthread_mutex_unlock (&fc_cache_lock);
+
+  return (chains);
+} /* }}} fc_chain_t *fc_chains_detach */
+
+void fc_chains_free (fc_chain_t *chains) /* {{{ */
+{
+  fc_free_chains (chains);
+} /* }}} void fc_chains_free */
+
 /* Iterate over all rules in the chain and execute all targets for which all
  * matches match. */
 int fc_default_action (const data_set_t *ds, value_list_t *vl) /* {{{ */
@@ -28,6 +28,19 @@
 #define FC_MATCH_NO_MATCH  0
 #define FC_MATCH_MATCHES   1
 
+/* Flags for match_proc_t. FC_MATCH_CACHEABLE declares that the result of the
+ * match depends only on the identifier of the value list (and the match'
+ * configuration), so it may be cached per series. */
+#define FC_MATCH_CACHEABLE 0x0001
+
+/* Identifier fields, see match_proc_t.exact. */
+#define FC_FIELD_HOST            0
+#define FC_FIELD_PLUGIN          1
+#define FC_FIELD_PLUGIN_INSTANCE 2
+#define FC_FIELD_TYPE            3
+#define FC_FIELD_TYPE_INSTANCE   4
+#define FC_FIELD_NUM             5
+
 #define FC_TARGET_CONTINUE 0
 #define FC_TARGET_STOP     1
 #define FC_TARGET_RETURN   2
@@ -41,6 +54,11 @@ struct match_proc_s
   int (*destroy) (void **user_data);
   int (*match) (const data_set_t *ds, const value_list_t *vl,
       notification_meta_t **meta, void **user_data);
+  int flags;
+  /* Optional. If the match can only succeed if the identifier field `field'
+   * (one of the FC_FIELD_* constants) equals one exact string, returns that
+   * string. Returns NULL otherwise. Used to skip rules which cannot match. */
+  const char *(*exact) (int field, void **user_data);
 };
 typedef struct match_proc_s match_proc_t;
 
@@ -72,6 +90,13 @@ int fc_chain_add (const char *chain_name,
 int fc_chain_delete (const char *chain_name);
 #endif
 
+/* Removes all chains, so that a new set can be configured with
+ * fc_configure() when the configuration is reloaded. The previous chains are
+ * returned and must be freed with fc_chains_free() once no thread uses them
+ * anymore. */
+fc_chain_t *fc_chains_detach (void);
+void fc_chains_free (fc_chain_t *chains);
+
 /*
  * TODO: Rule management
  */
@@ -85,6 +110,11 @@ int fc_rule_delete (const char *chain_name, int position);
 /*
  * Processing function
  */
+/* Compiles all chains. Called after the configuration has been read and after
+ * the chains have been reconfigured. Match results cached for the previous
+ * chains are discarded. */
+int fc_init (void);
+
 fc_chain_t *fc_chain_get_by_name (const char *chain_name);
 
 int fc_process_chain (const data_set_t *ds, value_list_t *vl,
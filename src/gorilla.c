@@ -0,0 +1,1117 @@
+/**
+ * collectd - src/gorilla.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * The gorilla plugin stores values in a compact, columnar format. Instead of
+ * one file per series it appends compressed blocks to a few large "segment"
+ * files, so that all disk I/O is sequential:
+ *
+ *   <DataDir>/index.gor            Maps identifiers to numeric series IDs.
+ *                                  The file is memory mapped and consists of
+ *                                  fixed size records.
+ *   <DataDir>/segment-NNNNNNNN.gor Blocks of up to `BlockPoints' points of
+ *                                  one series each. Every block holds one
+ *                                  time column and one column per data
+ *                                  source, encoded by "utils_gorilla.h".
+ *
+ * All integers in both files are stored in network byte order. See
+ * contrib/gorilla_reader.py for a reader.
+ *
+ * Blocks are encoded into an output buffer while holding gr_lock. Full
+ * buffers are queued and written, and synced on flush, by a dedicated writer
+ * thread, so that the write callback never waits for the disk.
+ */
+
+#include "collectd.h"
+#include "plugin.h"
+#include "common.h"
+#include "utils_avltree.h"
+#include "utils_cache.h"
+#include "utils_gorilla.h"
+
+#if HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#if HAVE_ARPA_INET_H
+# include <arpa/inet.h>
+#endif
+#include <sys/mman.h>
+
+#define GR_INDEX_MAGIC   "CDGIDX01"
+#define GR_SEGMENT_MAGIC "CDGSEG01"
+#define GR_BLOCK_MAGIC   0x47424c4b /* "GBLK" */
+
+/* Identifier as produced by FORMAT_VL, i.e. "host/plugin-pi/type-ti". */
+#define GR_IDENT_LEN (6 * DATA_MAX_NAME_LEN)
+
+/* Column "type" of the time column in block headers. Value columns use the
+ * DS_TYPE_* constants. */
+#define GR_COLUMN_TIME 0xff
+
+#define GR_INDEX_HEADER_SIZE 16
+#define GR_INDEX_GROW        1024
+#define GR_OUT_BUFFER_SIZE   65536
+/* Number of queued buffers at which writers wait for the writer thread. */
+#define GR_QUEUE_MAX         64
+
+struct gr_index_record_s
+{
+  char     identifier[GR_IDENT_LEN];
+  uint32_t series_id;
+  uint32_t ds_num;
+};
+typedef struct gr_index_record_s gr_index_record_t;
+
+struct gr_series_s
+{
+  char     identifier[GR_IDENT_LEN];
+  uint32_t series_id;
+  int      ds_num;
+  /* The mismatch of ds_num and the data set has been reported. */
+  _Bool    ds_num_reported;
+
+  /* Allocated when the first value is written. */
+  int              *ds_types;
+  gorilla_column_t  time;
+  gorilla_column_t *values;
+  cdtime_t          first_time;
+};
+typedef struct gr_series_s gr_series_t;
+
+/* Holds complete blocks only, so that a failed write can be undone by
+ * truncating the segment to where the buffer started. */
+typedef struct gr_buffer_s gr_buffer_t;
+struct gr_buffer_s
+{
+  uint8_t *data;
+  size_t   size;
+  size_t   fill;
+
+  /* Open the next segment before writing this buffer. */
+  _Bool    new_segment;
+  /* Sync the segment and the index after writing this buffer. */
+  _Bool    sync;
+
+  uint64_t     ticket;
+  gr_buffer_t *next;
+};
+
+/*
+ * Private variables
+ */
+static const char *config_keys[] =
+{
+  "DataDir",
+  "StoreRates",
+  "BlockPoints",
+  "SegmentSize"
+};
+static int config_keys_num = STATIC_ARRAY_SIZE (config_keys);
+
+static char    *datadir      = NULL;
+static _Bool    store_rates  = 0;
+static uint32_t block_points = 120;
+static off_t    segment_size = 64 * 1024 * 1024;
+
+static pthread_mutex_t gr_lock = PTHREAD_MUTEX_INITIALIZER;
+static c_avl_tree_t   *series_tree = NULL;
+
+static int      index_fd   = -1;
+static uint8_t *index_map  = NULL;
+static size_t   index_size = 0;
+static uint32_t index_num  = 0;
+
+/* Buffer blocks are currently encoded into and the number of bytes in the
+ * current segment including that buffer. Protected by gr_lock. */
+static gr_buffer_t *out_buffer     = NULL;
+static off_t        segment_offset = 0;
+static _Bool        segment_rotate = 1;
+
+/* Buffers waiting for the writer thread. Protected by queue_lock. */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  done_cond  = PTHREAD_COND_INITIALIZER;
+static gr_buffer_t    *queue_head = NULL;
+static gr_buffer_t    *queue_tail = NULL;
+static int             queue_num  = 0;
+static uint64_t        ticket_next = 0;
+static uint64_t        ticket_done = 0;
+static _Bool           writer_failed = 0;
+static _Bool           writer_loop = 0;
+static pthread_t       writer_thread;
+
+/* Only used by the writer thread while it is running. */
+static int      segment_fd      = -1;
+static uint32_t segment_seq     = 0;
+static off_t    segment_written = 0;
+
+/*
+ * Helpers
+ */
+static int gr_path (char *buffer, size_t buffer_size, /* {{{ */
+    const char *file)
+{
+  int status;
+
+  if (datadir != NULL)
+    status = ssnprintf (buffer, buffer_size, "%s/%s", datadir, file);
+  else
+    status = ssnprintf (buffer, buffer_size, "%s", file);
+
+  if ((status < 1) || ((size_t) status >= buffer_size))
+    return (-1);
+  return (0);
+} /* }}} int gr_path */
+
+static void gr_put_u32 (uint8_t *buffer, uint32_t v) /* {{{ */
+{
+  v = htonl (v);
+  memcpy (buffer, &v, sizeof (v));
+} /* }}} void gr_put_u32 */
+
+static uint32_t gr_get_u32 (const uint8_t *buffer) /* {{{ */
+{
+  uint32_t v;
+  memcpy (&v, buffer, sizeof (v));
+  return (ntohl (v));
+} /* }}} uint32_t gr_get_u32 */
+
+/*
+ * Index file
+ */
+static gr_index_record_t *gr_index_record (uint32_t n) /* {{{ */
+{
+  return ((gr_index_record_t *) (index_map + GR_INDEX_HEADER_SIZE
+        + n * sizeof (gr_index_record_t)));
+} /* }}} gr_index_record_t *gr_index_record */
+
+static int gr_index_map (size_t size) /* {{{ */
+{
+  char errbuf[1024];
+
+  if (index_map != NULL)
+  {
+    munmap (index_map, index_size);
+    index_map = NULL;
+    index_size = 0;
+  }
+
+  if (ftruncate (index_fd, (off_t) size) != 0)
+  {
+    ERROR ("gorilla plugin: ftruncate on the index failed: %s",
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  index_map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+      index_fd, /* offset = */ 0);
+  if (index_map == MAP_FAILED)
+  {
+    index_map = NULL;
+    ERROR ("gorilla plugin: mmap on the index failed: %s",
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  index_size = size;
+  return (0);
+} /* }}} int gr_index_map */
+
+static gr_series_t *gr_series_create (const char *identifier, /* {{{ */
+    uint32_t series_id, int ds_num)
+{
+  gr_series_t *s;
+
+  s = calloc (1, sizeof (*s));
+  if (s == NULL)
+    return (NULL);
+
+  sstrncpy (s->identifier, identifier, sizeof (s->identifier));
+  s->series_id = series_id;
+  s->ds_num = ds_num;
+
+  if (c_avl_insert (series_tree, s->identifier, s) != 0)
+  {
+    sfree (s);
+    return (NULL);
+  }
+
+  return (s);
+} /* }}} gr_series_t *gr_series_create */
+
+static int gr_index_open (void) /* {{{ */
+{
+  char filename[1024];
+  char errbuf[1024];
+  struct stat statbuf;
+  uint32_t i;
+
+  if (gr_path (filename, sizeof (filename), "index.gor") != 0)
+    return (-1);
+
+  if (check_create_dir (filename) != 0)
+    return (-1);
+
+  index_fd = open (filename, O_RDWR | O_CREAT, 0644);
+  if (index_fd < 0)
+  {
+    ERROR ("gorilla plugin: open (%s) failed: %s", filename,
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  if (fstat (index_fd, &statbuf) != 0)
+  {
+    ERROR ("gorilla plugin: fstat (%s) failed: %s", filename,
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  if (statbuf.st_size < GR_INDEX_HEADER_SIZE)
+  {
+    /* New index */
+    if (gr_index_map (GR_INDEX_HEADER_SIZE
+          + GR_INDEX_GROW * sizeof (gr_index_record_t)) != 0)
+      return (-1);
+
+    memcpy (index_map, GR_INDEX_MAGIC, 8);
+    gr_put_u32 (index_map + 8, 0);
+    gr_put_u32 (index_map + 12, 0);
+    index_num = 0;
+    return (0);
+  }
+
+  if (gr_index_map ((size_t) statbuf.st_size) != 0)
+    return (-1);
+
+  if (memcmp (index_map, GR_INDEX_MAGIC, 8) != 0)
+  {
+    ERROR ("gorilla plugin: %s is not a gorilla index file.", filename);
+    return (-1);
+  }
+
+  index_num = gr_get_u32 (index_map + 8);
+  if ((GR_INDEX_HEADER_SIZE + index_num * sizeof (gr_index_record_t))
+      > index_size)
+  {
+    ERROR ("gorilla plugin: %s is truncated.", filename);
+    return (-1);
+  }
+
+  for (i = 0; i < index_num; i++)
+  {
+    gr_index_record_t *r = gr_index_record (i);
+    char identifier[GR_IDENT_LEN];
+
+    sstrncpy (identifier, r->identifier, sizeof (identifier));
+    if (gr_series_create (identifier, ntohl (r->series_id),
+          (int) ntohl (r->ds_num)) == NULL)
+    {
+      ERROR ("gorilla plugin: Loading \"%s\" from the index failed.",
+          identifier);
+      return (-1);
+    }
+  }
+
+  DEBUG ("gorilla plugin: Loaded %"PRIu32" series from %s.",
+      index_num, filename);
+  return (0);
+} /* }}} int gr_index_open */
+
+static int gr_index_add (gr_series_t *s) /* {{{ */
+{
+  gr_index_record_t *r;
+  size_t need;
+
+  need = GR_INDEX_HEADER_SIZE + (index_num + 1) * sizeof (gr_index_record_t);
+  if (need > index_size)
+  {
+    if (gr_index_map (index_size
+          + GR_INDEX_GROW * sizeof (gr_index_record_t)) != 0)
+      return (-1);
+  }
+
+  r = gr_index_record (index_num);
+  memset (r, 0, sizeof (*r));
+  sstrncpy (r->identifier, s->identifier, sizeof (r->identifier));
+  r->series_id = htonl (s->series_id);
+  r->ds_num = htonl ((uint32_t) s->ds_num);
+
+  index_num++;
+  gr_put_u32 (index_map + 8, index_num);
+  return (0);
+} /* }}} int gr_index_add */
+
+static void gr_index_close (void) /* {{{ */
+{
+  if (index_map != NULL)
+  {
+    msync (index_map, index_size, MS_SYNC);
+    munmap (index_map, index_size);
+    index_map = NULL;
+    index_size = 0;
+  }
+
+  if (index_fd >= 0)
+  {
+    close (index_fd);
+    index_fd = -1;
+  }
+} /* }}} void gr_index_close */
+
+/*
+ * Segment files, written by the writer thread
+ */
+static int gr_segment_write_all (const uint8_t *data, size_t size) /* {{{ */
+{
+  size_t offset = 0;
+
+  while (offset < size)
+  {
+    ssize_t status;
+
+    status = write (segment_fd, data + offset, size - offset);
+    if (status < 0)
+    {
+      char errbuf[1024];
+
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      ERROR ("gorilla plugin: Writing segment %"PRIu32" failed: %s",
+          segment_seq, sstrerror (errno, errbuf, sizeof (errbuf)));
+      return (-1);
+    }
+
+    offset += (size_t) status;
+  }
+
+  return (0);
+} /* }}} int gr_segment_write_all */
+
+/* Removes a partially written buffer from the end of the segment, so that it
+ * ends with a complete block. If that fails, the segment is closed and the
+ * next buffer starts a new one. */
+static void gr_segment_undo (void) /* {{{ */
+{
+  char errbuf[1024];
+
+  if (ftruncate (segment_fd, segment_written) == 0)
+    return;
+
+  ERROR ("gorilla plugin: Truncating segment %"PRIu32" failed: %s. "
+      "Starting a new segment.", segment_seq,
+      sstrerror (errno, errbuf, sizeof (errbuf)));
+  close (segment_fd);
+  segment_fd = -1;
+} /* }}} void gr_segment_undo */
+
+static void gr_segment_close (void) /* {{{ */
+{
+  if (segment_fd < 0)
+    return;
+
+  fdatasync (segment_fd);
+  close (segment_fd);
+  segment_fd = -1;
+} /* }}} void gr_segment_close */
+
+static int gr_segment_find_last (void) /* {{{ */
+{
+  DIR *dh;
+  struct dirent *de;
+
+  dh = opendir ((datadir != NULL) ? datadir : ".");
+  if (dh == NULL)
+    return (-1);
+
+  while ((de = readdir (dh)) != NULL)
+  {
+    unsigned int seq;
+
+    if (sscanf (de->d_name, "segment-%u.gor", &seq) != 1)
+      continue;
+    if (seq > segment_seq)
+      segment_seq = (uint32_t) seq;
+  }
+
+  closedir (dh);
+  return (0);
+} /* }}} int gr_segment_find_last */
+
+/* Closes the current segment, if any, and opens the next one. Existing
+ * segments are never appended to, because their tail may be incomplete. */
+static int gr_segment_open_next (void) /* {{{ */
+{
+  char file[64];
+  char filename[1024];
+  char errbuf[1024];
+
+  gr_segment_close ();
+
+  segment_seq++;
+  ssnprintf (file, sizeof (file), "segment-%08"PRIu32".gor", segment_seq);
+  if (gr_path (filename, sizeof (filename), file) != 0)
+    return (-1);
+
+  segment_fd = open (filename, O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+  if (segment_fd < 0)
+  {
+    ERROR ("gorilla plugin: open (%s) failed: %s", filename,
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  segment_written = 0;
+  if (gr_segment_write_all ((const uint8_t *) GR_SEGMENT_MAGIC, 8) != 0)
+  {
+    gr_segment_undo ();
+    return (-1);
+  }
+  segment_written = 8;
+
+  return (0);
+} /* }}} int gr_segment_open_next */
+
+static int gr_segment_write_buffer (const gr_buffer_t *b) /* {{{ */
+{
+  int status = 0;
+
+  if ((b->fill > 0) && (b->new_segment || (segment_fd < 0)))
+    status = gr_segment_open_next ();
+
+  if ((status == 0) && (b->fill > 0))
+  {
+    status = gr_segment_write_all (b->data, b->fill);
+    if (status == 0)
+      segment_written += (off_t) b->fill;
+    else
+      gr_segment_undo ();
+  }
+
+  if (b->sync)
+  {
+    if (segment_fd >= 0)
+      fdatasync (segment_fd);
+    /* Also writes back the pages of the memory mapped index. */
+    if (index_fd >= 0)
+      fdatasync (index_fd);
+  }
+
+  return (status);
+} /* }}} int gr_segment_write_buffer */
+
+static void *gr_writer_thread (void __attribute__((unused)) *arg) /* {{{ */
+{
+  pthread_mutex_lock (&queue_lock);
+  while (42)
+  {
+    gr_buffer_t *b;
+    int status;
+
+    while (writer_loop && (queue_head == NULL))
+      pthread_cond_wait (&queue_cond, &queue_lock);
+
+    /* Write all queued buffers before exiting. */
+    if (queue_head == NULL)
+      break;
+
+    b = queue_head;
+    queue_head = b->next;
+    if (queue_head == NULL)
+      queue_tail = NULL;
+    pthread_mutex_unlock (&queue_lock);
+
+    status = gr_segment_write_buffer (b);
+
+    pthread_mutex_lock (&queue_lock);
+    queue_num--;
+    ticket_done = b->ticket;
+    if (status != 0)
+      writer_failed = 1;
+    pthread_cond_broadcast (&done_cond);
+
+    sfree (b->data);
+    sfree (b);
+  }
+  pthread_mutex_unlock (&queue_lock);
+
+  gr_segment_close ();
+  return (NULL);
+} /* }}} void *gr_writer_thread */
+
+/* Waits until the buffer with `ticket' has been written. Returns non-zero if
+ * writing a buffer failed since the last call. */
+static int gr_writer_wait (uint64_t ticket) /* {{{ */
+{
+  int status;
+
+  pthread_mutex_lock (&queue_lock);
+  while (writer_loop && (ticket_done < ticket))
+    pthread_cond_wait (&done_cond, &queue_lock);
+  status = writer_failed ? -1 : 0;
+  writer_failed = 0;
+  pthread_mutex_unlock (&queue_lock);
+
+  return (status);
+} /* }}} int gr_writer_wait */
+
+/* Waits while the writer thread is behind by more than GR_QUEUE_MAX
+ * buffers. Must be called without holding gr_lock. */
+static void gr_writer_throttle (void) /* {{{ */
+{
+  pthread_mutex_lock (&queue_lock);
+  while (writer_loop && (queue_num > GR_QUEUE_MAX))
+    pthread_cond_wait (&done_cond, &queue_lock);
+  pthread_mutex_unlock (&queue_lock);
+} /* }}} void gr_writer_throttle */
+
+/*
+ * Output buffer, protected by gr_lock
+ */
+
+/* Hands the current output buffer over to the writer thread. With `sync', a
+ * buffer is queued even if there is no data, so that the files are synced.
+ * Returns the ticket of the queued buffer, or zero. */
+static uint64_t gr_buffer_queue (_Bool sync) /* {{{ */
+{
+  gr_buffer_t *b = out_buffer;
+  uint64_t ticket;
+
+  if ((b == NULL) && sync)
+    b = calloc (1, sizeof (*b));
+  if (b == NULL)
+    return (0);
+
+  out_buffer = NULL;
+  b->sync = sync;
+
+  pthread_mutex_lock (&queue_lock);
+  b->ticket = ++ticket_next;
+  ticket = b->ticket;
+  if (queue_tail == NULL)
+    queue_head = b;
+  else
+    queue_tail->next = b;
+  queue_tail = b;
+  queue_num++;
+  pthread_cond_signal (&queue_cond);
+  pthread_mutex_unlock (&queue_lock);
+
+  return (ticket);
+} /* }}} uint64_t gr_buffer_queue */
+
+static int gr_buffer_append (const void *data, size_t size) /* {{{ */
+{
+  gr_buffer_t *b = out_buffer;
+
+  if (b == NULL)
+  {
+    b = calloc (1, sizeof (*b));
+    if (b == NULL)
+      return (-1);
+    b->data = malloc (GR_OUT_BUFFER_SIZE);
+    if (b->data == NULL)
+    {
+      sfree (b);
+      return (-1);
+    }
+    b->size = GR_OUT_BUFFER_SIZE;
+
+    b->new_segment = segment_rotate;
+    if (segment_rotate)
+    {
+      segment_rotate = 0;
+      segment_offset = 8;
+    }
+
+    out_buffer = b;
+  }
+
+  if ((b->size - b->fill) < size)
+  {
+    size_t new_size = b->size;
+    uint8_t *tmp;
+
+    while ((new_size - b->fill) < size)
+      new_size *= 2;
+
+    tmp = realloc (b->data, new_size);
+    if (tmp == NULL)
+      return (-1);
+    b->data = tmp;
+    b->size = new_size;
+  }
+
+  memcpy (b->data + b->fill, data, size);
+  b->fill += size;
+  segment_offset += (off_t) size;
+
+  return (0);
+} /* }}} int gr_buffer_append */
+
+/* Encodes the pending points of `s' as one block into the output buffer and
+ * resets its columns. The caller must hold gr_lock. */
+static int gr_block_write (gr_series_t *s) /* {{{ */
+{
+  uint8_t header[16];
+  uint8_t column_header[8];
+  size_t fill;
+  int status;
+  int i;
+
+  if ((s->values == NULL) || (s->time.num == 0))
+    return (0);
+
+  if (segment_offset >= segment_size)
+  {
+    gr_buffer_queue (/* sync = */ 0);
+    segment_rotate = 1;
+  }
+
+  /* Buffers must only hold complete blocks. */
+  fill = (out_buffer != NULL) ? out_buffer->fill : 0;
+
+  gr_put_u32 (header, GR_BLOCK_MAGIC);
+  gr_put_u32 (header + 4, s->series_id);
+  gr_put_u32 (header + 8, s->time.num);
+  gr_put_u32 (header + 12, (uint32_t) (s->ds_num + 1) << 16);
+  status = gr_buffer_append (header, sizeof (header));
+
+  /* Column headers */
+  memset (column_header, 0, sizeof (column_header));
+  column_header[0] = GR_COLUMN_TIME;
+  gr_put_u32 (column_header + 4, (uint32_t) s->time.bits);
+  if (status == 0)
+    status = gr_buffer_append (column_header, sizeof (column_header));
+
+  for (i = 0; (i < s->ds_num) && (status == 0); i++)
+  {
+    column_header[0] = (uint8_t) s->ds_types[i];
+    gr_put_u32 (column_header + 4, (uint32_t) s->values[i].bits);
+    status = gr_buffer_append (column_header, sizeof (column_header));
+  }
+
+  /* Column data */
+  if (status == 0)
+    status = gr_buffer_append (s->time.data, gorilla_column_size (&s->time));
+  for (i = 0; (i < s->ds_num) && (status == 0); i++)
+    status = gr_buffer_append (s->values[i].data,
+        gorilla_column_size (&s->values[i]));
+
+  if (status != 0)
+  {
+    ERROR ("gorilla plugin: Buffering a block of \"%s\" failed.",
+        s->identifier);
+    if (out_buffer != NULL)
+    {
+      segment_offset -= (off_t) (out_buffer->fill - fill);
+      out_buffer->fill = fill;
+    }
+  }
+
+  gorilla_column_reset (&s->time);
+  for (i = 0; i < s->ds_num; i++)
+    gorilla_column_reset (&s->values[i]);
+
+  if ((out_buffer != NULL) && (out_buffer->fill >= GR_OUT_BUFFER_SIZE))
+    gr_buffer_queue (/* sync = */ 0);
+
+  return (status);
+} /* }}} int gr_block_write */
+
+/*
+ * Series handling
+ */
+static void gr_series_free (gr_series_t *s) /* {{{ */
+{
+  int i;
+
+  if (s == NULL)
+    return;
+
+  gorilla_column_destroy (&s->time);
+  if (s->values != NULL)
+    for (i = 0; i < s->ds_num; i++)
+      gorilla_column_destroy (&s->values[i]);
+  sfree (s->values);
+  sfree (s->ds_types);
+  sfree (s);
+} /* }}} void gr_series_free */
+
+static gr_series_t *gr_series_get (const data_set_t *ds, /* {{{ */
+    const char *identifier)
+{
+  gr_series_t *s = NULL;
+  int i;
+
+  if (c_avl_get (series_tree, identifier, (void *) &s) != 0)
+  {
+    s = gr_series_create (identifier, index_num, ds->ds_num);
+    if (s == NULL)
+    {
+      ERROR ("gorilla plugin: Creating series \"%s\" failed.", identifier);
+      return (NULL);
+    }
+
+    if (gr_index_add (s) != 0)
+    {
+      c_avl_remove (series_tree, s->identifier, NULL, NULL);
+      gr_series_free (s);
+      return (NULL);
+    }
+  }
+
+  if (s->ds_num != ds->ds_num)
+  {
+    if (!s->ds_num_reported)
+      ERROR ("gorilla plugin: Series \"%s\" has %i data sources in the "
+          "index, but the value list has %i. Values of this series are "
+          "dropped.", identifier, s->ds_num, ds->ds_num);
+    s->ds_num_reported = 1;
+    return (NULL);
+  }
+
+  if (s->values != NULL)
+    return (s);
+
+  s->ds_types = calloc ((size_t) s->ds_num, sizeof (*s->ds_types));
+  s->values = calloc ((size_t) s->ds_num, sizeof (*s->values));
+  if ((s->ds_types == NULL) || (s->values == NULL))
+  {
+    ERROR ("gorilla plugin: calloc failed.");
+    sfree (s->ds_types);
+    sfree (s->values);
+    return (NULL);
+  }
+
+  gorilla_column_reset (&s->time);
+  for (i = 0; i < s->ds_num; i++)
+  {
+    s->ds_types[i] = store_rates ? DS_TYPE_GAUGE : ds->ds[i].type;
+    gorilla_column_reset (&s->values[i]);
+  }
+
+  return (s);
+} /* }}} gr_series_t *gr_series_get */
+
+static uint64_t gr_value_bits (int ds_type, value_t v, /* {{{ */
+    const gauge_t *rates, int index)
+{
+  uint64_t bits;
+
+  if ((ds_type == DS_TYPE_GAUGE) || (rates != NULL))
+  {
+    gauge_t g = (rates != NULL) ? rates[index] : v.gauge;
+    memcpy (&bits, &g, sizeof (bits));
+  }
+  else if (ds_type == DS_TYPE_COUNTER)
+    bits = (uint64_t) v.counter;
+  else if (ds_type == DS_TYPE_DERIVE)
+    bits = (uint64_t) v.derive;
+  else
+    bits = (uint64_t) v.absolute;
+
+  return (bits);
+} /* }}} uint64_t gr_value_bits */
+
+/*
+ * Callbacks
+ */
+static int gr_config (const char *key, const char *value) /* {{{ */
+{
+  if (strcasecmp ("DataDir", key) == 0)
+  {
+    sfree (datadir);
+    datadir = strdup (value);
+    if (datadir != NULL)
+    {
+      int len = strlen (datadir);
+      while ((len > 0) && (datadir[len - 1] == '/'))
+      {
+        len--;
+        datadir[len] = '\0';
+      }
+      if (len <= 0)
+        sfree (datadir);
+    }
+  }
+  else if (strcasecmp ("StoreRates", key) == 0)
+  {
+    store_rates = IS_TRUE (value) ? 1 : 0;
+  }
+  else if (strcasecmp ("BlockPoints", key) == 0)
+  {
+    int tmp = atoi (value);
+    if (tmp <= 0)
+    {
+      ERROR ("gorilla plugin: `BlockPoints' must be greater than 0.");
+      return (1);
+    }
+    block_points = (uint32_t) tmp;
+  }
+  else if (strcasecmp ("SegmentSize", key) == 0)
+  {
+    double tmp = atof (value);
+    if (tmp < 4096.0)
+    {
+      ERROR ("gorilla plugin: `SegmentSize' must be at least 4096 bytes.");
+      return (1);
+    }
+    segment_size = (off_t) tmp;
+  }
+  else
+  {
+    return (-1);
+  }
+  return (0);
+} /* }}} int gr_config */
+
+static int gr_write (const data_set_t *ds, const value_list_t *vl, /* {{{ */
+    user_data_t __attribute__((unused)) *user_data)
+{
+  char identifier[GR_IDENT_LEN];
+  gauge_t *rates = NULL;
+  gr_series_t *s;
+  uint64_t time_ms;
+  int status;
+  int i;
+
+  if (0 != strcmp (ds->type, vl->type)) {
+    ERROR ("gorilla plugin: DS type does not match value list type");
+    return -1;
+  }
+
+  if (FORMAT_VL (identifier, sizeof (identifier), vl) != 0)
+    return (-1);
+
+  if (store_rates)
+  {
+    rates = uc_get_rate (ds, vl);
+    if (rates == NULL)
+    {
+      WARNING ("gorilla plugin: uc_get_rate failed.");
+      return (-1);
+    }
+  }
+
+  /* Time stamps are stored with millisecond resolution, which keeps the
+   * delta-of-delta of jittery intervals small. */
+  time_ms = (uint64_t) (CDTIME_T_TO_DOUBLE (vl->time) * 1000.0);
+
+  pthread_mutex_lock (&gr_lock);
+
+  if (series_tree == NULL)
+  {
+    pthread_mutex_unlock (&gr_lock);
+    sfree (rates);
+    return (-1);
+  }
+
+  s = gr_series_get (ds, identifier);
+  if (s == NULL)
+  {
+    pthread_mutex_unlock (&gr_lock);
+    sfree (rates);
+    return (-1);
+  }
+
+  /* Reserve space in all columns first, so that a failing allocation can't
+   * leave the time column with one entry more than the value columns. */
+  status = gorilla_column_reserve (&s->time);
+  for (i = 0; (i < ds->ds_num) && (status == 0); i++)
+    status = gorilla_column_reserve (&s->values[i]);
+
+  if (status != 0)
+  {
+    ERROR ("gorilla plugin: Encoding a value of \"%s\" failed.", identifier);
+  }
+  else
+  {
+    if (s->time.num == 0)
+      s->first_time = vl->time;
+
+    gorilla_column_append_time (&s->time, time_ms);
+    for (i = 0; i < ds->ds_num; i++)
+      gorilla_column_append_value (&s->values[i],
+          gr_value_bits (ds->ds[i].type, vl->values[i], rates, i));
+
+    if (s->time.num >= block_points)
+      status = gr_block_write (s);
+  }
+
+  pthread_mutex_unlock (&gr_lock);
+  sfree (rates);
+
+  gr_writer_throttle ();
+
+  return (status);
+} /* }}} int gr_write */
+
+/* Encodes all blocks older than `timeout' (or all blocks, if `timeout' is
+ * zero) and queues the output buffer, asking the writer thread to sync the
+ * files. Stores the ticket to wait for in `ret_ticket'. The caller must hold
+ * gr_lock. */
+static int gr_flush_nolock (cdtime_t timeout, /* {{{ */
+    const char *identifier, uint64_t *ret_ticket)
+{
+  c_avl_iterator_t *iter;
+  gr_series_t *s;
+  char *key;
+  cdtime_t now;
+  int status = 0;
+
+  if (series_tree == NULL)
+    return (0);
+
+  now = cdtime ();
+
+  if (identifier != NULL)
+  {
+    if (c_avl_get (series_tree, identifier, (void *) &s) == 0)
+      status = gr_block_write (s);
+  }
+  else
+  {
+    iter = c_avl_get_iterator (series_tree);
+    while (c_avl_iterator_next (iter, (void *) &key, (void *) &s) == 0)
+    {
+      if (s->time.num == 0)
+        continue;
+      if ((timeout != 0) && ((now - s->first_time) < timeout))
+        continue;
+      if (gr_block_write (s) != 0)
+        status = -1;
+    }
+    c_avl_iterator_destroy (iter);
+  }
+
+  *ret_ticket = gr_buffer_queue (/* sync = */ 1);
+
+  return (status);
+} /* }}} int gr_flush_nolock */
+
+static int gr_flush (cdtime_t timeout, const char *identifier, /* {{{ */
+    user_data_t __attribute__((unused)) *user_data)
+{
+  uint64_t ticket = 0;
+  int status;
+
+  pthread_mutex_lock (&gr_lock);
+  status = gr_flush_nolock (timeout, identifier, &ticket);
+  pthread_mutex_unlock (&gr_lock);
+
+  /* The files are written and synced without holding gr_lock. */
+  if ((ticket != 0) && (gr_writer_wait (ticket) != 0))
+    status = -1;
+
+  return (status);
+} /* }}} int gr_flush */
+
+static int gr_init (void) /* {{{ */
+{
+  pthread_mutex_lock (&gr_lock);
+
+  if (series_tree != NULL)
+  {
+    pthread_mutex_unlock (&gr_lock);
+    return (0);
+  }
+
+  series_tree = c_avl_create ((int (*) (const void *, const void *)) strcmp);
+  if (series_tree == NULL)
+  {
+    pthread_mutex_unlock (&gr_lock);
+    ERROR ("gorilla plugin: c_avl_create failed.");
+    return (-1);
+  }
+
+  if ((gr_index_open () != 0) || (gr_segment_find_last () != 0))
+  {
+    pthread_mutex_unlock (&gr_lock);
+    ERROR ("gorilla plugin: Opening the data directory failed.");
+    return (-1);
+  }
+
+  writer_loop = 1;
+  if (plugin_thread_create (&writer_thread, /* attr = */ NULL,
+        gr_writer_thread, /* arg = */ NULL) != 0)
+  {
+    char errbuf[1024];
+
+    writer_loop = 0;
+    pthread_mutex_unlock (&gr_lock);
+    ERROR ("gorilla plugin: Starting the writer thread failed: %s",
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  pthread_mutex_unlock (&gr_lock);
+  return (0);
+} /* }}} int gr_init */
+
+static int gr_shutdown (void) /* {{{ */
+{
+  gr_series_t *s;
+  uint64_t ticket = 0;
+  char *key;
+
+  pthread_mutex_lock (&gr_lock);
+
+  gr_flush_nolock (/* timeout = */ 0, /* identifier = */ NULL, &ticket);
+
+  /* The writer thread writes all queued buffers before it exits. */
+  if (writer_loop)
+  {
+    pthread_mutex_lock (&queue_lock);
+    writer_loop = 0;
+    pthread_cond_broadcast (&queue_cond);
+    pthread_cond_broadcast (&done_cond);
+    pthread_mutex_unlock (&queue_lock);
+
+    pthread_join (writer_thread, /* retval = */ NULL);
+  }
+
+  gr_index_close ();
+
+  if (series_tree != NULL)
+  {
+    while (c_avl_pick (series_tree, (void *) &key, (void *) &s) == 0)
+      gr_series_free (s);
+    c_avl_destroy (series_tree);
+    series_tree = NULL;
+  }
+
+  pthread_mutex_unlock (&gr_lock);
+  return (0);
+} /* }}} int gr_shutdown */
+
+void module_register (void)
+{
+  plugin_register_config ("gorilla", gr_config,
+      config_keys, config_keys_num);
+  plugin_register_init ("gorilla", gr_init);
+  plugin_register_write ("gorilla", gr_write, /* user_data = */ NULL);
+  plugin_register_flush ("gorilla", gr_flush, /* user_data = */ NULL);
+  plugin_register_shutdown ("gorilla", gr_shutdown);
+} /* void module_register */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,366 @@
+/**
+ * collectd - src/gorilla_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Encodes sequences of time stamps and values with the column encoder of
+ * "utils_gorilla.h" and checks that decoding returns the exact bit patterns.
+ */
+
+#include "collectd.h"
+#include "common.h"
+#include "utils_gorilla.h"
+
+#include <float.h>
+#include <math.h>
+
+static int failures = 0;
+
+static uint64_t double_bits (double d) /* {{{ */
+{
+  uint64_t bits;
+
+  memcpy (&bits, &d, sizeof (bits));
+  return (bits);
+} /* }}} uint64_t double_bits */
+
+static void append_time (gorilla_column_t *c, uint64_t t) /* {{{ */
+{
+  if (gorilla_column_append_time (c, t) != 0)
+  {
+    printf ("gorilla_column_append_time failed\n");
+    failures++;
+  }
+} /* }}} void append_time */
+
+static void append_value (gorilla_column_t *c, uint64_t v) /* {{{ */
+{
+  if (gorilla_column_append_value (c, v) != 0)
+  {
+    printf ("gorilla_column_append_value failed\n");
+    failures++;
+  }
+} /* }}} void append_value */
+
+/* Decodes `c' and compares the result with `expected'. `is_time' selects
+ * the time or the value decoder. */
+static void check_column (char const *name, /* {{{ */
+    gorilla_column_t const *c, uint64_t const *expected, size_t expected_num,
+    _Bool is_time)
+{
+  gorilla_reader_t r;
+  size_t i;
+  int status;
+
+  if (c->num != expected_num)
+  {
+    printf ("%s: column holds %"PRIu32" values, expected %zu\n",
+        name, c->num, expected_num);
+    failures++;
+  }
+
+  if (gorilla_column_size (c) != (c->bits + 7) / 8)
+  {
+    printf ("%s: column size %zu does not match %zu bits\n",
+        name, gorilla_column_size (c), c->bits);
+    failures++;
+  }
+
+  gorilla_reader_init (&r, c->data, c->bits);
+  for (i = 0; i < expected_num; i++)
+  {
+    uint64_t v = 0;
+
+    status = is_time
+      ? gorilla_reader_next_time (&r, &v)
+      : gorilla_reader_next_value (&r, &v);
+    if (status != 0)
+    {
+      printf ("%s: decoding value %zu failed with status %i\n",
+          name, i, status);
+      failures++;
+      return;
+    }
+
+    if (v != expected[i])
+    {
+      printf ("%s: value %zu is 0x%016"PRIx64", expected 0x%016"PRIx64"\n",
+          name, i, v, expected[i]);
+      failures++;
+      return;
+    }
+  }
+
+  if (r.pos != r.bits)
+  {
+    printf ("%s: %zu bits left after decoding\n", name, r.bits - r.pos);
+    failures++;
+  }
+} /* }}} void check_column */
+
+static void check_times (char const *name, /* {{{ */
+    uint64_t const *times, size_t times_num)
+{
+  gorilla_column_t c;
+  size_t i;
+
+  memset (&c, 0, sizeof (c));
+  gorilla_column_reset (&c);
+
+  for (i = 0; i < times_num; i++)
+    append_time (&c, times[i]);
+
+  check_column (name, &c, times, times_num, /* is_time = */ 1);
+  gorilla_column_destroy (&c);
+} /* }}} void check_times */
+
+static void check_values (char const *name, /* {{{ */
+    uint64_t const *values, size_t values_num)
+{
+  gorilla_column_t c;
+  size_t i;
+
+  memset (&c, 0, sizeof (c));
+  gorilla_column_reset (&c);
+
+  for (i = 0; i < values_num; i++)
+    append_value (&c, values[i]);
+
+  check_column (name, &c, values, values_num, /* is_time = */ 0);
+  gorilla_column_destroy (&c);
+} /* }}} void check_values */
+
+static void test_times (void) /* {{{ */
+{
+  /* Regular 10 second interval in milliseconds, some jitter. */
+  uint64_t regular[] = { 1380000000000ULL, 1380000010000ULL,
+    1380000020000ULL, 1380000030000ULL, 1380000040001ULL, 1380000049999ULL,
+    1380000060000ULL, 1380000070063ULL, 1380000079937ULL };
+  /* Every delta-of-delta range, at and just beyond its limits. */
+  uint64_t ranges[] = { 1000, 1000, 1063, 1062, 1317, 1316, 3363, 3362,
+    7457, 7456, 11553, 11552 };
+  /* Delta-of-delta needing the 64 bit encoding, including steps back. */
+  uint64_t jumps[] = { 0, 1, ((uint64_t) 1) << 40, 5, UINT64_MAX,
+    UINT64_MAX, 0, ((uint64_t) 1) << 63, 42 };
+  uint64_t same[] = { 1380000000000ULL, 1380000000000ULL, 1380000000000ULL,
+    1380000000000ULL };
+  uint64_t one[] = { UINT64_MAX };
+  uint64_t many[1000];
+  size_t i;
+
+  check_times ("regular times", regular, STATIC_ARRAY_SIZE (regular));
+  check_times ("delta-of-delta ranges", ranges, STATIC_ARRAY_SIZE (ranges));
+  check_times ("time jumps", jumps, STATIC_ARRAY_SIZE (jumps));
+  check_times ("identical times", same, STATIC_ARRAY_SIZE (same));
+  check_times ("single time", one, STATIC_ARRAY_SIZE (one));
+
+  /* Enough values to grow the buffer several times. */
+  srand (42);
+  many[0] = 1380000000000ULL;
+  for (i = 1; i < STATIC_ARRAY_SIZE (many); i++)
+    many[i] = many[i - 1] + 10000 + (uint64_t) (rand () % 5000);
+  check_times ("random times", many, STATIC_ARRAY_SIZE (many));
+} /* }}} void test_times */
+
+static void test_values (void) /* {{{ */
+{
+  uint64_t same[] = { double_bits (42.0), double_bits (42.0),
+    double_bits (42.0), double_bits (42.0) };
+  uint64_t special[] = { double_bits (NAN), double_bits (NAN),
+    double_bits (INFINITY), double_bits (-INFINITY), double_bits (INFINITY),
+    double_bits (0.0), double_bits (-0.0), double_bits (NAN),
+    double_bits (DBL_MAX), double_bits (-DBL_MAX), double_bits (DBL_MIN),
+    double_bits (4.9406564584124654e-324) };
+  uint64_t signs[] = { double_bits (1.5), double_bits (-1.5),
+    double_bits (1.5), double_bits (-1.5), double_bits (-1.5),
+    double_bits (1e300), double_bits (-1e-300) };
+  /* The window of the previous value is reused, then widened. */
+  uint64_t windows[] = { double_bits (1.0), double_bits (1.25),
+    double_bits (1.5), double_bits (1.75), double_bits (1.0000001),
+    double_bits (3.0) };
+  /* Counters and derives are stored as integers. */
+  uint64_t integers[] = { 0, 1, 2, UINT64_MAX, 0, ((uint64_t) 1) << 63,
+    ((uint64_t) 1) << 63, 12345678901234ULL, 1 };
+  uint64_t one[] = { double_bits (NAN) };
+  uint64_t many[1000];
+  size_t i;
+
+  check_values ("identical values", same, STATIC_ARRAY_SIZE (same));
+  check_values ("special values", special, STATIC_ARRAY_SIZE (special));
+  check_values ("sign flips", signs, STATIC_ARRAY_SIZE (signs));
+  check_values ("windows", windows, STATIC_ARRAY_SIZE (windows));
+  check_values ("integers", integers, STATIC_ARRAY_SIZE (integers));
+  check_values ("single value", one, STATIC_ARRAY_SIZE (one));
+
+  srand (42);
+  for (i = 0; i < STATIC_ARRAY_SIZE (many); i++)
+  {
+    double d = ((double) rand ()) / ((double) RAND_MAX);
+
+    /* A slowly changing gauge with an occasional outlier. */
+    if ((i % 97) == 0)
+      d *= -1e10;
+    else
+      d = 100.0 + floor (d * 10.0) / 10.0;
+    many[i] = double_bits (d);
+  }
+  check_values ("random values", many, STATIC_ARRAY_SIZE (many));
+} /* }}} void test_values */
+
+/* The gorilla plugin resets its columns after writing a block. Each block
+ * must decode on its own, independent of the previous one. */
+static void test_blocks (void) /* {{{ */
+{
+  gorilla_column_t t;
+  gorilla_column_t v;
+  uint64_t times[10];
+  uint64_t values[10];
+  size_t block;
+  size_t i;
+
+  memset (&t, 0, sizeof (t));
+  memset (&v, 0, sizeof (v));
+  gorilla_column_reset (&t);
+  gorilla_column_reset (&v);
+
+  for (block = 0; block < 5; block++)
+  {
+    char name[64];
+
+    /* Block sizes of 1, 3, 5, ... points. */
+    for (i = 0; i < (2 * block) + 1; i++)
+    {
+      times[i] = 1380000000000ULL + (block * 100000) + (i * 10000);
+      values[i] = double_bits ((block % 2) ? -(double) i : (double) i / 3.0);
+      if (block == 3)
+        values[i] = double_bits (NAN);
+
+      append_time (&t, times[i]);
+      append_value (&v, values[i]);
+    }
+
+    snprintf (name, sizeof (name), "block %zu times", block);
+    check_column (name, &t, times, i, /* is_time = */ 1);
+    snprintf (name, sizeof (name), "block %zu values", block);
+    check_column (name, &v, values, i, /* is_time = */ 0);
+
+    gorilla_column_reset (&t);
+    gorilla_column_reset (&v);
+
+    if ((t.bits != 0) || (t.num != 0) || (v.bits != 0) || (v.num != 0))
+    {
+      printf ("block %zu: column not empty after reset\n", block);
+      failures++;
+    }
+  }
+
+  gorilla_column_destroy (&t);
+  gorilla_column_destroy (&v);
+} /* }}} void test_blocks */
+
+/* After gorilla_column_reserve(), appending must not need any memory, even
+ * for the largest possible encodings. */
+static void test_reserve (void) /* {{{ */
+{
+  gorilla_column_t t;
+  gorilla_column_t v;
+  size_t t_size;
+  size_t v_size;
+  int i;
+
+  memset (&t, 0, sizeof (t));
+  memset (&v, 0, sizeof (v));
+  gorilla_column_reset (&t);
+  gorilla_column_reset (&v);
+
+  for (i = 0; i < 1000; i++)
+  {
+    if ((gorilla_column_reserve (&t) != 0)
+        || (gorilla_column_reserve (&v) != 0))
+    {
+      printf ("reserve: gorilla_column_reserve failed\n");
+      failures++;
+      break;
+    }
+    t_size = t.data_size;
+    v_size = v.data_size;
+
+    /* Alternating large jumps and bit patterns with a single set bit at
+     * either end need the longest encodings. */
+    append_time (&t, (i % 2) ? 0 : (UINT64_C (1) << 62));
+    append_value (&v, (i % 2) ? UINT64_C (1) : (UINT64_C (1) << 63));
+
+    if ((t.data_size != t_size) || (v.data_size != v_size))
+    {
+      printf ("reserve: append %i needed more memory\n", i);
+      failures++;
+      break;
+    }
+  }
+
+  gorilla_column_destroy (&t);
+  gorilla_column_destroy (&v);
+} /* }}} void test_reserve */
+
+/* Truncated columns must be reported as corrupt, not decoded. */
+static void test_truncated (void) /* {{{ */
+{
+  gorilla_column_t c;
+  gorilla_reader_t r;
+  uint64_t v;
+  int status = 0;
+
+  memset (&c, 0, sizeof (c));
+  gorilla_column_reset (&c);
+
+  append_value (&c, double_bits (1.0));
+  append_value (&c, double_bits (-3.14));
+
+  gorilla_reader_init (&r, c.data, c.bits - 1);
+  while (status == 0)
+    status = gorilla_reader_next_value (&r, &v);
+
+  if (status >= 0)
+  {
+    printf ("truncated column: status %i, expected an error\n", status);
+    failures++;
+  }
+
+  gorilla_column_destroy (&c);
+} /* }}} void test_truncated */
+
+int main (void) /* {{{ */
+{
+  test_times ();
+  test_values ();
+  test_blocks ();
+  test_reserve ();
+  test_truncated ();
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
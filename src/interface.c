@@ -27,6 +27,7 @@
 #include "plugin.h"
 #include "configfile.h"
 #include "utils_ignorelist.h"
+#include "utils_procfs.h"
 
 #if HAVE_SYS_TYPES_H
 #  include <sys/types.h>
@@ -154,9 +155,11 @@ static int interface_init (void)
 } /* int interface_init */
 #endif /* HAVE_LIBKSTAT */
 
+/* If `value_time' is zero, the current time is used. */
 static void if_submit (const char *dev, const char *type,
 		derive_t rx,
-		derive_t tx)
+		derive_t tx,
+		cdtime_t value_time)
 {
 	value_t values[2];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -169,6 +172,7 @@ static void if_submit (const char *dev, const char *type,
 
 	vl.values = values;
 	vl.values_len = 2;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "interface", sizeof (vl.plugin));
 	sstrncpy (vl.plugin_instance, dev, sizeof (vl.plugin_instance));
@@ -218,37 +222,40 @@ static int interface_read (void)
 
 		if_submit (if_ptr->ifa_name, "if_octets",
 				if_data->IFA_RX_BYTES,
-				if_data->IFA_TX_BYTES);
+				if_data->IFA_TX_BYTES, 0);
 		if_submit (if_ptr->ifa_name, "if_packets",
 				if_data->IFA_RX_PACKT,
-				if_data->IFA_TX_PACKT);
+				if_data->IFA_TX_PACKT, 0);
 		if_submit (if_ptr->ifa_name, "if_errors",
 				if_data->IFA_RX_ERROR,
-				if_data->IFA_TX_ERROR);
+				if_data->IFA_TX_ERROR, 0);
 	}
 
 	freeifaddrs (if_list);
 /* #endif HAVE_GETIFADDRS */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
+	char *snapshot;
+	char *buffer;
+	char *cursor;
 	derive_t incoming, outgoing;
 	char *device;
+	cdtime_t value_time = 0;
 
 	char *dummy;
 	char *fields[16];
 	int numfields;
 
-	if ((fh = fopen ("/proc/net/dev", "r")) == NULL)
+	if ((snapshot = procfs_snapshot ("/proc/net/dev", NULL, &value_time)) == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("interface plugin: fopen: %s",
+		WARNING ("interface plugin: Reading /proc/net/dev failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, 1024, fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		if (!(dummy = strchr(buffer, ':')))
 			continue;
@@ -269,18 +276,18 @@ static int interface_read (void)
 
 		incoming = atoll (fields[0]);
 		outgoing = atoll (fields[8]);
-		if_submit (device, "if_octets", incoming, outgoing);
+		if_submit (device, "if_octets", incoming, outgoing, value_time);
 
 		incoming = atoll (fields[1]);
 		outgoing = atoll (fields[9]);
-		if_submit (device, "if_packets", incoming, outgoing);
+		if_submit (device, "if_packets", incoming, outgoing, value_time);
 
 		incoming = atoll (fields[2]);
 		outgoing = atoll (fields[10]);
-		if_submit (device, "if_errors", incoming, outgoing);
+		if_submit (device, "if_errors", incoming, outgoing, value_time);
 	}
 
-	fclose (fh);
+	sfree (snapshot);
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -305,7 +312,7 @@ static int interface_read (void)
 		if (tx == -1LL)
 			tx = get_kstat_value (ksp[i], "obytes");
 		if ((rx != -1LL) || (tx != -1LL))
-			if_submit (ksp[i]->ks_name, "if_octets", rx, tx);
+			if_submit (ksp[i]->ks_name, "if_octets", rx, tx, 0);
 
 		/* try to get 64bit counters */
 		rx = get_kstat_value (ksp[i], "ipackets64");
@@ -316,13 +323,13 @@ static int interface_read (void)
 		if (tx == -1LL)
 			tx = get_kstat_value (ksp[i], "opackets");
 		if ((rx != -1LL) || (tx != -1LL))
-			if_submit (ksp[i]->ks_name, "if_packets", rx, tx);
+			if_submit (ksp[i]->ks_name, "if_packets", rx, tx, 0);
 
 		/* no 64bit error counters yet */
 		rx = get_kstat_value (ksp[i], "ierrors");
 		tx = get_kstat_value (ksp[i], "oerrors");
 		if ((rx != -1LL) || (tx != -1LL))
-			if_submit (ksp[i]->ks_name, "if_errors", rx, tx);
+			if_submit (ksp[i]->ks_name, "if_errors", rx, tx, 0);
 	}
 /* #endif HAVE_LIBKSTAT */
 
@@ -333,7 +340,7 @@ static int interface_read (void)
 	ios = sg_get_network_io_stats (&num);
 
 	for (i = 0; i < num; i++)
-		if_submit (ios[i].interface_name, "if_octets", ios[i].rx, ios[i].tx);
+		if_submit (ios[i].interface_name, "if_octets", ios[i].rx, ios[i].tx, 0);
 /* #endif HAVE_LIBSTATGRAB */
 
 #elif defined(HAVE_PERFSTAT)
@@ -367,9 +374,9 @@ static int interface_read (void)
 
 	for (i = 0; i < ifs; i++)
 	{
-		if_submit (ifstat[i].name, "if_octets", ifstat[i].ibytes, ifstat[i].obytes);
-		if_submit (ifstat[i].name, "if_packets", ifstat[i].ipackets ,ifstat[i].opackets);
-		if_submit (ifstat[i].name, "if_errors", ifstat[i].ierrors, ifstat[i].oerrors );
+		if_submit (ifstat[i].name, "if_octets", ifstat[i].ibytes, ifstat[i].obytes, 0);
+		if_submit (ifstat[i].name, "if_packets", ifstat[i].ipackets ,ifstat[i].opackets, 0);
+		if_submit (ifstat[i].name, "if_errors", ifstat[i].ierrors, ifstat[i].oerrors, 0);
 	}
 #endif /* HAVE_PERFSTAT */
 
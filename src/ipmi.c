@@ -664,8 +664,8 @@ static int c_ipmi_init (void)
   int status;
 
   /* Don't send `ADD' notifications during startup (~ 1 minute) */
-  time_t iv = CDTIME_T_TO_TIME_T (plugin_get_interval ());
-  c_ipmi_init_in_progress = 1 + (60 / iv);
+  double iv = CDTIME_T_TO_DOUBLE (plugin_get_interval ());
+  c_ipmi_init_in_progress = 1 + (int) (60.0 / iv);
 
   c_ipmi_active = 1;
 
@@ -26,6 +26,7 @@
 #include "plugin.h"
 #include "configfile.h"
 #include "utils_ignorelist.h"
+#include "utils_procfs.h"
 
 #if !KERNEL_LINUX
 # error "No applicable input method."
@@ -70,7 +71,8 @@ static int irq_config (const char *key, const char *value)
 	return (0);
 }
 
-static void irq_submit (const char *irq_name, derive_t value)
+static void irq_submit (const char *irq_name, derive_t value,
+		cdtime_t value_time)
 {
 	value_t values[1];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -82,6 +84,7 @@ static void irq_submit (const char *irq_name, derive_t value)
 
 	vl.values = values;
 	vl.values_len = 1;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "irq", sizeof (vl.plugin));
 	sstrncpy (vl.type, "irq", sizeof (vl.type));
@@ -92,10 +95,12 @@ static void irq_submit (const char *irq_name, derive_t value)
 
 static int irq_read (void)
 {
-	FILE *fh;
-	char buffer[1024];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
 	int  cpu_count;
 	char *fields[256];
+	cdtime_t value_time = 0;
 
 	/*
 	 * Example content:
@@ -104,26 +109,28 @@ static int irq_read (void)
 	 * 1:     102553     158669     218062      70587   IO-APIC-edge      i8042
 	 * 8:          0          0          0          1   IO-APIC-edge      rtc0
 	 */
-	fh = fopen ("/proc/interrupts", "r");
-	if (fh == NULL)
+	snapshot = procfs_snapshot ("/proc/interrupts", NULL, &value_time);
+	if (snapshot == NULL)
 	{
 		char errbuf[1024];
-		ERROR ("irq plugin: fopen (/proc/interrupts): %s",
+		ERROR ("irq plugin: Reading /proc/interrupts failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
+	cursor = snapshot;
 
 	/* Get CPU count from the first line */
-	if(fgets (buffer, sizeof (buffer), fh) != NULL) {
+	if ((buffer = procfs_next_line (&cursor)) != NULL) {
 		cpu_count = strsplit (buffer, fields,
 				STATIC_ARRAY_SIZE (fields));
 	} else {
 		ERROR ("irq plugin: unable to get CPU count from first line "
 				"of /proc/interrupts");
+		sfree (snapshot);
 		return (-1);
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		char *irq_name;
 		size_t irq_name_len;
@@ -176,10 +183,10 @@ static int irq_read (void)
 		if (i <= 1)
 			continue;
 
-		irq_submit (irq_name, irq_value);
+		irq_submit (irq_name, irq_value, value_time);
 	}
 
-	fclose (fh);
+	sfree (snapshot);
 
 	return (0);
 } /* int irq_read */
@@ -26,6 +26,7 @@
 #include "collectd.h"
 #include "common.h"
 #include "plugin.h"
+#include "utils_procfs.h"
 
 #ifdef HAVE_SYS_LOADAVG_H
 #include <sys/loadavg.h>
@@ -49,7 +50,9 @@
 # include <libperfstat.h>
 #endif /* HAVE_PERFSTAT */
 
-static void load_submit (gauge_t snum, gauge_t mnum, gauge_t lnum)
+/* If `value_time' is zero, the current time is used. */
+static void load_submit (gauge_t snum, gauge_t mnum, gauge_t lnum,
+		cdtime_t value_time)
 {
 	value_t values[3];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -60,6 +63,7 @@ static void load_submit (gauge_t snum, gauge_t mnum, gauge_t lnum)
 
 	vl.values = values;
 	vl.values_len = STATIC_ARRAY_SIZE (values);
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "load", sizeof (vl.plugin));
 	sstrncpy (vl.type, "load", sizeof (vl.type));
@@ -73,7 +77,7 @@ static int load_read (void)
 	double load[3];
 
 	if (getloadavg (load, 3) == 3)
-		load_submit (load[LOADAVG_1MIN], load[LOADAVG_5MIN], load[LOADAVG_15MIN]);
+		load_submit (load[LOADAVG_1MIN], load[LOADAVG_5MIN], load[LOADAVG_15MIN], 0);
 	else
 	{
 		char errbuf[1024];
@@ -84,46 +88,35 @@ static int load_read (void)
 
 #elif defined(KERNEL_LINUX)
 	gauge_t snum, mnum, lnum;
-	FILE *loadavg;
-	char buffer[16];
+	char *buffer;
+	cdtime_t value_time = 0;
 
 	char *fields[8];
 	int numfields;
 
-	if ((loadavg = fopen ("/proc/loadavg", "r")) == NULL)
+	buffer = procfs_snapshot ("/proc/loadavg", NULL, &value_time);
+	if (buffer == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("load: fopen: %s",
+		WARNING ("load: Reading /proc/loadavg failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	if (fgets (buffer, 16, loadavg) == NULL)
-	{
-		char errbuf[1024];
-		WARNING ("load: fgets: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-		fclose (loadavg);
-		return (-1);
-	}
-
-	if (fclose (loadavg))
-	{
-		char errbuf[1024];
-		WARNING ("load: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-	}
-
 	numfields = strsplit (buffer, fields, 8);
 
 	if (numfields < 3)
+	{
+		sfree (buffer);
 		return (-1);
+	}
 
 	snum = atof (fields[0]);
 	mnum = atof (fields[1]);
 	lnum = atof (fields[2]);
+	sfree (buffer);
 
-	load_submit (snum, mnum, lnum);
+	load_submit (snum, mnum, lnum, value_time);
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBSTATGRAB
@@ -137,7 +130,7 @@ static int load_read (void)
 	mnum = ls->min5;
 	lnum = ls->min15;
 
-	load_submit (snum, mnum, lnum);
+	load_submit (snum, mnum, lnum, 0);
 /* #endif HAVE_LIBSTATGRAB */
 
 #elif HAVE_PERFSTAT
@@ -156,7 +149,7 @@ static int load_read (void)
 	mnum = (float)cputotal.loadavg[1]/(float)(1<<SBITS);
 	lnum = (float)cputotal.loadavg[2]/(float)(1<<SBITS);
 
-	load_submit (snum, mnum, lnum);
+	load_submit (snum, mnum, lnum, 0);
 /* #endif HAVE_PERFSTAT */
 
 #else
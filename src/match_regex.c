@@ -28,9 +28,7 @@
 
 #include "collectd.h"
 #include "filter_chain.h"
-
-#include <sys/types.h>
-#include <regex.h>
+#include "utils_regex_set.h"
 
 #define log_err(...) ERROR ("`regex' match: " __VA_ARGS__)
 #define log_warn(...) WARNING ("`regex' match: " __VA_ARGS__)
@@ -39,94 +37,56 @@
  * private data types
  */
 
-struct mr_regex_s;
-typedef struct mr_regex_s mr_regex_t;
-struct mr_regex_s
-{
-	regex_t re;
-	char *re_str;
-
-	mr_regex_t *next;
-};
-
 struct mr_match_s;
 typedef struct mr_match_s mr_match_t;
 struct mr_match_s
 {
-	mr_regex_t *host;
-	mr_regex_t *plugin;
-	mr_regex_t *plugin_instance;
-	mr_regex_t *type;
-	mr_regex_t *type_instance;
+	regex_set_t *host;
+	regex_set_t *plugin;
+	regex_set_t *plugin_instance;
+	regex_set_t *type;
+	regex_set_t *type_instance;
 	_Bool invert;
 };
 
 /*
  * internal helper functions
  */
-static void mr_free_regex (mr_regex_t *r) /* {{{ */
-{
-	if (r == NULL)
-		return;
-
-	regfree (&r->re);
-	memset (&r->re, 0, sizeof (r->re));
-	free (r->re_str);
-
-	if (r->next != NULL)
-		mr_free_regex (r->next);
-} /* }}} void mr_free_regex */
-
 static void mr_free_match (mr_match_t *m) /* {{{ */
 {
 	if (m == NULL)
 		return;
 
-	mr_free_regex (m->host);
-	mr_free_regex (m->plugin);
-	mr_free_regex (m->plugin_instance);
-	mr_free_regex (m->type);
-	mr_free_regex (m->type_instance);
+	regex_set_destroy (m->host);
+	regex_set_destroy (m->plugin);
+	regex_set_destroy (m->plugin_instance);
+	regex_set_destroy (m->type);
+	regex_set_destroy (m->type_instance);
 
 	free (m);
 } /* }}} void mr_free_match */
 
-static int mr_match_regexen (mr_regex_t *re_head, /* {{{ */
+/* All regular expressions configured for one field have to match. */
+static int mr_match_regexen (regex_set_t *set, /* {{{ */
 		const char *string)
 {
-	mr_regex_t *re;
-
-	if (re_head == NULL)
+	if (set == NULL)
 		return (FC_MATCH_MATCHES);
 
-	for (re = re_head; re != NULL; re = re->next)
+	if (regex_set_match_all (set, string))
 	{
-		int status;
-
-		status = regexec (&re->re, string,
-				/* nmatch = */ 0, /* pmatch = */ NULL,
-				/* eflags = */ 0);
-		if (status == 0)
-		{
-			DEBUG ("regex match: Regular expression `%s' matches `%s'.",
-					re->re_str, string);
-		}
-		else
-		{
-			DEBUG ("regex match: Regular expression `%s' does not match `%s'.",
-					re->re_str, string);
-			return (FC_MATCH_NO_MATCH);
-		}
-
+		DEBUG ("regex match: All regular expressions match `%s'.", string);
+		return (FC_MATCH_MATCHES);
 	}
 
-	return (FC_MATCH_MATCHES);
+	DEBUG ("regex match: Not all regular expressions match `%s'.", string);
+	return (FC_MATCH_NO_MATCH);
 } /* }}} int mr_match_regexen */
 
-static int mr_config_add_regex (mr_regex_t **re_head, /* {{{ */
+static int mr_config_add_regex (regex_set_t **set, /* {{{ */
 		oconfig_item_t *ci)
 {
-	mr_regex_t *re;
+	char errmsg[1024] = "";
 	int status;
 
 	if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING))
@@ -135,51 +95,26 @@ static int mr_config_add_regex (mr_regex_t **re_head, /* {{{ */
 		return (-1);
 	}
 
-	re = (mr_regex_t *) malloc (sizeof (*re));
-	if (re == NULL)
+	if (*set == NULL)
 	{
-		log_err ("mr_config_add_regex: malloc failed.");
-		return (-1);
-	}
-	memset (re, 0, sizeof (*re));
-	re->next = NULL;
-
-	re->re_str = strdup (ci->values[0].value.string);
-	if (re->re_str == NULL)
-	{
-		free (re);
-		log_err ("mr_config_add_regex: strdup failed.");
-		return (-1);
+		*set = regex_set_create ();
+		if (*set == NULL)
+		{
+			log_err ("mr_config_add_regex: regex_set_create failed.");
+			return (-1);
+		}
 	}
 
-	status = regcomp (&re->re, re->re_str, REG_EXTENDED | REG_NOSUB);
-	if (status != 0)
+	status = regex_set_add (*set, ci->values[0].value.string,
+			errmsg, sizeof (errmsg));
+	if (status < 0)
 	{
-		char errmsg[1024];
-		regerror (status, &re->re, errmsg, sizeof (errmsg));
 		errmsg[sizeof (errmsg) - 1] = 0;
 		log_err ("Compiling regex `%s' for `%s' failed: %s.", 
-				re->re_str, ci->key, errmsg);
-		free (re->re_str);
-		free (re);
+				ci->values[0].value.string, ci->key, errmsg);
 		return (-1);
 	}
 
-	if (*re_head == NULL)
-	{
-		*re_head = re;
-	}
-	else
-	{
-		mr_regex_t *ptr;
-
-		ptr = *re_head;
-		while (ptr->next != NULL)
-			ptr = ptr->next;
-
-		ptr->next = re;
-	}
-
 	return (0);
 } /* }}} int mr_config_add_regex */
 
@@ -298,6 +233,40 @@ static int mr_match (const data_set_t __attribute__((unused)) *ds, /* {{{ */
 	return (match_value);
 } /* }}} int mr_match */
 
+static const char *mr_exact (int field, void **user_data) /* {{{ */
+{
+	mr_match_t *m;
+	regex_set_t *set;
+	size_t i;
+
+	if ((user_data == NULL) || (*user_data == NULL))
+		return (NULL);
+
+	m = *user_data;
+	if (m->invert)
+		return (NULL);
+
+	switch (field)
+	{
+		case FC_FIELD_HOST:            set = m->host;            break;
+		case FC_FIELD_PLUGIN:          set = m->plugin;          break;
+		case FC_FIELD_PLUGIN_INSTANCE: set = m->plugin_instance; break;
+		case FC_FIELD_TYPE:            set = m->type;            break;
+		case FC_FIELD_TYPE_INSTANCE:   set = m->type_instance;   break;
+		default:                       set = NULL;
+	}
+
+	/* All expressions have to match, so one exact expression suffices. */
+	for (i = 0; i < regex_set_size (set); i++)
+	{
+		const char *exact = regex_set_exact_string (set, i);
+		if (exact != NULL)
+			return (exact);
+	}
+
+	return (NULL);
+} /* }}} const char *mr_exact */
+
 void module_register (void)
 {
 	match_proc_t mproc;
@@ -306,6 +275,8 @@ void module_register (void)
 	mproc.create  = mr_create;
 	mproc.destroy = mr_destroy;
 	mproc.match   = mr_match;
+	mproc.flags   = FC_MATCH_CACHEABLE;
+	mproc.exact   = mr_exact;
 	fc_register_match ("regex", mproc);
 } /* module_register */
 
@@ -26,6 +26,7 @@
 #include "collectd.h"
 #include "common.h"
 #include "plugin.h"
+#include "utils_procfs.h"
 
 #ifdef HAVE_SYS_SYSCTL_H
 # include <sys/sysctl.h>
@@ -134,7 +135,9 @@ static int memory_init (void)
 	return (0);
 } /* int memory_init */
 
-static void memory_submit (const char *type_instance, gauge_t value)
+/* If `value_time' is zero, the current time is used. */
+static void memory_submit (const char *type_instance, gauge_t value,
+		cdtime_t value_time)
 {
 	value_t values[1];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -143,6 +146,7 @@ static void memory_submit (const char *type_instance, gauge_t value)
 
 	vl.values = values;
 	vl.values_len = 1;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "memory", sizeof (vl.plugin));
 	sstrncpy (vl.type, "memory", sizeof (vl.type));
@@ -200,10 +204,10 @@ static int memory_read (void)
 	inactive = (gauge_t) (((uint64_t) vm_data.inactive_count) * ((uint64_t) pagesize));
 	free     = (gauge_t) (((uint64_t) vm_data.free_count)     * ((uint64_t) pagesize));
 
-	memory_submit ("wired",    wired);
-	memory_submit ("active",   active);
-	memory_submit ("inactive", inactive);
-	memory_submit ("free",     free);
+	memory_submit ("wired",    wired, 0);
+	memory_submit ("active",   active, 0);
+	memory_submit ("inactive", inactive, 0);
+	memory_submit ("free",     free, 0);
 /* #endif HAVE_HOST_STATISTICS */
 
 #elif HAVE_SYSCTLBYNAME
@@ -253,16 +257,17 @@ static int memory_read (void)
 		if (!isnan (sysctl_vals[i]))
 			sysctl_vals[i] *= sysctl_vals[0];
 
-	memory_submit ("free",     sysctl_vals[2]);
-	memory_submit ("wired",    sysctl_vals[3]);
-	memory_submit ("active",   sysctl_vals[4]);
-	memory_submit ("inactive", sysctl_vals[5]);
-	memory_submit ("cache",    sysctl_vals[6]);
+	memory_submit ("free",     sysctl_vals[2], 0);
+	memory_submit ("wired",    sysctl_vals[3], 0);
+	memory_submit ("active",   sysctl_vals[4], 0);
+	memory_submit ("inactive", sysctl_vals[5], 0);
+	memory_submit ("cache",    sysctl_vals[6], 0);
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
 
 	char *fields[8];
 	int numfields;
@@ -272,15 +277,19 @@ static int memory_read (void)
 	long long mem_cached = 0;
 	long long mem_free = 0;
 
-	if ((fh = fopen ("/proc/meminfo", "r")) == NULL)
+	cdtime_t value_time = 0;
+
+	snapshot = procfs_snapshot ("/proc/meminfo", NULL, &value_time);
+	if (snapshot == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("memory: fopen: %s",
+		WARNING ("memory: Reading /proc/meminfo failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, 1024, fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		long long *val = NULL;
 
@@ -303,20 +312,15 @@ static int memory_read (void)
 		*val = atoll (fields[1]) * 1024LL;
 	}
 
-	if (fclose (fh))
-	{
-		char errbuf[1024];
-		WARNING ("memory: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-	}
+	sfree (snapshot);
 
 	if (mem_used >= (mem_free + mem_buffered + mem_cached))
 	{
 		mem_used -= mem_free + mem_buffered + mem_cached;
-		memory_submit ("used",     mem_used);
-		memory_submit ("buffered", mem_buffered);
-		memory_submit ("cached",   mem_cached);
-		memory_submit ("free",     mem_free);
+		memory_submit ("used",     mem_used, value_time);
+		memory_submit ("buffered", mem_buffered, value_time);
+		memory_submit ("cached",   mem_cached, value_time);
+		memory_submit ("free",     mem_free, value_time);
 	}
 /* #endif KERNEL_LINUX */
 
@@ -389,11 +393,11 @@ static int memory_read (void)
 	mem_kern *= pagesize; /* it's 2011 RAM is cheap */
 	mem_unus *= pagesize;
 
-	memory_submit ("used",   mem_used);
-	memory_submit ("free",   mem_free);
-	memory_submit ("locked", mem_lock);
-	memory_submit ("kernel", mem_kern);
-	memory_submit ("unusable", mem_unus);
+	memory_submit ("used",   mem_used, 0);
+	memory_submit ("free",   mem_free, 0);
+	memory_submit ("locked", mem_lock, 0);
+	memory_submit ("kernel", mem_kern, 0);
+	memory_submit ("unusable", mem_unus, 0);
 /* #endif HAVE_LIBKSTAT */
 
 #elif HAVE_SYSCTL
@@ -412,9 +416,9 @@ static int memory_read (void)
 	}
 
 	assert (pagesize > 0);
-	memory_submit ("active",   vmtotal.t_arm * pagesize);
-	memory_submit ("inactive", (vmtotal.t_rm - vmtotal.t_arm) * pagesize);
-	memory_submit ("free",     vmtotal.t_free * pagesize);
+	memory_submit ("active",   vmtotal.t_arm * pagesize, 0);
+	memory_submit ("inactive", (vmtotal.t_rm - vmtotal.t_arm) * pagesize, 0);
+	memory_submit ("free",     vmtotal.t_free * pagesize, 0);
 /* #endif HAVE_SYSCTL */
 
 #elif HAVE_LIBSTATGRAB
@@ -422,9 +426,9 @@ static int memory_read (void)
 
 	if ((ios = sg_get_mem_stats ()) != NULL)
 	{
-		memory_submit ("used",   ios->used);
-		memory_submit ("cached", ios->cache);
-		memory_submit ("free",   ios->free);
+		memory_submit ("used",   ios->used, 0);
+		memory_submit ("cached", ios->cache, 0);
+		memory_submit ("free",   ios->free, 0);
 	}
 /* #endif HAVE_LIBSTATGRAB */
 
@@ -436,11 +440,11 @@ static int memory_read (void)
 			sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
-	memory_submit ("used",   pmemory.real_inuse * pagesize);
-	memory_submit ("free",   pmemory.real_free * pagesize);
-	memory_submit ("cached", pmemory.numperm * pagesize);
-	memory_submit ("system", pmemory.real_system * pagesize);
-	memory_submit ("user",   pmemory.real_process * pagesize);
+	memory_submit ("used",   pmemory.real_inuse * pagesize, 0);
+	memory_submit ("free",   pmemory.real_free * pagesize, 0);
+	memory_submit ("cached", pmemory.numperm * pagesize, 0);
+	memory_submit ("system", pmemory.real_system * pagesize, 0);
+	memory_submit ("user",   pmemory.real_process * pagesize, 0);
 #endif /* HAVE_PERFSTAT */
 
 	return (0);
@@ -25,6 +25,15 @@
 
 #include <pthread.h>
 
+/* Tables with more entries than this are indexed by a hash table. Up to
+ * MD_INLINE_ENTRIES entries are stored in the table itself. */
+#define MD_INLINE_ENTRIES 4
+#define MD_INDEX_MIN 8
+
+/* At most this many keys are interned. Further keys are copied into each
+ * entry, like before interning was introduced. */
+#define MD_INTERN_MAX 65536
+
 /*
  * Data types
  */
@@ -42,18 +51,49 @@ struct meta_entry_s;
 typedef struct meta_entry_s meta_entry_t;
 struct meta_entry_s
 {
-  char         *key;
+  const char   *key; /* interned unless `key_owned' is set */
+  _Bool         key_owned;
   meta_value_t  value;
   int           type;
-  meta_entry_t *next;
+};
+
+/* The entries of one or more meta_data_t. Tables are shared between a
+ * meta_data_t and its clones until one of them is modified (copy on write).
+ * `refcount' is protected by `md_refcount_lock'. */
+struct meta_table_s;
+typedef struct meta_table_s meta_table_t;
+struct meta_table_s
+{
+  int refcount;
+
+  meta_entry_t *entries; /* `inline_entries' or allocated */
+  size_t entries_num;
+  size_t entries_size;
+
+  /* Open addressing, positions in `entries' or -1. NULL for small tables. */
+  int *index;
+  size_t index_size;
+
+  meta_entry_t inline_entries[MD_INLINE_ENTRIES];
 };
 
 struct meta_data_s
 {
-  meta_entry_t   *head;
+  meta_table_t   *table; /* NULL if there are no entries */
   pthread_mutex_t lock;
 };
 
+/*
+ * Global variables
+ */
+static pthread_mutex_t md_refcount_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Interned keys, open addressing. Keys are never freed. */
+static pthread_rwlock_t md_intern_lock = PTHREAD_RWLOCK_INITIALIZER;
+static char **md_intern_table = NULL;
+static size_t md_intern_size = 0;
+static size_t md_intern_num = 0;
+
 /*
  * Private functions
  */
@@ -75,117 +115,428 @@ static char *md_strdup (const char *orig) /* {{{ */
   return (dest);
 } /* }}} char *md_strdup */
 
-static meta_entry_t *md_entry_alloc (const char *key) /* {{{ */
+/* Keys are compared case-insensitively, so the hash is, too. */
+static uint32_t md_hash (const char *key) /* {{{ */
 {
-  meta_entry_t *e;
+  uint32_t hash = 2166136261U;
 
-  e = (meta_entry_t *) malloc (sizeof (*e));
-  if (e == NULL)
+  for (; *key != 0; key++)
+  {
+    hash ^= (uint32_t) tolower ((unsigned char) *key);
+    hash *= 16777619U;
+  }
+
+  return (hash);
+} /* }}} uint32_t md_hash */
+
+/* Returns the slot of `key' in the intern table, which may be empty. The
+ * caller must hold `md_intern_lock'. Interned keys are compared
+ * case-sensitively, so that meta_data_toc() returns the keys as added. */
+static size_t md_intern_slot (const char *key) /* {{{ */
+{
+  size_t mask = md_intern_size - 1;
+  size_t i;
+
+  for (i = md_hash (key) & mask;
+      md_intern_table[i] != NULL;
+      i = (i + 1) & mask)
+  {
+    if (strcmp (md_intern_table[i], key) == 0)
+      break;
+  }
+
+  return (i);
+} /* }}} size_t md_intern_slot */
+
+/* Returns the interned copy of `key' or NULL if the key could not be
+ * interned. */
+static const char *md_intern (const char *key) /* {{{ */
+{
+  const char *ret = NULL;
+  size_t i;
+
+  pthread_rwlock_rdlock (&md_intern_lock);
+  if (md_intern_size > 0)
+    ret = md_intern_table[md_intern_slot (key)];
+  pthread_rwlock_unlock (&md_intern_lock);
+
+  if (ret != NULL)
+    return (ret);
+
+  pthread_rwlock_wrlock (&md_intern_lock);
+
+  if (md_intern_num >= MD_INTERN_MAX)
   {
-    ERROR ("md_entry_alloc: malloc failed.");
+    pthread_rwlock_unlock (&md_intern_lock);
     return (NULL);
   }
+
+  /* Keep the load factor below one half. */
+  if ((2 * (md_intern_num + 1)) > md_intern_size)
+  {
+    char **old_table = md_intern_table;
+    size_t old_size = md_intern_size;
+    char **new_table;
+    size_t new_size = (old_size == 0) ? 64 : (2 * old_size);
+
+    new_table = calloc (new_size, sizeof (*new_table));
+    if (new_table == NULL)
+    {
+      pthread_rwlock_unlock (&md_intern_lock);
+      return (NULL);
+    }
+
+    md_intern_table = new_table;
+    md_intern_size = new_size;
+    for (i = 0; i < old_size; i++)
+      if (old_table[i] != NULL)
+        md_intern_table[md_intern_slot (old_table[i])] = old_table[i];
+    free (old_table);
+  }
+
+  i = md_intern_slot (key);
+  if (md_intern_table[i] == NULL)
+  {
+    md_intern_table[i] = md_strdup (key);
+    if (md_intern_table[i] != NULL)
+      md_intern_num++;
+  }
+  ret = md_intern_table[i];
+
+  pthread_rwlock_unlock (&md_intern_lock);
+
+  return (ret);
+} /* }}} const char *md_intern */
+
+static int md_entry_init (meta_entry_t *e, const char *key) /* {{{ */
+{
   memset (e, 0, sizeof (*e));
 
-  e->key = md_strdup (key);
+  e->key = md_intern (key);
+  e->key_owned = 0;
   if (e->key == NULL)
   {
-    free (e);
-    ERROR ("md_entry_alloc: md_strdup failed.");
-    return (NULL);
+    e->key = md_strdup (key);
+    e->key_owned = 1;
+  }
+
+  if (e->key == NULL)
+  {
+    ERROR ("md_entry_init: md_strdup failed.");
+    return (-ENOMEM);
   }
 
   e->type = 0;
-  e->next = NULL;
 
-  return (e);
-} /* }}} meta_entry_t *md_entry_alloc */
+  return (0);
+} /* }}} int md_entry_init */
 
-static meta_entry_t *md_entry_clone (const meta_entry_t *orig) /* {{{ */
+static int md_entry_copy (meta_entry_t *dst, const meta_entry_t *src) /* {{{ */
 {
-  meta_entry_t *copy;
+  memcpy (dst, src, sizeof (*dst));
 
-  if (orig == NULL)
-    return (NULL);
+  if (src->key_owned)
+  {
+    dst->key = md_strdup (src->key);
+    if (dst->key == NULL)
+      return (-ENOMEM);
+  }
 
-  copy = md_entry_alloc (orig->key);
-  copy->type = orig->type;
-  if (copy->type == MD_TYPE_STRING)
-    copy->value.mv_string = strdup (orig->value.mv_string);
-  else
-    copy->value = orig->value;
+  if (src->type == MD_TYPE_STRING)
+  {
+    dst->value.mv_string = md_strdup (src->value.mv_string);
+    if (dst->value.mv_string == NULL)
+    {
+      if (dst->key_owned)
+        free ((char *) dst->key);
+      return (-ENOMEM);
+    }
+  }
 
-  copy->next = md_entry_clone (orig->next);
-  return (copy);
-} /* }}} meta_entry_t *md_entry_clone */
+  return (0);
+} /* }}} int md_entry_copy */
 
+/* Frees the memory owned by `e', not `e' itself. */
 static void md_entry_free (meta_entry_t *e) /* {{{ */
 {
   if (e == NULL)
     return;
 
-  free (e->key);
+  if (e->key_owned)
+    free ((char *) e->key);
 
   if (e->type == MD_TYPE_STRING)
     free (e->value.mv_string);
 
-  if (e->next != NULL)
-    md_entry_free (e->next);
-
-  free (e);
+  memset (e, 0, sizeof (*e));
 } /* }}} void md_entry_free */
 
-static int md_entry_insert (meta_data_t *md, meta_entry_t *e) /* {{{ */
+static meta_table_t *md_table_create (void) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
+  meta_table_t *t;
 
-  if ((md == NULL) || (e == NULL))
-    return (-EINVAL);
+  t = calloc (1, sizeof (*t));
+  if (t == NULL)
+  {
+    ERROR ("md_table_create: calloc failed.");
+    return (NULL);
+  }
 
-  pthread_mutex_lock (&md->lock);
+  t->refcount = 1;
+  t->entries = t->inline_entries;
+  t->entries_num = 0;
+  t->entries_size = MD_INLINE_ENTRIES;
+  t->index = NULL;
+  t->index_size = 0;
+
+  return (t);
+} /* }}} meta_table_t *md_table_create */
+
+static void md_table_free (meta_table_t *t) /* {{{ */
+{
+  size_t i;
+
+  if (t == NULL)
+    return;
+
+  for (i = 0; i < t->entries_num; i++)
+    md_entry_free (t->entries + i);
+
+  if (t->entries != t->inline_entries)
+    free (t->entries);
+  free (t->index);
+  free (t);
+} /* }}} void md_table_free */
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL)
+/* Drops one reference to `t', freeing it when it was the last one. */
+static void md_table_release (meta_table_t *t) /* {{{ */
+{
+  int refcount;
+
+  if (t == NULL)
+    return;
+
+  pthread_mutex_lock (&md_refcount_lock);
+  t->refcount--;
+  refcount = t->refcount;
+  pthread_mutex_unlock (&md_refcount_lock);
+
+  if (refcount <= 0)
+    md_table_free (t);
+} /* }}} void md_table_release */
+
+/* Rebuilds the hash index of `t', dropping it for small tables. */
+static int md_table_reindex (meta_table_t *t) /* {{{ */
+{
+  size_t size;
+  size_t i;
+
+  free (t->index);
+  t->index = NULL;
+  t->index_size = 0;
+
+  if (t->entries_num <= MD_INDEX_MIN)
+    return (0);
+
+  size = 4 * MD_INDEX_MIN;
+  while (size < (2 * t->entries_num))
+    size *= 2;
+
+  t->index = malloc (size * sizeof (*t->index));
+  if (t->index == NULL)
+    return (-ENOMEM);
+  for (i = 0; i < size; i++)
+    t->index[i] = -1;
+  t->index_size = size;
+
+  for (i = 0; i < t->entries_num; i++)
   {
-    if (strcasecmp (e->key, this->key) == 0)
-      break;
+    size_t j = md_hash (t->entries[i].key) & (size - 1);
+
+    while (t->index[j] >= 0)
+      j = (j + 1) & (size - 1);
+    t->index[j] = (int) i;
+  }
+
+  return (0);
+} /* }}} int md_table_reindex */
+
+static meta_table_t *md_table_copy (const meta_table_t *orig) /* {{{ */
+{
+  meta_table_t *t;
+  size_t i;
+
+  t = md_table_create ();
+  if (t == NULL)
+    return (NULL);
+
+  if (orig->entries_num > MD_INLINE_ENTRIES)
+  {
+    t->entries = calloc (orig->entries_num, sizeof (*t->entries));
+    if (t->entries == NULL)
+    {
+      t->entries = t->inline_entries;
+      md_table_free (t);
+      return (NULL);
+    }
+    t->entries_size = orig->entries_num;
+  }
 
-    prev = this;
-    this = this->next;
+  for (i = 0; i < orig->entries_num; i++)
+  {
+    if (md_entry_copy (t->entries + i, orig->entries + i) != 0)
+    {
+      md_table_free (t);
+      return (NULL);
+    }
+    t->entries_num++;
   }
 
-  if (this == NULL)
+  if (md_table_reindex (t) != 0)
+  {
+    md_table_free (t);
+    return (NULL);
+  }
+
+  return (t);
+} /* }}} meta_table_t *md_table_copy */
+
+/* Returns the position of `key' in `t' or -1. */
+static int md_table_find (const meta_table_t *t, const char *key) /* {{{ */
+{
+  size_t i;
+
+  if (t == NULL)
+    return (-1);
+
+  if (t->index != NULL)
   {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else
+    size_t mask = t->index_size - 1;
+
+    for (i = md_hash (key) & mask; t->index[i] >= 0; i = (i + 1) & mask)
     {
-      assert (prev != NULL);
-      prev->next = e;
+      const meta_entry_t *e = t->entries + t->index[i];
+      if ((e->key == key) || (strcasecmp (key, e->key) == 0))
+        return (t->index[i]);
     }
 
-    e->next = NULL;
+    return (-1);
   }
-  else /* (this != NULL) */
+
+  for (i = 0; i < t->entries_num; i++)
   {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
+    const meta_entry_t *e = t->entries + i;
+    if ((e->key == key) || (strcasecmp (key, e->key) == 0))
+      return ((int) i);
+  }
+
+  return (-1);
+} /* }}} int md_table_find */
 
-    e->next = this->next;
+/* Makes sure md->table may be modified, i.e. exists and is not shared with
+ * any clones. The lock on md must be held while calling this function! */
+static meta_table_t *md_table_writable (meta_data_t *md) /* {{{ */
+{
+  meta_table_t *t = md->table;
+  int refcount;
+
+  if (t == NULL)
+  {
+    md->table = md_table_create ();
+    return (md->table);
   }
 
-  pthread_mutex_unlock (&md->lock);
+  pthread_mutex_lock (&md_refcount_lock);
+  refcount = t->refcount;
+  pthread_mutex_unlock (&md_refcount_lock);
+
+  if (refcount <= 1)
+    return (t);
+
+  t = md_table_copy (md->table);
+  if (t == NULL)
+    return (NULL);
+
+  md_table_release (md->table);
+  md->table = t;
+
+  return (t);
+} /* }}} meta_table_t *md_table_writable */
 
-  if (this != NULL)
+/* Adds `e' to md, replacing an existing entry with the same key. On success,
+ * `e' is owned by md. */
+static int md_entry_insert (meta_data_t *md, meta_entry_t *e) /* {{{ */
+{
+  meta_table_t *t;
+  meta_entry_t old;
+  int pos;
+
+  if ((md == NULL) || (e == NULL))
+    return (-EINVAL);
+
+  memset (&old, 0, sizeof (old));
+
+  pthread_mutex_lock (&md->lock);
+
+  t = md_table_writable (md);
+  if (t == NULL)
+  {
+    pthread_mutex_unlock (&md->lock);
+    return (-ENOMEM);
+  }
+
+  pos = md_table_find (t, e->key);
+  if (pos >= 0)
   {
-    this->next = NULL;
-    md_entry_free (this);
+    /* Replace the existing entry. */
+    old = t->entries[pos];
+    t->entries[pos] = *e;
   }
+  else
+  {
+    if (t->entries_num >= t->entries_size)
+    {
+      size_t new_size = 2 * t->entries_size;
+      meta_entry_t *tmp;
+
+      if (t->entries == t->inline_entries)
+      {
+        tmp = malloc (new_size * sizeof (*tmp));
+        if (tmp != NULL)
+          memcpy (tmp, t->entries, t->entries_num * sizeof (*tmp));
+      }
+      else
+        tmp = realloc (t->entries, new_size * sizeof (*tmp));
+
+      if (tmp == NULL)
+      {
+        pthread_mutex_unlock (&md->lock);
+        return (-ENOMEM);
+      }
+
+      t->entries = tmp;
+      t->entries_size = new_size;
+    }
+
+    t->entries[t->entries_num] = *e;
+    t->entries_num++;
+
+    if ((t->entries_num > MD_INDEX_MIN)
+        && ((t->index == NULL) || (2 * t->entries_num > t->index_size)))
+      md_table_reindex (t);
+    else if (t->index != NULL)
+    {
+      size_t j = md_hash (e->key) & (t->index_size - 1);
+
+      while (t->index[j] >= 0)
+        j = (j + 1) & (t->index_size - 1);
+      t->index[j] = (int) (t->entries_num - 1);
+    }
+  }
+
+  pthread_mutex_unlock (&md->lock);
+
+  md_entry_free (&old);
 
   return (0);
 } /* }}} int md_entry_insert */
@@ -194,16 +545,16 @@ static int md_entry_insert (meta_data_t *md, meta_entry_t *e) /* {{{ */
 static meta_entry_t *md_entry_lookup (meta_data_t *md, /* {{{ */
     const char *key)
 {
-  meta_entry_t *e;
+  int pos;
 
   if ((md == NULL) || (key == NULL))
     return (NULL);
 
-  for (e = md->head; e != NULL; e = e->next)
-    if (strcasecmp (key, e->key) == 0)
-      break;
+  pos = md_table_find (md->table, key);
+  if (pos < 0)
+    return (NULL);
 
-  return (e);
+  return (md->table->entries + pos);
 } /* }}} meta_entry_t *md_entry_lookup */
 
 /*
@@ -221,12 +572,14 @@ meta_data_t *meta_data_create (void) /* {{{ */
   }
   memset (md, 0, sizeof (*md));
 
-  md->head = NULL;
+  md->table = NULL;
   pthread_mutex_init (&md->lock, /* attr = */ NULL);
 
   return (md);
 } /* }}} meta_data_t *meta_data_create */
 
+/* The clone shares the entries with `orig' until either of them is
+ * modified. */
 meta_data_t *meta_data_clone (meta_data_t *orig) /* {{{ */
 {
   meta_data_t *copy;
@@ -239,7 +592,13 @@ meta_data_t *meta_data_clone (meta_data_t *orig) /* {{{ */
     return (NULL);
 
   pthread_mutex_lock (&orig->lock);
-  copy->head = md_entry_clone (orig->head);
+  if (orig->table != NULL)
+  {
+    pthread_mutex_lock (&md_refcount_lock);
+    orig->table->refcount++;
+    pthread_mutex_unlock (&md_refcount_lock);
+  }
+  copy->table = orig->table;
   pthread_mutex_unlock (&orig->lock);
 
   return (copy);
@@ -250,113 +609,101 @@ void meta_data_destroy (meta_data_t *md) /* {{{ */
   if (md == NULL)
     return;
 
-  pthread_mutex_destroy(&md->lock);
-  md_entry_free (md->head);
+  md_table_release (md->table);
+  md->table = NULL;
   pthread_mutex_destroy (&md->lock);
   free (md);
 } /* }}} void meta_data_destroy */
 
 int meta_data_exists (meta_data_t *md, const char *key) /* {{{ */
 {
-  meta_entry_t *e;
+  int pos;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
   pthread_mutex_lock (&md->lock);
-
-  for (e = md->head; e != NULL; e = e->next)
-  {
-    if (strcasecmp (key, e->key) == 0)
-    {
-      pthread_mutex_unlock (&md->lock);
-      return (1);
-    }
-  }
-
+  pos = md_table_find (md->table, key);
   pthread_mutex_unlock (&md->lock);
-  return (0);
+
+  return ((pos >= 0) ? 1 : 0);
 } /* }}} int meta_data_exists */
 
 int meta_data_type (meta_data_t *md, const char *key) /* {{{ */
 {
   meta_entry_t *e;
+  int type = 0;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
   pthread_mutex_lock (&md->lock);
 
-  for (e = md->head; e != NULL; e = e->next)
-  {
-    if (strcasecmp (key, e->key) == 0)
-    {
-      pthread_mutex_unlock (&md->lock);
-      return e->type;
-    }
-  }
+  e = md_entry_lookup (md, key);
+  if (e != NULL)
+    type = e->type;
 
   pthread_mutex_unlock (&md->lock);
-  return 0;
+  return type;
 } /* }}} int meta_data_type */
 
 int meta_data_toc (meta_data_t *md, char ***toc) /* {{{ */
 {
   int i = 0, count = 0;
-  meta_entry_t *e;
 
   if ((md == NULL) || (toc == NULL))
     return -EINVAL;
 
   pthread_mutex_lock (&md->lock);
 
-  for (e = md->head; e != NULL; e = e->next)
-    ++count;    
+  if (md->table != NULL)
+    count = (int) md->table->entries_num;
 
   *toc = malloc(count * sizeof(**toc));
-  for (e = md->head; e != NULL; e = e->next)
-    (*toc)[i++] = strdup(e->key);
-  
+  for (i = 0; i < count; i++)
+    (*toc)[i] = strdup(md->table->entries[i].key);
+
   pthread_mutex_unlock (&md->lock);
   return count;
 } /* }}} int meta_data_toc */
 
 int meta_data_delete (meta_data_t *md, const char *key) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
+  meta_table_t *t;
+  meta_entry_t old;
+  int pos;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
   pthread_mutex_lock (&md->lock);
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL)
+  if (md_table_find (md->table, key) < 0)
   {
-    if (strcasecmp (key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
+    pthread_mutex_unlock (&md->lock);
+    return (-ENOENT);
   }
 
-  if (this == NULL)
+  t = md_table_writable (md);
+  if (t == NULL)
   {
     pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
+    return (-ENOMEM);
   }
 
-  if (prev == NULL)
-    md->head = this->next;
-  else
-    prev->next = this->next;
+  /* The position may differ in a copy of the table. */
+  pos = md_table_find (t, key);
+  assert (pos >= 0);
+
+  old = t->entries[pos];
+  memmove (t->entries + pos, t->entries + pos + 1,
+      (t->entries_num - (pos + 1)) * sizeof (*t->entries));
+  t->entries_num--;
+  md_table_reindex (t);
 
   pthread_mutex_unlock (&md->lock);
 
-  this->next = NULL;
-  md_entry_free (this);
+  md_entry_free (&old);
 
   return (0);
 } /* }}} int meta_data_delete */
@@ -367,97 +714,122 @@ int meta_data_delete (meta_data_t *md, const char *key) /* {{{ */
 int meta_data_add_string (meta_data_t *md, /* {{{ */
     const char *key, const char *value)
 {
-  meta_entry_t *e;
+  meta_entry_t e;
+  int status;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
+  status = md_entry_init (&e, key);
+  if (status != 0)
+    return (status);
 
-  e->value.mv_string = md_strdup (value);
-  if (e->value.mv_string == NULL)
+  e.value.mv_string = md_strdup (value);
+  if (e.value.mv_string == NULL)
   {
     ERROR ("meta_data_add_string: md_strdup failed.");
-    md_entry_free (e);
+    md_entry_free (&e);
     return (-ENOMEM);
   }
-  e->type = MD_TYPE_STRING;
+  e.type = MD_TYPE_STRING;
 
-  return (md_entry_insert (md, e));
+  status = md_entry_insert (md, &e);
+  if (status != 0)
+    md_entry_free (&e);
+
+  return (status);
 } /* }}} int meta_data_add_string */
 
 int meta_data_add_signed_int (meta_data_t *md, /* {{{ */
     const char *key, int64_t value)
 {
-  meta_entry_t *e;
+  meta_entry_t e;
+  int status;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
+  status = md_entry_init (&e, key);
+  if (status != 0)
+    return (status);
+
+  e.value.mv_signed_int = value;
+  e.type = MD_TYPE_SIGNED_INT;
 
-  e->value.mv_signed_int = value;
-  e->type = MD_TYPE_SIGNED_INT;
+  status = md_entry_insert (md, &e);
+  if (status != 0)
+    md_entry_free (&e);
 
-  return (md_entry_insert (md, e));
+  return (status);
 } /* }}} int meta_data_add_signed_int */
 
 int meta_data_add_unsigned_int (meta_data_t *md, /* {{{ */
     const char *key, uint64_t value)
 {
-  meta_entry_t *e;
+  meta_entry_t e;
+  int status;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
+  status = md_entry_init (&e, key);
+  if (status != 0)
+    return (status);
+
+  e.value.mv_unsigned_int = value;
+  e.type = MD_TYPE_UNSIGNED_INT;
 
-  e->value.mv_unsigned_int = value;
-  e->type = MD_TYPE_UNSIGNED_INT;
+  status = md_entry_insert (md, &e);
+  if (status != 0)
+    md_entry_free (&e);
 
-  return (md_entry_insert (md, e));
+  return (status);
 } /* }}} int meta_data_add_unsigned_int */
 
 int meta_data_add_double (meta_data_t *md, /* {{{ */
     const char *key, double value)
 {
-  meta_entry_t *e;
+  meta_entry_t e;
+  int status;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
+  status = md_entry_init (&e, key);
+  if (status != 0)
+    return (status);
 
-  e->value.mv_double = value;
-  e->type = MD_TYPE_DOUBLE;
+  e.value.mv_double = value;
+  e.type = MD_TYPE_DOUBLE;
 
-  return (md_entry_insert (md, e));
+  status = md_entry_insert (md, &e);
+  if (status != 0)
+    md_entry_free (&e);
+
+  return (status);
 } /* }}} int meta_data_add_double */
 
 int meta_data_add_boolean (meta_data_t *md, /* {{{ */
     const char *key, _Bool value)
 {
-  meta_entry_t *e;
+  meta_entry_t e;
+  int status;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
+  status = md_entry_init (&e, key);
+  if (status != 0)
+    return (status);
+
+  e.value.mv_boolean = value;
+  e.type = MD_TYPE_BOOLEAN;
 
-  e->value.mv_boolean = value;
-  e->type = MD_TYPE_BOOLEAN;
+  status = md_entry_insert (md, &e);
+  if (status != 0)
+    md_entry_free (&e);
 
-  return (md_entry_insert (md, e));
+  return (status);
 } /* }}} int meta_data_add_boolean */
 
 /*
@@ -483,7 +855,7 @@ int meta_data_get_string (meta_data_t *md, /* {{{ */
 
   if (e->type != MD_TYPE_STRING)
   {
-    ERROR ("meta_data_get_signed_int: Type mismatch for key `%s'", e->key);
+    ERROR ("meta_data_get_string: Type mismatch for key `%s'", e->key);
     pthread_mutex_unlock (&md->lock);
     return (-ENOENT);
   }
@@ -0,0 +1,518 @@
+/**
+ * collectd - src/meta_data_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Tests for the meta data tables. meta_data.c is included so that sharing
+ * between clones, the hash index and key interning can be checked directly.
+ */
+
+#include "meta_data.c"
+#include "common.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf ("%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+/*
+ * Stubs for the daemon functions used by meta_data.c.
+ */
+void plugin_log (int level, const char *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  printf ("[severity %i] ", level);
+  va_start (ap, format);
+  vprintf (format, ap);
+  va_end (ap);
+  printf ("\n");
+} /* }}} void plugin_log */
+
+static size_t md_num (meta_data_t *md) /* {{{ */
+{
+  return ((md->table == NULL) ? 0 : md->table->entries_num);
+} /* }}} size_t md_num */
+
+/* Checks that `md' maps `key' to the signed integer `expected'. */
+static void check_int (meta_data_t *md, char const *key, /* {{{ */
+    int64_t expected, int line)
+{
+  int64_t value = -1;
+  int status;
+
+  status = meta_data_get_signed_int (md, key, &value);
+  if ((status != 0) || (value != expected))
+  {
+    printf ("%s:%i: \"%s\": status %i, value %"PRIi64", expected %"PRIi64"\n",
+        __FILE__, line, key, status, value, expected);
+    failures++;
+  }
+} /* }}} void check_int */
+
+/* Checks that `md' maps `key' to the string `expected'. */
+static void check_string (meta_data_t *md, char const *key, /* {{{ */
+    char const *expected, int line)
+{
+  char *value = NULL;
+  int status;
+
+  status = meta_data_get_string (md, key, &value);
+  if ((status != 0) || (value == NULL) || (strcmp (value, expected) != 0))
+  {
+    printf ("%s:%i: \"%s\": status %i, value \"%s\", expected \"%s\"\n",
+        __FILE__, line, key, status, (value != NULL) ? value : "(null)",
+        expected);
+    failures++;
+  }
+  sfree (value);
+} /* }}} void check_string */
+
+#define CHECK_INT(md, key, expected) check_int (md, key, expected, __LINE__)
+#define CHECK_STRING(md, key, expected) \
+  check_string (md, key, expected, __LINE__)
+
+static void test_types (void) /* {{{ */
+{
+  meta_data_t *md = meta_data_create ();
+  char *s = NULL;
+  int64_t si = 0;
+  uint64_t ui = 0;
+  double d = 0.0;
+  _Bool b = 0;
+
+  CHECK (md != NULL);
+  if (md == NULL)
+    return;
+
+  CHECK (meta_data_add_string (md, "string", "foo") == 0);
+  CHECK (meta_data_add_signed_int (md, "signed", INT64_MIN) == 0);
+  CHECK (meta_data_add_unsigned_int (md, "unsigned", UINT64_MAX) == 0);
+  CHECK (meta_data_add_double (md, "double", -0.5) == 0);
+  CHECK (meta_data_add_boolean (md, "boolean", 1) == 0);
+
+  CHECK (meta_data_type (md, "string") == MD_TYPE_STRING);
+  CHECK (meta_data_type (md, "signed") == MD_TYPE_SIGNED_INT);
+  CHECK (meta_data_type (md, "unsigned") == MD_TYPE_UNSIGNED_INT);
+  CHECK (meta_data_type (md, "double") == MD_TYPE_DOUBLE);
+  CHECK (meta_data_type (md, "boolean") == MD_TYPE_BOOLEAN);
+  CHECK (meta_data_type (md, "missing") == 0);
+
+  CHECK_STRING (md, "string", "foo");
+  CHECK ((meta_data_get_signed_int (md, "signed", &si) == 0)
+      && (si == INT64_MIN));
+  CHECK ((meta_data_get_unsigned_int (md, "unsigned", &ui) == 0)
+      && (ui == UINT64_MAX));
+  CHECK ((meta_data_get_double (md, "double", &d) == 0) && (d == -0.5));
+  CHECK ((meta_data_get_boolean (md, "boolean", &b) == 0) && b);
+
+  /* Type mismatches and missing keys. */
+  CHECK (meta_data_get_string (md, "signed", &s) == -ENOENT);
+  CHECK (s == NULL);
+  CHECK (meta_data_get_signed_int (md, "unsigned", &si) == -ENOENT);
+  CHECK (meta_data_get_unsigned_int (md, "double", &ui) == -ENOENT);
+  CHECK (meta_data_get_double (md, "boolean", &d) == -ENOENT);
+  CHECK (meta_data_get_boolean (md, "string", &b) == -ENOENT);
+  CHECK (meta_data_get_boolean (md, "missing", &b) == -ENOENT);
+
+  /* Replacing an entry may change its type. */
+  CHECK (meta_data_add_signed_int (md, "string", 42) == 0);
+  CHECK (meta_data_type (md, "string") == MD_TYPE_SIGNED_INT);
+  CHECK_INT (md, "string", 42);
+  CHECK (meta_data_add_string (md, "signed", "bar") == 0);
+  CHECK_STRING (md, "signed", "bar");
+  CHECK (md_num (md) == 5);
+
+  meta_data_destroy (md);
+} /* }}} void test_types */
+
+static void test_case (void) /* {{{ */
+{
+  meta_data_t *md = meta_data_create ();
+  char **toc = NULL;
+  int toc_num;
+  int i;
+
+  CHECK (md != NULL);
+  if (md == NULL)
+    return;
+
+  CHECK (meta_data_add_string (md, "Key", "first") == 0);
+  CHECK (meta_data_exists (md, "Key") == 1);
+  CHECK (meta_data_exists (md, "key") == 1);
+  CHECK (meta_data_exists (md, "KEY") == 1);
+  CHECK (meta_data_exists (md, "Key2") == 0);
+  CHECK_STRING (md, "kEY", "first");
+
+  /* Adding a key differing only in case replaces the entry. */
+  CHECK (meta_data_add_string (md, "KEY", "second") == 0);
+  CHECK (md_num (md) == 1);
+  CHECK_STRING (md, "key", "second");
+
+  toc_num = meta_data_toc (md, &toc);
+  CHECK (toc_num == 1);
+  for (i = 0; i < toc_num; i++)
+    sfree (toc[i]);
+  sfree (toc);
+
+  CHECK (meta_data_delete (md, "kEy") == 0);
+  CHECK (meta_data_exists (md, "Key") == 0);
+
+  meta_data_destroy (md);
+} /* }}} void test_case */
+
+static void test_growth (void) /* {{{ */
+{
+  meta_data_t *md = meta_data_create ();
+  char **toc = NULL;
+  int toc_num;
+  int i;
+
+  CHECK (md != NULL);
+  if (md == NULL)
+    return;
+
+  for (i = 0; i < 100; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (meta_data_add_signed_int (md, key, i) == 0);
+
+    /* Entries move out of the table once the inline entries are used up,
+     * and small tables are searched without an index. */
+    CHECK ((md->table->entries == md->table->inline_entries)
+        == (i < MD_INLINE_ENTRIES));
+    CHECK ((md->table->index != NULL) == (i >= MD_INDEX_MIN));
+  }
+  CHECK (md_num (md) == 100);
+
+  for (i = 0; i < 100; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "KEY%i", i);
+    CHECK_INT (md, key, i);
+  }
+  CHECK (meta_data_exists (md, "key100") == 0);
+
+  /* The table of contents lists the keys in the order they were added. */
+  toc_num = meta_data_toc (md, &toc);
+  CHECK (toc_num == 100);
+  for (i = 0; i < toc_num; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (strcmp (toc[i], key) == 0);
+    sfree (toc[i]);
+  }
+  sfree (toc);
+
+  meta_data_destroy (md);
+} /* }}} void test_growth */
+
+static void test_delete (void) /* {{{ */
+{
+  meta_data_t *md = meta_data_create ();
+  int i;
+
+  CHECK (md != NULL);
+  if (md == NULL)
+    return;
+
+  CHECK (meta_data_delete (md, "missing") == -ENOENT);
+
+  for (i = 0; i < 20; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (meta_data_add_signed_int (md, key, i) == 0);
+  }
+
+  /* Delete every other key. The remaining ones must still be found through
+   * the index. */
+  for (i = 0; i < 20; i += 2)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (meta_data_delete (md, key) == 0);
+    CHECK (meta_data_delete (md, key) == -ENOENT);
+  }
+  CHECK (md_num (md) == 10);
+  CHECK (md->table->index != NULL);
+
+  for (i = 0; i < 20; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    if ((i % 2) == 0)
+      CHECK (meta_data_exists (md, key) == 0);
+    else
+      CHECK_INT (md, key, i);
+  }
+
+  /* Re-add the deleted keys with new values. */
+  for (i = 0; i < 20; i += 2)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (meta_data_add_signed_int (md, key, 100 + i) == 0);
+  }
+  CHECK (md_num (md) == 20);
+
+  for (i = 0; i < 20; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK_INT (md, key, ((i % 2) == 0) ? 100 + i : i);
+  }
+
+  /* Shrinking below the threshold drops the index. */
+  for (i = 0; i < 15; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (meta_data_delete (md, key) == 0);
+  }
+  CHECK (md_num (md) == 5);
+  CHECK (md->table->index == NULL);
+  CHECK_INT (md, "key15", 15);
+  CHECK_INT (md, "key18", 118);
+
+  CHECK (meta_data_add_string (md, "key0", "back") == 0);
+  CHECK_STRING (md, "key0", "back");
+
+  meta_data_destroy (md);
+} /* }}} void test_delete */
+
+/* Fills `md' with `num' entries and checks that modifying a clone leaves
+ * the original untouched, and vice versa. */
+static void test_clone_num (int num) /* {{{ */
+{
+  meta_data_t *orig = meta_data_create ();
+  meta_data_t *copy;
+  meta_data_t *empty;
+  int i;
+
+  CHECK (orig != NULL);
+  if (orig == NULL)
+    return;
+
+  for (i = 0; i < num; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK (meta_data_add_signed_int (orig, key, i) == 0);
+  }
+  CHECK (meta_data_add_string (orig, "string", "orig") == 0);
+
+  /* The clone shares the entries until one of them is modified. */
+  copy = meta_data_clone (orig);
+  CHECK (copy != NULL);
+  if (copy == NULL)
+  {
+    meta_data_destroy (orig);
+    return;
+  }
+  CHECK (copy->table == orig->table);
+  CHECK (orig->table->refcount == 2);
+
+  /* Reads don't copy the table. */
+  CHECK_STRING (copy, "string", "orig");
+  CHECK (copy->table == orig->table);
+
+  /* Deleting a missing key doesn't, either. */
+  CHECK (meta_data_delete (copy, "missing") == -ENOENT);
+  CHECK (copy->table == orig->table);
+
+  CHECK (meta_data_add_string (copy, "string", "copy") == 0);
+  CHECK (copy->table != orig->table);
+  CHECK (orig->table->refcount == 1);
+  CHECK (copy->table->refcount == 1);
+  CHECK (meta_data_add_boolean (copy, "new", 1) == 0);
+  CHECK (meta_data_delete (copy, "key0") == 0);
+
+  CHECK_STRING (orig, "string", "orig");
+  CHECK (meta_data_exists (orig, "new") == 0);
+  CHECK_INT (orig, "key0", 0);
+  CHECK (md_num (orig) == (size_t) (num + 1));
+
+  CHECK_STRING (copy, "string", "copy");
+  CHECK (meta_data_exists (copy, "new") == 1);
+  CHECK (meta_data_exists (copy, "key0") == 0);
+  CHECK (md_num (copy) == (size_t) (num + 1));
+  for (i = 1; i < num; i++)
+  {
+    char key[32];
+
+    snprintf (key, sizeof (key), "key%i", i);
+    CHECK_INT (copy, key, i);
+  }
+  meta_data_destroy (copy);
+
+  /* Modifying the original leaves the clone untouched. */
+  copy = meta_data_clone (orig);
+  CHECK (copy != NULL);
+  if (copy == NULL)
+  {
+    meta_data_destroy (orig);
+    return;
+  }
+
+  CHECK (meta_data_add_string (orig, "string", "changed") == 0);
+  CHECK (meta_data_delete (orig, "key1") == 0);
+  CHECK_STRING (copy, "string", "orig");
+  CHECK_INT (copy, "key1", 1);
+  CHECK (md_num (copy) == (size_t) (num + 1));
+
+  /* The clone outlives the original. */
+  meta_data_destroy (orig);
+  CHECK_STRING (copy, "string", "orig");
+  CHECK_INT (copy, "key0", 0);
+
+  /* Clones of an empty set are independent, too. */
+  empty = meta_data_create ();
+  CHECK (empty != NULL);
+  if (empty != NULL)
+  {
+    meta_data_t *empty_copy = meta_data_clone (empty);
+
+    CHECK (empty_copy != NULL);
+    CHECK (meta_data_add_signed_int (empty_copy, "key", 1) == 0);
+    CHECK (meta_data_exists (empty, "key") == 0);
+    meta_data_destroy (empty_copy);
+    meta_data_destroy (empty);
+  }
+
+  meta_data_destroy (copy);
+} /* }}} void test_clone_num */
+
+static void test_clone (void) /* {{{ */
+{
+  /* Inline entries, allocated entries and an indexed table. */
+  test_clone_num (2);
+  test_clone_num (MD_INLINE_ENTRIES + 1);
+  test_clone_num (4 * MD_INDEX_MIN);
+} /* }}} void test_clone */
+
+/* Must run last: the interned keys are never freed. */
+static void test_intern (void) /* {{{ */
+{
+  meta_data_t *md = meta_data_create ();
+  meta_data_t *copy;
+  meta_entry_t *e;
+  char key[64];
+  size_t i;
+
+  CHECK (md != NULL);
+  if (md == NULL)
+    return;
+
+  /* The same key is interned only once, regardless of the set. */
+  CHECK (meta_data_add_signed_int (md, "interned", 1) == 0);
+  e = md_entry_lookup (md, "interned");
+  CHECK ((e != NULL) && !e->key_owned);
+  CHECK ((e != NULL) && (e->key == md_intern ("interned")));
+  CHECK (meta_data_delete (md, "interned") == 0);
+
+  /* Fill the intern table. */
+  for (i = 0; md_intern_num < MD_INTERN_MAX; i++)
+  {
+    snprintf (key, sizeof (key), "fill%zu", i);
+    if (meta_data_add_boolean (md, key, 1) != 0)
+    {
+      printf ("meta_data_add_boolean (\"%s\") failed\n", key);
+      failures++;
+      break;
+    }
+    meta_data_delete (md, key);
+  }
+  CHECK (md_intern_num == MD_INTERN_MAX);
+  CHECK (md_num (md) == 0);
+
+  /* Keys seen before are still interned ... */
+  CHECK (meta_data_add_signed_int (md, "interned", 2) == 0);
+  e = md_entry_lookup (md, "interned");
+  CHECK ((e != NULL) && !e->key_owned);
+
+  /* ... new keys are copied into their entries and work just the same. */
+  for (i = 0; i < 2 * MD_INDEX_MIN; i++)
+  {
+    snprintf (key, sizeof (key), "Beyond%zu", i);
+    CHECK (meta_data_add_string (md, key, key) == 0);
+  }
+  CHECK (md_intern_num == MD_INTERN_MAX);
+  e = md_entry_lookup (md, "beyond0");
+  CHECK ((e != NULL) && e->key_owned);
+  CHECK ((e != NULL) && (strcmp (e->key, "Beyond0") == 0));
+
+  copy = meta_data_clone (md);
+  CHECK (copy != NULL);
+  if (copy != NULL)
+  {
+    /* The copied table owns its own keys. */
+    CHECK (meta_data_delete (copy, "beyond1") == 0);
+    CHECK (meta_data_exists (md, "BEYOND1") == 1);
+    e = md_entry_lookup (copy, "beyond2");
+    CHECK ((e != NULL) && e->key_owned);
+    CHECK ((e != NULL) && (e != md_entry_lookup (md, "beyond2"))
+        && (e->key != md_entry_lookup (md, "beyond2")->key));
+    meta_data_destroy (md);
+    md = NULL;
+
+    CHECK_STRING (copy, "BEYOND2", "Beyond2");
+    CHECK_INT (copy, "interned", 2);
+    meta_data_destroy (copy);
+  }
+
+  meta_data_destroy (md);
+} /* }}} void test_intern */
+
+int main (void) /* {{{ */
+{
+  test_types ();
+  test_case ();
+  test_growth ();
+  test_delete ();
+  test_clone ();
+  test_intern ();
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
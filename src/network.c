@@ -1518,7 +1518,13 @@ static int parse_packet (sockent_t *se, /* {{{ */
 			status = parse_part_string (&buffer, &buffer_size,
 					vl.type, sizeof (vl.type));
 			if (status == 0)
+			{
 				sstrncpy (n.type, vl.type, sizeof (n.type));
+				/* The type is only sent when it changes, so
+				 * resolving it here saves a lookup per value
+				 * list. */
+				vl.type_id = plugin_get_type_id (vl.type);
+			}
 		}
 		else if (pkg_type == TYPE_TYPE_INSTANCE)
 		{
@@ -30,6 +30,8 @@
 #include "utils_complain.h"
 #include "utils_llist.h"
 #include "utils_heap.h"
+#include "utils_procfs.h"
+#include "utils_profile.h"
 #include "utils_time.h"
 
 #if HAVE_PTHREAD_H
@@ -49,6 +51,35 @@ struct callback_func_s
 };
 typedef struct callback_func_s callback_func_t;
 
+/* The last value of one series dispatched by a read function with an adaptive
+ * interval. Counters are converted to rates, so `raw' and `time' hold the
+ * previous counter value. */
+struct read_series_s
+{
+	uint64_t hash;
+	double raw;
+	cdtime_t time;
+	double value;
+	_Bool used;
+	_Bool have_raw;
+	_Bool have_value;
+};
+typedef struct read_series_s read_series_t;
+
+/* Series of a read function with an adaptive interval, in a hash table using
+ * open addressing. `change' and `level' sum up the absolute changes and the
+ * magnitudes of the values dispatched by the current run. */
+#define READ_SERIES_MAX 4096
+struct read_adaptive_s
+{
+	read_series_t *series;
+	size_t size;
+	size_t num;
+	double change;
+	double level;
+};
+typedef struct read_adaptive_s read_adaptive_t;
+
 #define RF_SIMPLE  0
 #define RF_COMPLEX 1
 #define RF_REMOVE  65535
@@ -66,9 +97,48 @@ struct read_func_s
 	cdtime_t rf_interval;
 	cdtime_t rf_effective_interval;
 	cdtime_t rf_next_read;
+	/* Only used by the thread running the read function. */
+	cdtime_t rf_adaptive_interval;
+	read_adaptive_t *rf_adaptive;
+	struct read_pool_s *rf_pool;
+	/* Protected by the lock of `rf_pool'. */
+	uint64_t rf_overruns;
+	uint64_t rf_skipped;
 };
 typedef struct read_func_s read_func_t;
 
+/* The state of one read thread, protected by the lock of its pool. `rf' is
+ * the read function currently being executed by the thread, if any. `overrun'
+ * is set by the watchdog when `rf' has exceeded its timeout. */
+struct read_thread_s
+{
+	struct read_pool_s *pool;
+	pthread_t thread;
+	_Bool active;
+	read_func_t *rf;
+	cdtime_t started;
+	_Bool overrun;
+};
+typedef struct read_thread_s read_thread_t;
+
+/* A set of read threads with its own heap of read functions, so that slow
+ * plugins can't delay the plugins of other pools. `lock' protects the heap's
+ * condition variable, the threads and the `rf_type' of the read functions in
+ * the pool. Pool zero is the default pool. */
+struct read_pool_s
+{
+	char name[DATA_MAX_NAME_LEN];
+	c_heap_t *heap;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	read_thread_t *threads;
+	int threads_num;
+	/* Configured sizes, zero if not configured. */
+	int threads_min;
+	int threads_max;
+};
+typedef struct read_pool_s read_pool_t;
+
 struct write_queue_s;
 typedef struct write_queue_s write_queue_t;
 struct write_queue_s
@@ -78,6 +148,27 @@ struct write_queue_s
 	write_queue_t *next;
 };
 
+/* A plugin loaded by plugin_load(). Entries are never freed, so that the
+ * `name' of plugin contexts stays valid after the plugin has been unloaded.
+ * `dlh' is NULL while the plugin isn't loaded. `threads' counts the running
+ * threads started with plugin_thread_create() and is protected by
+ * `plugins_lock'. */
+struct loaded_plugin_s;
+typedef struct loaded_plugin_s loaded_plugin_t;
+struct loaded_plugin_s
+{
+	char name[DATA_MAX_NAME_LEN];
+	lt_dlhandle dlh;
+	uint32_t flags;
+	int threads;
+	/* Threads of the plugin didn't exit when unloading it. */
+	_Bool defunct;
+	/* The plugin tried to register a callback which can't be added during
+	 * a reload, see plugin_reload_begin(). */
+	_Bool refused;
+	loaded_plugin_t *next;
+};
+
 /*
  * Private variables
  */
@@ -92,17 +183,47 @@ static llist_t *list_notification;
 static fc_chain_t *pre_cache_chain = NULL;
 static fc_chain_t *post_cache_chain = NULL;
 
-static c_avl_tree_t *data_sets;
+/* Snapshot of the value cache, see uc_save() and uc_load(). */
+static char const *cache_file = NULL;
+static cdtime_t    cache_save_interval = 0;
+static cdtime_t    cache_save_next = 0;
+
+/* `data_sets' maps type names to data sets. Each data set is also stored in
+ * `data_set_list' at the index of its ID. Index zero is unused. */
+struct data_set_entry_s
+{
+	data_set_t ds; /* must be the first member */
+	int        id;
+};
+typedef struct data_set_entry_s data_set_entry_t;
+
+static c_avl_tree_t      *data_sets;
+static data_set_entry_t **data_set_list = NULL;
+static size_t             data_set_list_num = 0;
+
+/* Set while the configuration is reloaded, see plugin_reload_begin(). Only
+ * changed by the main thread. */
+static _Bool plugin_reloading = 0;
 
 static char *plugindir = NULL;
 
-static c_heap_t       *read_heap = NULL;
+/* `read_lock' protects `read_list' and `read_pools'. */
 static llist_t        *read_list;
 static int             read_loop = 1;
 static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  read_cond = PTHREAD_COND_INITIALIZER;
-static pthread_t      *read_threads = NULL;
-static int             read_threads_num = 0;
+static read_pool_t   **read_pools = NULL;
+static size_t          read_pools_num = 0;
+static _Bool           read_threads_running = 0;
+static cdtime_t        read_timeout_default = 0;
+
+#define READ_SCHEDULE_IMMEDIATE 0
+#define READ_SCHEDULE_SPREAD    1
+#define READ_SCHEDULE_ALIGN     2
+static int             read_schedule = READ_SCHEDULE_IMMEDIATE;
+
+static pthread_t       read_watchdog;
+static _Bool           read_watchdog_running = 0;
+static pthread_cond_t  read_watchdog_cond = PTHREAD_COND_INITIALIZER;
 
 static write_queue_t  *write_queue_head;
 static write_queue_t  *write_queue_tail;
@@ -111,14 +232,26 @@ static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  write_cond = PTHREAD_COND_INITIALIZER;
 static pthread_t      *write_threads = NULL;
 static size_t          write_threads_num = 0;
+/* Number of write threads dispatching a value list with the filter chains of
+ * an even or odd `write_chains_generation', see plugin_reload_chains(). */
+static int             write_chains_generation = 0;
+static int             write_chains_busy[2] = { 0, 0 };
+static pthread_cond_t  write_chains_cond = PTHREAD_COND_INITIALIZER;
+
+static loaded_plugin_t *plugins_loaded = NULL;
+static pthread_mutex_t plugins_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_key_t   plugin_ctx_key;
 static _Bool           plugin_ctx_key_initialized = 0;
 
+/* The read function run by the calling read thread, if any. */
+static pthread_key_t   read_func_key;
+
 /*
  * Static functions
  */
 static int plugin_dispatch_values_internal (value_list_t *vl);
+static const data_set_t *plugin_get_ds_vl (value_list_t const *vl);
 
 static const char *plugin_get_dir (void)
 {
@@ -142,6 +275,19 @@ static void destroy_callback (callback_func_t *cf) /* {{{ */
 	sfree (cf);
 } /* }}} void destroy_callback */
 
+static void destroy_read_func (read_func_t *rf) /* {{{ */
+{
+	if (rf == NULL)
+		return;
+
+	if (rf->rf_adaptive != NULL)
+	{
+		sfree (rf->rf_adaptive->series);
+		sfree (rf->rf_adaptive);
+	}
+	destroy_callback (&rf->rf_super);
+} /* }}} void destroy_read_func */
+
 static void destroy_all_callbacks (llist_t **list) /* {{{ */
 {
 	llentry_t *le;
@@ -167,25 +313,57 @@ static void destroy_all_callbacks (llist_t **list) /* {{{ */
 	*list = NULL;
 } /* }}} void destroy_all_callbacks */
 
-static void destroy_read_heap (void) /* {{{ */
+static void destroy_read_pools (void) /* {{{ */
 {
-	if (read_heap == NULL)
-		return;
+	size_t i;
 
-	while (42)
+	for (i = 0; i < read_pools_num; i++)
 	{
-		callback_func_t *cf;
+		read_pool_t *pool = read_pools[i];
 
-		cf = c_heap_get_root (read_heap);
-		if (cf == NULL)
-			break;
+		while (42)
+		{
+			read_func_t *rf;
 
-		destroy_callback (cf);
+			rf = c_heap_get_root (pool->heap);
+			if (rf == NULL)
+				break;
+
+			destroy_read_func (rf);
+		}
+
+		c_heap_destroy (pool->heap);
+		pthread_mutex_destroy (&pool->lock);
+		pthread_cond_destroy (&pool->cond);
+		sfree (pool->threads);
+		sfree (pool);
 	}
 
-	c_heap_destroy (read_heap);
-	read_heap = NULL;
-} /* }}} void destroy_read_heap */
+	sfree (read_pools);
+	read_pools_num = 0;
+} /* }}} void destroy_read_pools */
+
+static loaded_plugin_t *plugin_loaded_by_ctx (plugin_ctx_t ctx);
+
+/* Returns EPERM if `what' can't be registered because the configuration is
+ * being reloaded, and zero otherwise. The plugin trying to register it is
+ * flagged, so that it can be unloaded again. */
+static int plugin_check_reloading (const char *what, /* {{{ */
+		const char *name)
+{
+	loaded_plugin_t *lp;
+
+	if (!plugin_reloading)
+		return (0);
+
+	lp = plugin_loaded_by_ctx (plugin_get_ctx ());
+	if (lp != NULL)
+		lp->refused = 1;
+
+	ERROR ("plugin: The %s `%s' can't be registered while the "
+			"configuration is reloaded.", what, name);
+	return (EPERM);
+} /* }}} int plugin_check_reloading */
 
 static int register_callback (llist_t **list, /* {{{ */
 		const char *name, callback_func_t *cf)
@@ -301,7 +479,8 @@ static int plugin_unregister (llist_t *list, const char *name) /* {{{ */
  * object, but it will bitch about a shared object not having a
  * ``module_register'' symbol..
  */
-static int plugin_load_file (char *file, uint32_t flags)
+static int plugin_load_file (char *file, uint32_t flags,
+		lt_dlhandle *ret_dlh)
 {
 	lt_dlhandle dlh;
 	void (*reg_handle) (void);
@@ -355,35 +534,393 @@ static int plugin_load_file (char *file, uint32_t flags)
 		return (-1);
 	}
 
+	*ret_dlh = dlh;
 	(*reg_handle) ();
 
 	return (0);
 }
 
-static void *plugin_read_thread (void __attribute__((unused)) *args)
+/* Returns the entry of the plugin `name', creating it if necessary. */
+static loaded_plugin_t *plugin_loaded_get (const char *name, /* {{{ */
+		_Bool create)
 {
+	loaded_plugin_t *lp;
+
+	pthread_mutex_lock (&plugins_lock);
+
+	for (lp = plugins_loaded; lp != NULL; lp = lp->next)
+		if (strcasecmp (name, lp->name) == 0)
+			break;
+
+	if ((lp == NULL) && create)
+	{
+		lp = calloc (1, sizeof (*lp));
+		if (lp != NULL)
+		{
+			sstrncpy (lp->name, name, sizeof (lp->name));
+			lp->next = plugins_loaded;
+			plugins_loaded = lp;
+		}
+	}
+
+	pthread_mutex_unlock (&plugins_lock);
+
+	return (lp);
+} /* }}} loaded_plugin_t *plugin_loaded_get */
+
+/* Returns true if `cf' has been registered by the plugin `lp'. */
+static _Bool plugin_callback_owned (callback_func_t const *cf, /* {{{ */
+		loaded_plugin_t const *lp)
+{
+	return (cf->cf_ctx.name == lp->name);
+} /* }}} _Bool plugin_callback_owned */
+
+/* Returns true if `lp' registered a callback in `list'. */
+static _Bool plugin_list_owned (llist_t *list, /* {{{ */
+		loaded_plugin_t const *lp)
+{
+	llentry_t *le;
+
+	if (list == NULL)
+		return (0);
+
+	for (le = llist_head (list); le != NULL; le = le->next)
+		if (plugin_callback_owned (le->value, lp))
+			return (1);
+
+	return (0);
+} /* }}} _Bool plugin_list_owned */
+
+/* Plugins whose callbacks are called by other plugins or by the write
+ * threads can't be unloaded, because the daemon can't tell when these
+ * callbacks are no longer in use. The same goes for matches and targets,
+ * which are referenced by the filter chains, and for plugins exporting
+ * symbols. */
+static _Bool plugin_unloadable (loaded_plugin_t const *lp) /* {{{ */
+{
+	if (lp->flags & PLUGIN_FLAGS_GLOBAL)
+		return (0);
+
+	if ((strncasecmp ("match_", lp->name, strlen ("match_")) == 0)
+			|| (strncasecmp ("target_", lp->name,
+					strlen ("target_")) == 0))
+		return (0);
+
+	if (plugin_list_owned (list_write, lp)
+			|| plugin_list_owned (list_flush, lp)
+			|| plugin_list_owned (list_missing, lp)
+			|| plugin_list_owned (list_log, lp)
+			|| plugin_list_owned (list_notification, lp))
+		return (0);
+
+	return (1);
+} /* }}} _Bool plugin_unloadable */
+
+/* Returns the first time at or after `now' at which `rf' may be read. With
+ * the "Spread" schedule, every read function gets a phase within its interval
+ * derived from the host and the function's name, so that hosts started at the
+ * same time don't all read (and send) at the same instant. With "Align", reads
+ * happen at multiples of the interval, i.e. at the same wall-clock times on
+ * all hosts. The effective interval is used, so that a read which fell behind
+ * keeps the back-off of a failing function or the shortened interval of an
+ * adaptive one, see plugin_read_adapt(). */
+static cdtime_t plugin_read_schedule (read_func_t const *rf, /* {{{ */
+		cdtime_t now)
+{
+	cdtime_t interval = rf->rf_effective_interval;
+	cdtime_t phase = 0;
+	cdtime_t next;
+
+	if ((read_schedule == READ_SCHEDULE_IMMEDIATE) || (interval == 0))
+		return (now);
+
+	if (read_schedule == READ_SCHEDULE_SPREAD)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		char const *str;
+
+		/* FNV-1a over "<host>/<name>". */
+		for (str = hostname_g; *str != 0; str++)
+			hash = (hash ^ (unsigned char) *str) * 1099511628211ULL;
+		hash = (hash ^ (unsigned char) '/') * 1099511628211ULL;
+		for (str = rf->rf_name; *str != 0; str++)
+			hash = (hash ^ (unsigned char) *str) * 1099511628211ULL;
+
+		phase = (cdtime_t) (hash % interval);
+	}
+
+	next = now - (now % interval) + phase;
+	if (next < now)
+		next += interval;
+
+	return (next);
+} /* }}} cdtime_t plugin_read_schedule */
+
+/*
+ * Adaptive intervals
+ *
+ * If the MinInterval option is set for a plugin, the values dispatched by each
+ * run of its read functions are compared to the values of the previous run.
+ * The sum of the absolute changes relative to the sum of the magnitudes is the
+ * "change score" of the run. The interval is halved, down to MinInterval,
+ * while the score exceeds the ChangeThreshold and grows by a quarter, up to
+ * the configured interval, while it is below half the threshold. Counters are
+ * compared as rates.
+ */
+#define READ_CHANGE_THRESHOLD_DEFAULT 0.1
+
+static uint64_t plugin_read_hash (uint64_t hash, char const *str) /* {{{ */
+{
+	/* FNV-1a, including the terminating null byte. */
+	do
+		hash = (hash ^ (unsigned char) *str) * 1099511628211ULL;
+	while (*(str++) != 0);
+
+	return (hash);
+} /* }}} uint64_t plugin_read_hash */
+
+/* Returns the series with the given hash, creating it if necessary, or NULL if
+ * the table is full. */
+static read_series_t *plugin_read_series (read_adaptive_t *ra, /* {{{ */
+		uint64_t hash)
+{
+	read_series_t *s;
+	size_t i;
+
+	if ((2 * (ra->num + 1)) > ra->size)
+	{
+		read_series_t *series;
+		size_t size;
+
+		if (ra->num >= READ_SERIES_MAX)
+			size = 0;
+		else
+			size = (ra->size == 0) ? 16 : (2 * ra->size);
+
+		series = (size != 0) ? calloc (size, sizeof (*series)) : NULL;
+		if (series != NULL)
+		{
+			for (i = 0; i < ra->size; i++)
+			{
+				size_t j;
+
+				if (!ra->series[i].used)
+					continue;
+
+				for (j = ra->series[i].hash & (size - 1);
+						series[j].used;
+						j = (j + 1) & (size - 1))
+					/* find a free slot */;
+				series[j] = ra->series[i];
+			}
+			sfree (ra->series);
+			ra->series = series;
+			ra->size = size;
+		}
+	}
+
+	if (ra->size == 0)
+		return (NULL);
+
+	for (i = hash & (ra->size - 1); ; i = (i + 1) & (ra->size - 1))
+	{
+		s = ra->series + i;
+		if (!s->used)
+			break;
+		if (s->hash == hash)
+			return (s);
+	}
+
+	/* `s' is a free slot. Only fill it if there is room left. */
+	if ((2 * (ra->num + 1)) > ra->size)
+		return (NULL);
+
+	s->hash = hash;
+	s->used = 1;
+	ra->num++;
+	return (s);
+} /* }}} read_series_t *plugin_read_series */
+
+/* Adds the values dispatched by the read function running in the calling
+ * thread to the change score of its current run. */
+static void plugin_read_record (value_list_t const *vl) /* {{{ */
+{
+	read_func_t *rf;
+	read_adaptive_t *ra;
+	data_set_t const *ds;
+	uint64_t hash;
+	cdtime_t t;
+	int i;
+
+	if (!plugin_ctx_key_initialized)
+		return;
+
+	rf = pthread_getspecific (read_func_key);
+	if ((rf == NULL) || (rf->rf_ctx.min_interval == 0))
+		return;
+
+	ds = plugin_get_ds_vl (vl);
+	if ((ds == NULL) || (ds->ds_num != vl->values_len))
+		return;
+
+	if (rf->rf_adaptive == NULL)
+	{
+		rf->rf_adaptive = calloc (1, sizeof (*rf->rf_adaptive));
+		if (rf->rf_adaptive == NULL)
+			return;
+	}
+	ra = rf->rf_adaptive;
+
+	hash = 14695981039346656037ULL;
+	hash = plugin_read_hash (hash, vl->host);
+	hash = plugin_read_hash (hash, vl->plugin);
+	hash = plugin_read_hash (hash, vl->plugin_instance);
+	hash = plugin_read_hash (hash, vl->type);
+	hash = plugin_read_hash (hash, vl->type_instance);
+
+	t = (vl->time != 0) ? vl->time : cdtime ();
+
+	for (i = 0; i < vl->values_len; i++)
+	{
+		read_series_t *s;
+		double raw;
+		double x;
+
+		s = plugin_read_series (ra, (hash ^ (uint64_t) i) * 1099511628211ULL);
+		if (s == NULL)
+			return;
+
+		if (ds->ds[i].type == DS_TYPE_GAUGE)
+		{
+			x = vl->values[i].gauge;
+			if (isnan (x))
+				continue;
+		}
+		else
+		{
+			if (ds->ds[i].type == DS_TYPE_COUNTER)
+				raw = (double) vl->values[i].counter;
+			else if (ds->ds[i].type == DS_TYPE_DERIVE)
+				raw = (double) vl->values[i].derive;
+			else
+				raw = (double) vl->values[i].absolute;
+
+			/* Rates need two values, except for absolute values,
+			 * which are reset when read. Counter wrap-arounds and
+			 * resets are skipped. */
+			if (!s->have_raw || (t <= s->time)
+					|| ((ds->ds[i].type != DS_TYPE_ABSOLUTE)
+						&& (raw < s->raw)))
+			{
+				s->raw = raw;
+				s->time = t;
+				s->have_raw = 1;
+				continue;
+			}
+
+			if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
+				x = raw / CDTIME_T_TO_DOUBLE (t - s->time);
+			else
+				x = (raw - s->raw) / CDTIME_T_TO_DOUBLE (t - s->time);
+
+			s->raw = raw;
+			s->time = t;
+		}
+
+		if (s->have_value)
+		{
+			ra->change += fabs (x - s->value);
+			ra->level += (fabs (x) > fabs (s->value))
+				? fabs (x) : fabs (s->value);
+		}
+		s->value = x;
+		s->have_value = 1;
+	}
+} /* }}} void plugin_read_record */
+
+/* Returns the interval until the next run of `rf' after a successful run. */
+static cdtime_t plugin_read_adapt (read_func_t *rf) /* {{{ */
+{
+	read_adaptive_t *ra = rf->rf_adaptive;
+	cdtime_t min_interval = rf->rf_ctx.min_interval;
+	cdtime_t interval = rf->rf_adaptive_interval;
+	double threshold = rf->rf_ctx.change_threshold;
+	double score = 0.0;
+
+	/* Read functions registered with their own interval may not honor the
+	 * plugin's MinInterval. */
+	if ((min_interval == 0) || (min_interval >= rf->rf_interval))
+		return (rf->rf_interval);
+
+	if (interval == 0)
+		interval = rf->rf_interval;
+	if (threshold <= 0.0)
+		threshold = READ_CHANGE_THRESHOLD_DEFAULT;
+
+	if (ra != NULL)
+	{
+		if (ra->level > 0.0)
+			score = ra->change / ra->level;
+		ra->change = 0.0;
+		ra->level = 0.0;
+	}
+
+	if (score > threshold)
+	{
+		interval /= 2;
+		if (interval < min_interval)
+			interval = min_interval;
+	}
+	else if (score < (threshold / 2.0))
+	{
+		interval += interval / 4;
+		if (interval > rf->rf_interval)
+			interval = rf->rf_interval;
+	}
+
+	if (interval != rf->rf_adaptive_interval)
+		DEBUG ("plugin_read_adapt: The change score of the %s plugin "
+				"is %g, reading it every %.3f seconds.",
+				rf->rf_name, score, CDTIME_T_TO_DOUBLE (interval));
+
+	rf->rf_adaptive_interval = interval;
+	return (interval);
+} /* }}} cdtime_t plugin_read_adapt */
+
+/* How often the watchdog checks for read functions exceeding their timeout. */
+#define READ_WATCHDOG_INTERVAL TIME_T_TO_CDTIME_T (1)
+
+static void *plugin_read_thread (void *args)
+{
+	read_thread_t *self = args;
+	read_pool_t *pool = self->pool;
+
 	while (read_loop != 0)
 	{
 		read_func_t *rf;
 		plugin_ctx_t old_ctx;
 		cdtime_t now;
+		cdtime_t started;
+		cdtime_t profile_start = 0;
+		_Bool profiling;
+		_Bool overrun;
 		int status;
 		int rf_type;
 		int rc;
 
 		/* Get the read function that needs to be read next.
-		 * We don't need to hold "read_lock" for the heap, but we need
+		 * We don't need to hold the pool's lock for the heap, but we need
 		 * to call c_heap_get_root() and pthread_cond_wait() in the
 		 * same protected block. */
-		pthread_mutex_lock (&read_lock);
-		rf = c_heap_get_root (read_heap);
+		pthread_mutex_lock (&pool->lock);
+		rf = c_heap_get_root (pool->heap);
 		if (rf == NULL)
 		{
-			pthread_cond_wait (&read_cond, &read_lock);
-                        pthread_mutex_unlock (&read_lock);
+			pthread_cond_wait (&pool->cond, &pool->lock);
+                        pthread_mutex_unlock (&pool->lock);
 			continue;
 		}
-		pthread_mutex_unlock (&read_lock);
+		pthread_mutex_unlock (&pool->lock);
 
 		if (rf->rf_interval == 0)
 		{
@@ -393,12 +930,26 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 			rf->rf_interval = plugin_get_interval ();
 			rf->rf_effective_interval = rf->rf_interval;
 
-			rf->rf_next_read = cdtime ();
+			rf->rf_next_read = 0;
+		}
+
+		/* Read functions are scheduled when they are first taken from
+		 * the heap rather than when they are registered, because the
+		 * host name, which determines the phase, is not known yet at
+		 * that time. */
+		if (rf->rf_next_read == 0)
+		{
+			rf->rf_next_read = plugin_read_schedule (rf, cdtime ());
+			DEBUG ("plugin_read_thread: First read of the %s plugin "
+					"at %.3f.", rf->rf_name,
+					CDTIME_T_TO_DOUBLE (rf->rf_next_read));
+			c_heap_insert (pool->heap, rf);
+			continue;
 		}
 
 		/* sleep until this entry is due,
 		 * using pthread_cond_timedwait */
-		pthread_mutex_lock (&read_lock);
+		pthread_mutex_lock (&pool->lock);
 		/* In pthread_cond_timedwait, spurious wakeups are possible
 		 * (and really happen, at least on NetBSD with > 1 CPU), thus
 		 * we need to re-evaluate the condition every time
@@ -412,20 +963,31 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 
 			CDTIME_T_TO_TIMESPEC (rf->rf_next_read, &ts);
 
-			rc = pthread_cond_timedwait (&read_cond, &read_lock,
+			rc = pthread_cond_timedwait (&pool->cond, &pool->lock,
 				&ts);
 		}
 
-		/* Must hold `read_lock' when accessing `rf->rf_type'. */
+		/* Must hold the pool's lock when accessing `rf->rf_type'.
+		 * Let the watchdog and plugin_unload() know what we're doing
+		 * in the same critical section. While `rf' is running, it is
+		 * not in the heap, so it won't be started a second time by
+		 * another thread. */
 		rf_type = rf->rf_type;
-		pthread_mutex_unlock (&read_lock);
+		started = cdtime ();
+		if ((read_loop != 0) && (rf_type != RF_REMOVE))
+		{
+			self->rf = rf;
+			self->started = started;
+			self->overrun = 0;
+		}
+		pthread_mutex_unlock (&pool->lock);
 
 		/* Check if we're supposed to stop.. This may have interrupted
 		 * the sleep, too. */
 		if (read_loop == 0)
 		{
 			/* Insert `rf' again, so it can be free'd correctly */
-			c_heap_insert (read_heap, rf);
+			c_heap_insert (pool->heap, rf);
 			break;
 		}
 
@@ -437,7 +999,7 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		{
 			DEBUG ("plugin_read_thread: Destroying the `%s' "
 					"callback.", rf->rf_name);
-			destroy_callback ((callback_func_t *) rf);
+			destroy_read_func (rf);
 			rf = NULL;
 			continue;
 		}
@@ -445,6 +1007,12 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		DEBUG ("plugin_read_thread: Handling `%s'.", rf->rf_name);
 
 		old_ctx = plugin_set_ctx (rf->rf_ctx);
+		if (rf->rf_ctx.min_interval != 0)
+			pthread_setspecific (read_func_key, rf);
+
+		profiling = profile_is_enabled ();
+		if (profiling)
+			profile_start = profile_clock ();
 
 		if (rf_type == RF_SIMPLE)
 		{
@@ -463,8 +1031,20 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 			status = (*callback) (&rf->rf_udata);
 		}
 
+		if (profiling)
+			profile_record (PROFILE_READ, rf->rf_name,
+					profile_clock () - profile_start,
+					/* values = */ 0);
+
+		pthread_setspecific (read_func_key, NULL);
 		plugin_set_ctx (old_ctx);
 
+		pthread_mutex_lock (&pool->lock);
+		overrun = self->overrun;
+		self->rf = NULL;
+		self->overrun = 0;
+		pthread_mutex_unlock (&pool->lock);
+
 		/* If the function signals failure, we will increase the
 		 * intervals in which it will be called. */
 		if (status != 0)
@@ -480,8 +1060,9 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		}
 		else
 		{
-			/* Success: Restore the interval, if it was changed. */
-			rf->rf_effective_interval = rf->rf_interval;
+			/* Success: Restore the interval, if it was changed,
+			 * or adapt it to the values read. */
+			rf->rf_effective_interval = plugin_read_adapt (rf);
 		}
 
 		/* update the ``next read due'' field */
@@ -499,79 +1080,315 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		/* Check, if `rf_next_read' is in the past. */
 		if (rf->rf_next_read < now)
 		{
-			/* `rf_next_read' is in the past. Insert `now'
-			 * so this value doesn't trail off into the
-			 * past too much. */
-			rf->rf_next_read = now;
+			/* Runs which were due while the function was still
+			 * running are skipped, not made up for. */
+			uint64_t skipped = (now - rf->rf_next_read)
+				/ rf->rf_effective_interval;
+
+			if (overrun)
+			{
+				pthread_mutex_lock (&pool->lock);
+				rf->rf_skipped += skipped;
+				pthread_mutex_unlock (&pool->lock);
+			}
+
+			/* `rf_next_read' is in the past. Insert the next
+			 * possible time so this value doesn't trail off into
+			 * the past too much. */
+			rf->rf_next_read = plugin_read_schedule (rf, now);
 		}
 
 		DEBUG ("plugin_read_thread: Next read of the %s plugin at %.3f.",
 				rf->rf_name,
 				CDTIME_T_TO_DOUBLE (rf->rf_next_read));
 
+		if (overrun)
+		{
+			pthread_mutex_lock (&pool->lock);
+			NOTICE ("read-function of plugin `%s' returned after "
+					"%.3f seconds. It has exceeded its "
+					"timeout %"PRIu64" times and skipped "
+					"%"PRIu64" runs so far.",
+					rf->rf_name,
+					CDTIME_T_TO_DOUBLE (now - started),
+					rf->rf_overruns, rf->rf_skipped);
+			pthread_mutex_unlock (&pool->lock);
+		}
+
 		/* Re-insert this read function into the heap again. */
-		c_heap_insert (read_heap, rf);
+		c_heap_insert (pool->heap, rf);
+
+		/* The watchdog may have started additional threads while this
+		 * one was blocked. Shrink the pool back to its configured
+		 * size. */
+		if (overrun)
+		{
+			pthread_mutex_lock (&pool->lock);
+			if ((read_loop != 0)
+					&& (pool->threads_num > pool->threads_min))
+			{
+				self->active = 0;
+				pool->threads_num--;
+				pthread_detach (self->thread);
+				pthread_mutex_unlock (&pool->lock);
+
+				INFO ("plugin_read_thread: Stopping an "
+						"additional read thread.");
+				break;
+			}
+			pthread_mutex_unlock (&pool->lock);
+		}
 	} /* while (read_loop) */
 
 	pthread_exit (NULL);
 	return ((void *) 0);
 } /* void *plugin_read_thread */
 
-static void start_read_threads (int num)
+/* Starts one read thread in `pool'. The caller must hold the pool's lock. */
+static int start_read_thread (read_pool_t *pool) /* {{{ */
 {
 	int i;
 
-	if (read_threads != NULL)
-		return;
+	for (i = 0; i < pool->threads_max; i++)
+		if (!pool->threads[i].active)
+			break;
+
+	if (i >= pool->threads_max)
+		return (ENOENT);
 
-	read_threads = (pthread_t *) calloc (num, sizeof (pthread_t));
-	if (read_threads == NULL)
+	memset (pool->threads + i, 0, sizeof (pool->threads[i]));
+	pool->threads[i].pool = pool;
+	if (pthread_create (&pool->threads[i].thread, NULL,
+				plugin_read_thread, pool->threads + i) != 0)
 	{
-		ERROR ("plugin: start_read_threads: calloc failed.");
-		return;
+		ERROR ("plugin: start_read_thread: pthread_create failed.");
+		return (-1);
 	}
 
-	read_threads_num = 0;
-	for (i = 0; i < num; i++)
+	pool->threads[i].active = 1;
+	pool->threads_num++;
+
+	return (0);
+} /* }}} int start_read_thread */
+
+/* Checks the threads of one pool, see plugin_read_watchdog(). */
+static void plugin_read_watchdog_pool (read_pool_t *pool, /* {{{ */
+		cdtime_t now)
+{
+	int available = 0;
+	int i;
+
+	pthread_mutex_lock (&pool->lock);
+
+	for (i = 0; i < pool->threads_max; i++)
 	{
-		if (pthread_create (read_threads + read_threads_num, NULL,
-					plugin_read_thread, NULL) == 0)
+		read_thread_t *rt = pool->threads + i;
+		cdtime_t timeout;
+
+		if (!rt->active || rt->overrun)
+			continue;
+
+		if (rt->rf == NULL)
 		{
-			read_threads_num++;
+			available++;
+			continue;
 		}
-		else
+
+		timeout = rt->rf->rf_ctx.read_timeout;
+		if (timeout == 0)
+			timeout = read_timeout_default;
+		if (timeout == 0)
+			timeout = rt->rf->rf_effective_interval;
+
+		if ((now - rt->started) <= timeout)
 		{
-			ERROR ("plugin: start_read_threads: pthread_create failed.");
-			return;
+			available++;
+			continue;
 		}
+
+		rt->overrun = 1;
+		rt->rf->rf_overruns++;
+		WARNING ("read-function of plugin `%s' has been running "
+				"for %.3f seconds, exceeding its timeout "
+				"of %.3f seconds. It won't be started "
+				"again until it returns.",
+				rt->rf->rf_name,
+				CDTIME_T_TO_DOUBLE (now - rt->started),
+				CDTIME_T_TO_DOUBLE (timeout));
+	}
+
+	for (i = available; i < pool->threads_min; i++)
+	{
+		if (start_read_thread (pool) != 0)
+		{
+			WARNING ("plugin_read_watchdog: All %i threads of "
+					"the read thread pool \"%s\" are busy. "
+					"Consider increasing `MaxThreads'.",
+					pool->threads_max, pool->name);
+			break;
+		}
+		INFO ("plugin_read_watchdog: Started an additional read "
+				"thread in pool \"%s\", now %i.",
+				pool->name, pool->threads_num);
+	}
+
+	pthread_mutex_unlock (&pool->lock);
+} /* }}} void plugin_read_watchdog_pool */
+
+/* Watches the read threads. When a read function runs for longer than its
+ * timeout, it is reported and, if fewer than `threads_min' threads of its pool
+ * are left to run the other read functions, another thread is started. The
+ * additional threads exit once the blocked read functions return. */
+static void *plugin_read_watchdog (void __attribute__((unused)) *args) /* {{{ */
+{
+	pthread_mutex_lock (&read_lock);
+	while (read_loop != 0)
+	{
+		struct timespec ts = { 0 };
+		cdtime_t now = cdtime ();
+		size_t i;
+
+		for (i = 0; i < read_pools_num; i++)
+			plugin_read_watchdog_pool (read_pools[i], now);
+
+		CDTIME_T_TO_TIMESPEC (now + READ_WATCHDOG_INTERVAL, &ts);
+		pthread_cond_timedwait (&read_watchdog_cond, &read_lock, &ts);
+	}
+	pthread_mutex_unlock (&read_lock);
+
+	pthread_exit (NULL);
+	return ((void *) 0);
+} /* }}} void *plugin_read_watchdog */
+
+/* Starts the threads of all pools. `num' and `max_num' are used for pools
+ * without an explicit configuration. */
+static void start_read_threads (int num, int max_num)
+{
+	size_t i;
+	int j;
+
+	if (read_threads_running)
+		return;
+
+	if (max_num < num)
+		max_num = num;
+
+	pthread_mutex_lock (&read_lock);
+
+	for (i = 0; i < read_pools_num; i++)
+	{
+		read_pool_t *pool = read_pools[i];
+
+		pthread_mutex_lock (&pool->lock);
+
+		if (pool->threads_min <= 0)
+		{
+			pool->threads_min = num;
+			if (pool->threads_max <= 0)
+				pool->threads_max = max_num;
+		}
+		else if (pool->threads_max <= 0)
+			pool->threads_max = 2 * pool->threads_min;
+		if (pool->threads_max < pool->threads_min)
+			pool->threads_max = pool->threads_min;
+
+		pool->threads = calloc (pool->threads_max,
+				sizeof (*pool->threads));
+		if (pool->threads == NULL)
+		{
+			ERROR ("plugin: start_read_threads: calloc failed.");
+			pool->threads_max = 0;
+			pthread_mutex_unlock (&pool->lock);
+			continue;
+		}
+
+		pool->threads_num = 0;
+		for (j = 0; j < pool->threads_min; j++)
+		{
+			if (start_read_thread (pool) != 0)
+				break;
+		} /* for (j) */
+
+		DEBUG ("plugin: start_read_threads: Started %i threads in "
+				"pool \"%s\".", pool->threads_num, pool->name);
+
+		pthread_mutex_unlock (&pool->lock);
 	} /* for (i) */
+
+	if (pthread_create (&read_watchdog, NULL,
+				plugin_read_watchdog, NULL) == 0)
+		read_watchdog_running = 1;
+	else
+		ERROR ("plugin: start_read_threads: pthread_create failed.");
+
+	read_threads_running = 1;
+
+	pthread_mutex_unlock (&read_lock);
 } /* void start_read_threads */
 
 static void stop_read_threads (void)
 {
-	int i;
+	size_t i;
+	int j;
 
-	if (read_threads == NULL)
+	if (!read_threads_running)
 		return;
 
-	INFO ("collectd: Stopping %i read threads.", read_threads_num);
-
 	pthread_mutex_lock (&read_lock);
 	read_loop = 0;
-	DEBUG ("plugin: stop_read_threads: Signalling `read_cond'");
-	pthread_cond_broadcast (&read_cond);
+	DEBUG ("plugin: stop_read_threads: Signalling the read threads.");
+	for (i = 0; i < read_pools_num; i++)
+	{
+		pthread_mutex_lock (&read_pools[i]->lock);
+		pthread_cond_broadcast (&read_pools[i]->cond);
+		pthread_mutex_unlock (&read_pools[i]->lock);
+	}
+	pthread_cond_broadcast (&read_watchdog_cond);
 	pthread_mutex_unlock (&read_lock);
 
-	for (i = 0; i < read_threads_num; i++)
+	if (read_watchdog_running)
 	{
-		if (pthread_join (read_threads[i], NULL) != 0)
-		{
+		if (pthread_join (read_watchdog, NULL) != 0)
 			ERROR ("plugin: stop_read_threads: pthread_join failed.");
+		read_watchdog_running = 0;
+	}
+
+	for (i = 0; i < read_pools_num; i++)
+	{
+		read_pool_t *pool = read_pools[i];
+		pthread_t *threads;
+		int threads_num = 0;
+
+		INFO ("collectd: Stopping %i read threads of pool \"%s\".",
+				pool->threads_num, pool->name);
+
+		/* Threads don't exit on their own once `read_loop' is zero,
+		 * so the set of active threads doesn't change anymore. */
+		threads = calloc (pool->threads_max, sizeof (*threads));
+		pthread_mutex_lock (&pool->lock);
+		for (j = 0; (threads != NULL) && (j < pool->threads_max); j++)
+			if (pool->threads[j].active)
+				threads[threads_num++] = pool->threads[j].thread;
+		pthread_mutex_unlock (&pool->lock);
+
+		for (j = 0; j < threads_num; j++)
+		{
+			if (pthread_join (threads[j], NULL) != 0)
+			{
+				ERROR ("plugin: stop_read_threads: "
+						"pthread_join failed.");
+			}
 		}
-		read_threads[i] = (pthread_t) 0;
+		sfree (threads);
+
+		pthread_mutex_lock (&pool->lock);
+		sfree (pool->threads);
+		pool->threads_num = 0;
+		pool->threads_max = 0;
+		pthread_mutex_unlock (&pool->lock);
 	}
-	sfree (read_threads);
-	read_threads_num = 0;
+
+	read_threads_running = 0;
 } /* void stop_read_threads */
 
 static void plugin_value_list_free (value_list_t *vl) /* {{{ */
@@ -615,7 +1432,10 @@ static value_list_t *plugin_value_list_clone (value_list_t const *vl_orig) /* {{
 	if (vl->time == 0)
 		vl->time = cdtime ();
 
-	/* Fill in the interval from the thread context, if it is zero. */
+	/* Fill in the interval from the thread context, if it is zero. This is
+	 * the configured interval, also while an adaptive interval (MinInterval)
+	 * reads the plugin more often, so that the step of RRD files and the
+	 * timeouts of the cache don't depend on when the values were read. */
 	if (vl->interval == 0)
 	{
 		plugin_ctx_t ctx = plugin_get_ctx ();
@@ -680,13 +1500,24 @@ static int plugin_write_enqueue (value_list_t const *vl) /* {{{ */
 	return (0);
 } /* }}} int plugin_write_enqueue */
 
-static value_list_t *plugin_write_dequeue (void) /* {{{ */
+/* Returns the next value list from the queue. `chains_slot' is the slot of
+ * `write_chains_busy' the calling thread has been counted in while
+ * dispatching the previous value list, or -1. */
+static value_list_t *plugin_write_dequeue (int *chains_slot) /* {{{ */
 {
 	write_queue_t *q;
 	value_list_t *vl;
 
 	pthread_mutex_lock (&write_lock);
 
+	if (*chains_slot >= 0)
+	{
+		write_chains_busy[*chains_slot]--;
+		if (write_chains_busy[*chains_slot] == 0)
+			pthread_cond_broadcast (&write_chains_cond);
+		*chains_slot = -1;
+	}
+
 	while (write_loop && (write_queue_head == NULL))
 		pthread_cond_wait (&write_cond, &write_lock);
 
@@ -701,6 +1532,9 @@ static value_list_t *plugin_write_dequeue (void) /* {{{ */
 	if (write_queue_head == NULL)
 		write_queue_tail = NULL;
 
+	*chains_slot = write_chains_generation % 2;
+	write_chains_busy[*chains_slot]++;
+
 	pthread_mutex_unlock (&write_lock);
 
 	(void) plugin_set_ctx (q->ctx);
@@ -712,9 +1546,11 @@ static value_list_t *plugin_write_dequeue (void) /* {{{ */
 
 static void *plugin_write_thread (void __attribute__((unused)) *args) /* {{{ */
 {
+	int chains_slot = -1;
+
 	while (write_loop)
 	{
-		value_list_t *vl = plugin_write_dequeue ();
+		value_list_t *vl = plugin_write_dequeue (&chains_slot);
 		if (vl == NULL)
 			continue;
 
@@ -841,8 +1677,34 @@ int plugin_load (const char *type, uint32_t flags)
 	int   ret;
 	struct stat    statbuf;
 	struct dirent *de;
+	loaded_plugin_t *lp;
+	plugin_ctx_t ctx;
+	plugin_ctx_t old_ctx;
 	int status;
 
+	lp = plugin_loaded_get (type, /* create = */ 1);
+	if (lp == NULL)
+	{
+		ERROR ("plugin_load: calloc failed.");
+		return (-1);
+	}
+
+	if (lp->dlh != NULL)
+	{
+		DEBUG ("plugin_load: The \"%s\" plugin is already loaded.", type);
+		return (0);
+	}
+
+	if (lp->defunct)
+	{
+		ERROR ("plugin_load: The \"%s\" plugin couldn't be unloaded "
+				"completely before. Restart collectd to load it "
+				"again.", type);
+		return (-1);
+	}
+
+	lp->refused = 0;
+
 	dir = plugin_get_dir ();
 	ret = 1;
 
@@ -894,10 +1756,17 @@ int plugin_load (const char *type, uint32_t flags)
 			continue;
 		}
 
-		status = plugin_load_file (filename, flags);
+		/* Callbacks registered by the plugin remember its name, so
+		 * that they can be removed by plugin_unload(). */
+		ctx = plugin_get_ctx ();
+		ctx.name = lp->name;
+		old_ctx = plugin_set_ctx (ctx);
+		status = plugin_load_file (filename, flags, &lp->dlh);
+		plugin_set_ctx (old_ctx);
 		if (status == 0)
 		{
 			/* success */
+			lp->flags = flags;
 			ret = 0;
 			break;
 		}
@@ -957,15 +1826,61 @@ static int plugin_compare_read_func (const void *arg0, const void *arg1)
 		return (0);
 } /* int plugin_compare_read_func */
 
+/* Returns the read thread pool `name', creating it if necessary. The default
+ * pool is always at index zero. The caller must hold `read_lock'. */
+static int read_pool_get (const char *name) /* {{{ */
+{
+	read_pool_t **tmp;
+	read_pool_t *pool;
+	size_t i;
+
+	if ((read_pools_num == 0) && (strcasecmp ("default", name) != 0))
+	{
+		int status = read_pool_get ("default");
+		if (status < 0)
+			return (status);
+	}
+
+	for (i = 0; i < read_pools_num; i++)
+		if (strcasecmp (read_pools[i]->name, name) == 0)
+			return ((int) i);
+
+	tmp = realloc (read_pools, (read_pools_num + 1) * sizeof (*read_pools));
+	if (tmp == NULL)
+		return (-ENOMEM);
+	read_pools = tmp;
+
+	pool = calloc (1, sizeof (*pool));
+	if (pool == NULL)
+		return (-ENOMEM);
+
+	sstrncpy (pool->name, name, sizeof (pool->name));
+	pool->heap = c_heap_create (plugin_compare_read_func);
+	if (pool->heap == NULL)
+	{
+		sfree (pool);
+		return (-ENOMEM);
+	}
+	pthread_mutex_init (&pool->lock, /* attr = */ NULL);
+	pthread_cond_init (&pool->cond, /* attr = */ NULL);
+
+	read_pools[read_pools_num] = pool;
+	read_pools_num++;
+
+	return ((int) (read_pools_num - 1));
+} /* }}} int read_pool_get */
+
 /* Add a read function to both, the heap and a linked list. The linked list if
  * used to look-up read functions, especially for the remove function. The heap
  * is used to determine which plugin to read next. */
 static int plugin_insert_read (read_func_t *rf)
 {
+	read_pool_t *pool;
 	int status;
 	llentry_t *le;
 
-	rf->rf_next_read = cdtime ();
+	/* Scheduled by the read threads, see plugin_read_schedule(). */
+	rf->rf_next_read = 0;
 	rf->rf_effective_interval = rf->rf_interval;
 
 	pthread_mutex_lock (&read_lock);
@@ -981,16 +1896,32 @@ static int plugin_insert_read (read_func_t *rf)
 		}
 	}
 
-	if (read_heap == NULL)
+	if (read_pool_get ("default") < 0)
 	{
-		read_heap = c_heap_create (plugin_compare_read_func);
-		if (read_heap == NULL)
-		{
-			pthread_mutex_unlock (&read_lock);
-			ERROR ("plugin_insert_read: c_heap_create failed.");
-			return (-1);
-		}
+		pthread_mutex_unlock (&read_lock);
+		ERROR ("plugin_insert_read: Creating the default read thread "
+				"pool failed.");
+		return (-1);
+	}
+
+	/* The pool is determined by the `ReadThreadPool' option of the
+	 * plugin's <LoadPlugin> block. */
+	if ((rf->rf_ctx.read_pool > 0)
+			&& ((size_t) rf->rf_ctx.read_pool < read_pools_num))
+		pool = read_pools[rf->rf_ctx.read_pool];
+	else
+		pool = read_pools[0];
+	/* Pools created after the read threads have been started, e.g. when
+	 * reloading the configuration, don't have any threads. */
+	if (read_threads_running && (pool->threads == NULL))
+	{
+		WARNING ("plugin_insert_read: The read thread pool \"%s\" has "
+				"no threads. Restart collectd to start them. "
+				"Using the default pool for \"%s\".",
+				pool->name, rf->rf_name);
+		pool = read_pools[0];
 	}
+	rf->rf_pool = pool;
 
 	le = llist_search (read_list, rf->rf_name);
 	if (le != NULL)
@@ -1007,27 +1938,78 @@ static int plugin_insert_read (read_func_t *rf)
 	if (le == NULL)
 	{
 		pthread_mutex_unlock (&read_lock);
-		ERROR ("plugin_insert_read: llentry_create failed.");
-		return (-1);
+		ERROR ("plugin_insert_read: llentry_create failed.");
+		return (-1);
+	}
+
+	status = c_heap_insert (pool->heap, rf);
+	if (status != 0)
+	{
+		pthread_mutex_unlock (&read_lock);
+		ERROR ("plugin_insert_read: c_heap_insert failed.");
+		llentry_destroy (le);
+		return (-1);
+	}
+
+	/* This does not fail. */
+	llist_append (read_list, le);
+
+	pthread_mutex_unlock (&read_lock);
+
+	/* Wake up all the read threads of the pool. */
+	pthread_mutex_lock (&pool->lock);
+	pthread_cond_broadcast (&pool->cond);
+	pthread_mutex_unlock (&pool->lock);
+
+	return (0);
+} /* int plugin_insert_read */
+
+int plugin_read_pool_get (const char *name) /* {{{ */
+{
+	int status;
+
+	if (name == NULL)
+		return (-EINVAL);
+
+	pthread_mutex_lock (&read_lock);
+	status = read_pool_get (name);
+	pthread_mutex_unlock (&read_lock);
+
+	return (status);
+} /* }}} int plugin_read_pool_get */
+
+int plugin_read_pool_configure (const char *name, /* {{{ */
+		int threads, int max_threads)
+{
+	read_pool_t *pool;
+	int status;
+
+	if ((name == NULL) || (threads < 0) || (max_threads < 0))
+		return (-EINVAL);
+
+	pthread_mutex_lock (&read_lock);
+
+	if (read_threads_running)
+	{
+		pthread_mutex_unlock (&read_lock);
+		return (-EBUSY);
 	}
 
-	status = c_heap_insert (read_heap, rf);
-	if (status != 0)
+	status = read_pool_get (name);
+	if (status < 0)
 	{
 		pthread_mutex_unlock (&read_lock);
-		ERROR ("plugin_insert_read: c_heap_insert failed.");
-		llentry_destroy (le);
-		return (-1);
+		return (status);
 	}
 
-	/* This does not fail. */
-	llist_append (read_list, le);
+	pool = read_pools[status];
+	pool->threads_min = threads;
+	pool->threads_max = max_threads;
 
-	/* Wake up all the read threads. */
-	pthread_cond_broadcast (&read_cond);
 	pthread_mutex_unlock (&read_lock);
+
 	return (0);
-} /* int plugin_insert_read */
+} /* }}} int plugin_read_pool_configure */
 
 int plugin_register_read (const char *name,
 		int (*callback) (void))
@@ -1110,6 +2092,9 @@ int plugin_register_complex_read (const char *group, const char *name,
 int plugin_register_write (const char *name,
 		plugin_write_cb callback, user_data_t *ud)
 {
+	if (plugin_check_reloading ("write callback", name) != 0)
+		return (EPERM);
+
 	return (create_register_callback (&list_write, name,
 				(void *) callback, ud));
 } /* int plugin_register_write */
@@ -1117,6 +2102,9 @@ int plugin_register_write (const char *name,
 int plugin_register_flush (const char *name,
 		plugin_flush_cb callback, user_data_t *ud)
 {
+	if (plugin_check_reloading ("flush callback", name) != 0)
+		return (EPERM);
+
 	return (create_register_callback (&list_flush, name,
 				(void *) callback, ud));
 } /* int plugin_register_flush */
@@ -1124,6 +2112,9 @@ int plugin_register_flush (const char *name,
 int plugin_register_missing (const char *name,
 		plugin_missing_cb callback, user_data_t *ud)
 {
+	if (plugin_check_reloading ("missing callback", name) != 0)
+		return (EPERM);
+
 	return (create_register_callback (&list_missing, name,
 				(void *) callback, ud));
 } /* int plugin_register_missing */
@@ -1137,9 +2128,16 @@ int plugin_register_shutdown (const char *name,
 
 int plugin_register_data_set (const data_set_t *ds)
 {
-	data_set_t *ds_copy;
+	data_set_entry_t *entry;
+	int type_id;
 	int i;
 
+	if (plugin_check_reloading ("data set", ds->type) != 0)
+		return (EPERM);
+
+	/* Keep the ID of a replaced data set. */
+	type_id = plugin_get_type_id (ds->type);
+
 	if ((data_sets != NULL)
 			&& (c_avl_get (data_sets, ds->type, NULL) == 0))
 	{
@@ -1153,28 +2151,55 @@ int plugin_register_data_set (const data_set_t *ds)
 			return (-1);
 	}
 
-	ds_copy = (data_set_t *) malloc (sizeof (data_set_t));
-	if (ds_copy == NULL)
+	if (type_id == 0)
+	{
+		data_set_entry_t **tmp;
+		size_t new_num = (data_set_list_num == 0) ? 2 : (data_set_list_num + 1);
+
+		tmp = realloc (data_set_list, new_num * sizeof (*data_set_list));
+		if (tmp == NULL)
+			return (-1);
+		data_set_list = tmp;
+
+		while (data_set_list_num < new_num)
+			data_set_list[data_set_list_num++] = NULL;
+		type_id = (int) (data_set_list_num - 1);
+	}
+
+	entry = malloc (sizeof (*entry));
+	if (entry == NULL)
 		return (-1);
-	memcpy(ds_copy, ds, sizeof (data_set_t));
+	memcpy (&entry->ds, ds, sizeof (data_set_t));
+	entry->id = type_id;
 
-	ds_copy->ds = (data_source_t *) malloc (sizeof (data_source_t)
+	entry->ds.ds = (data_source_t *) malloc (sizeof (data_source_t)
 			* ds->ds_num);
-	if (ds_copy->ds == NULL)
+	if (entry->ds.ds == NULL)
 	{
-		free (ds_copy);
+		free (entry);
 		return (-1);
 	}
 
 	for (i = 0; i < ds->ds_num; i++)
-		memcpy (ds_copy->ds + i, ds->ds + i, sizeof (data_source_t));
+		memcpy (entry->ds.ds + i, ds->ds + i, sizeof (data_source_t));
+
+	if (c_avl_insert (data_sets, (void *) entry->ds.type, (void *) entry) != 0)
+	{
+		sfree (entry->ds.ds);
+		sfree (entry);
+		return (-1);
+	}
 
-	return (c_avl_insert (data_sets, (void *) ds_copy->type, (void *) ds_copy));
+	data_set_list[type_id] = entry;
+	return (0);
 } /* int plugin_register_data_set */
 
 int plugin_register_log (const char *name,
 		plugin_log_cb callback, user_data_t *ud)
 {
+	if (plugin_check_reloading ("log callback", name) != 0)
+		return (EPERM);
+
 	return (create_register_callback (&list_log, name,
 				(void *) callback, ud));
 } /* int plugin_register_log */
@@ -1182,6 +2207,9 @@ int plugin_register_log (const char *name,
 int plugin_register_notification (const char *name,
 		plugin_notification_cb callback, user_data_t *ud)
 {
+	if (plugin_check_reloading ("notification callback", name) != 0)
+		return (EPERM);
+
 	return (create_register_callback (&list_notification, name,
 				(void *) callback, ud));
 } /* int plugin_register_log */
@@ -1232,7 +2260,9 @@ int plugin_unregister_read (const char *name) /* {{{ */
 
 	rf = le->value;
 	assert (rf != NULL);
+	pthread_mutex_lock (&rf->rf_pool->lock);
 	rf->rf_type = RF_REMOVE;
+	pthread_mutex_unlock (&rf->rf_pool->lock);
 
 	pthread_mutex_unlock (&read_lock);
 
@@ -1283,7 +2313,9 @@ int plugin_unregister_read_group (const char *group) /* {{{ */
 
 		rf = le->value;
 		assert (rf != NULL);
+		pthread_mutex_lock (&rf->rf_pool->lock);
 		rf->rf_type = RF_REMOVE;
+		pthread_mutex_unlock (&rf->rf_pool->lock);
 
 		llentry_destroy (le);
 
@@ -1326,16 +2358,22 @@ int plugin_unregister_shutdown (const char *name)
 
 int plugin_unregister_data_set (const char *name)
 {
-	data_set_t *ds;
+	data_set_entry_t *entry;
 
 	if (data_sets == NULL)
 		return (-1);
 
-	if (c_avl_remove (data_sets, name, NULL, (void *) &ds) != 0)
+	if (plugin_check_reloading ("data set", name) != 0)
+		return (EPERM);
+
+	if (c_avl_remove (data_sets, name, NULL, (void *) &entry) != 0)
 		return (-1);
 
-	sfree (ds->ds);
-	sfree (ds);
+	/* The ID is not reused for other data sets. */
+	data_set_list[entry->id] = NULL;
+
+	sfree (entry->ds.ds);
+	sfree (entry);
 
 	return (0);
 } /* int plugin_unregister_data_set */
@@ -1359,12 +2397,30 @@ void plugin_init_all (void)
 	/* Init the value cache */
 	uc_init ();
 
+	/* Restore the value cache of the previous run, so that rates continue
+	 * without a gap. */
+	cache_file = global_option_get ("CacheFile");
+	if (cache_file != NULL)
+	{
+		uc_load (cache_file);
+
+		cache_save_interval = DOUBLE_TO_CDTIME_T (atof (
+					global_option_get ("CacheSaveInterval")));
+		cache_save_next = cdtime () + cache_save_interval;
+	}
+
+	/* Compile the filter chains now that all of them are known. */
+	fc_init ();
+
 	chain_name = global_option_get ("PreCacheChain");
 	pre_cache_chain = fc_chain_get_by_name (chain_name);
 
 	chain_name = global_option_get ("PostCacheChain");
 	post_cache_chain = fc_chain_get_by_name (chain_name);
 
+	/* Registers the read callback of the statistics if enabled. */
+	profile_set_enabled (IS_TRUE (global_option_get ("Profiling")));
+
 	{
 		char const *tmp = global_option_get ("WriteThreads");
 		int num = atoi (tmp);
@@ -1375,7 +2431,7 @@ void plugin_init_all (void)
 		start_write_threads ((size_t) num);
 	}
 
-	if ((list_init == NULL) && (read_heap == NULL))
+	if ((list_init == NULL) && (read_list == NULL))
 		return;
 
 	/* Calling all init callbacks before checking if read callbacks
@@ -1411,14 +2467,38 @@ void plugin_init_all (void)
 	}
 
 	/* Start read-threads */
-	if (read_heap != NULL)
+	if (read_list != NULL)
 	{
 		const char *rt;
 		int num;
+		int max_num;
+
+		rt = global_option_get ("ReadTimeout");
+		if (rt != NULL)
+			read_timeout_default = DOUBLE_TO_CDTIME_T (atof (rt));
+
+		rt = global_option_get ("ReadSchedule");
+		if (strcasecmp ("Spread", rt) == 0)
+			read_schedule = READ_SCHEDULE_SPREAD;
+		else if (strcasecmp ("Align", rt) == 0)
+			read_schedule = READ_SCHEDULE_ALIGN;
+		else if (strcasecmp ("Immediate", rt) == 0)
+			read_schedule = READ_SCHEDULE_IMMEDIATE;
+		else
+			WARNING ("plugin_init_all: Unknown ReadSchedule \"%s\". "
+					"Valid values are \"Immediate\", "
+					"\"Spread\" and \"Align\".", rt);
+
 		rt = global_option_get ("ReadThreads");
 		num = atoi (rt);
-		if (num != -1)
-			start_read_threads ((num > 0) ? num : 5);
+		if (num <= 0)
+			num = 5;
+
+		rt = global_option_get ("MaxReadThreads");
+		max_num = (rt != NULL) ? atoi (rt) : (2 * num);
+
+		if (atoi (global_option_get ("ReadThreads")) != -1)
+			start_read_threads (num, max_num);
 	}
 } /* void plugin_init_all */
 
@@ -1427,6 +2507,13 @@ void plugin_read_all (void)
 {
 	uc_check_timeout ();
 
+	if ((cache_file != NULL) && (cache_save_interval > 0)
+			&& (cdtime () >= cache_save_next))
+	{
+		uc_save (cache_file);
+		cache_save_next = cdtime () + cache_save_interval;
+	}
+
 	return;
 } /* void plugin_read_all */
 
@@ -1435,21 +2522,25 @@ int plugin_read_all_once (void)
 {
 	int status;
 	int return_status = 0;
+	size_t i = 0;
 
-	if (read_heap == NULL)
+	if (read_list == NULL)
 	{
 		NOTICE ("No read-functions are registered.");
 		return (0);
 	}
 
-	while (42)
+	while (i < read_pools_num)
 	{
 		read_func_t *rf;
 		plugin_ctx_t old_ctx;
 
-		rf = c_heap_get_root (read_heap);
+		rf = c_heap_get_root (read_pools[i]->heap);
 		if (rf == NULL)
-			break;
+		{
+			i++;
+			continue;
+		}
 
 		old_ctx = plugin_set_ctx (rf->rf_ctx);
 
@@ -1477,7 +2568,7 @@ int plugin_read_all_once (void)
 			return_status = -1;
 		}
 
-		destroy_callback ((void *) rf);
+		destroy_read_func (rf);
 	}
 
 	return (return_status);
@@ -1487,6 +2578,8 @@ int plugin_write (const char *plugin, /* {{{ */
 		const data_set_t *ds, const value_list_t *vl)
 {
   llentry_t *le;
+  _Bool profiling = profile_is_enabled ();
+  cdtime_t profile_start = 0;
   int status;
 
   if (vl == NULL)
@@ -1497,7 +2590,7 @@ int plugin_write (const char *plugin, /* {{{ */
 
   if (ds == NULL)
   {
-    ds = plugin_get_ds (vl->type);
+    ds = plugin_get_ds_vl (vl);
     if (ds == NULL)
     {
       ERROR ("plugin_write: Unable to lookup type `%s'.", vl->type);
@@ -1521,7 +2614,12 @@ int plugin_write (const char *plugin, /* {{{ */
 
       DEBUG ("plugin: plugin_write: Writing values via %s.", le->key);
       callback = cf->cf_callback;
+      if (profiling)
+        profile_start = profile_clock ();
       status = (*callback) (ds, vl, &cf->cf_udata);
+      if (profiling)
+        profile_record (PROFILE_WRITE, le->key,
+            profile_clock () - profile_start, (uint64_t) vl->values_len);
       if (status != 0)
         failure++;
       else
@@ -1559,7 +2657,12 @@ int plugin_write (const char *plugin, /* {{{ */
 
     DEBUG ("plugin: plugin_write: Writing values via %s.", le->key);
     callback = cf->cf_callback;
+    if (profiling)
+      profile_start = profile_clock ();
     status = (*callback) (ds, vl, &cf->cf_udata);
+    if (profiling)
+      profile_record (PROFILE_WRITE, le->key,
+          profile_clock () - profile_start, (uint64_t) vl->values_len);
   }
 
   return (status);
@@ -1612,7 +2715,7 @@ void plugin_shutdown_all (void)
 	read_list = NULL;
 	pthread_mutex_unlock (&read_lock);
 
-	destroy_read_heap ();
+	destroy_read_pools ();
 
 	plugin_flush (/* plugin = */ NULL,
 			/* timeout = */ 0,
@@ -1643,6 +2746,13 @@ void plugin_shutdown_all (void)
 		plugin_set_ctx (old_ctx);
 	}
 
+	/* All plugins dispatching values have been shut down, so the cache
+	 * won't change anymore. */
+	if (cache_file != NULL)
+		uc_save (cache_file);
+
+	procfs_snapshot_shutdown ();
+
 	stop_write_threads ();
 
 	/* Write plugins which use the `user_data' pointer usually need the
@@ -1659,6 +2769,280 @@ void plugin_shutdown_all (void)
 	destroy_all_callbacks (&list_log);
 } /* void plugin_shutdown_all */
 
+/* Returns true if one of the read threads is running a read function of
+ * `lp'. */
+static _Bool plugin_read_busy (loaded_plugin_t const *lp) /* {{{ */
+{
+	_Bool busy = 0;
+	size_t i;
+	int j;
+
+	pthread_mutex_lock (&read_lock);
+	for (i = 0; (i < read_pools_num) && !busy; i++)
+	{
+		read_pool_t *pool = read_pools[i];
+
+		pthread_mutex_lock (&pool->lock);
+		for (j = 0; (j < pool->threads_max) && !busy; j++)
+		{
+			read_thread_t *rt = pool->threads + j;
+
+			if (rt->active && (rt->rf != NULL)
+					&& plugin_callback_owned (&rt->rf->rf_super, lp))
+				busy = 1;
+		}
+		pthread_mutex_unlock (&pool->lock);
+	}
+	pthread_mutex_unlock (&read_lock);
+
+	return (busy);
+} /* }}} _Bool plugin_read_busy */
+
+/* Removes the read functions of `lp'. The read threads free the
+ * `read_func_t's when they take them from the heap, but the user data is
+ * freed here, before the plugin's code is unloaded. */
+static void plugin_unload_read (loaded_plugin_t const *lp) /* {{{ */
+{
+	user_data_t *udata = NULL;
+	size_t udata_num = 0;
+	llentry_t *le;
+	size_t i;
+
+	pthread_mutex_lock (&read_lock);
+	le = (read_list != NULL) ? llist_head (read_list) : NULL;
+	while (le != NULL)
+	{
+		read_func_t *rf = le->value;
+		llentry_t *le_next = le->next;
+		user_data_t *tmp;
+
+		if (!plugin_callback_owned (&rf->rf_super, lp))
+		{
+			le = le_next;
+			continue;
+		}
+
+		tmp = realloc (udata, (udata_num + 1) * sizeof (*udata));
+		if (tmp == NULL)
+		{
+			ERROR ("plugin_unload: realloc failed.");
+			break;
+		}
+		udata = tmp;
+
+		llist_remove (read_list, le);
+		llentry_destroy (le);
+
+		pthread_mutex_lock (&rf->rf_pool->lock);
+		rf->rf_type = RF_REMOVE;
+		udata[udata_num] = rf->rf_udata;
+		rf->rf_udata.data = NULL;
+		rf->rf_udata.free_func = NULL;
+		pthread_mutex_unlock (&rf->rf_pool->lock);
+		udata_num++;
+
+		le = le_next;
+	}
+	pthread_mutex_unlock (&read_lock);
+
+	/* Read functions which were already running when they were marked
+	 * for removal may still use the user data. */
+	while (plugin_read_busy (lp))
+		usleep (10000);
+
+	for (i = 0; i < udata_num; i++)
+		if ((udata[i].data != NULL) && (udata[i].free_func != NULL))
+			udata[i].free_func (udata[i].data);
+	sfree (udata);
+} /* }}} void plugin_unload_read */
+
+/* Removes the callbacks of `lp' from `list'. */
+static void plugin_unload_list (llist_t *list, /* {{{ */
+		loaded_plugin_t const *lp)
+{
+	llentry_t *le;
+
+	if (list == NULL)
+		return;
+
+	le = llist_head (list);
+	while (le != NULL)
+	{
+		llentry_t *le_next = le->next;
+
+		if (plugin_callback_owned (le->value, lp))
+		{
+			llist_remove (list, le);
+			sfree (le->key);
+			destroy_callback (le->value);
+			llentry_destroy (le);
+		}
+
+		le = le_next;
+	}
+} /* }}} void plugin_unload_list */
+
+/* How long plugin_unload() waits for the threads of a plugin to exit. */
+#define PLUGIN_UNLOAD_TIMEOUT TIME_T_TO_CDTIME_T (10)
+
+int plugin_unload (const char *name) /* {{{ */
+{
+	loaded_plugin_t *lp;
+	llentry_t *le;
+	cdtime_t deadline;
+	int threads;
+
+	lp = plugin_loaded_get (name, /* create = */ 0);
+	if ((lp == NULL) || (lp->dlh == NULL))
+		return (ENOENT);
+
+	if (!plugin_unloadable (lp))
+		return (EPERM);
+
+	plugin_unload_read (lp);
+
+	le = (list_shutdown != NULL) ? llist_head (list_shutdown) : NULL;
+	while (le != NULL)
+	{
+		callback_func_t *cf = le->value;
+		plugin_shutdown_cb callback;
+		plugin_ctx_t old_ctx;
+
+		le = le->next;
+		if (!plugin_callback_owned (cf, lp))
+			continue;
+
+		old_ctx = plugin_set_ctx (cf->cf_ctx);
+		callback = cf->cf_callback;
+		(*callback) ();
+		plugin_set_ctx (old_ctx);
+	}
+
+	plugin_unload_list (list_shutdown, lp);
+	plugin_unload_list (list_init, lp);
+	cf_unregister_plugin (lp->name);
+
+	deadline = cdtime () + PLUGIN_UNLOAD_TIMEOUT;
+	while (42)
+	{
+		pthread_mutex_lock (&plugins_lock);
+		threads = lp->threads;
+		pthread_mutex_unlock (&plugins_lock);
+
+		if ((threads == 0) || (cdtime () >= deadline))
+			break;
+		usleep (10000);
+	}
+
+	if (threads != 0)
+	{
+		ERROR ("plugin_unload: %i thread%s of the \"%s\" plugin didn't "
+				"exit. The plugin can't be unloaded until collectd "
+				"is restarted.", threads, (threads == 1) ? "" : "s",
+				lp->name);
+		lp->defunct = 1;
+		return (EBUSY);
+	}
+
+	lt_dlclose (lp->dlh);
+	lp->dlh = NULL;
+
+	INFO ("plugin_unload: The \"%s\" plugin has been unloaded.", lp->name);
+	return (0);
+} /* }}} int plugin_unload */
+
+int plugin_init_plugin (const char *name) /* {{{ */
+{
+	loaded_plugin_t *lp;
+	llentry_t *le;
+	int ret = 0;
+
+	lp = plugin_loaded_get (name, /* create = */ 0);
+	if ((lp == NULL) || (lp->dlh == NULL))
+		return (ENOENT);
+
+	le = (list_init != NULL) ? llist_head (list_init) : NULL;
+	while (le != NULL)
+	{
+		callback_func_t *cf = le->value;
+		plugin_init_cb callback;
+		plugin_ctx_t old_ctx;
+		int status;
+
+		if (!plugin_callback_owned (cf, lp))
+		{
+			le = le->next;
+			continue;
+		}
+
+		old_ctx = plugin_set_ctx (cf->cf_ctx);
+		callback = cf->cf_callback;
+		status = (*callback) ();
+		plugin_set_ctx (old_ctx);
+
+		if (status != 0)
+		{
+			ERROR ("Initialization of plugin `%s' "
+					"failed with status %i. "
+					"Plugin will be unloaded.",
+					le->key, status);
+			plugin_unregister_read (le->key);
+			ret = -1;
+		}
+
+		le = le->next;
+	}
+
+	return (ret);
+} /* }}} int plugin_init_plugin */
+
+void plugin_reload_begin (void) /* {{{ */
+{
+	plugin_reloading = 1;
+} /* }}} void plugin_reload_begin */
+
+void plugin_reload_end (void) /* {{{ */
+{
+	plugin_reloading = 0;
+} /* }}} void plugin_reload_end */
+
+_Bool plugin_reload_refused (const char *name) /* {{{ */
+{
+	loaded_plugin_t *lp;
+
+	lp = plugin_loaded_get (name, /* create = */ 0);
+	if (lp == NULL)
+		return (0);
+
+	return (lp->refused);
+} /* }}} _Bool plugin_reload_refused */
+
+void plugin_reload_chains (void) /* {{{ */
+{
+	fc_chain_t *pre;
+	fc_chain_t *post;
+	int slot;
+
+	fc_init ();
+
+	pre = fc_chain_get_by_name (global_option_get ("PreCacheChain"));
+	post = fc_chain_get_by_name (global_option_get ("PostCacheChain"));
+
+	pthread_mutex_lock (&write_lock);
+
+	pre_cache_chain = pre;
+	post_cache_chain = post;
+
+	/* Value lists dequeued from now on are dispatched with the new
+	 * chains. Wait for those still using the previous ones. */
+	slot = write_chains_generation % 2;
+	write_chains_generation++;
+	while (write_chains_busy[slot] > 0)
+		pthread_cond_wait (&write_chains_cond, &write_lock);
+
+	pthread_mutex_unlock (&write_lock);
+} /* }}} void plugin_reload_chains */
+
 int plugin_dispatch_missing (const value_list_t *vl) /* {{{ */
 {
   llentry_t *le;
@@ -1705,10 +3089,7 @@ static int plugin_dispatch_values_internal (value_list_t *vl)
 	int status;
 	static c_complain_t no_write_complaint = C_COMPLAIN_INIT_STATIC;
 
-	value_t *saved_values;
-	int      saved_values_len;
-
-	data_set_t *ds;
+	const data_set_t *ds;
 
 	int free_meta_data = 0;
 
@@ -1740,7 +3121,8 @@ static int plugin_dispatch_values_internal (value_list_t *vl)
 		return (-1);
 	}
 
-	if (c_avl_get (data_sets, vl->type, (void *) &ds) != 0)
+	ds = plugin_get_ds_vl (vl);
+	if (ds == NULL)
 	{
 		char ident[6 * DATA_MAX_NAME_LEN];
 
@@ -1793,30 +3175,11 @@ static int plugin_dispatch_values_internal (value_list_t *vl)
 	escape_slashes (vl->type, sizeof (vl->type));
 	escape_slashes (vl->type_instance, sizeof (vl->type_instance));
 
-	/* Copy the values. This way, we can assure `targets' that they get
-	 * dynamically allocated values, which they can free and replace if
-	 * they like. */
-	if ((pre_cache_chain != NULL) || (post_cache_chain != NULL))
-	{
-		saved_values     = vl->values;
-		saved_values_len = vl->values_len;
-
-		vl->values = (value_t *) calloc (vl->values_len,
-				sizeof (*vl->values));
-		if (vl->values == NULL)
-		{
-			ERROR ("plugin_dispatch_values: calloc failed.");
-			vl->values = saved_values;
-			return (-1);
-		}
-		memcpy (vl->values, saved_values,
-				vl->values_len * sizeof (*vl->values));
-	}
-	else /* if ((pre == NULL) && (post == NULL)) */
-	{
-		saved_values     = NULL;
-		saved_values_len = 0;
-	}
+	/* The value list has been copied by plugin_value_list_clone() when it
+	 * was enqueued, so its values are dynamically allocated and owned by
+	 * the write thread. Targets may therefore modify, free and replace them
+	 * without a further copy; plugin_value_list_free() frees whatever
+	 * `vl->values' points to afterwards. */
 
 	if (pre_cache_chain != NULL)
 	{
@@ -1829,17 +3192,7 @@ static int plugin_dispatch_values_internal (value_list_t *vl)
 					status, status);
 		}
 		else if (status == FC_TARGET_STOP)
-		{
-			/* Restore the state of the value_list so that plugins
-			 * don't get confused.. */
-			if (saved_values != NULL)
-			{
-				free (vl->values);
-				vl->values     = saved_values;
-				vl->values_len = saved_values_len;
-			}
 			return (0);
-		}
 	}
 
 	/* Update the value cache */
@@ -1859,15 +3212,6 @@ static int plugin_dispatch_values_internal (value_list_t *vl)
 	else
 		fc_default_action (ds, vl);
 
-	/* Restore the state of the value_list so that plugins don't get
-	 * confused.. */
-	if (saved_values != NULL)
-	{
-		free (vl->values);
-		vl->values     = saved_values;
-		vl->values_len = saved_values_len;
-	}
-
 	if ((free_meta_data != 0) && (vl->meta != NULL))
 	{
 		meta_data_destroy (vl->meta);
@@ -1891,6 +3235,12 @@ int plugin_dispatch_values (value_list_t const *vl)
 		return (status);
 	}
 
+	if (profile_is_enabled ())
+		profile_record (PROFILE_DISPATCH, vl->plugin, /* duration = */ 0,
+				(uint64_t) vl->values_len);
+
+	plugin_read_record (vl);
+
 	return (0);
 }
 
@@ -2025,6 +3375,42 @@ const data_set_t *plugin_get_ds (const char *name)
 	return (ds);
 } /* data_set_t *plugin_get_ds */
 
+int plugin_get_type_id (const char *type) /* {{{ */
+{
+	data_set_entry_t *entry;
+
+	if ((data_sets == NULL) || (type == NULL)
+			|| (c_avl_get (data_sets, type, (void *) &entry) != 0))
+		return (0);
+
+	return (entry->id);
+} /* }}} int plugin_get_type_id */
+
+const data_set_t *plugin_get_ds_by_id (int type_id) /* {{{ */
+{
+	if ((type_id <= 0) || (((size_t) type_id) >= data_set_list_num)
+			|| (data_set_list[type_id] == NULL))
+		return (NULL);
+
+	return (&data_set_list[type_id]->ds);
+} /* }}} const data_set_t *plugin_get_ds_by_id */
+
+/* Returns the data set of `vl'. Uses the ID of its type if it is set and
+ * matches the type's name, so that value lists which are reused for several
+ * types are handled correctly. */
+static const data_set_t *plugin_get_ds_vl (value_list_t const *vl) /* {{{ */
+{
+	data_set_t const *ds = plugin_get_ds_by_id (vl->type_id);
+
+	if ((ds != NULL) && (strcmp (ds->type, vl->type) == 0))
+		return (ds);
+
+	if (data_sets == NULL)
+		return (NULL);
+
+	return (plugin_get_ds (vl->type));
+} /* }}} const data_set_t *plugin_get_ds_vl */
+
 static int plugin_notification_meta_add (notification_t *n,
     const char *name,
     enum notification_meta_type_e type,
@@ -2230,6 +3616,8 @@ void plugin_init_ctx (void)
 {
 	pthread_key_create (&plugin_ctx_key, plugin_ctx_destructor);
 	plugin_ctx_key_initialized = 1;
+
+	pthread_key_create (&read_func_key, /* destructor = */ NULL);
 } /* void plugin_init_ctx */
 
 plugin_ctx_t plugin_get_ctx (void)
@@ -2283,39 +3671,94 @@ cdtime_t plugin_get_interval (void)
 
 typedef struct {
 	plugin_ctx_t ctx;
+	loaded_plugin_t *plugin;
 	void *(*start_routine) (void *);
 	void *arg;
 } plugin_thread_t;
 
+/* Returns the entry of the plugin loaded in `ctx', if any. */
+static loaded_plugin_t *plugin_loaded_by_ctx (plugin_ctx_t ctx) /* {{{ */
+{
+	loaded_plugin_t *lp;
+
+	if (ctx.name == NULL)
+		return (NULL);
+
+	pthread_mutex_lock (&plugins_lock);
+	for (lp = plugins_loaded; lp != NULL; lp = lp->next)
+		if (lp->name == ctx.name)
+			break;
+	pthread_mutex_unlock (&plugins_lock);
+
+	return (lp);
+} /* }}} loaded_plugin_t *plugin_loaded_by_ctx */
+
+static void plugin_thread_exit (void *arg)
+{
+	loaded_plugin_t *lp = arg;
+
+	if (lp == NULL)
+		return;
+
+	pthread_mutex_lock (&plugins_lock);
+	lp->threads--;
+	pthread_mutex_unlock (&plugins_lock);
+} /* void plugin_thread_exit */
+
 static void *plugin_thread_start (void *arg)
 {
 	plugin_thread_t *plugin_thread = arg;
 
 	void *(*start_routine) (void *) = plugin_thread->start_routine;
 	void *plugin_arg = plugin_thread->arg;
+	loaded_plugin_t *lp = plugin_thread->plugin;
+	void *ret;
 
 	plugin_set_ctx (plugin_thread->ctx);
 
 	free (plugin_thread);
 
-	return start_routine (plugin_arg);
+	/* Also called when the thread is cancelled or calls pthread_exit(). */
+	pthread_cleanup_push (plugin_thread_exit, lp);
+	ret = start_routine (plugin_arg);
+	pthread_cleanup_pop (1);
+
+	return (ret);
 } /* void *plugin_thread_start */
 
 int plugin_thread_create (pthread_t *thread, const pthread_attr_t *attr,
 		void *(*start_routine) (void *), void *arg)
 {
 	plugin_thread_t *plugin_thread;
+	int status;
 
 	plugin_thread = malloc (sizeof (*plugin_thread));
 	if (plugin_thread == NULL)
 		return -1;
 
 	plugin_thread->ctx           = plugin_get_ctx ();
+	plugin_thread->plugin        = plugin_loaded_by_ctx (plugin_thread->ctx);
 	plugin_thread->start_routine = start_routine;
 	plugin_thread->arg           = arg;
 
-	return pthread_create (thread, attr,
+	/* Counted before the thread starts, so that plugin_unload() doesn't
+	 * miss it. */
+	if (plugin_thread->plugin != NULL)
+	{
+		pthread_mutex_lock (&plugins_lock);
+		plugin_thread->plugin->threads++;
+		pthread_mutex_unlock (&plugins_lock);
+	}
+
+	status = pthread_create (thread, attr,
 			plugin_thread_start, plugin_thread);
+	if (status != 0)
+	{
+		plugin_thread_exit (plugin_thread->plugin);
+		free (plugin_thread);
+	}
+
+	return (status);
 } /* int plugin_thread_create */
 
 /* vim: set sw=8 ts=8 noet fdm=marker : */
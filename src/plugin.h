@@ -96,12 +96,15 @@ struct value_list_s
 	char     type[DATA_MAX_NAME_LEN];
 	char     type_instance[DATA_MAX_NAME_LEN];
 	meta_data_t *meta;
+	/* Optional ID of `type', see plugin_get_type_id(). Zero means unknown.
+	 * An ID that doesn't match `type' is ignored. */
+	int      type_id;
 };
 typedef struct value_list_s value_list_t;
 
 #define VALUE_LIST_INIT { NULL, 0, 0, plugin_get_interval (), \
-	"localhost", "", "", "", "", NULL }
-#define VALUE_LIST_STATIC { NULL, 0, 0, 0, "localhost", "", "", "", "", NULL }
+	"localhost", "", "", "", "", NULL, 0 }
+#define VALUE_LIST_STATIC { NULL, 0, 0, 0, "localhost", "", "", "", "", NULL, 0 }
 
 struct data_source_s
 {
@@ -167,6 +170,15 @@ typedef struct user_data_s user_data_t;
 struct plugin_ctx_s
 {
 	cdtime_t interval;
+	cdtime_t read_timeout;
+	int read_pool;
+	/* If non-zero, the interval of read functions adapts to the values
+	 * they dispatch, between `min_interval' and `interval'. The interval
+	 * of the dispatched values stays `interval'. */
+	cdtime_t min_interval;
+	double change_threshold;
+	/* Name of the plugin loaded in this context, NULL for the daemon. */
+	const char *name;
 };
 typedef struct plugin_ctx_s plugin_ctx_t;
 
@@ -227,11 +239,70 @@ void plugin_set_dir (const char *dir);
  */
 int plugin_load (const char *name, uint32_t flags);
 
+/*
+ * NAME
+ *  plugin_unload
+ *
+ * DESCRIPTION
+ *  Calls the shutdown callbacks of the plugin `name', removes all its
+ *  callbacks and unloads it, so that it can be loaded again with a new
+ *  configuration. Only plugins which register nothing but config, init, read
+ *  and shutdown callbacks can be unloaded, because callbacks used by other
+ *  parts of the daemon, e.g. write callbacks, can't be removed safely.
+ *
+ * RETURN VALUE
+ *  Zero upon success, ENOENT if the plugin isn't loaded, EPERM if it can't be
+ *  unloaded and EBUSY if threads of the plugin didn't exit.
+ */
+int plugin_unload (const char *name);
+
+/* Calls the init callbacks registered by the plugin `name'. Used to start
+ * plugins loaded after plugin_init_all(). */
+int plugin_init_plugin (const char *name);
+
+/* Looks up the pre-cache and post-cache chains again after the filter chains
+ * have been reconfigured and waits until no write thread uses the previous
+ * chains anymore. */
+void plugin_reload_chains (void);
+
+/*
+ * Write, flush, missing, log and notification callbacks and data sets are used
+ * by other threads without holding a lock. Between plugin_reload_begin() and
+ * plugin_reload_end(), while these threads are running, they can't be
+ * registered: the registration fails with EPERM. plugin_reload_refused()
+ * returns true if the plugin `name' has tried to register one of them since it
+ * was loaded, in which case it should be unloaded again.
+ */
+void plugin_reload_begin (void);
+void plugin_reload_end (void);
+_Bool plugin_reload_refused (const char *name);
+
 void plugin_init_all (void);
 void plugin_read_all (void);
 int plugin_read_all_once (void);
 void plugin_shutdown_all (void);
 
+/*
+ * NAME
+ *  plugin_read_pool_get
+ *
+ * DESCRIPTION
+ *  Returns the index of the read thread pool `name', which can be used as the
+ *  `read_pool' member of the plugin context. The pool is created if it does
+ *  not exist. Read functions registered in a context without a pool are run
+ *  by the "default" pool.
+ *
+ * RETURN VALUE
+ *  The index of the pool or a negative errno value on failure.
+ */
+int plugin_read_pool_get (const char *name);
+
+/* Sets the number of threads of the read thread pool `name'. Zero selects the
+ * default sizes given by `ReadThreads' and `MaxReadThreads'. May only be
+ * called before the read threads have been started. */
+int plugin_read_pool_configure (const char *name,
+		int threads, int max_threads);
+
 /*
  * NAME
  *  plugin_write
@@ -350,6 +421,18 @@ int parse_notif_severity (const char *severity);
 
 const data_set_t *plugin_get_ds (const char *name);
 
+/*
+ * Data sets are interned when they are registered. Their IDs can be used
+ * instead of the type name to look them up without any string comparisons.
+ * Plugins dispatching many values should resolve the ID of their types once
+ * during initialization and set `type_id' in addition to `type' in their
+ * value lists. plugin_get_type_id() returns the ID of `type' or zero if no
+ * such data set has been registered. IDs stay valid when a data set is
+ * replaced.
+ */
+int plugin_get_type_id (const char *type);
+const data_set_t *plugin_get_ds_by_id (int type_id);
+
 int plugin_notification_meta_add_string (notification_t *n,
     const char *name,
     const char *value);
@@ -38,6 +38,7 @@
 #include "common.h"
 #include "plugin.h"
 #include "configfile.h"
+#include "utils_procfs.h"
 
 /* Include header files for the mach system, if they exist.. */
 #if HAVE_THREAD_INFO
@@ -738,7 +739,8 @@ static void ps_submit_proc_list (procstat_t *ps)
 } /* void ps_submit_proc_list */
 
 #if KERNEL_LINUX || KERNEL_SOLARIS
-static void ps_submit_fork_rate (derive_t value)
+/* If `value_time' is zero, the current time is used. */
+static void ps_submit_fork_rate (derive_t value, cdtime_t value_time)
 {
 	value_t values[1];
 	value_list_t vl = VALUE_LIST_INIT;
@@ -747,6 +749,7 @@ static void ps_submit_fork_rate (derive_t value)
 
 	vl.values = values;
 	vl.values_len = 1;
+	vl.time = value_time;
 	sstrncpy(vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy(vl.plugin, "processes", sizeof (vl.plugin));
 	sstrncpy(vl.plugin_instance, "", sizeof (vl.plugin_instance));
@@ -1150,21 +1153,25 @@ static char *ps_get_cmdline (pid_t pid, char *name, char *buf, size_t buf_len)
 
 static int read_fork_rate ()
 {
-	FILE *proc_stat;
-	char buffer[1024];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
+	cdtime_t value_time = 0;
 	value_t value;
 	_Bool value_valid = 0;
 
-	proc_stat = fopen ("/proc/stat", "r");
-	if (proc_stat == NULL)
+	/* /proc/stat is shared with the cpu and contextswitch plugins. */
+	snapshot = procfs_snapshot ("/proc/stat", NULL, &value_time);
+	if (snapshot == NULL)
 	{
 		char errbuf[1024];
-		ERROR ("processes plugin: fopen (/proc/stat) failed: %s",
+		ERROR ("processes plugin: Reading /proc/stat failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, sizeof (buffer), proc_stat) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		int status;
 		char *fields[3];
@@ -1184,12 +1191,12 @@ static int read_fork_rate ()
 
 		break;
 	}
-	fclose(proc_stat);
+	sfree (snapshot);
 
 	if (!value_valid)
 		return (-1);
 
-	ps_submit_fork_rate (value.derive);
+	ps_submit_fork_rate (value.derive, value_time);
 	return (0);
 }
 #endif /*KERNEL_LINUX */
@@ -1364,7 +1371,7 @@ static int read_fork_rate()
 		}
 	}
 
-	ps_submit_fork_rate (result);
+	ps_submit_fork_rate (result, /* value_time = */ 0);
 	return (0);
 }
 #endif /* KERNEL_SOLARIS */
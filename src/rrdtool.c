@@ -722,7 +722,10 @@ static int rrd_cache_insert (const char *filename,
 		new_rc = 1;
 	}
 
-	if (rc->last_value >= value_time)
+	/* Values are written with a resolution of one second, so with
+	 * sub-second intervals only the first value of each second is kept. */
+	if (CDTIME_T_TO_TIME_T (rc->last_value)
+			>= CDTIME_T_TO_TIME_T (value_time))
 	{
 		pthread_mutex_unlock (&cache_lock);
 		DEBUG ("rrdtool plugin: (rc->last_value = %"PRIu64") "
@@ -37,6 +37,7 @@
 #include "collectd.h"
 #include "common.h"
 #include "plugin.h"
+#include "utils_procfs.h"
 
 #if HAVE_SYS_SWAP_H
 # include <sys/swap.h>
@@ -191,9 +192,10 @@ static int swap_init (void) /* {{{ */
 	return (0);
 } /* }}} int swap_init */
 
+/* If `value_time' is zero, the current time is used. */
 static void swap_submit (const char *plugin_instance, /* {{{ */
 		const char *type, const char *type_instance,
-		value_t value)
+		value_t value, cdtime_t value_time)
 {
 	value_list_t vl = VALUE_LIST_INIT;
 
@@ -201,6 +203,7 @@ static void swap_submit (const char *plugin_instance, /* {{{ */
 
 	vl.values = &value;
 	vl.values_len = 1;
+	vl.time = value_time;
 	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
 	sstrncpy (vl.plugin, "swap", sizeof (vl.plugin));
 	if (plugin_instance != NULL)
@@ -213,41 +216,44 @@ static void swap_submit (const char *plugin_instance, /* {{{ */
 } /* }}} void swap_submit_inst */
 
 static void swap_submit_gauge (const char *plugin_instance, /* {{{ */
-		const char *type_instance, gauge_t value)
+		const char *type_instance, gauge_t value, cdtime_t value_time)
 {
 	value_t v;
 
 	v.gauge = value;
-	swap_submit (plugin_instance, "swap", type_instance, v);
+	swap_submit (plugin_instance, "swap", type_instance, v, value_time);
 } /* }}} void swap_submit_gauge */
 
 #if KERNEL_LINUX || HAVE_PERFSTAT
 static void swap_submit_derive (const char *plugin_instance, /* {{{ */
-		const char *type_instance, derive_t value)
+		const char *type_instance, derive_t value, cdtime_t value_time)
 {
 	value_t v;
 
 	v.derive = value;
-	swap_submit (plugin_instance, "swap_io", type_instance, v);
+	swap_submit (plugin_instance, "swap_io", type_instance, v, value_time);
 } /* }}} void swap_submit_derive */
 #endif
 
 #if KERNEL_LINUX
 static int swap_read_separate (void) /* {{{ */
 {
-	FILE *fh;
-	char buffer[1024];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
+	cdtime_t value_time = 0;
 
-	fh = fopen ("/proc/swaps", "r");
-	if (fh == NULL)
+	snapshot = procfs_snapshot ("/proc/swaps", NULL, &value_time);
+	if (snapshot == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("swap plugin: fopen (/proc/swaps) failed: %s",
+		WARNING ("swap plugin: Reading /proc/swaps failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		char *fields[8];
 		int numfields;
@@ -282,19 +288,20 @@ static int swap_read_separate (void) /* {{{ */
 
 		free = size - used;
 
-		swap_submit_gauge (path, "used", used);
-		swap_submit_gauge (path, "free", free);
+		swap_submit_gauge (path, "used", used, value_time);
+		swap_submit_gauge (path, "free", free, value_time);
 	}
 
-	fclose (fh);
+	sfree (snapshot);
 
 	return (0);
 } /* }}} int swap_read_separate */
 
 static int swap_read_combined (void) /* {{{ */
 {
-	FILE *fh;
-	char buffer[1024];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
 
 	uint8_t have_data = 0;
 	gauge_t swap_used   = 0.0;
@@ -302,16 +309,19 @@ static int swap_read_combined (void) /* {{{ */
 	gauge_t swap_free   = 0.0;
 	gauge_t swap_total  = 0.0;
 
-	fh = fopen ("/proc/meminfo", "r");
-	if (fh == NULL)
+	cdtime_t value_time = 0;
+
+	snapshot = procfs_snapshot ("/proc/meminfo", NULL, &value_time);
+	if (snapshot == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("swap plugin: fopen (/proc/meminfo) failed: %s",
+		WARNING ("swap plugin: Reading /proc/meminfo failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		char *fields[8];
 		int numfields;
@@ -337,7 +347,7 @@ static int swap_read_combined (void) /* {{{ */
 		}
 	}
 
-	fclose (fh);
+	sfree (snapshot);
 
 	if (have_data != 0x07)
 		return (ENOENT);
@@ -349,17 +359,18 @@ static int swap_read_combined (void) /* {{{ */
 
 	swap_used = swap_total - (swap_free + swap_cached);
 
-	swap_submit_gauge (NULL, "used",   1024.0 * swap_used);
-	swap_submit_gauge (NULL, "free",   1024.0 * swap_free);
-	swap_submit_gauge (NULL, "cached", 1024.0 * swap_cached);
+	swap_submit_gauge (NULL, "used",   1024.0 * swap_used, value_time);
+	swap_submit_gauge (NULL, "free",   1024.0 * swap_free, value_time);
+	swap_submit_gauge (NULL, "cached", 1024.0 * swap_cached, value_time);
 
 	return (0);
 } /* }}} int swap_read_combined */
 
 static int swap_read_io (void) /* {{{ */
 {
-	FILE *fh;
-	char buffer[1024];
+	char *snapshot;
+	char *cursor;
+	char *buffer;
 
 	_Bool old_kernel = 0;
 
@@ -367,15 +378,17 @@ static int swap_read_io (void) /* {{{ */
 	derive_t swap_in  = 0;
 	derive_t swap_out = 0;
 
-	fh = fopen ("/proc/vmstat", "r");
-	if (fh == NULL)
+	cdtime_t value_time = 0;
+
+	snapshot = procfs_snapshot ("/proc/vmstat", NULL, &value_time);
+	if (snapshot == NULL)
 	{
 		/* /proc/vmstat does not exist in kernels <2.6 */
-		fh = fopen ("/proc/stat", "r");
-		if (fh == NULL)
+		snapshot = procfs_snapshot ("/proc/stat", NULL, &value_time);
+		if (snapshot == NULL)
 		{
 			char errbuf[1024];
-			WARNING ("swap: fopen: %s",
+			WARNING ("swap plugin: Reading /proc/stat failed: %s",
 					sstrerror (errno, errbuf, sizeof (errbuf)));
 			return (-1);
 		}
@@ -383,7 +396,8 @@ static int swap_read_io (void) /* {{{ */
 			old_kernel = 1;
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	cursor = snapshot;
+	while ((buffer = procfs_next_line (&cursor)) != NULL)
 	{
 		char *fields[8];
 		int numfields;
@@ -417,9 +431,9 @@ static int swap_read_io (void) /* {{{ */
 				strtoderive (fields[2], &swap_out);
 			}
 		}
-	} /* while (fgets) */
+	} /* while (procfs_next_line) */
 
-	fclose (fh);
+	sfree (snapshot);
 
 	if (have_data != 0x03)
 		return (ENOENT);
@@ -430,8 +444,8 @@ static int swap_read_io (void) /* {{{ */
 		swap_out = swap_out * pagesize;
 	}
 
-	swap_submit_derive (NULL, "in",  swap_in);
-	swap_submit_derive (NULL, "out", swap_out);
+	swap_submit_derive (NULL, "in",  swap_in, value_time);
+	swap_submit_derive (NULL, "out", swap_out, value_time);
 
 	return (0);
 } /* }}} int swap_read_io */
@@ -502,9 +516,9 @@ static int swap_read_kstat (void) /* {{{ */
 			* pagesize);
 	swap_avail  = (derive_t) ((ai.ani_max - ai.ani_resv) * pagesize);
 
-	swap_submit_gauge (NULL, "used", swap_alloc);
-	swap_submit_gauge (NULL, "free", swap_avail);
-	swap_submit_gauge (NULL, "reserved", swap_resv);
+	swap_submit_gauge (NULL, "used", swap_alloc, 0);
+	swap_submit_gauge (NULL, "free", swap_avail, 0);
+	swap_submit_gauge (NULL, "reserved", swap_resv, 0);
 
 	return (0);
 } /* }}} int swap_read_kstat */
@@ -604,8 +618,8 @@ static int swap_read (void) /* {{{ */
 		sstrncpy (path, s->swt_ent[i].ste_path, sizeof (path));
 		escape_slashes (path, sizeof (path));
 
-		swap_submit_gauge (path, "used", (gauge_t) (this_total - this_avail));
-		swap_submit_gauge (path, "free", (gauge_t) this_avail);
+		swap_submit_gauge (path, "used", (gauge_t) (this_total - this_avail), 0);
+		swap_submit_gauge (path, "free", (gauge_t) this_avail, 0);
         } /* for (swap_num) */
 
         if (total < avail)
@@ -622,8 +636,8 @@ static int swap_read (void) /* {{{ */
 	 * values have already been dispatched from within the loop. */
 	if (!report_by_device)
 	{
-		swap_submit_gauge (NULL, "used", (gauge_t) (total - avail));
-		swap_submit_gauge (NULL, "free", (gauge_t) avail);
+		swap_submit_gauge (NULL, "used", (gauge_t) (total - avail), 0);
+		swap_submit_gauge (NULL, "free", (gauge_t) avail, 0);
 	}
 
 	sfree (s_paths);
@@ -694,8 +708,8 @@ static int swap_read (void) /* {{{ */
 		return (-1);
 	}
 
-	swap_submit_gauge (NULL, "used", (gauge_t) used);
-	swap_submit_gauge (NULL, "free", (gauge_t) (total - used));
+	swap_submit_gauge (NULL, "used", (gauge_t) used, 0);
+	swap_submit_gauge (NULL, "free", (gauge_t) (total - used), 0);
 
 	sfree (swap_entries);
 
@@ -721,8 +735,8 @@ static int swap_read (void) /* {{{ */
 		return (-1);
 
 	/* The returned values are bytes. */
-	swap_submit_gauge (NULL, "used", (gauge_t) sw_usage.xsu_used);
-	swap_submit_gauge (NULL, "free", (gauge_t) sw_usage.xsu_avail);
+	swap_submit_gauge (NULL, "used", (gauge_t) sw_usage.xsu_used, 0);
+	swap_submit_gauge (NULL, "free", (gauge_t) sw_usage.xsu_avail, 0);
 
 	return (0);
 } /* }}} int swap_read */
@@ -754,8 +768,8 @@ static int swap_read (void) /* {{{ */
 
 	free = total - used;
 
-	swap_submit_gauge (NULL, "used", (gauge_t) used);
-	swap_submit_gauge (NULL, "free", (gauge_t) free);
+	swap_submit_gauge (NULL, "used", (gauge_t) used, 0);
+	swap_submit_gauge (NULL, "free", (gauge_t) free, 0);
 
 	return (0);
 } /* }}} int swap_read */
@@ -771,8 +785,8 @@ static int swap_read (void) /* {{{ */
 	if (swap == NULL)
 		return (-1);
 
-	swap_submit_gauge (NULL, "used", (gauge_t) swap->used);
-	swap_submit_gauge (NULL, "free", (gauge_t) swap->free);
+	swap_submit_gauge (NULL, "used", (gauge_t) swap->used, 0);
+	swap_submit_gauge (NULL, "free", (gauge_t) swap->free, 0);
 
 	return (0);
 } /* }}} int swap_read */
@@ -789,11 +803,11 @@ static int swap_read (void) /* {{{ */
                 return (-1);
         }
 
-	swap_submit_gauge (NULL, "used", (gauge_t) (pmemory.pgsp_total - pmemory.pgsp_free) * pagesize);
-	swap_submit_gauge (NULL, "free", (gauge_t) pmemory.pgsp_free * pagesize );
-	swap_submit_gauge (NULL, "reserved", (gauge_t) pmemory.pgsp_rsvd * pagesize);
-	swap_submit_derive (NULL, "in",  (derive_t) pmemory.pgspins * pagesize);
-	swap_submit_derive (NULL, "out", (derive_t) pmemory.pgspouts * pagesize);
+	swap_submit_gauge (NULL, "used", (gauge_t) (pmemory.pgsp_total - pmemory.pgsp_free) * pagesize, 0);
+	swap_submit_gauge (NULL, "free", (gauge_t) pmemory.pgsp_free * pagesize, 0);
+	swap_submit_gauge (NULL, "reserved", (gauge_t) pmemory.pgsp_rsvd * pagesize, 0);
+	swap_submit_derive (NULL, "in",  (derive_t) pmemory.pgspins * pagesize, 0);
+	swap_submit_derive (NULL, "out", (derive_t) pmemory.pgspouts * pagesize, 0);
 
 	return (0);
 } /* }}} int swap_read */
@@ -23,6 +23,7 @@
 #include "common.h"
 #include "filter_chain.h"
 #include "utils_subst.h"
+#include "utils_regex_set.h"
 
 #include <regex.h>
 
@@ -31,6 +32,9 @@ typedef struct tr_action_s tr_action_t;
 struct tr_action_s
 {
   regex_t re;
+  /* Same expression as `re'. Most values don't match any action, so this
+   * faster matcher is tried before running regexec(3) to locate the match. */
+  regex_set_t *filter;
   char *replacement;
   int may_be_empty;
 
@@ -71,6 +75,7 @@ static void tr_action_destroy (tr_action_t *act) /* {{{ */
     return;
 
   regfree (&act->re);
+  regex_set_destroy (act->filter);
   sfree (act->replacement);
 
   if (act->next != NULL)
@@ -122,10 +127,23 @@ static int tr_config_add_action (tr_action_t **dest, /* {{{ */
     return (-EINVAL);
   }
 
+  act->filter = regex_set_create ();
+  if ((act->filter == NULL)
+      || (regex_set_add (act->filter, ci->values[0].value.string,
+          /* errbuf = */ NULL, /* errbuf_size = */ 0) < 0))
+  {
+    ERROR ("tr_config_add_action: Creating the regex set failed.");
+    regex_set_destroy (act->filter);
+    regfree (&act->re);
+    sfree (act);
+    return (-ENOMEM);
+  }
+
   act->replacement = tr_strdup (ci->values[1].value.string);
   if (act->replacement == NULL)
   {
     ERROR ("tr_config_add_action: tr_strdup failed.");
+    regex_set_destroy (act->filter);
     regfree (&act->re);
     sfree (act);
     return (-ENOMEM);
@@ -169,6 +187,9 @@ static int tr_action_invoke (tr_action_t *act_head, /* {{{ */
     char temp[DATA_MAX_NAME_LEN];
     char *subst_status;
 
+    if (!regex_set_match_any (act->filter, buffer))
+      continue;
+
     status = regexec (&act->re, buffer,
         STATIC_ARRAY_SIZE (matches), matches,
         /* flags = */ 0);
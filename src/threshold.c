@@ -57,12 +57,22 @@ typedef struct threshold_s
   int hits;
   struct threshold_s *next;
 } threshold_t;
+
+/* All thresholds configured for one type, i.e. the heads of the lists stored
+ * in `threshold_tree'. The thresholds are sorted by specificity, see
+ * threshold_rank(), so the first matching one is the one to use. */
+typedef struct threshold_type_s
+{
+  threshold_t **thresholds;
+  size_t thresholds_num;
+} threshold_type_t;
 /* }}} */
 
 /*
  * Private (static) variables
  * {{{ */
 static c_avl_tree_t   *threshold_tree = NULL;
+static c_avl_tree_t   *threshold_type_tree = NULL;
 static pthread_mutex_t threshold_lock = PTHREAD_MUTEX_INITIALIZER;
 /* }}} */
 
@@ -98,6 +108,98 @@ static threshold_t *threshold_get (const char *hostname,
     return (NULL);
 } /* }}} threshold_t *threshold_get */
 
+/*
+ * int threshold_rank
+ *
+ * Returns the position of the threshold in the order "threshold_search" has
+ * always used: A matching host is more important than a matching plugin,
+ * which is more important than a matching plugin instance, which in turn is
+ * more important than a matching type instance. Lower is more specific.
+ */
+static int threshold_rank (const threshold_t *th)
+{ /* {{{ */
+  int rank = 0;
+
+  if (th->host[0] == 0)
+    rank += 6;
+
+  if (th->plugin[0] == 0)
+    rank += 4;
+  else if (th->plugin_instance[0] == 0)
+    rank += 2;
+
+  if (th->type_instance[0] == 0)
+    rank += 1;
+
+  return (rank);
+} /* }}} int threshold_rank */
+
+/*
+ * threshold_type_t *threshold_index_reserve
+ *
+ * Returns the entry of `type' in `threshold_type_tree', creating it if
+ * necessary, with room for one more threshold. This is the part of adding
+ * to the index that may fail, so callers do it before changing anything
+ * else. The caller must hold `threshold_lock'.
+ */
+static threshold_type_t *threshold_index_reserve (const char *type)
+{ /* {{{ */
+  threshold_type_t *tt = NULL;
+  threshold_t **tmp;
+
+  if (threshold_type_tree == NULL)
+  {
+    threshold_type_tree = c_avl_create ((void *) strcmp);
+    if (threshold_type_tree == NULL)
+      return (NULL);
+  }
+
+  if (c_avl_get (threshold_type_tree, type, (void *) &tt) != 0)
+  {
+    char *type_copy;
+
+    tt = calloc (1, sizeof (*tt));
+    type_copy = strdup (type);
+    if ((tt == NULL) || (type_copy == NULL)
+        || (c_avl_insert (threshold_type_tree, type_copy, tt) != 0))
+    {
+      sfree (tt);
+      sfree (type_copy);
+      return (NULL);
+    }
+  }
+
+  tmp = realloc (tt->thresholds,
+      (tt->thresholds_num + 1) * sizeof (*tt->thresholds));
+  if (tmp == NULL)
+    return (NULL);
+  tt->thresholds = tmp;
+
+  return (tt);
+} /* }}} threshold_type_t *threshold_index_reserve */
+
+/*
+ * void threshold_index_add
+ *
+ * Adds a new list of thresholds to the entry returned by
+ * threshold_index_reserve. The caller must hold `threshold_lock'.
+ */
+static void threshold_index_add (threshold_type_t *tt, threshold_t *th)
+{ /* {{{ */
+  size_t i;
+
+  /* Insertion sort, keeping the configuration order for equal ranks. */
+  i = tt->thresholds_num;
+  while ((i > 0)
+      && (threshold_rank (tt->thresholds[i - 1]) > threshold_rank (th)))
+  {
+    tt->thresholds[i] = tt->thresholds[i - 1];
+    i--;
+  }
+  tt->thresholds[i] = th;
+  tt->thresholds_num++;
+} /* }}} void threshold_index_add */
+
 /*
  * int ut_threshold_add
  *
@@ -111,6 +213,7 @@ static int ut_threshold_add (const threshold_t *th)
   char *name_copy;
   threshold_t *th_copy;
   threshold_t *th_ptr;
+  threshold_type_t *tt;
   int status = 0;
 
   if (format_name (name, sizeof (name), th->host,
@@ -150,7 +253,29 @@ static int ut_threshold_add (const threshold_t *th)
 
   if (th_ptr == NULL) /* no such threshold yet */
   {
+    /* Reserve room in the index first, so nothing has to be undone once
+     * the threshold is in the tree. */
+    tt = threshold_index_reserve (th->type);
+    if (tt == NULL)
+    {
+      pthread_mutex_unlock (&threshold_lock);
+      ERROR ("ut_threshold_add: Indexing `%s' failed.", name);
+      sfree (name_copy);
+      sfree (th_copy);
+      return (-1);
+    }
+
     status = c_avl_insert (threshold_tree, name_copy, th_copy);
+    if (status != 0)
+    {
+      pthread_mutex_unlock (&threshold_lock);
+      ERROR ("ut_threshold_add: c_avl_insert (%s) failed.", name);
+      sfree (name_copy);
+      sfree (th_copy);
+      return (status);
+    }
+
+    threshold_index_add (tt, th_copy);
   }
   else /* th_ptr points to the last threshold in the list */
   {
@@ -161,64 +286,43 @@ static int ut_threshold_add (const threshold_t *th)
 
   pthread_mutex_unlock (&threshold_lock);
 
-  if (status != 0)
-  {
-    ERROR ("ut_threshold_add: c_avl_insert (%s) failed.", name);
-    sfree (name_copy);
-    sfree (th_copy);
-  }
-
-  return (status);
+  return (0);
 } /* }}} int ut_threshold_add */
 
 /* 
  * threshold_t *threshold_search
  *
  * Searches for a threshold configuration using all the possible variations of
- * "Host", "Plugin" and "Type" blocks. Returns NULL if no threshold could be
- * found.
- * XXX: This is likely the least efficient function in collectd.
+ * "Host", "Plugin" and "Type" blocks. Only thresholds configured for the
+ * value list's type are considered, most specific first. Returns NULL if no
+ * threshold could be found.
  */
 static threshold_t *threshold_search (const value_list_t *vl)
 { /* {{{ */
-  threshold_t *th;
+  threshold_type_t *tt = NULL;
+  size_t i;
+
+  if ((threshold_type_tree == NULL)
+      || (c_avl_get (threshold_type_tree, vl->type, (void *) &tt) != 0))
+    return (NULL);
+
+  for (i = 0; i < tt->thresholds_num; i++)
+  {
+    threshold_t *th = tt->thresholds[i];
+
+    if ((th->host[0] != 0) && (strcmp (th->host, vl->host) != 0))
+      continue;
+    if ((th->plugin[0] != 0) && (strcmp (th->plugin, vl->plugin) != 0))
+      continue;
+    if ((th->plugin_instance[0] != 0)
+        && (strcmp (th->plugin_instance, vl->plugin_instance) != 0))
+      continue;
+    if ((th->type_instance[0] != 0)
+        && (strcmp (th->type_instance, vl->type_instance) != 0))
+      continue;
 
-  if ((th = threshold_get (vl->host, vl->plugin, vl->plugin_instance,
-	  vl->type, vl->type_instance)) != NULL)
-    return (th);
-  else if ((th = threshold_get (vl->host, vl->plugin, vl->plugin_instance,
-	  vl->type, NULL)) != NULL)
-    return (th);
-  else if ((th = threshold_get (vl->host, vl->plugin, NULL,
-	  vl->type, vl->type_instance)) != NULL)
-    return (th);
-  else if ((th = threshold_get (vl->host, vl->plugin, NULL,
-	  vl->type, NULL)) != NULL)
-    return (th);
-  else if ((th = threshold_get (vl->host, "", NULL,
-	  vl->type, vl->type_instance)) != NULL)
-    return (th);
-  else if ((th = threshold_get (vl->host, "", NULL,
-	  vl->type, NULL)) != NULL)
-    return (th);
-  else if ((th = threshold_get ("", vl->plugin, vl->plugin_instance,
-	  vl->type, vl->type_instance)) != NULL)
-    return (th);
-  else if ((th = threshold_get ("", vl->plugin, vl->plugin_instance,
-	  vl->type, NULL)) != NULL)
-    return (th);
-  else if ((th = threshold_get ("", vl->plugin, NULL,
-	  vl->type, vl->type_instance)) != NULL)
-    return (th);
-  else if ((th = threshold_get ("", vl->plugin, NULL,
-	  vl->type, NULL)) != NULL)
-    return (th);
-  else if ((th = threshold_get ("", "", NULL,
-	  vl->type, vl->type_instance)) != NULL)
-    return (th);
-  else if ((th = threshold_get ("", "", NULL,
-	  vl->type, NULL)) != NULL)
     return (th);
+  }
 
   return (NULL);
 } /* }}} threshold_t *threshold_search */
@@ -27,6 +27,7 @@
 #include "utils_cmd_flush.h"
 #include "utils_cmd_getval.h"
 #include "utils_cmd_listval.h"
+#include "utils_cmd_profile.h"
 #include "utils_cmd_putval.h"
 #include "utils_cmd_putnotif.h"
 
@@ -297,6 +298,10 @@ static void *us_handle_client (void *arg)
 		{
 			handle_flush (fhout, buffer);
 		}
+		else if (strcasecmp (fields[0], "profile") == 0)
+		{
+			handle_profile (fhout, buffer);
+		}
 		else
 		{
 			if (fprintf (fhout, "-1 Unknown command: %s\n", fields[0]) < 0)
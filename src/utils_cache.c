@@ -28,6 +28,7 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <sys/mman.h>
 
 typedef struct cache_entry_s
 {
@@ -393,68 +394,19 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
     return (-1);
   }
 
-  for (i = 0; i < ds->ds_num; i++)
+  status = values_to_rates (ce->values_gauge, ce->values_raw, vl->values,
+      ds, vl->time - ce->last_time);
+  if (status != 0)
   {
-    switch (ds->ds[i].type)
-    {
-      case DS_TYPE_COUNTER:
-	{
-	  counter_t diff;
-
-	  /* check if the counter has wrapped around */
-	  if (vl->values[i].counter < ce->values_raw[i].counter)
-	  {
-	    if (ce->values_raw[i].counter <= 4294967295U)
-	      diff = (4294967295U - ce->values_raw[i].counter)
-		+ vl->values[i].counter;
-	    else
-	      diff = (18446744073709551615ULL - ce->values_raw[i].counter)
-		+ vl->values[i].counter;
-	  }
-	  else /* counter has NOT wrapped around */
-	  {
-	    diff = vl->values[i].counter - ce->values_raw[i].counter;
-	  }
-
-	  ce->values_gauge[i] = ((double) diff)
-	    / (CDTIME_T_TO_DOUBLE (vl->time - ce->last_time));
-	  ce->values_raw[i].counter = vl->values[i].counter;
-	}
-	break;
-
-      case DS_TYPE_GAUGE:
-	ce->values_raw[i].gauge = vl->values[i].gauge;
-	ce->values_gauge[i] = vl->values[i].gauge;
-	break;
-
-      case DS_TYPE_DERIVE:
-	{
-	  derive_t diff;
-
-	  diff = vl->values[i].derive - ce->values_raw[i].derive;
-
-	  ce->values_gauge[i] = ((double) diff)
-	    / (CDTIME_T_TO_DOUBLE (vl->time - ce->last_time));
-	  ce->values_raw[i].derive = vl->values[i].derive;
-	}
-	break;
-
-      case DS_TYPE_ABSOLUTE:
-	ce->values_gauge[i] = ((double) vl->values[i].absolute)
-	  / (CDTIME_T_TO_DOUBLE (vl->time - ce->last_time));
-	ce->values_raw[i].absolute = vl->values[i].absolute;
-	break;
-
-      default:
-	/* This shouldn't happen. */
-	pthread_mutex_unlock (&cache_lock);
-	ERROR ("uc_update: Don't know how to handle data source type %i.",
-	    ds->ds[i].type);
-	return (-1);
-    } /* switch (ds->ds[i].type) */
+    /* This shouldn't happen. */
+    pthread_mutex_unlock (&cache_lock);
+    ERROR ("uc_update: Don't know how to handle the data source types "
+	"of %s.", ds->type);
+    return (-1);
+  }
 
+  for (i = 0; i < ds->ds_num; i++)
     DEBUG ("uc_update: %s: ds[%i] = %lf", name, i, ce->values_gauge[i]);
-  } /* for (i) */
 
   /* Update the history if it exists. */
   if (ce->history != NULL)
@@ -860,6 +812,569 @@ int uc_inc_hits (const data_set_t *ds, const value_list_t *vl, int step)
   return (ret);
 } /* int uc_inc_hits */
 
+/*
+ * Snapshots
+ *
+ * A snapshot starts with `uc_snapshot_header_t', followed by one record per
+ * cache entry. Numbers are stored in the byte order of the host; snapshots
+ * written by a host with a different byte order are rejected. Records are not
+ * aligned and are read using memcpy().
+ *
+ * record:    uc_snapshot_record_t,
+ *            name (name_len bytes, not null terminated),
+ *            value_t values_raw[values_num],
+ *            gauge_t values_gauge[values_num],
+ *            meta data (meta_len bytes)
+ * meta data: uint8_t type, uint16_t key_len, key (not null terminated),
+ *            value; strings are stored as uint32_t length followed by the
+ *            bytes, all other types use eight bytes.
+ */
+#define UC_SNAPSHOT_MAGIC      "collectd-cache"
+#define UC_SNAPSHOT_VERSION    1
+#define UC_SNAPSHOT_BYTE_ORDER 0x01020304
+
+struct uc_snapshot_header_s
+{
+  char     magic[16];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t entries_num;
+};
+typedef struct uc_snapshot_header_s uc_snapshot_header_t;
+
+struct uc_snapshot_record_s
+{
+  uint16_t name_len;
+  uint16_t values_num;
+  uint32_t meta_len;
+  uint64_t last_time;
+  uint64_t last_update;
+  uint64_t interval;
+  int32_t  state;
+  int32_t  hits;
+};
+typedef struct uc_snapshot_record_s uc_snapshot_record_t;
+
+struct uc_buffer_s
+{
+  char  *data;
+  size_t size;
+  size_t len;
+};
+typedef struct uc_buffer_s uc_buffer_t;
+
+static int uc_buffer_append (uc_buffer_t *b, /* {{{ */
+    void const *data, size_t len)
+{
+  if ((b->len + len) > b->size)
+  {
+    size_t new_size = (b->size == 0) ? 65536 : b->size;
+    char *tmp;
+
+    while ((b->len + len) > new_size)
+      new_size *= 2;
+
+    tmp = realloc (b->data, new_size);
+    if (tmp == NULL)
+      return (ENOMEM);
+    b->data = tmp;
+    b->size = new_size;
+  }
+
+  memcpy (b->data + b->len, data, len);
+  b->len += len;
+  return (0);
+} /* }}} int uc_buffer_append */
+
+static int uc_snapshot_write_meta (uc_buffer_t *b, /* {{{ */
+    meta_data_t *meta)
+{
+  char **toc = NULL;
+  int toc_num;
+  int status = 0;
+  int i;
+
+  toc_num = meta_data_toc (meta, &toc);
+  for (i = 0; i < toc_num; i++)
+  {
+    uint8_t type = (uint8_t) meta_data_type (meta, toc[i]);
+    uint16_t key_len = (uint16_t) strlen (toc[i]);
+    union
+    {
+      int64_t  mv_signed_int;
+      uint64_t mv_unsigned_int;
+      double   mv_double;
+      _Bool    mv_boolean;
+      char     bytes[8];
+    } value;
+    char *string = NULL;
+
+    if (status != 0)
+    {
+      sfree (toc[i]);
+      continue;
+    }
+
+    memset (&value, 0, sizeof (value));
+    switch (type)
+    {
+      case MD_TYPE_STRING:
+        status = meta_data_get_string (meta, toc[i], &string);
+        break;
+      case MD_TYPE_SIGNED_INT:
+        status = meta_data_get_signed_int (meta, toc[i],
+            &value.mv_signed_int);
+        break;
+      case MD_TYPE_UNSIGNED_INT:
+        status = meta_data_get_unsigned_int (meta, toc[i],
+            &value.mv_unsigned_int);
+        break;
+      case MD_TYPE_DOUBLE:
+        status = meta_data_get_double (meta, toc[i], &value.mv_double);
+        break;
+      case MD_TYPE_BOOLEAN:
+        status = meta_data_get_boolean (meta, toc[i], &value.mv_boolean);
+        break;
+      default:
+        status = -1;
+    }
+
+    /* Entries which can't be read are skipped, not the whole snapshot. */
+    if (status != 0)
+    {
+      status = 0;
+      sfree (toc[i]);
+      continue;
+    }
+
+    status = uc_buffer_append (b, &type, sizeof (type));
+    if (status == 0)
+      status = uc_buffer_append (b, &key_len, sizeof (key_len));
+    if (status == 0)
+      status = uc_buffer_append (b, toc[i], key_len);
+    if ((status == 0) && (string != NULL))
+    {
+      uint32_t string_len = (uint32_t) strlen (string);
+
+      status = uc_buffer_append (b, &string_len, sizeof (string_len));
+      if (status == 0)
+        status = uc_buffer_append (b, string, string_len);
+    }
+    else if (status == 0)
+      status = uc_buffer_append (b, value.bytes, sizeof (value.bytes));
+
+    sfree (string);
+    sfree (toc[i]);
+  }
+  sfree (toc);
+
+  return (status);
+} /* }}} int uc_snapshot_write_meta */
+
+/* Caller must hold `cache_lock'. */
+static int uc_snapshot_write_entry (uc_buffer_t *b, /* {{{ */
+    cache_entry_t const *ce)
+{
+  uc_snapshot_record_t rec;
+  size_t rec_pos = b->len;
+  size_t meta_pos;
+  int status;
+
+  memset (&rec, 0, sizeof (rec));
+  rec.name_len = (uint16_t) strlen (ce->name);
+  rec.values_num = (uint16_t) ce->values_num;
+  rec.last_time = (uint64_t) ce->last_time;
+  rec.last_update = (uint64_t) ce->last_update;
+  rec.interval = (uint64_t) ce->interval;
+  rec.state = (int32_t) ce->state;
+  rec.hits = (int32_t) ce->hits;
+
+  status = uc_buffer_append (b, &rec, sizeof (rec));
+  if (status == 0)
+    status = uc_buffer_append (b, ce->name, rec.name_len);
+  if (status == 0)
+    status = uc_buffer_append (b, ce->values_raw,
+        ce->values_num * sizeof (*ce->values_raw));
+  if (status == 0)
+    status = uc_buffer_append (b, ce->values_gauge,
+        ce->values_num * sizeof (*ce->values_gauge));
+  if (status != 0)
+    return (status);
+
+  if (ce->meta == NULL)
+    return (0);
+
+  meta_pos = b->len;
+  status = uc_snapshot_write_meta (b, ce->meta);
+  if (status != 0)
+    return (status);
+
+  /* Fill in the size of the meta data now that it is known. */
+  rec.meta_len = (uint32_t) (b->len - meta_pos);
+  memcpy (b->data + rec_pos, &rec, sizeof (rec));
+
+  return (0);
+} /* }}} int uc_snapshot_write_entry */
+
+/* Copies `len' bytes at `*pos' to `dst' and advances `*pos'. Returns non-zero
+ * if the snapshot is too short. */
+static int uc_snapshot_read (void *dst, /* {{{ */
+    char const *map, size_t map_size, size_t *pos, size_t len)
+{
+  if ((len > map_size) || (*pos > (map_size - len)))
+    return (-1);
+
+  memcpy (dst, map + *pos, len);
+  *pos += len;
+  return (0);
+} /* }}} int uc_snapshot_read */
+
+static int uc_snapshot_read_meta (meta_data_t *meta, /* {{{ */
+    char const *map, size_t map_size)
+{
+  size_t pos = 0;
+
+  while (pos < map_size)
+  {
+    uint8_t type;
+    uint16_t key_len;
+    char key[DATA_MAX_NAME_LEN];
+    union
+    {
+      int64_t  mv_signed_int;
+      uint64_t mv_unsigned_int;
+      double   mv_double;
+      _Bool    mv_boolean;
+      char     bytes[8];
+    } value;
+
+    if ((uc_snapshot_read (&type, map, map_size, &pos, sizeof (type)) != 0)
+        || (uc_snapshot_read (&key_len, map, map_size, &pos,
+            sizeof (key_len)) != 0)
+        || (key_len >= sizeof (key))
+        || (uc_snapshot_read (key, map, map_size, &pos, key_len) != 0))
+      return (-1);
+    key[key_len] = 0;
+
+    if (type == MD_TYPE_STRING)
+    {
+      uint32_t string_len;
+      char *string;
+
+      if (uc_snapshot_read (&string_len, map, map_size, &pos,
+            sizeof (string_len)) != 0)
+        return (-1);
+      if ((string_len > map_size) || (pos > (map_size - string_len)))
+        return (-1);
+
+      string = malloc (string_len + 1);
+      if (string == NULL)
+        return (ENOMEM);
+      memcpy (string, map + pos, string_len);
+      string[string_len] = 0;
+      pos += string_len;
+
+      meta_data_add_string (meta, key, string);
+      sfree (string);
+      continue;
+    }
+
+    if (uc_snapshot_read (value.bytes, map, map_size, &pos,
+          sizeof (value.bytes)) != 0)
+      return (-1);
+
+    switch (type)
+    {
+      case MD_TYPE_SIGNED_INT:
+        meta_data_add_signed_int (meta, key, value.mv_signed_int);
+        break;
+      case MD_TYPE_UNSIGNED_INT:
+        meta_data_add_unsigned_int (meta, key, value.mv_unsigned_int);
+        break;
+      case MD_TYPE_DOUBLE:
+        meta_data_add_double (meta, key, value.mv_double);
+        break;
+      case MD_TYPE_BOOLEAN:
+        meta_data_add_boolean (meta, key, value.mv_boolean);
+        break;
+      default:
+        return (-1);
+    }
+  }
+
+  return (0);
+} /* }}} int uc_snapshot_read_meta */
+
+/* Reads one record and adds it to the cache unless it is stale or doesn't
+ * match its data set. Returns non-zero if the snapshot is corrupt. Caller must
+ * hold `cache_lock'. */
+static int uc_snapshot_read_entry (char const *map, /* {{{ */
+    size_t map_size, size_t *pos, cdtime_t now, _Bool *ret_restored)
+{
+  uc_snapshot_record_t rec;
+  char name[6 * DATA_MAX_NAME_LEN];
+  size_t values_size;
+  size_t data_pos;
+  value_list_t vl = VALUE_LIST_INIT;
+  const data_set_t *ds;
+  cache_entry_t *ce;
+  char *key;
+
+  *ret_restored = 0;
+
+  if ((uc_snapshot_read (&rec, map, map_size, pos, sizeof (rec)) != 0)
+      || (rec.name_len >= sizeof (name))
+      || (uc_snapshot_read (name, map, map_size, pos, rec.name_len) != 0))
+    return (-1);
+  name[rec.name_len] = 0;
+
+  values_size = rec.values_num * (sizeof (value_t) + sizeof (gauge_t));
+  if ((values_size + rec.meta_len) > (map_size - *pos))
+    return (-1);
+  data_pos = *pos;
+  *pos += values_size + rec.meta_len;
+
+  /* Entries which would have timed out by now are dropped, so that
+   * uc_check_timeout() doesn't report them as missing. */
+  if ((((cdtime_t) rec.last_update) + (timeout_g * ((cdtime_t) rec.interval)))
+      <= now)
+    return (0);
+
+  if (c_avl_get (cache_tree, name, /* value = */ NULL) == 0)
+    return (0);
+
+  if (parse_identifier_vl (name, &vl) != 0)
+    return (0);
+
+  ds = plugin_get_ds (vl.type);
+  if ((ds == NULL) || (ds->ds_num != (int) rec.values_num))
+  {
+    DEBUG ("utils_cache: Not restoring %s: The data set has changed.", name);
+    return (0);
+  }
+
+  ce = cache_alloc (ds->ds_num);
+  if (ce == NULL)
+    return (ENOMEM);
+
+  sstrncpy (ce->name, name, sizeof (ce->name));
+  memcpy (ce->values_raw, map + data_pos,
+      rec.values_num * sizeof (*ce->values_raw));
+  memcpy (ce->values_gauge,
+      map + data_pos + rec.values_num * sizeof (*ce->values_raw),
+      rec.values_num * sizeof (*ce->values_gauge));
+  ce->last_time = (cdtime_t) rec.last_time;
+  ce->last_update = (cdtime_t) rec.last_update;
+  ce->interval = (cdtime_t) rec.interval;
+  ce->state = (int) rec.state;
+  ce->hits = (int) rec.hits;
+
+  if (rec.meta_len > 0)
+  {
+    ce->meta = meta_data_create ();
+    if ((ce->meta == NULL)
+        || (uc_snapshot_read_meta (ce->meta,
+            map + data_pos + values_size, rec.meta_len) != 0))
+    {
+      cache_free (ce);
+      return (-1);
+    }
+  }
+
+  key = strdup (name);
+  if ((key == NULL) || (c_avl_insert (cache_tree, key, ce) != 0))
+  {
+    sfree (key);
+    cache_free (ce);
+    return (ENOMEM);
+  }
+
+  *ret_restored = 1;
+  return (0);
+} /* }}} int uc_snapshot_read_entry */
+
+int uc_save (const char *file) /* {{{ */
+{
+  uc_buffer_t buffer = { NULL, 0, 0 };
+  uc_snapshot_header_t header;
+  char tmpfile[PATH_MAX];
+  c_avl_iterator_t *iter;
+  char *key;
+  cache_entry_t *ce;
+#if COLLECT_DEBUG
+  cdtime_t start = cdtime ();
+#endif
+  int status;
+  int fd;
+
+  if ((file == NULL) || (cache_tree == NULL))
+    return (EINVAL);
+
+  memset (&header, 0, sizeof (header));
+  sstrncpy (header.magic, UC_SNAPSHOT_MAGIC, sizeof (header.magic));
+  header.version = UC_SNAPSHOT_VERSION;
+  header.byte_order = UC_SNAPSHOT_BYTE_ORDER;
+
+  status = uc_buffer_append (&buffer, &header, sizeof (header));
+
+  /* Serialize into memory while holding the lock and write the file
+   * afterwards, so that slow disks don't block the dispatch threads. */
+  pthread_mutex_lock (&cache_lock);
+  iter = c_avl_get_iterator (cache_tree);
+  while ((status == 0)
+      && (c_avl_iterator_next (iter, (void *) &key, (void *) &ce) == 0))
+  {
+    status = uc_snapshot_write_entry (&buffer, ce);
+    header.entries_num++;
+  }
+  c_avl_iterator_destroy (iter);
+  pthread_mutex_unlock (&cache_lock);
+
+  if (status != 0)
+  {
+    ERROR ("utils_cache: uc_save: Out of memory.");
+    sfree (buffer.data);
+    return (status);
+  }
+  memcpy (buffer.data, &header, sizeof (header));
+
+  /* Write to a temporary file and rename it, so that a crash never leaves a
+   * truncated snapshot behind. */
+  ssnprintf (tmpfile, sizeof (tmpfile), "%s.tmp", file);
+  fd = open (tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+  {
+    char errbuf[1024];
+    status = errno;
+    ERROR ("utils_cache: uc_save: open (%s) failed: %s", tmpfile,
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    sfree (buffer.data);
+    return (status);
+  }
+
+  status = (int) swrite (fd, buffer.data, buffer.len);
+  if (status == 0)
+    status = fsync (fd);
+  if (status != 0)
+    status = errno;
+  close (fd);
+  sfree (buffer.data);
+
+  if (status == 0)
+    status = (rename (tmpfile, file) == 0) ? 0 : errno;
+
+  if (status != 0)
+  {
+    char errbuf[1024];
+    ERROR ("utils_cache: uc_save: Writing \"%s\" failed: %s", file,
+        sstrerror (status, errbuf, sizeof (errbuf)));
+    unlink (tmpfile);
+    return (status);
+  }
+
+#if COLLECT_DEBUG
+  DEBUG ("utils_cache: Saved %llu entries to \"%s\" in %.3f seconds.",
+      (unsigned long long) header.entries_num, file,
+      CDTIME_T_TO_DOUBLE (cdtime () - start));
+#endif
+  return (0);
+} /* }}} int uc_save */
+
+int uc_load (const char *file) /* {{{ */
+{
+  uc_snapshot_header_t header;
+  struct stat statbuf;
+  char const *map;
+  size_t map_size;
+  size_t pos = 0;
+  uint64_t restored = 0;
+  uint64_t i;
+  cdtime_t now;
+  int status = 0;
+  int fd;
+
+  if (file == NULL)
+    return (EINVAL);
+
+  if (cache_tree == NULL)
+    uc_init ();
+
+  fd = open (file, O_RDONLY);
+  if (fd < 0)
+  {
+    char errbuf[1024];
+    status = errno;
+    /* There is no snapshot on the very first start. */
+    if (status == ENOENT)
+      INFO ("utils_cache: No value cache snapshot found at \"%s\".", file);
+    else
+      ERROR ("utils_cache: uc_load: open (%s) failed: %s", file,
+          sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (status);
+  }
+
+  if ((fstat (fd, &statbuf) != 0) || (statbuf.st_size < 0)
+      || ((size_t) statbuf.st_size < sizeof (header)))
+  {
+    ERROR ("utils_cache: uc_load: \"%s\" is not a value cache snapshot.",
+        file);
+    close (fd);
+    return (EINVAL);
+  }
+
+  map_size = (size_t) statbuf.st_size;
+  map = mmap (/* addr = */ NULL, map_size, PROT_READ, MAP_PRIVATE, fd,
+      /* offset = */ 0);
+  close (fd);
+  if (map == MAP_FAILED)
+  {
+    char errbuf[1024];
+    status = errno;
+    ERROR ("utils_cache: uc_load: mmap (%s) failed: %s", file,
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (status);
+  }
+
+  uc_snapshot_read (&header, map, map_size, &pos, sizeof (header));
+  if ((strncmp (UC_SNAPSHOT_MAGIC, header.magic, sizeof (header.magic)) != 0)
+      || (header.version != UC_SNAPSHOT_VERSION)
+      || (header.byte_order != UC_SNAPSHOT_BYTE_ORDER))
+  {
+    ERROR ("utils_cache: uc_load: \"%s\" is not a value cache snapshot of "
+        "this version or was written by a host with a different byte order.",
+        file);
+    munmap ((void *) map, map_size);
+    return (EINVAL);
+  }
+
+  now = cdtime ();
+
+  pthread_mutex_lock (&cache_lock);
+  for (i = 0; i < header.entries_num; i++)
+  {
+    _Bool entry_restored = 0;
+
+    status = uc_snapshot_read_entry (map, map_size, &pos, now,
+        &entry_restored);
+    if (status != 0)
+      break;
+    if (entry_restored)
+      restored++;
+  }
+  pthread_mutex_unlock (&cache_lock);
+
+  munmap ((void *) map, map_size);
+
+  if (status != 0)
+    ERROR ("utils_cache: uc_load: \"%s\" is corrupt. Only the first "
+        "%llu entries have been read.", file, (unsigned long long) i);
+
+  INFO ("utils_cache: Restored %llu of %llu entries from \"%s\".",
+      (unsigned long long) restored, (unsigned long long) header.entries_num,
+      file);
+  return (status);
+} /* }}} int uc_load */
+
 /*
  * Meta data interface
  */
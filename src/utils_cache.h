@@ -48,6 +48,17 @@ int uc_get_history (const data_set_t *ds, const value_list_t *vl,
 int uc_get_history_by_name (const char *name,
     gauge_t *ret_history, size_t num_steps, size_t num_ds);
 
+/*
+ * Snapshots
+ *
+ * uc_save() writes the state of all cache entries, including raw values,
+ * rates and plugin meta data, to `file'. uc_load() adds the entries found in
+ * `file' to the cache, skipping entries which would have timed out already or
+ * whose data set has changed. Both return zero on success.
+ */
+int uc_save (const char *file);
+int uc_load (const char *file);
+
 /*
  * Meta data interface
  */
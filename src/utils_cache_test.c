@@ -0,0 +1,377 @@
+/**
+ * collectd - src/utils_cache_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Tests for the value cache snapshots. A child process fills the cache and
+ * saves it, the parent restores it into its empty cache and checks the
+ * entries. Run with "-b" to benchmark saving and restoring a large cache.
+ */
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_cache.h"
+
+#include <sys/wait.h>
+#include <time.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf ("%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+/*
+ * Stubs for the daemon functions used by the cache.
+ */
+int timeout_g = 2;
+char hostname_g[DATA_MAX_NAME_LEN] = "example.com";
+
+/* The number of data sources of the "changed" type differs between the
+ * process saving the cache and the one restoring it. */
+static _Bool is_child = 0;
+
+static data_source_t ds_if_octets[] = {
+  { "rx", DS_TYPE_DERIVE, 0.0, NAN },
+  { "tx", DS_TYPE_DERIVE, 0.0, NAN }
+};
+static data_source_t ds_gauge[] = {
+  { "value", DS_TYPE_GAUGE, NAN, NAN }
+};
+static data_source_t ds_changed[] = {
+  { "a", DS_TYPE_GAUGE, NAN, NAN },
+  { "b", DS_TYPE_GAUGE, NAN, NAN }
+};
+
+static data_set_t data_sets[] = {
+  { "if_octets", STATIC_ARRAY_SIZE (ds_if_octets), ds_if_octets },
+  { "gauge",     STATIC_ARRAY_SIZE (ds_gauge),     ds_gauge },
+  { "changed",   STATIC_ARRAY_SIZE (ds_changed),   ds_changed }
+};
+
+const data_set_t *plugin_get_ds (const char *name) /* {{{ */
+{
+  size_t i;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (data_sets); i++)
+  {
+    if (strcmp (data_sets[i].type, name) != 0)
+      continue;
+
+    if (strcmp ("changed", name) == 0)
+      data_sets[i].ds_num = is_child ? 1 : 2;
+    return (data_sets + i);
+  }
+
+  return (NULL);
+} /* }}} const data_set_t *plugin_get_ds */
+
+cdtime_t plugin_get_interval (void)
+{
+  return (TIME_T_TO_CDTIME_T (10));
+}
+
+int plugin_dispatch_missing (const value_list_t __attribute__((unused)) *vl)
+{
+  return (0);
+}
+
+void plugin_log (int level, const char *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  if (level >= LOG_INFO)
+    return;
+
+  va_start (ap, format);
+  printf ("[severity %i] ", level);
+  vprintf (format, ap);
+  printf ("\n");
+  va_end (ap);
+} /* }}} void plugin_log */
+
+/*
+ * Helpers
+ */
+static void update (char const *type, char const *type_instance, /* {{{ */
+    cdtime_t time, cdtime_t interval, value_t *values)
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  data_set_t const *ds = plugin_get_ds (type);
+
+  vl.values = values;
+  vl.values_len = ds->ds_num;
+  vl.time = time;
+  vl.interval = interval;
+  sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+  sstrncpy (vl.plugin, "test", sizeof (vl.plugin));
+  sstrncpy (vl.type, type, sizeof (vl.type));
+  sstrncpy (vl.type_instance, type_instance, sizeof (vl.type_instance));
+
+  CHECK (uc_update (ds, &vl) == 0);
+} /* }}} void update */
+
+static void vl_init (value_list_t *vl, char const *type, /* {{{ */
+    char const *type_instance)
+{
+  sstrncpy (vl->host, hostname_g, sizeof (vl->host));
+  sstrncpy (vl->plugin, "test", sizeof (vl->plugin));
+  sstrncpy (vl->type, type, sizeof (vl->type));
+  sstrncpy (vl->type_instance, type_instance, sizeof (vl->type_instance));
+} /* }}} void vl_init */
+
+/* Fills the cache and saves it to `file'. Runs in the child process. */
+static int fill_and_save (char const *file) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  cdtime_t now = cdtime ();
+  cdtime_t interval = TIME_T_TO_CDTIME_T (10);
+  value_t values[2];
+  data_set_t const *ds;
+
+  uc_init ();
+
+  values[0].derive = 1000;
+  values[1].derive = 5000;
+  update ("if_octets", "eth0", now - interval, interval, values);
+  values[0].derive = 2000;
+  values[1].derive = 5500;
+  update ("if_octets", "eth0", now, interval, values);
+
+  values[0].gauge = 42.0;
+  update ("gauge", "answer", now, interval, values);
+
+  /* Times out immediately and must not be restored. */
+  update ("gauge", "stale", now, /* interval = */ 1, values);
+
+  values[0].gauge = 1.0;
+  update ("changed", "", now, interval, values);
+
+  vl_init (&vl, "if_octets", "eth0");
+  uc_meta_data_add_string (&vl, "string", "a string");
+  uc_meta_data_add_signed_int (&vl, "signed", -42);
+  uc_meta_data_add_unsigned_int (&vl, "unsigned", 42);
+  uc_meta_data_add_double (&vl, "double", 0.5);
+  uc_meta_data_add_boolean (&vl, "boolean", 1);
+
+  ds = plugin_get_ds ("if_octets");
+  uc_set_state (ds, &vl, STATE_WARNING);
+  uc_set_hits (ds, &vl, 3);
+
+  return (uc_save (file));
+} /* }}} int fill_and_save */
+
+static int run_child (int (*func) (char const *), char const *file) /* {{{ */
+{
+  pid_t pid;
+  int status = 0;
+
+  fflush (stdout);
+  pid = fork ();
+  if (pid < 0)
+    return (-1);
+  else if (pid == 0)
+  {
+    is_child = 1;
+    exit ((*func) (file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  if ((waitpid (pid, &status, 0) != pid) || !WIFEXITED (status))
+    return (-1);
+  return (WEXITSTATUS (status));
+} /* }}} int run_child */
+
+static void test_snapshot (char const *file) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  data_set_t const *ds = plugin_get_ds ("if_octets");
+  gauge_t *rates = NULL;
+  size_t rates_num = 0;
+  char name[6 * DATA_MAX_NAME_LEN];
+  char *string = NULL;
+  int64_t signed_int = 0;
+  uint64_t unsigned_int = 0;
+  double d = 0.0;
+  _Bool b = 0;
+  value_t values[2];
+
+  CHECK (run_child (fill_and_save, file) == 0);
+
+  uc_init ();
+  CHECK (uc_load (file) == 0);
+
+  /* Rates are restored. */
+  vl_init (&vl, "if_octets", "eth0");
+  FORMAT_VL (name, sizeof (name), &vl);
+  CHECK (uc_get_rate_by_name (name, &rates, &rates_num) == 0);
+  CHECK (rates_num == 2);
+  if (rates_num == 2)
+  {
+    CHECK (rates[0] == 100.0);
+    CHECK (rates[1] == 50.0);
+  }
+  sfree (rates);
+
+  /* Rates continue based on the restored raw values. */
+  values[0].derive = 2500;
+  values[1].derive = 5500;
+  update ("if_octets", "eth0", cdtime () + TIME_T_TO_CDTIME_T (10),
+      TIME_T_TO_CDTIME_T (10), values);
+  rates = uc_get_rate (ds, &vl);
+  CHECK ((rates != NULL) && (rates[0] > 0.0) && (rates[0] <= 50.0)
+      && (rates[1] == 0.0));
+  sfree (rates);
+
+  CHECK (uc_get_state (ds, &vl) == STATE_WARNING);
+  CHECK (uc_get_hits (ds, &vl) == 3);
+
+  CHECK (uc_meta_data_get_string (&vl, "string", &string) == 0);
+  CHECK ((string != NULL) && (strcmp ("a string", string) == 0));
+  sfree (string);
+  CHECK (uc_meta_data_get_signed_int (&vl, "signed", &signed_int) == 0);
+  CHECK (signed_int == -42);
+  CHECK (uc_meta_data_get_unsigned_int (&vl, "unsigned", &unsigned_int) == 0);
+  CHECK (unsigned_int == 42);
+  CHECK (uc_meta_data_get_double (&vl, "double", &d) == 0);
+  CHECK (d == 0.5);
+  CHECK (uc_meta_data_get_boolean (&vl, "boolean", &b) == 0);
+  CHECK (b == 1);
+
+  vl_init (&vl, "gauge", "answer");
+  FORMAT_VL (name, sizeof (name), &vl);
+  CHECK (uc_get_rate_by_name (name, &rates, &rates_num) == 0);
+  CHECK ((rates_num == 1) && (rates[0] == 42.0));
+  sfree (rates);
+
+  /* Stale entries and entries whose data set has changed are dropped. */
+  vl_init (&vl, "gauge", "stale");
+  FORMAT_VL (name, sizeof (name), &vl);
+  CHECK (uc_get_rate_by_name (name, &rates, &rates_num) != 0);
+
+  vl_init (&vl, "changed", "");
+  FORMAT_VL (name, sizeof (name), &vl);
+  CHECK (uc_get_rate_by_name (name, &rates, &rates_num) != 0);
+} /* }}} void test_snapshot */
+
+static void test_corrupt (char const *file) /* {{{ */
+{
+  struct stat statbuf;
+  FILE *fh;
+
+  CHECK (uc_load ("/nonexistent/cache.dat") == ENOENT);
+
+  /* Truncated snapshots are detected. */
+  CHECK (stat (file, &statbuf) == 0);
+  CHECK (truncate (file, statbuf.st_size - 3) == 0);
+  CHECK (uc_load (file) != 0);
+
+  /* Files which are not snapshots are rejected. */
+  fh = fopen (file, "w");
+  CHECK (fh != NULL);
+  if (fh != NULL)
+  {
+    fprintf (fh, "This is not a snapshot of the value cache.\n");
+    fclose (fh);
+  }
+  CHECK (uc_load (file) == EINVAL);
+} /* }}} void test_corrupt */
+
+#define BENCH_ENTRIES 200000
+
+static double bench_now (void) /* {{{ */
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1e9);
+} /* }}} double bench_now */
+
+static int bench_fill_and_save (char const *file) /* {{{ */
+{
+  cdtime_t now = cdtime ();
+  cdtime_t interval = TIME_T_TO_CDTIME_T (10);
+  double t;
+  int i;
+
+  uc_init ();
+  for (i = 0; i < BENCH_ENTRIES; i++)
+  {
+    char type_instance[DATA_MAX_NAME_LEN];
+    value_t values[2];
+
+    ssnprintf (type_instance, sizeof (type_instance), "bench%i", i);
+    values[0].derive = i;
+    values[1].derive = 2 * i;
+    update ("if_octets", type_instance, now, interval, values);
+  }
+
+  t = bench_now ();
+  if (uc_save (file) != 0)
+    return (-1);
+  printf ("Saving %i entries took %.3f s.\n", BENCH_ENTRIES, bench_now () - t);
+  return (0);
+} /* }}} int bench_fill_and_save */
+
+static void benchmark (char const *file) /* {{{ */
+{
+  double t;
+
+  CHECK (run_child (bench_fill_and_save, file) == 0);
+
+  t = bench_now ();
+  CHECK (uc_load (file) == 0);
+  printf ("Restoring %i entries took %.3f s.\n", BENCH_ENTRIES,
+      bench_now () - t);
+} /* }}} void benchmark */
+
+int main (int argc, char **argv) /* {{{ */
+{
+  char file[] = "/tmp/utils_cache_test.XXXXXX";
+  int fd;
+
+  fd = mkstemp (file);
+  if (fd < 0)
+  {
+    perror ("mkstemp");
+    return (EXIT_FAILURE);
+  }
+  close (fd);
+
+  test_snapshot (file);
+  test_corrupt (file);
+
+  if ((failures == 0) && (argc > 1) && (strcmp ("-b", argv[1]) == 0))
+    benchmark (file);
+
+  unlink (file);
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
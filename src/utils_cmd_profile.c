@@ -0,0 +1,100 @@
+/**
+ * collectd - src/utils_cmd_profile.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_cmd_profile.h"
+#include "utils_parse_option.h"
+#include "utils_profile.h"
+
+#define print_to_socket(fh, ...) \
+  if (fprintf (fh, __VA_ARGS__) < 0) { \
+    char errbuf[1024]; \
+    WARNING ("handle_profile: failed to write to socket #%i: %s", \
+	fileno (fh), sstrerror (errno, errbuf, sizeof (errbuf))); \
+    return -1; \
+  }
+
+/* PROFILE [ENABLE|DISABLE] */
+int handle_profile (FILE *fh, char *buffer) /* {{{ */
+{
+  char *command;
+  char *action;
+  int status;
+
+  if ((fh == NULL) || (buffer == NULL))
+    return (-1);
+
+  DEBUG ("utils_cmd_profile: handle_profile (fh = %p, buffer = %s);",
+      (void *) fh, buffer);
+
+  command = NULL;
+  status = parse_string (&buffer, &command);
+  if (status != 0)
+  {
+    print_to_socket (fh, "-1 Cannot parse command.\n");
+    return (-1);
+  }
+  assert (command != NULL);
+
+  if (strcasecmp ("PROFILE", command) != 0)
+  {
+    print_to_socket (fh, "-1 Unexpected command: `%s'.\n", command);
+    return (-1);
+  }
+
+  action = NULL;
+  if (*buffer != 0)
+  {
+    status = parse_string (&buffer, &action);
+    if (status != 0)
+    {
+      print_to_socket (fh, "-1 Cannot parse action.\n");
+      return (-1);
+    }
+
+    if (*buffer != 0)
+    {
+      print_to_socket (fh, "-1 Garbage after end of command: %s\n", buffer);
+      return (-1);
+    }
+  }
+
+  if (action == NULL)
+    ; /* only report the state */
+  else if (strcasecmp ("ENABLE", action) == 0)
+    profile_set_enabled (1);
+  else if (strcasecmp ("DISABLE", action) == 0)
+    profile_set_enabled (0);
+  else
+  {
+    print_to_socket (fh, "-1 Unknown action: `%s'.\n", action);
+    return (-1);
+  }
+
+  print_to_socket (fh, "0 Profiling is %s\n",
+      profile_is_enabled () ? "enabled" : "disabled");
+
+  return (0);
+} /* }}} int handle_profile */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,407 @@
+/**
+ * collectd - src/utils_curl_async.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_curl_async.h"
+
+#include <pthread.h>
+
+#if LIBCURL_VERSION_NUM >= 0x071c00
+# define CA_HAVE_MULTI_WAIT 1
+#else
+# define CA_HAVE_MULTI_WAIT 0
+#endif
+
+#if CA_HAVE_MULTI_WAIT
+/* Maximum time the event loop waits for socket activity, in milliseconds. */
+#define CA_WAIT_TIMEOUT 1000
+
+struct ca_request_s;
+typedef struct ca_request_s ca_request_t;
+struct ca_request_s
+{
+  CURL *curl;
+  curl_async_cb callback;
+  void *user_data;
+
+  _Bool added;     /* the handle has been added to `ca_multi' */
+  _Bool cancelled; /* curl_async_cancel() is waiting for the removal */
+
+  ca_request_t *next;
+};
+
+/* `ca_lock' protects the list of requests. `ca_multi' is only used by the
+ * event loop thread while it is running. */
+static pthread_mutex_t ca_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ca_cond = PTHREAD_COND_INITIALIZER;
+static ca_request_t *ca_requests = NULL;
+
+static CURLM *ca_multi = NULL;
+static pthread_t ca_thread;
+static _Bool ca_thread_running = 0;
+static _Bool ca_loop = 0;
+static int ca_wakeup_fd[2] = { -1, -1 };
+
+/* Caller must hold `ca_lock'. */
+static ca_request_t *ca_request_find (CURL *curl) /* {{{ */
+{
+  ca_request_t *req;
+
+  for (req = ca_requests; req != NULL; req = req->next)
+    if (req->curl == curl)
+      return (req);
+
+  return (NULL);
+} /* }}} ca_request_t *ca_request_find */
+
+/* Removes `req' from the list and frees it. Caller must hold `ca_lock'. */
+static void ca_request_remove (ca_request_t *req) /* {{{ */
+{
+  ca_request_t **prev;
+
+  for (prev = &ca_requests; *prev != NULL; prev = &(*prev)->next)
+  {
+    if (*prev == req)
+    {
+      *prev = req->next;
+      break;
+    }
+  }
+
+  if (req->added)
+    curl_multi_remove_handle (ca_multi, req->curl);
+
+  sfree (req);
+  pthread_cond_broadcast (&ca_cond);
+} /* }}} void ca_request_remove */
+
+static void ca_wakeup (void) /* {{{ */
+{
+  char c = 0;
+
+  if (ca_wakeup_fd[1] >= 0)
+    if (write (ca_wakeup_fd[1], &c, 1) < 0)
+      ; /* The pipe is full, so the loop will wake up anyway. */
+} /* }}} void ca_wakeup */
+
+/* Adds new requests to the multi handle and removes cancelled ones. Requests
+ * which can't be added are failed with CURLE_FAILED_INIT. Caller must hold
+ * `ca_lock'. */
+static void ca_update_requests (void) /* {{{ */
+{
+  ca_request_t *req;
+  ca_request_t *next;
+
+  for (req = ca_requests; req != NULL; req = next)
+  {
+    CURLMcode status;
+
+    next = req->next;
+
+    if (req->cancelled)
+    {
+      ca_request_remove (req);
+      continue;
+    }
+
+    if (req->added)
+      continue;
+
+    status = curl_multi_add_handle (ca_multi, req->curl);
+    if (status == CURLM_OK)
+    {
+      req->added = 1;
+      continue;
+    }
+
+    ERROR ("utils_curl_async: curl_multi_add_handle failed: %s",
+        curl_multi_strerror (status));
+
+    /* Call the callback, so the plugin records the failure and may submit
+     * the handle again. As in ca_handle_finished(), the request stays in the
+     * list while the callback runs. */
+    pthread_mutex_unlock (&ca_lock);
+    (*req->callback) (req->curl, CURLE_FAILED_INIT, req->user_data);
+    pthread_mutex_lock (&ca_lock);
+
+    ca_request_remove (req);
+
+    /* The list may have changed while the lock was released. */
+    next = ca_requests;
+  }
+} /* }}} void ca_update_requests */
+
+/* Calls the callbacks of all finished transfers. */
+static void ca_handle_finished (void) /* {{{ */
+{
+  CURLMsg *msg;
+  int msgs_left;
+
+  while ((msg = curl_multi_info_read (ca_multi, &msgs_left)) != NULL)
+  {
+    CURL *curl = msg->easy_handle;
+    CURLcode result = msg->data.result;
+    ca_request_t *req;
+
+    if (msg->msg != CURLMSG_DONE)
+      continue;
+
+    pthread_mutex_lock (&ca_lock);
+    req = ca_request_find (curl);
+    if (req == NULL)
+    {
+      pthread_mutex_unlock (&ca_lock);
+      continue;
+    }
+
+    /* Remove the handle now, so that the callback may look at it and it may
+     * be submitted again. `msg' is invalid afterwards. */
+    curl_multi_remove_handle (ca_multi, curl);
+    req->added = 0;
+
+    /* The request stays in the list while the callback runs, so that
+     * curl_async_cancel() waits for it. */
+    if (!req->cancelled)
+    {
+      pthread_mutex_unlock (&ca_lock);
+
+      (*req->callback) (curl, result, req->user_data);
+
+      pthread_mutex_lock (&ca_lock);
+    }
+
+    ca_request_remove (req);
+    pthread_mutex_unlock (&ca_lock);
+  }
+} /* }}} void ca_handle_finished */
+
+static void *ca_thread_main (void __attribute__((unused)) *arg) /* {{{ */
+{
+  pthread_mutex_lock (&ca_lock);
+  while (ca_loop)
+  {
+    struct curl_waitfd wakeup;
+    int running = 0;
+    char buffer[64];
+
+    ca_update_requests ();
+    pthread_mutex_unlock (&ca_lock);
+
+    curl_multi_perform (ca_multi, &running);
+    ca_handle_finished ();
+
+    memset (&wakeup, 0, sizeof (wakeup));
+    wakeup.fd = ca_wakeup_fd[0];
+    wakeup.events = CURL_WAIT_POLLIN;
+    curl_multi_wait (ca_multi, &wakeup, 1, CA_WAIT_TIMEOUT,
+        /* numfds = */ NULL);
+
+    while (read (ca_wakeup_fd[0], buffer, sizeof (buffer)) > 0)
+      /* drain the pipe */;
+
+    pthread_mutex_lock (&ca_lock);
+  }
+  pthread_mutex_unlock (&ca_lock);
+
+  return ((void *) 0);
+} /* }}} void *ca_thread_main */
+
+/* Caller must hold `ca_lock'. */
+static int ca_thread_start (void) /* {{{ */
+{
+  int status;
+  int i;
+
+  if (ca_multi == NULL)
+  {
+    ca_multi = curl_multi_init ();
+    if (ca_multi == NULL)
+    {
+      ERROR ("utils_curl_async: curl_multi_init failed.");
+      return (-1);
+    }
+  }
+
+  if (ca_wakeup_fd[0] < 0)
+  {
+    if (pipe (ca_wakeup_fd) != 0)
+    {
+      char errbuf[1024];
+      ERROR ("utils_curl_async: pipe failed: %s",
+          sstrerror (errno, errbuf, sizeof (errbuf)));
+      ca_wakeup_fd[0] = ca_wakeup_fd[1] = -1;
+      return (-1);
+    }
+
+    for (i = 0; i < 2; i++)
+      fcntl (ca_wakeup_fd[i], F_SETFL,
+          fcntl (ca_wakeup_fd[i], F_GETFL) | O_NONBLOCK);
+  }
+
+  ca_loop = 1;
+  status = plugin_thread_create (&ca_thread, /* attr = */ NULL,
+      ca_thread_main, /* arg = */ NULL);
+  if (status != 0)
+  {
+    ERROR ("utils_curl_async: Starting the event loop thread failed.");
+    ca_loop = 0;
+    return (-1);
+  }
+
+  ca_thread_running = 1;
+  return (0);
+} /* }}} int ca_thread_start */
+
+int curl_async_submit (CURL *curl, curl_async_cb callback, /* {{{ */
+    void *user_data)
+{
+  ca_request_t *req;
+
+  if ((curl == NULL) || (callback == NULL))
+    return (EINVAL);
+
+  pthread_mutex_lock (&ca_lock);
+
+  if (ca_request_find (curl) != NULL)
+  {
+    pthread_mutex_unlock (&ca_lock);
+    return (EBUSY);
+  }
+
+  if (!ca_thread_running && (ca_thread_start () != 0))
+  {
+    pthread_mutex_unlock (&ca_lock);
+    return (-1);
+  }
+
+  req = calloc (1, sizeof (*req));
+  if (req == NULL)
+  {
+    pthread_mutex_unlock (&ca_lock);
+    return (ENOMEM);
+  }
+  req->curl = curl;
+  req->callback = callback;
+  req->user_data = user_data;
+
+  req->next = ca_requests;
+  ca_requests = req;
+
+  ca_wakeup ();
+  pthread_mutex_unlock (&ca_lock);
+
+  return (0);
+} /* }}} int curl_async_submit */
+
+_Bool curl_async_busy (CURL *curl) /* {{{ */
+{
+  _Bool busy;
+
+  pthread_mutex_lock (&ca_lock);
+  busy = (ca_request_find (curl) != NULL);
+  pthread_mutex_unlock (&ca_lock);
+
+  return (busy);
+} /* }}} _Bool curl_async_busy */
+
+void curl_async_cancel (CURL *curl) /* {{{ */
+{
+  ca_request_t *req;
+
+  pthread_mutex_lock (&ca_lock);
+  while ((req = ca_request_find (curl)) != NULL)
+  {
+    if (!ca_thread_running)
+    {
+      ca_request_remove (req);
+      continue;
+    }
+
+    req->cancelled = 1;
+    ca_wakeup ();
+    pthread_cond_wait (&ca_cond, &ca_lock);
+  }
+  pthread_mutex_unlock (&ca_lock);
+} /* }}} void curl_async_cancel */
+
+void curl_async_shutdown (void) /* {{{ */
+{
+  pthread_mutex_lock (&ca_lock);
+  if (ca_thread_running)
+  {
+    ca_loop = 0;
+    ca_wakeup ();
+    pthread_mutex_unlock (&ca_lock);
+
+    pthread_join (ca_thread, /* return = */ NULL);
+
+    pthread_mutex_lock (&ca_lock);
+    ca_thread_running = 0;
+  }
+
+  while (ca_requests != NULL)
+    ca_request_remove (ca_requests);
+
+  if (ca_multi != NULL)
+  {
+    curl_multi_cleanup (ca_multi);
+    ca_multi = NULL;
+  }
+
+  if (ca_wakeup_fd[0] >= 0)
+  {
+    close (ca_wakeup_fd[0]);
+    close (ca_wakeup_fd[1]);
+    ca_wakeup_fd[0] = ca_wakeup_fd[1] = -1;
+  }
+  pthread_mutex_unlock (&ca_lock);
+} /* }}} void curl_async_shutdown */
+
+#else /* !CA_HAVE_MULTI_WAIT */
+
+int curl_async_submit (CURL *curl, curl_async_cb callback, /* {{{ */
+    void *user_data)
+{
+  if ((curl == NULL) || (callback == NULL))
+    return (EINVAL);
+
+  (*callback) (curl, curl_easy_perform (curl), user_data);
+  return (0);
+} /* }}} int curl_async_submit */
+
+_Bool curl_async_busy (CURL __attribute__((unused)) *curl) /* {{{ */
+{
+  return (0);
+} /* }}} _Bool curl_async_busy */
+
+void curl_async_cancel (CURL __attribute__((unused)) *curl) /* {{{ */
+{
+} /* }}} void curl_async_cancel */
+
+void curl_async_shutdown (void) /* {{{ */
+{
+} /* }}} void curl_async_shutdown */
+
+#endif /* !CA_HAVE_MULTI_WAIT */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,63 @@
+/**
+ * collectd - src/utils_curl_async.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_CURL_ASYNC_H
+#define UTILS_CURL_ASYNC_H 1
+
+#include <curl/curl.h>
+
+/*
+ * Asynchronous transfers for the plugins using libcurl.
+ *
+ * Instead of blocking a read thread in curl_easy_perform(), read callbacks
+ * submit their easy handle and return. All transfers of a plugin are run
+ * concurrently by one thread using a curl multi handle. When a transfer has
+ * finished, its callback is called from that thread with the plugin context
+ * of the plugin, so it can parse the response and dispatch values.
+ *
+ * With libcurl versions before 7.28.0, which lack curl_multi_wait(), the
+ * transfers are performed synchronously by curl_async_submit().
+ */
+typedef void (*curl_async_cb) (CURL *curl, CURLcode status,
+    void *user_data);
+
+/* Starts the transfer of `curl'. Returns EBUSY if the previous transfer of
+ * `curl' hasn't finished yet. If the transfer can't be started later on,
+ * `callback' is called with CURLE_FAILED_INIT. The handle, and the buffers its
+ * callbacks write to, must not be used until `callback' has returned or
+ * curl_async_cancel() has been called. */
+int curl_async_submit (CURL *curl, curl_async_cb callback, void *user_data);
+
+/* Returns true if `curl' has been submitted and its callback hasn't returned
+ * yet. Read callbacks use this to skip a read while the previous one is still
+ * in progress. */
+_Bool curl_async_busy (CURL *curl);
+
+/* Aborts the transfer of `curl', if any. If its callback is running, waits
+ * until it has returned. Must be called before `curl' or the user data of
+ * its callback are freed. */
+void curl_async_cancel (CURL *curl);
+
+/* Stops the thread running the transfers and aborts all transfers. */
+void curl_async_shutdown (void);
+
+#endif /* UTILS_CURL_ASYNC_H */
+/* vim: set sw=2 sts=2 et : */
@@ -0,0 +1,433 @@
+/**
+ * collectd - src/utils_format_common.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils_format_common.h"
+
+#ifndef FORMAT_CACHE_SIZE
+# define FORMAT_CACHE_SIZE 1024 /* must be a power of two */
+#endif
+
+/*
+ * Numbers
+ */
+static char const digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+size_t format_uint64 (char *buffer, uint64_t v) /* {{{ */
+{
+  char tmp[FORMAT_UINT64_SIZE];
+  char *ptr = tmp + sizeof (tmp);
+  size_t len;
+
+  /* Two digits at a time, from the right. */
+  while (v >= 100)
+  {
+    unsigned int i = (unsigned int) (v % 100) * 2;
+    v /= 100;
+    ptr -= 2;
+    ptr[0] = digit_pairs[i];
+    ptr[1] = digit_pairs[i + 1];
+  }
+
+  if (v >= 10)
+  {
+    unsigned int i = (unsigned int) v * 2;
+    ptr -= 2;
+    ptr[0] = digit_pairs[i];
+    ptr[1] = digit_pairs[i + 1];
+  }
+  else
+  {
+    ptr--;
+    ptr[0] = (char) ('0' + v);
+  }
+
+  len = (size_t) ((tmp + sizeof (tmp)) - ptr);
+  memcpy (buffer, ptr, len);
+  buffer[len] = 0;
+
+  return (len);
+} /* }}} size_t format_uint64 */
+
+size_t format_int64 (char *buffer, int64_t v) /* {{{ */
+{
+  if (v >= 0)
+    return (format_uint64 (buffer, (uint64_t) v));
+
+  buffer[0] = '-';
+  /* Negate as unsigned so INT64_MIN does not overflow. */
+  return (1 + format_uint64 (buffer + 1, ((uint64_t) 0) - ((uint64_t) v)));
+} /* }}} size_t format_int64 */
+
+static double const powers_of_ten[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,
+  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19
+};
+
+/* Integers up to 2^53 are exact in a double. */
+#define FORMAT_EXACT_INT_MAX 9007199254740992.0
+
+/* Tries to find an integer m and a number of fraction digits k, such that
+ * m / 10^k == v exactly in double arithmetic. Since both m and 10^k are exact
+ * and the division is correctly rounded, strtod() of the resulting decimal
+ * string yields exactly v. The smallest k is the shortest representation in
+ * fixed point notation. */
+static size_t format_double_fixed (char *buffer, double v) /* {{{ */
+{
+  double a = fabs (v);
+  char digits[FORMAT_UINT64_SIZE];
+  size_t digits_len;
+  size_t int_len;
+  char *ptr = buffer;
+  double m = 0.0;
+  int k;
+
+  if ((a < 1e-4) || (a >= 1e15))
+    return (0);
+
+  for (k = 0; k < 16; k++)
+  {
+    m = floor (a * powers_of_ten[k] + 0.5);
+    if (m >= FORMAT_EXACT_INT_MAX)
+      return (0);
+    if ((m / powers_of_ten[k]) == a)
+      break;
+  }
+  if (k >= 16)
+    return (0);
+
+  digits_len = format_uint64 (digits, (uint64_t) m);
+  /* More than 17 significant digits can't be shorter than "%.17g". */
+  if (digits_len > 17)
+    return (0);
+
+  if (v < 0.0)
+    *(ptr++) = '-';
+
+  if ((size_t) k < digits_len)
+  {
+    int_len = digits_len - (size_t) k;
+    memcpy (ptr, digits, int_len);
+    ptr += int_len;
+    if (k > 0)
+    {
+      *(ptr++) = '.';
+      memcpy (ptr, digits + int_len, (size_t) k);
+      ptr += k;
+    }
+  }
+  else
+  {
+    /* 0.000ddd */
+    size_t zeros = (size_t) k - digits_len;
+    *(ptr++) = '0';
+    *(ptr++) = '.';
+    memset (ptr, '0', zeros);
+    ptr += zeros;
+    memcpy (ptr, digits, digits_len);
+    ptr += digits_len;
+  }
+
+  *ptr = 0;
+  return ((size_t) (ptr - buffer));
+} /* }}} size_t format_double_fixed */
+
+size_t format_double (char *buffer, double v) /* {{{ */
+{
+  size_t len;
+  int precision;
+
+  if (isnan (v))
+  {
+    memcpy (buffer, "nan", 4);
+    return (3);
+  }
+  else if (isinf (v))
+  {
+    if (v < 0.0)
+    {
+      memcpy (buffer, "-inf", 5);
+      return (4);
+    }
+    memcpy (buffer, "inf", 4);
+    return (3);
+  }
+  else if (v == 0.0)
+  {
+    if (signbit (v))
+    {
+      memcpy (buffer, "-0", 3);
+      return (2);
+    }
+    memcpy (buffer, "0", 2);
+    return (1);
+  }
+
+  len = format_double_fixed (buffer, v);
+  if (len > 0)
+    return (len);
+
+  /* Slow path: very large or small values and values needing 16 or 17
+   * significant digits. */
+  for (precision = 15; precision < 17; precision++)
+  {
+    snprintf (buffer, FORMAT_DOUBLE_SIZE, "%.*g", precision, v);
+    if (strtod (buffer, NULL) == v)
+      return (strlen (buffer));
+  }
+
+  snprintf (buffer, FORMAT_DOUBLE_SIZE, "%.17g", v);
+  return (strlen (buffer));
+} /* }}} size_t format_double */
+
+/*
+ * Scanning
+ */
+#define SWAR_ONES UINT64_C(0x0101010101010101)
+#define SWAR_HIGH UINT64_C(0x8080808080808080)
+
+/* Non-zero if any byte of x is zero / less than n (n <= 128) / equal to b.
+ * Only the truth value is meaningful, not the position of the set bits. */
+#define SWAR_HAS_ZERO(x) (((x) - SWAR_ONES) & ~(x) & SWAR_HIGH)
+#define SWAR_HAS_LESS(x,n) (((x) - SWAR_ONES * (uint64_t) (n)) & ~(x) & SWAR_HIGH)
+#define SWAR_HAS_BYTE(x,b) SWAR_HAS_ZERO ((x) ^ (SWAR_ONES * (uint64_t) (unsigned char) (b)))
+
+static int format_is_special (char c, char c0, char c1, char c2) /* {{{ */
+{
+  unsigned char u = (unsigned char) c;
+
+  return ((u < 0x20) || (u == 0x7f)
+      || ((c0 != 0) && (c == c0))
+      || ((c1 != 0) && (c == c1))
+      || ((c2 != 0) && (c == c2)));
+} /* }}} int format_is_special */
+
+size_t format_find_special (char const *str, size_t len, /* {{{ */
+    char c0, char c1, char c2)
+{
+  size_t pos = 0;
+
+  /* Whole words only while they are within the string. */
+  while ((len - pos) >= sizeof (uint64_t))
+  {
+    uint64_t w;
+    uint64_t hit;
+
+    memcpy (&w, str + pos, sizeof (w));
+    hit = SWAR_HAS_LESS (w, 0x20) | SWAR_HAS_BYTE (w, 0x7f);
+    if (c0 != 0)
+      hit |= SWAR_HAS_BYTE (w, c0);
+    if (c1 != 0)
+      hit |= SWAR_HAS_BYTE (w, c1);
+    if (c2 != 0)
+      hit |= SWAR_HAS_BYTE (w, c2);
+
+    if (hit != 0)
+      break;
+    pos += sizeof (w);
+  }
+
+  while ((pos < len) && !format_is_special (str[pos], c0, c1, c2))
+    pos++;
+
+  return (pos);
+} /* }}} size_t format_find_special */
+
+/*
+ * Cache
+ */
+struct format_cache_entry_s
+{
+  uint32_t hash;
+  size_t   key_len;
+  size_t   value_len;
+  char    *data; /* key, immediately followed by the value */
+};
+typedef struct format_cache_entry_s format_cache_entry_t;
+
+struct format_cache_s
+{
+  format_cache_entry_t entries[FORMAT_CACHE_SIZE];
+};
+
+static pthread_key_t format_cache_keys[FORMAT_CACHE_NUM];
+static pthread_once_t format_cache_once = PTHREAD_ONCE_INIT;
+
+static void format_cache_destroy (void *arg) /* {{{ */
+{
+  format_cache_t *c = arg;
+  size_t i;
+
+  if (c == NULL)
+    return;
+
+  for (i = 0; i < FORMAT_CACHE_SIZE; i++)
+    free (c->entries[i].data);
+  free (c);
+} /* }}} void format_cache_destroy */
+
+static void format_cache_init (void) /* {{{ */
+{
+  int i;
+
+  for (i = 0; i < FORMAT_CACHE_NUM; i++)
+    pthread_key_create (&format_cache_keys[i], format_cache_destroy);
+} /* }}} void format_cache_init */
+
+format_cache_t *format_cache_get (int id) /* {{{ */
+{
+  format_cache_t *c;
+
+  if ((id < 0) || (id >= FORMAT_CACHE_NUM))
+    return (NULL);
+
+  pthread_once (&format_cache_once, format_cache_init);
+
+  c = pthread_getspecific (format_cache_keys[id]);
+  if (c != NULL)
+    return (c);
+
+  c = calloc (1, sizeof (*c));
+  if (c == NULL)
+    return (NULL);
+
+  if (pthread_setspecific (format_cache_keys[id], c) != 0)
+  {
+    free (c);
+    return (NULL);
+  }
+
+  return (c);
+} /* }}} format_cache_t *format_cache_get */
+
+size_t format_cache_key (char *buffer, size_t buffer_size, ...) /* {{{ */
+{
+  va_list ap;
+  char const *str;
+  size_t pos = 0;
+
+  va_start (ap, buffer_size);
+  while ((str = va_arg (ap, char const *)) != NULL)
+  {
+    size_t len = strlen (str) + 1;
+
+    if ((pos + len) > buffer_size)
+    {
+      va_end (ap);
+      return (0);
+    }
+
+    memcpy (buffer + pos, str, len);
+    pos += len;
+  }
+  va_end (ap);
+
+  return (pos);
+} /* }}} size_t format_cache_key */
+
+/* FNV-1a */
+static uint32_t format_cache_hash (char const *key, size_t key_len) /* {{{ */
+{
+  uint32_t hash = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < key_len; i++)
+  {
+    hash ^= (uint32_t) (unsigned char) key[i];
+    hash *= 16777619U;
+  }
+
+  return (hash);
+} /* }}} uint32_t format_cache_hash */
+
+char const *format_cache_lookup (format_cache_t *c, /* {{{ */
+    char const *key, size_t key_len, size_t *ret_value_len)
+{
+  format_cache_entry_t *e;
+  uint32_t hash;
+
+  if ((c == NULL) || (key_len == 0))
+    return (NULL);
+
+  hash = format_cache_hash (key, key_len);
+  e = c->entries + (hash & (FORMAT_CACHE_SIZE - 1));
+
+  if ((e->data == NULL) || (e->hash != hash) || (e->key_len != key_len)
+      || (memcmp (e->data, key, key_len) != 0))
+    return (NULL);
+
+  *ret_value_len = e->value_len;
+  return (e->data + e->key_len);
+} /* }}} char const *format_cache_lookup */
+
+void format_cache_put (format_cache_t *c, /* {{{ */
+    char const *key, size_t key_len,
+    char const *value, size_t value_len)
+{
+  format_cache_entry_t *e;
+  uint32_t hash;
+  char *data;
+
+  if ((c == NULL) || (key_len == 0))
+    return;
+
+  hash = format_cache_hash (key, key_len);
+  e = c->entries + (hash & (FORMAT_CACHE_SIZE - 1));
+
+  /* Reuse the old allocation if it is large enough. */
+  if ((e->data != NULL) && ((e->key_len + e->value_len) >= (key_len + value_len)))
+    data = e->data;
+  else
+  {
+    data = malloc (key_len + value_len + 1);
+    if (data == NULL)
+      return;
+    free (e->data);
+  }
+
+  memcpy (data, key, key_len);
+  memcpy (data + key_len, value, value_len);
+  data[key_len + value_len] = 0;
+
+  e->data = data;
+  e->hash = hash;
+  e->key_len = key_len;
+  e->value_len = value_len;
+} /* }}} void format_cache_put */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,123 @@
+/**
+ * collectd - src/utils_format_common.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_FORMAT_COMMON_H
+#define UTILS_FORMAT_COMMON_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Helpers shared by the output formatters, e.g. utils_format_graphite.c and
+ * utils_format_json.c. None of these functions allocate memory on the fast
+ * path or call into the printf family.
+ */
+
+/* Minimum buffer sizes for the number formatting functions, including the
+ * terminating null byte. */
+#define FORMAT_UINT64_SIZE 21
+#define FORMAT_DOUBLE_SIZE 32
+
+/*
+ * NAME
+ *   format_uint64, format_int64
+ *
+ * DESCRIPTION
+ *   Writes the decimal representation of `v' to `buffer', which must hold at
+ *   least FORMAT_UINT64_SIZE bytes. The string is null terminated.
+ *
+ * RETURN VALUE
+ *   The length of the string, not counting the null byte.
+ */
+size_t format_uint64 (char *buffer, uint64_t v);
+size_t format_int64 (char *buffer, int64_t v);
+
+/*
+ * NAME
+ *   format_double
+ *
+ * DESCRIPTION
+ *   Writes the shortest decimal representation of `v' that converts back to
+ *   exactly `v' with strtod(3). `buffer' must hold at least
+ *   FORMAT_DOUBLE_SIZE bytes. Values with up to 15 significant digits in the
+ *   range [1e-4, 1e15) are written in fixed point notation without calling
+ *   printf; other values use "%.15g" through "%.17g", whichever is the
+ *   shortest to round-trip. Infinity and NaN are written as "inf", "-inf" and
+ *   "nan".
+ *
+ * RETURN VALUE
+ *   The length of the string, not counting the null byte.
+ */
+size_t format_double (char *buffer, double v);
+
+/*
+ * NAME
+ *   format_find_special
+ *
+ * DESCRIPTION
+ *   Returns the offset of the first of the `len' bytes of `str' which is a
+ *   control character (< 0x20), DEL (0x7f), or equal to one of `c0', `c1'
+ *   and `c2', or `len' if there is no such byte. Pass zero for unused
+ *   characters. `str' is scanned eight bytes at a time, but never beyond
+ *   `len' bytes.
+ */
+size_t format_find_special (char const *str, size_t len,
+    char c0, char c1, char c2);
+
+/*
+ * Format cache
+ *
+ * A small, direct mapped cache mapping series (the raw identifier plus
+ * anything else that influences the output) to a previously formatted
+ * string. Caches are per thread: `format_cache_get' returns the calling
+ * thread's instance for `id', creating it on first use, so no locking is
+ * needed.
+ */
+#define FORMAT_CACHE_GRAPHITE 0
+#define FORMAT_CACHE_JSON     1
+#define FORMAT_CACHE_NUM      2
+
+struct format_cache_s;
+typedef struct format_cache_s format_cache_t;
+
+format_cache_t *format_cache_get (int id);
+
+/* Builds the lookup key of a series from the given strings, separated by
+ * null bytes. Returns the length of the key or zero if it does not fit into
+ * `buffer'. The list of strings is terminated by a NULL pointer. */
+size_t format_cache_key (char *buffer, size_t buffer_size, ...);
+
+/* Returns the cached value for `key' and stores its length in
+ * `ret_value_len', or returns NULL if the key is not in the cache. The
+ * returned pointer is valid until the next call to `format_cache_put' in the
+ * same thread. */
+char const *format_cache_lookup (format_cache_t *c,
+    char const *key, size_t key_len, size_t *ret_value_len);
+
+/* Stores `value' for `key', replacing whatever occupied the slot before.
+ * Failure to allocate memory is not an error; the value is simply not
+ * cached. */
+void format_cache_put (format_cache_t *c,
+    char const *key, size_t key_len,
+    char const *value, size_t value_len);
+
+#endif /* UTILS_FORMAT_COMMON_H */
+/* vim: set sw=2 sts=2 et : */
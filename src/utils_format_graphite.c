@@ -25,6 +25,7 @@
 #include "plugin.h"
 #include "common.h"
 
+#include "utils_format_common.h"
 #include "utils_format_graphite.h"
 #include "utils_cache.h"
 #include "utils_parse_option.h"
@@ -32,140 +33,159 @@
 /* Utils functions to format data sets in graphite format.
  * Largely taken from write_graphite.c as it remains the same formatting */
 
-static int gr_format_values (char *ret, size_t ret_len,
-        int ds_num, const data_set_t *ds, const value_list_t *vl,
-        gauge_t const *rates)
+/* Appends `src' to `dst', replacing dots, whitespace and control characters
+ * with `escape_char'. Returns the number of bytes written. */
+static size_t gr_copy_escape_part (char *dst, const char *src, size_t dst_len,
+    char escape_char)
 {
-    size_t offset = 0;
-    int status;
+    size_t src_len;
+    size_t pos = 0;
 
-    assert (0 == strcmp (ds->type, vl->type));
-
-    memset (ret, 0, ret_len);
-
-#define BUFFER_ADD(...) do { \
-    status = ssnprintf (ret + offset, ret_len - offset, \
-            __VA_ARGS__); \
-    if (status < 1) \
-    { \
-        return (-1); \
-    } \
-    else if (((size_t) status) >= (ret_len - offset)) \
-    { \
-        return (-1); \
-    } \
-    else \
-    offset += ((size_t) status); \
-} while (0)
+    if (src == NULL)
+        return (0);
 
-    if (ds->ds[ds_num].type == DS_TYPE_GAUGE)
-        BUFFER_ADD ("%f", vl->values[ds_num].gauge);
-    else if (rates != NULL)
-        BUFFER_ADD ("%f", rates[ds_num]);
-    else if (ds->ds[ds_num].type == DS_TYPE_COUNTER)
-        BUFFER_ADD ("%llu", vl->values[ds_num].counter);
-    else if (ds->ds[ds_num].type == DS_TYPE_DERIVE)
-        BUFFER_ADD ("%"PRIi64, vl->values[ds_num].derive);
-    else if (ds->ds[ds_num].type == DS_TYPE_ABSOLUTE)
-        BUFFER_ADD ("%"PRIu64, vl->values[ds_num].absolute);
-    else
+    src_len = strlen (src);
+    while (pos < dst_len)
     {
-        ERROR ("gr_format_values plugin: Unknown data source type: %i",
-                ds->ds[ds_num].type);
-        return (-1);
-    }
+        size_t n = format_find_special (src + pos, src_len - pos, '.', ' ', 0);
 
-#undef BUFFER_ADD
+        if (n > (dst_len - pos))
+            n = dst_len - pos;
+        memcpy (dst + pos, src + pos, n);
+        pos += n;
 
-    return (0);
+        if ((pos >= dst_len) || (src[pos] == 0))
+            break;
+
+        dst[pos] = escape_char;
+        pos++;
+    }
+
+    return (pos);
 }
 
-static void gr_copy_escape_part (char *dst, const char *src, size_t dst_len,
-    char escape_char)
+#define GR_APPEND(str, len) do { \
+    if ((size_t) (len) >= (ret_len - pos)) \
+        return (0); \
+    memcpy (ret + pos, (str), (len)); \
+    pos += (len); \
+} while (0)
+
+#define GR_APPEND_ESCAPED(str) do { \
+    pos += gr_copy_escape_part (ret + pos, (str), \
+            (ret_len - pos > DATA_MAX_NAME_LEN) \
+            ? DATA_MAX_NAME_LEN : ret_len - pos - 1, \
+            escape_char); \
+} while (0)
+
+/* Formats the part of the metric name that is the same for all data sources
+ * of a value list, i.e. everything but the data source name. Returns the
+ * length of the name or zero if `ret' is too small. */
+static size_t gr_format_name (char *ret, size_t ret_len,
+        value_list_t const *vl,
+        char const *prefix,
+        char const *postfix,
+        char const escape_char,
+        unsigned int flags)
 {
-    size_t i;
+    char const separator = (flags & GRAPHITE_SEPARATE_INSTANCES) ? '.' : '-';
+    size_t pos = 0;
+
+    if (prefix == NULL)
+        prefix = "";
 
-    memset (dst, 0, dst_len);
+    if (postfix == NULL)
+        postfix = "";
 
-    if (src == NULL)
-        return;
+    GR_APPEND (prefix, strlen (prefix));
+    GR_APPEND_ESCAPED (vl->host);
+    GR_APPEND (postfix, strlen (postfix));
 
-    for (i = 0; i < dst_len; i++)
+    GR_APPEND (".", 1);
+    GR_APPEND_ESCAPED (vl->plugin);
+    if (vl->plugin_instance[0] != 0)
     {
-        if (src[i] == 0)
-        {
-            dst[i] = 0;
-            break;
-        }
+        GR_APPEND (&separator, 1);
+        GR_APPEND_ESCAPED (vl->plugin_instance);
+    }
 
-        if ((src[i] == '.')
-                || isspace ((int) src[i])
-                || iscntrl ((int) src[i]))
-            dst[i] = escape_char;
-        else
-            dst[i] = src[i];
+    GR_APPEND (".", 1);
+    GR_APPEND_ESCAPED (vl->type);
+    if (vl->type_instance[0] != 0)
+    {
+        GR_APPEND (&separator, 1);
+        GR_APPEND_ESCAPED (vl->type_instance);
     }
+
+    ret[pos] = 0;
+    return (pos);
 }
 
-static int gr_format_name (char *ret, int ret_len,
+#undef GR_APPEND_ESCAPED
+#undef GR_APPEND
+
+/* Returns the metric name of `vl', from the calling thread's cache if
+ * possible. `ret' is used as storage if the name is not cached. */
+static char const *gr_get_name (char *ret, size_t ret_len, size_t *ret_name_len,
         value_list_t const *vl,
-        char const *ds_name,
         char const *prefix,
         char const *postfix,
         char const escape_char,
         unsigned int flags)
 {
-    char n_host[DATA_MAX_NAME_LEN];
-    char n_plugin[DATA_MAX_NAME_LEN];
-    char n_plugin_instance[DATA_MAX_NAME_LEN];
-    char n_type[DATA_MAX_NAME_LEN];
-    char n_type_instance[DATA_MAX_NAME_LEN];
+    format_cache_t *cache;
+    char key[10 * DATA_MAX_NAME_LEN];
+    char options[3];
+    char const *name;
+    size_t key_len;
+    size_t name_len;
+
+    options[0] = escape_char;
+    options[1] = (char) ('0' + (flags & 0x0f));
+    options[2] = 0;
+
+    cache = format_cache_get (FORMAT_CACHE_GRAPHITE);
+    key_len = format_cache_key (key, sizeof (key),
+            vl->host, vl->plugin, vl->plugin_instance,
+            vl->type, vl->type_instance,
+            (prefix != NULL) ? prefix : "", (postfix != NULL) ? postfix : "",
+            options, /* sentinel = */ NULL);
+
+    name = format_cache_lookup (cache, key, key_len, &name_len);
+    if (name != NULL)
+    {
+        *ret_name_len = name_len;
+        return (name);
+    }
 
-    char tmp_plugin[2 * DATA_MAX_NAME_LEN + 1];
-    char tmp_type[2 * DATA_MAX_NAME_LEN + 1];
+    name_len = gr_format_name (ret, ret_len, vl, prefix, postfix,
+            escape_char, flags);
+    if (name_len == 0)
+        return (NULL);
 
-    if (prefix == NULL)
-        prefix = "";
+    format_cache_put (cache, key, key_len, ret, name_len);
 
-    if (postfix == NULL)
-        postfix = "";
+    *ret_name_len = name_len;
+    return (ret);
+}
 
-    gr_copy_escape_part (n_host, vl->host,
-            sizeof (n_host), escape_char);
-    gr_copy_escape_part (n_plugin, vl->plugin,
-            sizeof (n_plugin), escape_char);
-    gr_copy_escape_part (n_plugin_instance, vl->plugin_instance,
-            sizeof (n_plugin_instance), escape_char);
-    gr_copy_escape_part (n_type, vl->type,
-            sizeof (n_type), escape_char);
-    gr_copy_escape_part (n_type_instance, vl->type_instance,
-            sizeof (n_type_instance), escape_char);
-
-    if (n_plugin_instance[0] != '\0')
-        ssnprintf (tmp_plugin, sizeof (tmp_plugin), "%s%c%s",
-            n_plugin,
-            (flags & GRAPHITE_SEPARATE_INSTANCES) ? '.' : '-',
-            n_plugin_instance);
-    else
-        sstrncpy (tmp_plugin, n_plugin, sizeof (tmp_plugin));
-
-    if (n_type_instance[0] != '\0')
-        ssnprintf (tmp_type, sizeof (tmp_type), "%s%c%s",
-            n_type,
-            (flags & GRAPHITE_SEPARATE_INSTANCES) ? '.' : '-',
-            n_type_instance);
-    else
-        sstrncpy (tmp_type, n_type, sizeof (tmp_type));
-
-    /* Assert always_append_ds -> ds_name */
-    assert (!(flags & GRAPHITE_ALWAYS_APPEND_DS) || (ds_name != NULL));
-    if (ds_name != NULL)
-        ssnprintf (ret, ret_len, "%s%s%s.%s.%s.%s",
-            prefix, n_host, postfix, tmp_plugin, tmp_type, ds_name);
-    else
-        ssnprintf (ret, ret_len, "%s%s%s.%s.%s",
-            prefix, n_host, postfix, tmp_plugin, tmp_type);
+static size_t gr_format_value (char *ret, int ds_num,
+        const data_set_t *ds, const value_list_t *vl,
+        gauge_t const *rates)
+{
+    if (ds->ds[ds_num].type == DS_TYPE_GAUGE)
+        return (format_double (ret, vl->values[ds_num].gauge));
+    else if (rates != NULL)
+        return (format_double (ret, rates[ds_num]));
+    else if (ds->ds[ds_num].type == DS_TYPE_COUNTER)
+        return (format_uint64 (ret, (uint64_t) vl->values[ds_num].counter));
+    else if (ds->ds[ds_num].type == DS_TYPE_DERIVE)
+        return (format_int64 (ret, vl->values[ds_num].derive));
+    else if (ds->ds[ds_num].type == DS_TYPE_ABSOLUTE)
+        return (format_uint64 (ret, vl->values[ds_num].absolute));
 
+    ERROR ("gr_format_value: Unknown data source type: %i",
+            ds->ds[ds_num].type);
     return (0);
 }
 
@@ -174,60 +194,88 @@ int format_graphite (char *buffer, size_t buffer_size,
     char const *prefix, char const *postfix, char const escape_char,
     unsigned int flags)
 {
-    int status = 0;
+    char name_buffer[10 * DATA_MAX_NAME_LEN];
+    char const *name;
+    size_t name_len;
+    _Bool needs_quoting;
+    char time_str[FORMAT_UINT64_SIZE];
+    size_t time_len;
+    size_t buffer_pos = 0;
     int i;
-    int buffer_pos = 0;
 
     gauge_t *rates = NULL;
+
+    assert (0 == strcmp (ds->type, vl->type));
+
+    name = gr_get_name (name_buffer, sizeof (name_buffer), &name_len,
+            vl, prefix, postfix, escape_char, flags);
+    if (name == NULL)
+    {
+        ERROR ("format_graphite: error with gr_format_name");
+        return (-1);
+    }
+
+    /* The name is quoted if it contains whitespace, quotes or backslashes
+     * (see escape_string()). This only happens if the prefix or postfix
+     * contains such characters. */
+    needs_quoting = (strpbrk (name, " \t\"\\") != NULL);
+
     if (flags & GRAPHITE_STORE_RATES)
       rates = uc_get_rate (ds, vl);
 
+    time_len = format_uint64 (time_str,
+            (uint64_t) (unsigned int) CDTIME_T_TO_TIME_T (vl->time));
+
     for (i = 0; i < ds->ds_num; i++)
     {
         char const *ds_name = NULL;
+        size_t      ds_name_len = 0;
         char        key[10*DATA_MAX_NAME_LEN];
-        char        values[512];
+        char const *key_ptr;
+        size_t      key_len;
+        char        value[FORMAT_DOUBLE_SIZE];
+        size_t      value_len;
         size_t      message_len;
-        char        message[1024];
+        char       *ptr;
 
         if ((flags & GRAPHITE_ALWAYS_APPEND_DS)
             || (ds->ds_num > 1))
+        {
           ds_name = ds->ds[i].name;
+          ds_name_len = strlen (ds_name);
+        }
 
-        /* Copy the identifier to `key' and escape it. */
-        status = gr_format_name (key, sizeof (key), vl, ds_name,
-                    prefix, postfix, escape_char, flags);
-        if (status != 0)
+        if (needs_quoting)
         {
-            ERROR ("format_graphite: error with gr_format_name");
-            sfree (rates);
-            return (status);
+            /* Rare, slow path. */
+            if (ds_name != NULL)
+                ssnprintf (key, sizeof (key), "%s.%s", name, ds_name);
+            else
+                sstrncpy (key, name, sizeof (key));
+            escape_string (key, sizeof (key));
+            key_ptr = key;
+            key_len = strlen (key);
+            ds_name = NULL;
+            ds_name_len = 0;
         }
-
-        escape_string (key, sizeof (key));
-        /* Convert the values to an ASCII representation and put that into
-         * `values'. */
-        status = gr_format_values (values, sizeof (values), i, ds, vl, rates);
-        if (status != 0)
+        else
         {
-            ERROR ("format_graphite: error with gr_format_values");
-            sfree (rates);
-            return (status);
+            key_ptr = name;
+            key_len = name_len;
         }
 
-        /* Compute the graphite command */
-        message_len = (size_t) ssnprintf (message, sizeof (message),
-                "%s %s %u\r\n",
-                key,
-                values,
-                (unsigned int) CDTIME_T_TO_TIME_T (vl->time));
-        if (message_len >= sizeof (message)) {
-            ERROR ("format_graphite: message buffer too small: "
-                    "Need %zu bytes.", message_len + 1);
+        value_len = gr_format_value (value, i, ds, vl, rates);
+        if (value_len == 0)
+        {
+            ERROR ("format_graphite: error with gr_format_value");
             sfree (rates);
-            return (-ENOMEM);
+            return (-1);
         }
 
+        /* "<key>[.<ds_name>] <value> <time>\r\n" */
+        message_len = key_len + ((ds_name != NULL) ? (1 + ds_name_len) : 0)
+            + 1 + value_len + 1 + time_len + 2;
+
         /* Append it in case we got multiple data set */
         if ((buffer_pos + message_len) >= buffer_size)
         {
@@ -235,11 +283,30 @@ int format_graphite (char *buffer, size_t buffer_size,
             sfree (rates);
             return (-ENOMEM);
         }
-        memcpy((void *) (buffer + buffer_pos), message, message_len);
+
+        ptr = buffer + buffer_pos;
+        memcpy (ptr, key_ptr, key_len);
+        ptr += key_len;
+        if (ds_name != NULL)
+        {
+            *(ptr++) = '.';
+            memcpy (ptr, ds_name, ds_name_len);
+            ptr += ds_name_len;
+        }
+        *(ptr++) = ' ';
+        memcpy (ptr, value, value_len);
+        ptr += value_len;
+        *(ptr++) = ' ';
+        memcpy (ptr, time_str, time_len);
+        ptr += time_len;
+        *(ptr++) = '\r';
+        *(ptr++) = '\n';
+        *ptr = 0;
+
         buffer_pos += message_len;
     }
     sfree (rates);
-    return (status);
+    return (0);
 } /* int format_graphite */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -24,11 +24,16 @@
 #include "common.h"
 
 #include "utils_cache.h"
+#include "utils_format_common.h"
 #include "utils_format_json.h"
 
+/* Writes `string' as a quoted JSON string. Quotes and backslashes are
+ * escaped, control characters are replaced with question marks. Returns
+ * the length of the result, not counting the null byte, or -ENOMEM. */
 static int escape_string (char *buffer, size_t buffer_size, /* {{{ */
     const char *string)
 {
+  size_t src_len;
   size_t src_pos;
   size_t dst_pos;
 
@@ -51,106 +56,45 @@ static int escape_string (char *buffer, size_t buffer_size, /* {{{ */
 
   /* Escape special characters */
   BUFFER_ADD ('"');
-  for (src_pos = 0; string[src_pos] != 0; src_pos++)
+  src_len = strlen (string);
+  src_pos = 0;
+  while (42)
   {
-    if ((string[src_pos] == '"')
+    /* Copy runs of plain characters in one go. */
+    size_t n = format_find_special (string + src_pos, src_len - src_pos,
+        '"', '\\', 0);
+
+    if (n >= (buffer_size - 1 - dst_pos))
+    {
+      buffer[buffer_size - 1] = 0;
+      return (-ENOMEM);
+    }
+    memcpy (buffer + dst_pos, string + src_pos, n);
+    dst_pos += n;
+    src_pos += n;
+
+    if (string[src_pos] == 0)
+      break;
+    else if ((string[src_pos] == '"')
         || (string[src_pos] == '\\'))
     {
       BUFFER_ADD ('\\');
       BUFFER_ADD (string[src_pos]);
     }
-    else if (string[src_pos] <= 0x001F)
-      BUFFER_ADD ('?');
-    else
+    else if (string[src_pos] == 0x7f)
       BUFFER_ADD (string[src_pos]);
-  } /* for */
+    else
+      BUFFER_ADD ('?');
+    src_pos++;
+  }
   BUFFER_ADD ('"');
   buffer[dst_pos] = 0;
 
 #undef BUFFER_ADD
 
-  return (0);
+  return ((int) dst_pos);
 } /* }}} int escape_string */
 
-static int values_to_json (char *buffer, size_t buffer_size, /* {{{ */
-                const data_set_t *ds, const value_list_t *vl, int store_rates)
-{
-  size_t offset = 0;
-  int i;
-  gauge_t *rates = NULL;
-
-  memset (buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...) do { \
-  int status; \
-  status = ssnprintf (buffer + offset, buffer_size - offset, \
-      __VA_ARGS__); \
-  if (status < 1) \
-  { \
-    sfree(rates); \
-    return (-1); \
-  } \
-  else if (((size_t) status) >= (buffer_size - offset)) \
-  { \
-    sfree(rates); \
-    return (-ENOMEM); \
-  } \
-  else \
-    offset += ((size_t) status); \
-} while (0)
-
-  BUFFER_ADD ("[");
-  for (i = 0; i < ds->ds_num; i++)
-  {
-    if (i > 0)
-      BUFFER_ADD (",");
-
-    if (ds->ds[i].type == DS_TYPE_GAUGE)
-    {
-      if(isfinite (vl->values[i].gauge))
-        BUFFER_ADD ("%g", vl->values[i].gauge);
-      else
-        BUFFER_ADD ("null");
-    }
-    else if (store_rates)
-    {
-      if (rates == NULL)
-        rates = uc_get_rate (ds, vl);
-      if (rates == NULL)
-      {
-        WARNING ("utils_format_json: uc_get_rate failed.");
-        sfree(rates);
-        return (-1);
-      }
-
-      if(isfinite (rates[i]))
-        BUFFER_ADD ("%g", rates[i]);
-      else
-        BUFFER_ADD ("null");
-    }
-    else if (ds->ds[i].type == DS_TYPE_COUNTER)
-      BUFFER_ADD ("%llu", vl->values[i].counter);
-    else if (ds->ds[i].type == DS_TYPE_DERIVE)
-      BUFFER_ADD ("%"PRIi64, vl->values[i].derive);
-    else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
-      BUFFER_ADD ("%"PRIu64, vl->values[i].absolute);
-    else
-    {
-      ERROR ("format_json: Unknown data source type: %i",
-          ds->ds[i].type);
-      sfree (rates);
-      return (-1);
-    }
-  } /* for ds->ds_num */
-  BUFFER_ADD ("]");
-
-#undef BUFFER_ADD
-
-  DEBUG ("format_json: values_to_json: buffer = %s;", buffer);
-  sfree(rates);
-  return (0);
-} /* }}} int values_to_json */
-
 static int dstypes_to_json (char *buffer, size_t buffer_size, /* {{{ */
                 const data_set_t *ds)
 {
@@ -260,7 +204,8 @@ static int meta_data_to_json (char *buffer, size_t buffer_size, /* {{{ */
       if (meta_data_get_string (meta, key, &value) == 0)
       {
         char temp[512] = "";
-        escape_string (temp, sizeof (temp), value);
+        if (escape_string (temp, sizeof (temp), value) < 0)
+          sstrncpy (temp, "null", sizeof (temp));
         sfree (value);
         BUFFER_ADD (",\"%s\":%s", key, temp);
       }
@@ -305,15 +250,17 @@ static int meta_data_to_json (char *buffer, size_t buffer_size, /* {{{ */
   return (0);
 } /* int meta_data_to_json */
 
-static int value_list_to_json (char *buffer, size_t buffer_size, /* {{{ */
-                const data_set_t *ds, const value_list_t *vl, int store_rates)
+/* Formats the parts of a value list that don't change from one interval to
+ * the next: `,"dstypes":[...],"dsnames":[...]' and `,"host":...,
+ * "type_instance":...'. Both are stored in `buffer', separated by a null
+ * byte. Returns the total length or a negative value on error. */
+static int identifier_to_json (char *buffer, size_t buffer_size, /* {{{ */
+    const data_set_t *ds, const value_list_t *vl, size_t *ret_ds_len)
 {
   char temp[512];
   size_t offset = 0;
   int status;
 
-  memset (buffer, 0, buffer_size);
-
 #define BUFFER_ADD(...) do { \
   status = ssnprintf (buffer + offset, buffer_size - offset, \
       __VA_ARGS__); \
@@ -325,15 +272,6 @@ static int value_list_to_json (char *buffer, size_t buffer_size, /* {{{ */
     offset += ((size_t) status); \
 } while (0)
 
-  /* All value lists have a leading comma. The first one will be replaced with
-   * a square bracket in `format_json_finalize'. */
-  BUFFER_ADD (",{");
-
-  status = values_to_json (temp, sizeof (temp), ds, vl, store_rates);
-  if (status != 0)
-    return (status);
-  BUFFER_ADD ("\"values\":%s", temp);
-
   status = dstypes_to_json (temp, sizeof (temp), ds);
   if (status != 0)
     return (status);
@@ -344,12 +282,15 @@ static int value_list_to_json (char *buffer, size_t buffer_size, /* {{{ */
     return (status);
   BUFFER_ADD (",\"dsnames\":%s", temp);
 
-  BUFFER_ADD (",\"time\":%.3f", CDTIME_T_TO_DOUBLE (vl->time));
-  BUFFER_ADD (",\"interval\":%.3f", CDTIME_T_TO_DOUBLE (vl->interval));
+  *ret_ds_len = offset;
+  /* The separating null byte. */
+  offset++;
+  if (offset >= buffer_size)
+    return (-ENOMEM);
 
 #define BUFFER_ADD_KEYVAL(key, value) do { \
   status = escape_string (temp, sizeof (temp), (value)); \
-  if (status != 0) \
+  if (status < 0) \
     return (status); \
   BUFFER_ADD (",\"%s\":%s", (key), temp); \
 } while (0)
@@ -360,6 +301,150 @@ static int value_list_to_json (char *buffer, size_t buffer_size, /* {{{ */
   BUFFER_ADD_KEYVAL ("type", vl->type);
   BUFFER_ADD_KEYVAL ("type_instance", vl->type_instance);
 
+#undef BUFFER_ADD_KEYVAL
+#undef BUFFER_ADD
+
+  return ((int) offset);
+} /* }}} int identifier_to_json */
+
+/* Formats a time as seconds with three decimal places, like "%.3f" does. */
+static size_t cdtime_to_json (char *buffer, cdtime_t t) /* {{{ */
+{
+  uint64_t seconds = CDTIME_T_TO_TIME_T (t);
+  uint64_t ms = (((uint64_t) t & 0x3fffffff) * 1000 + 0x20000000) >> 30;
+  size_t len;
+
+  if (ms >= 1000)
+  {
+    seconds++;
+    ms -= 1000;
+  }
+
+  len = format_uint64 (buffer, seconds);
+  buffer[len] = '.';
+  buffer[len + 1] = (char) ('0' + (ms / 100));
+  buffer[len + 2] = (char) ('0' + ((ms / 10) % 10));
+  buffer[len + 3] = (char) ('0' + (ms % 10));
+  buffer[len + 4] = 0;
+
+  return (len + 4);
+} /* }}} size_t cdtime_to_json */
+
+static int value_list_to_json (char *buffer, size_t buffer_size, /* {{{ */
+                const data_set_t *ds, const value_list_t *vl, int store_rates)
+{
+  format_cache_t *cache;
+  char key[6 * DATA_MAX_NAME_LEN];
+  size_t key_len;
+  char ident_buffer[4096];
+  char const *ident;
+  size_t ident_len;
+  size_t ds_len;
+  gauge_t *rates = NULL;
+  char number[FORMAT_DOUBLE_SIZE];
+  size_t offset = 0;
+  int status;
+  int i;
+
+#define BUFFER_ADD(str, len) do { \
+  if ((len) >= (buffer_size - offset)) \
+  { \
+    sfree (rates); \
+    return (-ENOMEM); \
+  } \
+  memcpy (buffer + offset, (str), (len)); \
+  offset += (len); \
+} while (0)
+#define BUFFER_ADD_STR(str) BUFFER_ADD ((str), sizeof (str) - 1)
+
+  /* The parts describing the identifier are cached per thread, so on the
+   * fast path only the values and times are formatted. */
+  cache = format_cache_get (FORMAT_CACHE_JSON);
+  key_len = format_cache_key (key, sizeof (key),
+      vl->host, vl->plugin, vl->plugin_instance,
+      vl->type, vl->type_instance, /* sentinel = */ NULL);
+
+  ident = format_cache_lookup (cache, key, key_len, &ident_len);
+  if (ident == NULL)
+  {
+    status = identifier_to_json (ident_buffer, sizeof (ident_buffer),
+        ds, vl, &ds_len);
+    if (status < 0)
+      return (status);
+    ident = ident_buffer;
+    ident_len = (size_t) status;
+    format_cache_put (cache, key, key_len, ident, ident_len);
+  }
+  else
+    ds_len = strlen (ident);
+
+  /* All value lists have a leading comma. The first one will be replaced with
+   * a square bracket in `format_json_finalize'. */
+  BUFFER_ADD_STR (",{\"values\":[");
+
+  for (i = 0; i < ds->ds_num; i++)
+  {
+    size_t len;
+
+    if (i > 0)
+      BUFFER_ADD_STR (",");
+
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+    {
+      if (isfinite (vl->values[i].gauge))
+        len = format_double (number, vl->values[i].gauge);
+      else
+      {
+        sstrncpy (number, "null", sizeof (number));
+        len = 4;
+      }
+    }
+    else if (store_rates)
+    {
+      if (rates == NULL)
+        rates = uc_get_rate (ds, vl);
+      if (rates == NULL)
+      {
+        WARNING ("utils_format_json: uc_get_rate failed.");
+        return (-1);
+      }
+
+      if (isfinite (rates[i]))
+        len = format_double (number, rates[i]);
+      else
+      {
+        sstrncpy (number, "null", sizeof (number));
+        len = 4;
+      }
+    }
+    else if (ds->ds[i].type == DS_TYPE_COUNTER)
+      len = format_uint64 (number, (uint64_t) vl->values[i].counter);
+    else if (ds->ds[i].type == DS_TYPE_DERIVE)
+      len = format_int64 (number, vl->values[i].derive);
+    else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
+      len = format_uint64 (number, vl->values[i].absolute);
+    else
+    {
+      ERROR ("format_json: Unknown data source type: %i",
+          ds->ds[i].type);
+      sfree (rates);
+      return (-1);
+    }
+
+    BUFFER_ADD (number, len);
+  } /* for ds->ds_num */
+  BUFFER_ADD_STR ("]");
+  sfree (rates);
+
+  BUFFER_ADD (ident, ds_len);
+
+  BUFFER_ADD_STR (",\"time\":");
+  BUFFER_ADD (number, cdtime_to_json (number, vl->time));
+  BUFFER_ADD_STR (",\"interval\":");
+  BUFFER_ADD (number, cdtime_to_json (number, vl->interval));
+
+  BUFFER_ADD (ident + ds_len + 1, ident_len - ds_len - 1);
+
   if (vl->meta != NULL)
   {
     char meta_buffer[buffer_size];
@@ -368,12 +453,14 @@ static int value_list_to_json (char *buffer, size_t buffer_size, /* {{{ */
     if (status != 0)
       return (status);
 
-    BUFFER_ADD (",\"meta\":%s", meta_buffer);
+    BUFFER_ADD_STR (",\"meta\":");
+    BUFFER_ADD (meta_buffer, strlen (meta_buffer));
   } /* if (vl->meta != NULL) */
 
-  BUFFER_ADD ("}");
+  BUFFER_ADD_STR ("}");
+  buffer[offset] = 0;
 
-#undef BUFFER_ADD_KEYVAL
+#undef BUFFER_ADD_STR
 #undef BUFFER_ADD
 
   DEBUG ("format_json: value_list_to_json: buffer = %s;", buffer);
@@ -386,17 +473,22 @@ static int format_json_value_list_nocheck (char *buffer, /* {{{ */
     const data_set_t *ds, const value_list_t *vl,
     int store_rates, size_t temp_size)
 {
-  char temp[temp_size];
+  size_t len;
   int status;
 
-  status = value_list_to_json (temp, sizeof (temp), ds, vl, store_rates);
+  /* Format directly into the output buffer. On error, the buffer is
+   * terminated at the old fill level again. */
+  status = value_list_to_json (buffer + (*ret_buffer_fill), temp_size,
+      ds, vl, store_rates);
   if (status != 0)
+  {
+    buffer[*ret_buffer_fill] = 0;
     return (status);
-  temp_size = strlen (temp);
+  }
+  len = strlen (buffer + (*ret_buffer_fill));
 
-  memcpy (buffer + (*ret_buffer_fill), temp, temp_size + 1);
-  (*ret_buffer_fill) += temp_size;
-  (*ret_buffer_free) -= temp_size;
+  (*ret_buffer_fill) += len;
+  (*ret_buffer_free) -= len;
 
   return (0);
 } /* }}} int format_json_value_list_nocheck */
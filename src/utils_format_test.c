@@ -0,0 +1,541 @@
+/**
+ * collectd - src/utils_format_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Tests for the output formatters and a benchmark comparing them with the
+ * printf based implementation they replaced. Run with "-b" to run the
+ * benchmark, too.
+ */
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_cache.h"
+#include "utils_format_common.h"
+#include "utils_format_graphite.h"
+#include "utils_format_json.h"
+#include "utils_parse_option.h"
+
+#include <time.h>
+
+/*
+ * Stubs for the daemon functions used by the formatters.
+ */
+void plugin_log (int level, const char *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  if (level >= LOG_DEBUG)
+    return;
+
+  va_start (ap, format);
+  printf ("[severity %i] ", level);
+  vprintf (format, ap);
+  printf ("\n");
+  va_end (ap);
+} /* }}} void plugin_log */
+
+int ssnprintf (char *dest, size_t n, const char *format, ...) /* {{{ */
+{
+  int ret;
+  va_list ap;
+
+  va_start (ap, format);
+  ret = vsnprintf (dest, n, format, ap);
+  dest[n - 1] = 0;
+  va_end (ap);
+
+  return (ret);
+} /* }}} int ssnprintf */
+
+char *sstrncpy (char *dest, const char *src, size_t n) /* {{{ */
+{
+  snprintf (dest, n, "%s", src);
+  return (dest);
+} /* }}} char *sstrncpy */
+
+gauge_t *uc_get_rate (const data_set_t *ds, const value_list_t *vl) /* {{{ */
+{
+  return (NULL);
+} /* }}} gauge_t *uc_get_rate */
+
+/*
+ * Test data
+ */
+static data_source_t dsrc_load[3] =
+{
+  { "shortterm", DS_TYPE_GAUGE, 0.0, NAN },
+  { "midterm",   DS_TYPE_GAUGE, 0.0, NAN },
+  { "longterm",  DS_TYPE_GAUGE, 0.0, NAN }
+};
+static data_set_t const ds_load = { "load", 3, dsrc_load };
+
+static data_source_t dsrc_derive = { "value", DS_TYPE_DERIVE, 0.0, NAN };
+static data_set_t const ds_derive = { "derive", 1, &dsrc_derive };
+
+static void init_vl (value_list_t *vl, value_t *values, /* {{{ */
+    char const *host, char const *plugin, char const *plugin_instance,
+    char const *type, char const *type_instance)
+{
+  memset (vl, 0, sizeof (*vl));
+  vl->values = values;
+  sstrncpy (vl->host, host, sizeof (vl->host));
+  sstrncpy (vl->plugin, plugin, sizeof (vl->plugin));
+  sstrncpy (vl->plugin_instance, plugin_instance, sizeof (vl->plugin_instance));
+  sstrncpy (vl->type, type, sizeof (vl->type));
+  sstrncpy (vl->type_instance, type_instance, sizeof (vl->type_instance));
+  vl->time = TIME_T_TO_CDTIME_T (1380000000) + MS_TO_CDTIME_T (250);
+  vl->interval = TIME_T_TO_CDTIME_T (10);
+} /* }}} void init_vl */
+
+#define CHECK_STR(expect, actual) do { \
+  if (strcmp ((expect), (actual)) != 0) \
+  { \
+    printf ("%s:%i: expected \"%s\", got \"%s\"\n", \
+        __FILE__, __LINE__, (expect), (actual)); \
+    exit (EXIT_FAILURE); \
+  } \
+} while (0)
+
+/*
+ * Tests
+ */
+static void test_integers (void) /* {{{ */
+{
+  uint64_t const uvalues[] = { 0, 1, 9, 10, 99, 100, 12345, 4294967295ULL,
+    10000000000000000000ULL, 18446744073709551615ULL };
+  int64_t const ivalues[] = { 0, -1, 42, -100, INT64_MAX, INT64_MIN };
+  char buffer[FORMAT_UINT64_SIZE];
+  char expect[64];
+  size_t i;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (uvalues); i++)
+  {
+    format_uint64 (buffer, uvalues[i]);
+    snprintf (expect, sizeof (expect), "%"PRIu64, uvalues[i]);
+    CHECK_STR (expect, buffer);
+  }
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (ivalues); i++)
+  {
+    format_int64 (buffer, ivalues[i]);
+    snprintf (expect, sizeof (expect), "%"PRIi64, ivalues[i]);
+    CHECK_STR (expect, buffer);
+  }
+} /* }}} void test_integers */
+
+static void test_doubles (void) /* {{{ */
+{
+  char buffer[FORMAT_DOUBLE_SIZE];
+  char expect[64];
+  int i;
+
+  format_double (buffer, 0.0);            CHECK_STR ("0", buffer);
+  format_double (buffer, 42.0);           CHECK_STR ("42", buffer);
+  format_double (buffer, -0.5);           CHECK_STR ("-0.5", buffer);
+  format_double (buffer, 0.1);            CHECK_STR ("0.1", buffer);
+  format_double (buffer, 123.456);        CHECK_STR ("123.456", buffer);
+  format_double (buffer, 0.00025);        CHECK_STR ("0.00025", buffer);
+  format_double (buffer, 0.1 + 0.2);      CHECK_STR ("0.30000000000000004", buffer);
+  format_double (buffer, 1e20);           CHECK_STR ("1e+20", buffer);
+  format_double (buffer, NAN);            CHECK_STR ("nan", buffer);
+  format_double (buffer, -INFINITY);      CHECK_STR ("-inf", buffer);
+
+  /* Random values must round-trip and must not be longer than "%.17g". */
+  srand (42);
+  for (i = 0; i < 100000; i++)
+  {
+    double v;
+
+    if (i % 2)
+      v = ((double) rand ()) / ((double) (rand () + 1)) * 1000.0;
+    else
+      v = ((double) (rand () % 1000000)) / 1000.0;
+    if (i % 3 == 0)
+      v = -v;
+
+    format_double (buffer, v);
+    snprintf (expect, sizeof (expect), "%.17g", v);
+    if ((strtod (buffer, NULL) != v) || (strlen (buffer) > strlen (expect)))
+    {
+      printf ("format_double (%.17g) = \"%s\"\n", v, buffer);
+      exit (EXIT_FAILURE);
+    }
+  }
+} /* }}} void test_doubles */
+
+/* The scanner must neither miss a special byte at any position nor read
+ * beyond `len' bytes. The buffers have exactly `len' bytes and no null
+ * byte, so reading past them is caught by tools like valgrind. */
+static void test_find_special (void) /* {{{ */
+{
+  char const special[] = { 0, '\n', 0x1f, 0x7f, '.', ' ' };
+  size_t len;
+  size_t i;
+  size_t j;
+
+  for (len = 0; len <= 40; len++)
+  {
+    char *buffer = malloc ((len > 0) ? len : 1);
+    size_t n;
+
+    if (buffer == NULL)
+    {
+      printf ("%s:%i: malloc failed\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+
+    /* No special byte, at every offset of the scan start. */
+    memset (buffer, 'a', len);
+    for (i = 0; i <= len; i++)
+    {
+      n = format_find_special (buffer + i, len - i, '.', ' ', 0);
+      if (n != len - i)
+      {
+        printf ("%s:%i: len %zu, offset %zu: expected %zu, got %zu\n",
+            __FILE__, __LINE__, len, i, len - i, n);
+        exit (EXIT_FAILURE);
+      }
+    }
+
+    /* One special byte at every position. */
+    for (i = 0; i < len; i++)
+    {
+      for (j = 0; j < STATIC_ARRAY_SIZE (special); j++)
+      {
+        memset (buffer, 'a', len);
+        buffer[i] = special[j];
+        n = format_find_special (buffer, len, '.', ' ', 0);
+        if (n != i)
+        {
+          printf ("%s:%i: len %zu, byte 0x%02x at %zu: got %zu\n",
+              __FILE__, __LINE__, len, (unsigned int) special[j], i, n);
+          exit (EXIT_FAILURE);
+        }
+      }
+    }
+
+    free (buffer);
+  }
+} /* }}} void test_find_special */
+
+static void test_graphite (void) /* {{{ */
+{
+  value_list_t vl;
+  value_t values[3];
+  char buffer[1024];
+  int status;
+
+  values[0].gauge = 0.5;
+  values[1].gauge = 1.25;
+  values[2].gauge = NAN;
+  init_vl (&vl, values, "example.com", "load", "", "load", "");
+
+  memset (buffer, 0, sizeof (buffer));
+  status = format_graphite (buffer, sizeof (buffer), &ds_load, &vl,
+      "collectd.", NULL, '_', 0);
+  assert (status == 0);
+  CHECK_STR ("collectd.example_com.load.load.shortterm 0.5 1380000000\r\n"
+      "collectd.example_com.load.load.midterm 1.25 1380000000\r\n"
+      "collectd.example_com.load.load.longterm nan 1380000000\r\n", buffer);
+
+  values[0].derive = -42;
+  init_vl (&vl, values, "host", "cpu", "0", "derive", "user time");
+
+  /* Twice, to test the cached name, too. */
+  memset (buffer, 0, sizeof (buffer));
+  status = format_graphite (buffer, sizeof (buffer), &ds_derive, &vl,
+      NULL, NULL, '_', GRAPHITE_SEPARATE_INSTANCES);
+  assert (status == 0);
+  CHECK_STR ("host.cpu.0.derive.user_time -42 1380000000\r\n", buffer);
+
+  memset (buffer, 0, sizeof (buffer));
+  status = format_graphite (buffer, sizeof (buffer), &ds_derive, &vl,
+      NULL, NULL, '_', GRAPHITE_SEPARATE_INSTANCES);
+  assert (status == 0);
+  CHECK_STR ("host.cpu.0.derive.user_time -42 1380000000\r\n", buffer);
+
+  /* Different options must not use the cached name. */
+  memset (buffer, 0, sizeof (buffer));
+  status = format_graphite (buffer, sizeof (buffer), &ds_derive, &vl,
+      NULL, NULL, '-', GRAPHITE_ALWAYS_APPEND_DS);
+  assert (status == 0);
+  CHECK_STR ("host.cpu-0.derive-user-time.value -42 1380000000\r\n", buffer);
+
+  /* Too small a buffer. */
+  status = format_graphite (buffer, 20, &ds_derive, &vl,
+      NULL, NULL, '_', 0);
+  assert (status != 0);
+} /* }}} void test_graphite */
+
+static void test_json (void) /* {{{ */
+{
+  value_list_t vl;
+  value_t values[3];
+  char buffer[1024];
+  size_t fill = 0;
+  size_t bfree = sizeof (buffer);
+  int status;
+
+  values[0].gauge = 0.5;
+  values[1].gauge = 1.25;
+  values[2].gauge = NAN;
+  init_vl (&vl, values, "example.com", "load", "", "load", "\"quoted\"");
+
+  format_json_initialize (buffer, &fill, &bfree);
+  status = format_json_value_list (buffer, &fill, &bfree, &ds_load, &vl, 0);
+  assert (status == 0);
+  status = format_json_value_list (buffer, &fill, &bfree, &ds_load, &vl, 0);
+  assert (status == 0);
+  format_json_finalize (buffer, &fill, &bfree);
+
+#define EXPECT_JSON "{\"values\":[0.5,1.25,null]," \
+  "\"dstypes\":[\"gauge\",\"gauge\",\"gauge\"]," \
+  "\"dsnames\":[\"shortterm\",\"midterm\",\"longterm\"]," \
+  "\"time\":1380000000.250,\"interval\":10.000," \
+  "\"host\":\"example.com\",\"plugin\":\"load\",\"plugin_instance\":\"\"," \
+  "\"type\":\"load\",\"type_instance\":\"\\\"quoted\\\"\"}"
+  CHECK_STR ("[" EXPECT_JSON "," EXPECT_JSON "]", buffer);
+  assert (fill == strlen (buffer));
+  assert (fill + bfree == sizeof (buffer));
+
+  /* Running out of space must leave the buffer intact. */
+  do
+    status = format_json_value_list (buffer, &fill, &bfree, &ds_load, &vl, 0);
+  while (status == 0);
+  assert (status == -ENOMEM);
+  assert (fill == strlen (buffer));
+} /* }}} void test_json */
+
+/*
+ * Benchmark
+ *
+ * The "legacy" functions are the printf based implementations the
+ * formatters used before, kept here for comparison.
+ */
+static int legacy_graphite (char *buffer, size_t buffer_size, /* {{{ */
+    data_set_t const *ds, value_list_t const *vl,
+    char const *prefix, char escape_char)
+{
+  size_t buffer_pos = 0;
+  int i;
+
+  for (i = 0; i < ds->ds_num; i++)
+  {
+    char parts[5][DATA_MAX_NAME_LEN];
+    char const *src[5] = { vl->host, vl->plugin, vl->plugin_instance,
+      vl->type, vl->type_instance };
+    char tmp_plugin[2 * DATA_MAX_NAME_LEN + 1];
+    char tmp_type[2 * DATA_MAX_NAME_LEN + 1];
+    char key[10 * DATA_MAX_NAME_LEN];
+    char values[512];
+    char message[1024];
+    size_t message_len;
+    int j;
+    size_t k;
+
+    for (j = 0; j < 5; j++)
+    {
+      memset (parts[j], 0, sizeof (parts[j]));
+      for (k = 0; (k < sizeof (parts[j])) && (src[j][k] != 0); k++)
+        parts[j][k] = ((src[j][k] == '.') || isspace ((int) src[j][k])
+            || iscntrl ((int) src[j][k])) ? escape_char : src[j][k];
+    }
+
+    if (parts[2][0] != 0)
+      ssnprintf (tmp_plugin, sizeof (tmp_plugin), "%s-%s", parts[1], parts[2]);
+    else
+      sstrncpy (tmp_plugin, parts[1], sizeof (tmp_plugin));
+    if (parts[4][0] != 0)
+      ssnprintf (tmp_type, sizeof (tmp_type), "%s-%s", parts[3], parts[4]);
+    else
+      sstrncpy (tmp_type, parts[3], sizeof (tmp_type));
+
+    ssnprintf (key, sizeof (key), "%s%s.%s.%s.%s", prefix, parts[0],
+        tmp_plugin, tmp_type, ds->ds[i].name);
+    escape_string (key, sizeof (key));
+
+    memset (values, 0, sizeof (values));
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      ssnprintf (values, sizeof (values), "%f", vl->values[i].gauge);
+    else
+      ssnprintf (values, sizeof (values), "%"PRIi64, vl->values[i].derive);
+
+    message_len = (size_t) ssnprintf (message, sizeof (message),
+        "%s %s %u\r\n", key, values,
+        (unsigned int) CDTIME_T_TO_TIME_T (vl->time));
+    if ((buffer_pos + message_len) >= buffer_size)
+      return (-ENOMEM);
+    memcpy (buffer + buffer_pos, message, message_len);
+    buffer_pos += message_len;
+  }
+
+  return (0);
+} /* }}} int legacy_graphite */
+
+static int legacy_json (char *buffer, size_t buffer_size, /* {{{ */
+    data_set_t const *ds, value_list_t const *vl)
+{
+  char values[512];
+  char types[512];
+  char names[512];
+  char ident[5][512];
+  char const *src[5] = { vl->host, vl->plugin, vl->plugin_instance,
+    vl->type, vl->type_instance };
+  size_t offset;
+  int i;
+  int j;
+
+  memset (values, 0, sizeof (values));
+  offset = (size_t) ssnprintf (values, sizeof (values), "[");
+  for (i = 0; i < ds->ds_num; i++)
+    offset += (size_t) ssnprintf (values + offset, sizeof (values) - offset,
+        "%s%g", (i > 0) ? "," : "", vl->values[i].gauge);
+  ssnprintf (values + offset, sizeof (values) - offset, "]");
+
+  memset (types, 0, sizeof (types));
+  offset = (size_t) ssnprintf (types, sizeof (types), "[");
+  for (i = 0; i < ds->ds_num; i++)
+    offset += (size_t) ssnprintf (types + offset, sizeof (types) - offset,
+        "%s\"%s\"", (i > 0) ? "," : "", DS_TYPE_TO_STRING (ds->ds[i].type));
+  ssnprintf (types + offset, sizeof (types) - offset, "]");
+
+  memset (names, 0, sizeof (names));
+  offset = (size_t) ssnprintf (names, sizeof (names), "[");
+  for (i = 0; i < ds->ds_num; i++)
+    offset += (size_t) ssnprintf (names + offset, sizeof (names) - offset,
+        "%s\"%s\"", (i > 0) ? "," : "", ds->ds[i].name);
+  ssnprintf (names + offset, sizeof (names) - offset, "]");
+
+  for (j = 0; j < 5; j++)
+  {
+    size_t k;
+    offset = 0;
+    ident[j][offset++] = '"';
+    for (k = 0; src[j][k] != 0; k++)
+    {
+      if ((src[j][k] == '"') || (src[j][k] == '\\'))
+        ident[j][offset++] = '\\';
+      ident[j][offset++] = (src[j][k] <= 0x1f) ? '?' : src[j][k];
+    }
+    ident[j][offset++] = '"';
+    ident[j][offset] = 0;
+  }
+
+  ssnprintf (buffer, buffer_size, ",{\"values\":%s,\"dstypes\":%s,"
+      "\"dsnames\":%s,\"time\":%.3f,\"interval\":%.3f,\"host\":%s,"
+      "\"plugin\":%s,\"plugin_instance\":%s,\"type\":%s,"
+      "\"type_instance\":%s}",
+      values, types, names,
+      CDTIME_T_TO_DOUBLE (vl->time), CDTIME_T_TO_DOUBLE (vl->interval),
+      ident[0], ident[1], ident[2], ident[3], ident[4]);
+
+  return (0);
+} /* }}} int legacy_json */
+
+static int json_one (char *buffer, size_t buffer_size, /* {{{ */
+    data_set_t const *ds, value_list_t const *vl)
+{
+  size_t fill = 0;
+  size_t bfree = buffer_size;
+
+  return (format_json_value_list (buffer, &fill, &bfree, ds, vl,
+        /* store rates = */ 0));
+} /* }}} int json_one */
+
+#define BENCH_SERIES 256
+#define BENCH_ROUNDS 2000
+
+static double bench_now (void) /* {{{ */
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1e9);
+} /* }}} double bench_now */
+
+static void bench_report (char const *name, double t) /* {{{ */
+{
+  double values = (double) BENCH_SERIES * BENCH_ROUNDS * ds_load.ds_num;
+  printf ("%-20s %8.3f s  %12.0f values/s\n", name, t, values / t);
+} /* }}} void bench_report */
+
+static void benchmark (void) /* {{{ */
+{
+  value_list_t *vls;
+  value_t values[BENCH_SERIES][3];
+  char buffer[4096];
+  double t;
+  int i;
+  int r;
+
+  vls = calloc (BENCH_SERIES, sizeof (*vls));
+  assert (vls != NULL);
+  for (i = 0; i < BENCH_SERIES; i++)
+  {
+    char instance[DATA_MAX_NAME_LEN];
+
+    snprintf (instance, sizeof (instance), "instance%i", i);
+    values[i][0].gauge = 0.01 * i;
+    values[i][1].gauge = 1.5 + i;
+    values[i][2].gauge = 1234.5678;
+    init_vl (vls + i, values[i], "host.example.com", "load", instance,
+        "load", "");
+  }
+
+#define BENCH(name, expr) do { \
+  t = bench_now (); \
+  for (r = 0; r < BENCH_ROUNDS; r++) \
+    for (i = 0; i < BENCH_SERIES; i++) \
+    { \
+      int status = (expr); \
+      assert (status == 0); \
+    } \
+  bench_report ((name), bench_now () - t); \
+} while (0)
+
+  BENCH ("graphite (legacy)", legacy_graphite (buffer, sizeof (buffer),
+        &ds_load, vls + i, "collectd.", '_'));
+  BENCH ("graphite", format_graphite (buffer, sizeof (buffer),
+        &ds_load, vls + i, "collectd.", NULL, '_', 0));
+  BENCH ("json (legacy)", legacy_json (buffer, sizeof (buffer),
+        &ds_load, vls + i));
+  BENCH ("json", json_one (buffer, sizeof (buffer), &ds_load, vls + i));
+
+#undef BENCH
+
+  sfree (vls);
+} /* }}} void benchmark */
+
+int main (int argc, char **argv) /* {{{ */
+{
+  test_integers ();
+  test_doubles ();
+  test_find_special ();
+  test_graphite ();
+  test_json ();
+
+  if ((argc > 1) && (strcmp ("-b", argv[1]) == 0))
+    benchmark ();
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
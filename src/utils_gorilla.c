@@ -0,0 +1,435 @@
+/**
+ * collectd - src/utils_gorilla.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils_gorilla.h"
+
+/*
+ * Bit level helpers
+ */
+static int gc_leading_zeros (uint64_t x) /* {{{ */
+{
+#if defined(__GNUC__)
+  return ((x == 0) ? 64 : __builtin_clzll (x));
+#else
+  int n = 0;
+
+  if (x == 0)
+    return (64);
+  while ((x & (((uint64_t) 1) << 63)) == 0)
+  {
+    x <<= 1;
+    n++;
+  }
+  return (n);
+#endif
+} /* }}} int gc_leading_zeros */
+
+static int gc_trailing_zeros (uint64_t x) /* {{{ */
+{
+#if defined(__GNUC__)
+  return ((x == 0) ? 64 : __builtin_ctzll (x));
+#else
+  int n = 0;
+
+  if (x == 0)
+    return (64);
+  while ((x & 1) == 0)
+  {
+    x >>= 1;
+    n++;
+  }
+  return (n);
+#endif
+} /* }}} int gc_trailing_zeros */
+
+static int64_t gc_sign_extend (uint64_t v, int bits) /* {{{ */
+{
+  if (v & (((uint64_t) 1) << (bits - 1)))
+    return ((int64_t) v - (((int64_t) 1) << bits));
+  return ((int64_t) v);
+} /* }}} int64_t gc_sign_extend */
+
+/* Maximum number of bits written by one append: A value with a new window
+ * needs a two bit prefix, five bits of leading zeros, six bits of length and
+ * up to 64 significant bits. Time stamps need at most 4 + 64 bits. */
+#define GC_APPEND_MAX_BITS (2 + 5 + 6 + 64)
+
+static int gc_reserve (gorilla_column_t *c, int nbits) /* {{{ */
+{
+  size_t need = (c->bits + nbits + 7) / 8;
+  size_t new_size;
+  uint8_t *tmp;
+
+  if (need <= c->data_size)
+    return (0);
+
+  new_size = (c->data_size == 0) ? 64 : c->data_size;
+  while (new_size < need)
+    new_size *= 2;
+
+  tmp = realloc (c->data, new_size);
+  if (tmp == NULL)
+    return (-1);
+  memset (tmp + c->data_size, 0, new_size - c->data_size);
+
+  c->data = tmp;
+  c->data_size = new_size;
+  return (0);
+} /* }}} int gc_reserve */
+
+/* Writes the lowest `nbits' bits of `value', most significant bit first. */
+static int gc_write_bits (gorilla_column_t *c, uint64_t value, /* {{{ */
+    int nbits)
+{
+  if (gc_reserve (c, nbits) != 0)
+    return (-1);
+
+  while (nbits > 0)
+  {
+    int free_bits = 8 - (int) (c->bits % 8);
+    int n = (nbits < free_bits) ? nbits : free_bits;
+    uint8_t chunk;
+
+    chunk = (uint8_t) ((value >> (nbits - n)) & ((1 << n) - 1));
+    c->data[c->bits / 8] |= (uint8_t) (chunk << (free_bits - n));
+
+    c->bits += n;
+    nbits -= n;
+  }
+
+  return (0);
+} /* }}} int gc_write_bits */
+
+static int gr_read_bits (gorilla_reader_t *r, int nbits, /* {{{ */
+    uint64_t *ret)
+{
+  uint64_t value = 0;
+
+  if ((r->pos + nbits) > r->bits)
+    return (-1);
+
+  while (nbits > 0)
+  {
+    int avail = 8 - (int) (r->pos % 8);
+    int n = (nbits < avail) ? nbits : avail;
+    uint8_t byte = r->data[r->pos / 8];
+
+    value = (value << n)
+      | (uint64_t) ((byte >> (avail - n)) & ((1 << n) - 1));
+
+    r->pos += n;
+    nbits -= n;
+  }
+
+  *ret = value;
+  return (0);
+} /* }}} int gr_read_bits */
+
+/*
+ * Encoder
+ */
+int gorilla_column_append_time (gorilla_column_t *c, uint64_t t) /* {{{ */
+{
+  int64_t delta;
+  int64_t dod;
+  int status;
+
+  if (c->num == 0)
+  {
+    status = gc_write_bits (c, t, 64);
+    if (status != 0)
+      return (status);
+
+    c->prev = t;
+    c->prev_delta = 0;
+    c->num++;
+    return (0);
+  }
+
+  delta = (int64_t) (t - c->prev);
+  dod = delta - c->prev_delta;
+
+  if (dod == 0)
+    status = gc_write_bits (c, 0x0, 1);
+  else if ((dod >= -64) && (dod <= 63))
+    status = gc_write_bits (c, (0x2 << 7) | ((uint64_t) dod & 0x7f), 2 + 7);
+  else if ((dod >= -256) && (dod <= 255))
+    status = gc_write_bits (c, (0x6 << 9) | ((uint64_t) dod & 0x1ff), 3 + 9);
+  else if ((dod >= -2048) && (dod <= 2047))
+    status = gc_write_bits (c, (0xe << 12) | ((uint64_t) dod & 0xfff), 4 + 12);
+  else
+  {
+    status = gc_write_bits (c, 0xf, 4);
+    if (status == 0)
+      status = gc_write_bits (c, (uint64_t) dod, 64);
+  }
+
+  if (status != 0)
+    return (status);
+
+  c->prev = t;
+  c->prev_delta = delta;
+  c->num++;
+  return (0);
+} /* }}} int gorilla_column_append_time */
+
+int gorilla_column_append_value (gorilla_column_t *c, uint64_t v) /* {{{ */
+{
+  uint64_t xor;
+  int leading;
+  int trailing;
+  int significant;
+  int status;
+
+  if (c->num == 0)
+  {
+    status = gc_write_bits (c, v, 64);
+    if (status != 0)
+      return (status);
+
+    c->prev = v;
+    c->prev_leading = -1;
+    c->prev_trailing = -1;
+    c->num++;
+    return (0);
+  }
+
+  xor = v ^ c->prev;
+  if (xor == 0)
+  {
+    status = gc_write_bits (c, 0x0, 1);
+    if (status != 0)
+      return (status);
+    c->num++;
+    return (0);
+  }
+
+  leading = gc_leading_zeros (xor);
+  trailing = gc_trailing_zeros (xor);
+  /* The number of leading zeros is stored in five bits. */
+  if (leading > 31)
+    leading = 31;
+
+  if ((c->prev_leading >= 0)
+      && (leading >= c->prev_leading)
+      && (trailing >= c->prev_trailing))
+  {
+    /* The meaningful bits fit into the previous window. */
+    significant = 64 - c->prev_leading - c->prev_trailing;
+    status = gc_write_bits (c, 0x2, 2);
+    if (status == 0)
+      status = gc_write_bits (c, xor >> c->prev_trailing, significant);
+  }
+  else
+  {
+    significant = 64 - leading - trailing;
+    status = gc_write_bits (c, 0x3, 2);
+    if (status == 0)
+      status = gc_write_bits (c, (uint64_t) leading, 5);
+    /* 64 significant bits are stored as zero. */
+    if (status == 0)
+      status = gc_write_bits (c, (uint64_t) (significant & 0x3f), 6);
+    if (status == 0)
+      status = gc_write_bits (c, xor >> trailing, significant);
+
+    c->prev_leading = leading;
+    c->prev_trailing = trailing;
+  }
+
+  if (status != 0)
+    return (status);
+
+  c->prev = v;
+  c->num++;
+  return (0);
+} /* }}} int gorilla_column_append_value */
+
+int gorilla_column_reserve (gorilla_column_t *c) /* {{{ */
+{
+  return (gc_reserve (c, GC_APPEND_MAX_BITS));
+} /* }}} int gorilla_column_reserve */
+
+size_t gorilla_column_size (const gorilla_column_t *c) /* {{{ */
+{
+  return ((c->bits + 7) / 8);
+} /* }}} size_t gorilla_column_size */
+
+void gorilla_column_reset (gorilla_column_t *c) /* {{{ */
+{
+  if (c->data != NULL)
+    memset (c->data, 0, gorilla_column_size (c));
+
+  c->bits = 0;
+  c->num = 0;
+  c->prev = 0;
+  c->prev_delta = 0;
+  c->prev_leading = -1;
+  c->prev_trailing = -1;
+} /* }}} void gorilla_column_reset */
+
+void gorilla_column_destroy (gorilla_column_t *c) /* {{{ */
+{
+  free (c->data);
+  memset (c, 0, sizeof (*c));
+} /* }}} void gorilla_column_destroy */
+
+/*
+ * Decoder
+ */
+void gorilla_reader_init (gorilla_reader_t *r, const uint8_t *data, /* {{{ */
+    size_t bits)
+{
+  memset (r, 0, sizeof (*r));
+  r->data = data;
+  r->bits = bits;
+  r->prev_leading = -1;
+  r->prev_trailing = -1;
+} /* }}} void gorilla_reader_init */
+
+int gorilla_reader_next_time (gorilla_reader_t *r, uint64_t *ret) /* {{{ */
+{
+  uint64_t tmp;
+  int64_t dod;
+  int prefix_bits;
+
+  if (r->pos >= r->bits)
+    return (1);
+
+  if (r->num == 0)
+  {
+    if (gr_read_bits (r, 64, &r->prev) != 0)
+      return (-1);
+    r->prev_delta = 0;
+    r->num++;
+    *ret = r->prev;
+    return (0);
+  }
+
+  /* Count the leading one bits of the prefix: 0, 10, 110, 1110, 1111. */
+  for (prefix_bits = 0; prefix_bits < 4; prefix_bits++)
+  {
+    if (gr_read_bits (r, 1, &tmp) != 0)
+      return (-1);
+    if (tmp == 0)
+      break;
+  }
+
+  switch (prefix_bits)
+  {
+    case 0:
+      dod = 0;
+      break;
+    case 1:
+      if (gr_read_bits (r, 7, &tmp) != 0)
+        return (-1);
+      dod = gc_sign_extend (tmp, 7);
+      break;
+    case 2:
+      if (gr_read_bits (r, 9, &tmp) != 0)
+        return (-1);
+      dod = gc_sign_extend (tmp, 9);
+      break;
+    case 3:
+      if (gr_read_bits (r, 12, &tmp) != 0)
+        return (-1);
+      dod = gc_sign_extend (tmp, 12);
+      break;
+    default:
+      if (gr_read_bits (r, 64, &tmp) != 0)
+        return (-1);
+      dod = (int64_t) tmp;
+      break;
+  }
+
+  r->prev_delta += dod;
+  r->prev += (uint64_t) r->prev_delta;
+  r->num++;
+
+  *ret = r->prev;
+  return (0);
+} /* }}} int gorilla_reader_next_time */
+
+int gorilla_reader_next_value (gorilla_reader_t *r, uint64_t *ret) /* {{{ */
+{
+  uint64_t tmp;
+  uint64_t xor;
+  int significant;
+
+  if (r->pos >= r->bits)
+    return (1);
+
+  if (r->num == 0)
+  {
+    if (gr_read_bits (r, 64, &r->prev) != 0)
+      return (-1);
+    r->num++;
+    *ret = r->prev;
+    return (0);
+  }
+
+  if (gr_read_bits (r, 1, &tmp) != 0)
+    return (-1);
+  if (tmp == 0)
+  {
+    r->num++;
+    *ret = r->prev;
+    return (0);
+  }
+
+  if (gr_read_bits (r, 1, &tmp) != 0)
+    return (-1);
+  if (tmp != 0)
+  {
+    uint64_t leading;
+    uint64_t sig;
+
+    if ((gr_read_bits (r, 5, &leading) != 0)
+        || (gr_read_bits (r, 6, &sig) != 0))
+      return (-1);
+    if (sig == 0)
+      sig = 64;
+    if ((leading + sig) > 64)
+      return (-1);
+
+    r->prev_leading = (int) leading;
+    r->prev_trailing = 64 - (int) leading - (int) sig;
+  }
+  else if (r->prev_leading < 0)
+  {
+    /* Window reuse without a previous window. */
+    return (-1);
+  }
+
+  significant = 64 - r->prev_leading - r->prev_trailing;
+  if (gr_read_bits (r, significant, &xor) != 0)
+    return (-1);
+
+  r->prev ^= xor << r->prev_trailing;
+  r->num++;
+
+  *ret = r->prev;
+  return (0);
+} /* }}} int gorilla_reader_next_value */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
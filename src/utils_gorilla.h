@@ -0,0 +1,145 @@
+/**
+ * collectd - src/utils_gorilla.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_GORILLA_H
+#define UTILS_GORILLA_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A column is a bit stream holding a sequence of 64 bit values, compressed as
+ * described in Facebook's "Gorilla" time series database paper: Time columns
+ * use delta-of-delta encoding, value columns XOR the bit pattern of each value
+ * with its predecessor. The first value of each column is always stored
+ * verbatim, so every column can be decoded on its own.
+ */
+struct gorilla_column_s
+{
+  uint8_t *data;
+  size_t   data_size; /* allocated bytes */
+  size_t   bits;      /* used bits */
+
+  uint32_t num;       /* number of encoded values */
+  uint64_t prev;
+  int64_t  prev_delta;
+  int      prev_leading;
+  int      prev_trailing;
+};
+typedef struct gorilla_column_s gorilla_column_t;
+
+struct gorilla_reader_s
+{
+  const uint8_t *data;
+  size_t   bits;
+  size_t   pos;
+
+  uint32_t num;
+  uint64_t prev;
+  int64_t  prev_delta;
+  int      prev_leading;
+  int      prev_trailing;
+};
+typedef struct gorilla_reader_s gorilla_reader_t;
+
+/*
+ * NAME
+ *   gorilla_column_append_time
+ *
+ * DESCRIPTION
+ *   Appends a time stamp to the column, using delta-of-delta encoding. All
+ *   time stamps of one column must be passed to this function; time and value
+ *   encoding must not be mixed.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero if memory could not be allocated.
+ */
+int gorilla_column_append_time (gorilla_column_t *c, uint64_t t);
+
+/*
+ * NAME
+ *   gorilla_column_append_value
+ *
+ * DESCRIPTION
+ *   Appends the 64 bit pattern `v' to the column, using XOR encoding. For
+ *   floating point values, pass the bit pattern of the double, not a
+ *   converted integer.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero if memory could not be allocated.
+ */
+int gorilla_column_append_value (gorilla_column_t *c, uint64_t v);
+
+/*
+ * NAME
+ *   gorilla_column_reserve
+ *
+ * DESCRIPTION
+ *   Allocates enough memory for appending one more time stamp or value to the
+ *   column, so that the next call of `gorilla_column_append_time' or
+ *   `gorilla_column_append_value' cannot fail. Use this to keep the columns
+ *   of a series aligned: reserve space in all of them before appending to
+ *   any.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero if memory could not be allocated.
+ */
+int gorilla_column_reserve (gorilla_column_t *c);
+
+/* Returns the number of bytes needed to store the column, i.e. the number of
+ * used bits rounded up. */
+size_t gorilla_column_size (const gorilla_column_t *c);
+
+/* Forgets all values but keeps the allocated buffer for reuse. */
+void gorilla_column_reset (gorilla_column_t *c);
+
+/* Frees the memory held by the column. The column itself is not freed. */
+void gorilla_column_destroy (gorilla_column_t *c);
+
+/*
+ * NAME
+ *   gorilla_reader_init
+ *
+ * DESCRIPTION
+ *   Prepares `r' for decoding the column stored in `data'. `bits' is the
+ *   number of valid bits, `data' must hold at least (bits + 7) / 8 bytes.
+ */
+void gorilla_reader_init (gorilla_reader_t *r, const uint8_t *data,
+    size_t bits);
+
+/*
+ * NAME
+ *   gorilla_reader_next_time, gorilla_reader_next_value
+ *
+ * DESCRIPTION
+ *   Decodes the next time stamp or value of a column written with
+ *   `gorilla_column_append_time' or `gorilla_column_append_value'
+ *   respectively.
+ *
+ * RETURN VALUE
+ *   Zero upon success, greater than zero if the end of the column has been
+ *   reached and less than zero if the data is corrupt.
+ */
+int gorilla_reader_next_time (gorilla_reader_t *r, uint64_t *ret);
+int gorilla_reader_next_value (gorilla_reader_t *r, uint64_t *ret);
+
+#endif /* UTILS_GORILLA_H */
+/* vim: set sw=2 sts=2 et : */
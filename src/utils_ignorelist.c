@@ -56,15 +56,15 @@
 #include "common.h"
 #include "plugin.h"
 #include "utils_ignorelist.h"
+#if HAVE_REGEX_H
+# include "utils_regex_set.h"
+#endif
 
 /*
  * private prototypes
  */
 struct ignorelist_item_s
 {
-#if HAVE_REGEX_H
-	regex_t *rmatch;	/* regular expression entry identification */
-#endif
 	char *smatch;		/* string entry identification */
 	struct ignorelist_item_s *next;
 };
@@ -74,6 +74,9 @@ struct ignorelist_s
 {
 	int ignore;		/* ignore entries */
 	ignorelist_item_t *head;	/* pointer to the first entry */
+#if HAVE_REGEX_H
+	regex_set_t *regex_set;	/* all regular expression entries */
+#endif
 };
 
 /* *** *** *** ********************************************* *** *** *** */
@@ -91,62 +94,31 @@ static inline void ignorelist_append (ignorelist_t *il, ignorelist_item_t *item)
 #if HAVE_REGEX_H
 static int ignorelist_append_regex(ignorelist_t *il, const char *entry)
 {
-	int rcompile;
-	regex_t *regtemp;
-	int errsize;
-	char *regerr = NULL;
-	ignorelist_item_t *new;
+	char errbuf[1024] = "";
+	int status;
 
-	/* create buffer */
-	if ((regtemp = malloc(sizeof(regex_t))) == NULL)
+	/* All regular expressions are matched in one pass, see
+	 * utils_regex_set.h */
+	if (il->regex_set == NULL)
 	{
-		ERROR ("cannot allocate new config entry");
-		return (1);
-	}
-	memset (regtemp, '\0', sizeof(regex_t));
-
-	/* compile regex */
-	if ((rcompile = regcomp (regtemp, entry, REG_EXTENDED)) != 0)
-	{
-		/* prepare message buffer */
-		errsize = regerror(rcompile, regtemp, NULL, 0);
-		if (errsize)
-			regerr = smalloc(errsize);
-		/* get error message */
-		if (regerror (rcompile, regtemp, regerr, errsize))
-		{
-			fprintf (stderr, "Cannot compile regex %s: %i/%s",
-					entry, rcompile, regerr);
-			ERROR ("Cannot compile regex %s: %i/%s",
-					entry, rcompile, regerr);
-		}
-		else
+		if ((il->regex_set = regex_set_create ()) == NULL)
 		{
-			fprintf (stderr, "Cannot compile regex %s: %i",
-					entry, rcompile);
-			ERROR ("Cannot compile regex %s: %i",
-					entry, rcompile);
+			ERROR ("cannot allocate new config entry");
+			return (1);
 		}
-
-		if (errsize)
-			sfree (regerr);
-		regfree (regtemp);
-		return (1);
 	}
-	DEBUG("regex compiled: %s - %i", entry, rcompile);
 
-	/* create new entry */
-	if ((new = malloc(sizeof(ignorelist_item_t))) == NULL)
+	/* compile regex */
+	status = regex_set_add (il->regex_set, entry, errbuf, sizeof (errbuf));
+	if (status < 0)
 	{
-		ERROR ("cannot allocate new config entry");
-		regfree (regtemp);
+		fprintf (stderr, "Cannot compile regex %s: %s",
+				entry, errbuf);
+		ERROR ("Cannot compile regex %s: %s",
+				entry, errbuf);
 		return (1);
 	}
-	memset (new, '\0', sizeof(ignorelist_item_t));
-	new->rmatch = regtemp;
-
-	/* append new entry */
-	ignorelist_append (il, new);
+	DEBUG("regex compiled: %s - %i", entry, status);
 
 	return (0);
 } /* int ignorelist_append_regex(ignorelist_t *il, const char *entry) */
@@ -171,23 +143,6 @@ static int ignorelist_append_string(ignorelist_t *il, const char *entry)
 	return (0);
 } /* int ignorelist_append_string(ignorelist_t *il, const char *entry) */
 
-#if HAVE_REGEX_H
-/*
- * check list for entry regex match
- * return 1 if found
- */
-static int ignorelist_match_regex (ignorelist_item_t *item, const char *entry)
-{
-	assert ((item != NULL) && (item->rmatch != NULL)
-			&& (entry != NULL) && (strlen (entry) > 0));
-
-	/* match regex */
-	if (regexec (item->rmatch, entry, 0, NULL, 0) == 0)
-		return (1);
-
-	return (0);
-} /* int ignorelist_match_regex (ignorelist_item_t *item, const char *entry) */
-#endif
 
 /*
  * check list for entry string match
@@ -244,13 +199,6 @@ void ignorelist_free (ignorelist_t *il)
 	for (this = il->head; this != NULL; this = next)
 	{
 		next = this->next;
-#if HAVE_REGEX_H
-		if (this->rmatch != NULL)
-		{
-			regfree (this->rmatch);
-			this->rmatch = NULL;
-		}
-#endif
 		if (this->smatch != NULL)
 		{
 			sfree (this->smatch);
@@ -259,6 +207,11 @@ void ignorelist_free (ignorelist_t *il)
 		sfree (this);
 	}
 
+#if HAVE_REGEX_H
+	regex_set_destroy (il->regex_set);
+	il->regex_set = NULL;
+#endif
+
 	sfree (il);
 	il = NULL;
 } /* void ignorelist_destroy (ignorelist_t *il) */
@@ -336,8 +289,15 @@ int ignorelist_match (ignorelist_t *il, const char *entry)
 	ignorelist_item_t *traverse;
 
 	/* if no entries, collect all */
-	if ((il == NULL) || (il->head == NULL))
+	if (il == NULL)
+		return (0);
+#if HAVE_REGEX_H
+	if ((il->head == NULL) && (il->regex_set == NULL))
 		return (0);
+#else
+	if (il->head == NULL)
+		return (0);
+#endif
 
 	if ((entry == NULL) || (strlen (entry) == 0))
 		return (0);
@@ -345,19 +305,15 @@ int ignorelist_match (ignorelist_t *il, const char *entry)
 	/* traverse list and check entries */
 	for (traverse = il->head; traverse != NULL; traverse = traverse->next)
 	{
+		if (ignorelist_match_string (traverse, entry))
+			return (il->ignore);
+	} /* for traverse */
+
 #if HAVE_REGEX_H
-		if (traverse->rmatch != NULL)
-		{
-			if (ignorelist_match_regex (traverse, entry))
-				return (il->ignore);
-		}
-		else
+	if ((il->regex_set != NULL)
+			&& regex_set_match_any (il->regex_set, entry))
+		return (il->ignore);
 #endif
-		{
-			if (ignorelist_match_string (traverse, entry))
-				return (il->ignore);
-		}
-	} /* for traverse */
 
 	return (1 - il->ignore);
 } /* int ignorelist_match (ignorelist_t *il, const char *entry) */
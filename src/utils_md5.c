@@ -0,0 +1,145 @@
+/**
+ * collectd - src/utils_md5.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include <string.h>
+
+#include "utils_md5.h"
+
+/* Per-round shift amounts */
+static const uint8_t md5_shift[64] =
+{
+  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,
+  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,
+  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,
+  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21
+};
+
+/* floor (abs (sin (i + 1)) * 2^32) */
+static const uint32_t md5_k[64] =
+{
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+  0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+  0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+  0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+  0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+  0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+  0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+  0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+  0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+  0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+  0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static void md5_block (uint32_t state[4], const uint8_t block[64]) /* {{{ */
+{
+  uint32_t m[16];
+  uint32_t a = state[0];
+  uint32_t b = state[1];
+  uint32_t c = state[2];
+  uint32_t d = state[3];
+  int i;
+
+  /* MD5 is defined on little endian words. */
+  for (i = 0; i < 16; i++)
+    m[i] = ((uint32_t) block[4 * i])
+      | (((uint32_t) block[4 * i + 1]) << 8)
+      | (((uint32_t) block[4 * i + 2]) << 16)
+      | (((uint32_t) block[4 * i + 3]) << 24);
+
+  for (i = 0; i < 64; i++)
+  {
+    uint32_t f;
+    int g;
+    uint32_t tmp;
+
+    if (i < 16)
+    {
+      f = (b & c) | (~b & d);
+      g = i;
+    }
+    else if (i < 32)
+    {
+      f = (d & b) | (~d & c);
+      g = (5 * i + 1) % 16;
+    }
+    else if (i < 48)
+    {
+      f = b ^ c ^ d;
+      g = (3 * i + 5) % 16;
+    }
+    else
+    {
+      f = c ^ (b | ~d);
+      g = (7 * i) % 16;
+    }
+
+    tmp = d;
+    d = c;
+    c = b;
+    f = a + f + md5_k[i] + m[g];
+    b = b + ((f << md5_shift[i]) | (f >> (32 - md5_shift[i])));
+    a = tmp;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+} /* }}} void md5_block */
+
+void md5_digest (const void *data, size_t size, uint8_t digest[16]) /* {{{ */
+{
+  uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+  const uint8_t *ptr = data;
+  uint8_t tail[128];
+  size_t tail_size;
+  uint64_t bits = ((uint64_t) size) * 8;
+  size_t i;
+
+  while (size >= 64)
+  {
+    md5_block (state, ptr);
+    ptr += 64;
+    size -= 64;
+  }
+
+  /* Padding: a single one bit, zeros and the message length in bits. */
+  memset (tail, 0, sizeof (tail));
+  memcpy (tail, ptr, size);
+  tail[size] = 0x80;
+  tail_size = (size < 56) ? 64 : 128;
+  for (i = 0; i < 8; i++)
+    tail[tail_size - 8 + i] = (uint8_t) (bits >> (8 * i));
+
+  md5_block (state, tail);
+  if (tail_size == 128)
+    md5_block (state, tail + 64);
+
+  for (i = 0; i < 16; i++)
+    digest[i] = (uint8_t) (state[i / 4] >> (8 * (i % 4)));
+} /* }}} void md5_digest */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
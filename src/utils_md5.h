@@ -0,0 +1,46 @@
+/**
+ * collectd - src/utils_md5.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_MD5_H
+#define UTILS_MD5_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * NAME
+ *   md5_digest
+ *
+ * DESCRIPTION
+ *   Computes the MD5 message digest (RFC 1321) of `data'. This is used where
+ *   compatibility with other software requires MD5, for example to place
+ *   metrics on a Carbon consistent hashing ring. It must not be used for
+ *   anything security relevant.
+ *
+ * PARAMETERS
+ *   `data'    Data to hash.
+ *   `size'    Number of bytes in `data'.
+ *   `digest'  Buffer receiving the 16 byte digest.
+ */
+void md5_digest (const void *data, size_t size, uint8_t digest[16]);
+
+#endif /* UTILS_MD5_H */
+/* vim: set sw=2 sts=2 et : */
@@ -0,0 +1,382 @@
+/**
+ * collectd - src/utils_procfs.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_procfs.h"
+
+#include <pthread.h>
+
+#define PROCFS_BUFFER_INITIAL_SIZE 4096
+
+struct procfs_file_s
+{
+  char *path;
+  int fd;
+
+  char *buffer;
+  size_t buffer_size;
+};
+
+/* The time of the last snapshot returned to one plugin. */
+struct procfs_reader_s;
+typedef struct procfs_reader_s procfs_reader_t;
+struct procfs_reader_s
+{
+  char *name;
+  cdtime_t time;
+
+  procfs_reader_t *next;
+};
+
+/* The shared snapshot of one file. `lock' protects the file, the time and
+ * size of its last read and the list of readers. */
+struct procfs_snapshot_s;
+typedef struct procfs_snapshot_s procfs_snapshot_t;
+struct procfs_snapshot_s
+{
+  pthread_mutex_t lock;
+  procfs_file_t *pf;
+  char *data;
+  size_t size;
+  cdtime_t time;
+
+  procfs_reader_t *readers;
+
+  procfs_snapshot_t *next;
+};
+
+/* Protects the list of snapshots. Snapshots are only removed by
+ * procfs_snapshot_shutdown(). */
+static pthread_mutex_t snapshots_lock = PTHREAD_MUTEX_INITIALIZER;
+static procfs_snapshot_t *snapshots = NULL;
+
+static int procfs_reopen (procfs_file_t *pf) /* {{{ */
+{
+  if (pf->fd >= 0)
+    close (pf->fd);
+
+  pf->fd = open (pf->path, O_RDONLY);
+  if (pf->fd < 0)
+    return (-1);
+
+  return (0);
+} /* }}} int procfs_reopen */
+
+/* Reads the whole file into the buffer, growing it as necessary. Returns the
+ * number of bytes read or -1 on failure. */
+static ssize_t procfs_pread_all (procfs_file_t *pf) /* {{{ */
+{
+  size_t offset = 0;
+
+  while (42)
+  {
+    ssize_t status;
+
+    /* Leave room for the terminating null byte. */
+    if ((offset + 1) >= pf->buffer_size)
+    {
+      size_t size = 2 * pf->buffer_size;
+      char *buffer;
+
+      buffer = realloc (pf->buffer, size);
+      if (buffer == NULL)
+        return (-1);
+      pf->buffer = buffer;
+      pf->buffer_size = size;
+    }
+
+    status = pread (pf->fd, pf->buffer + offset,
+        pf->buffer_size - (offset + 1), (off_t) offset);
+    if (status < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return (-1);
+    }
+    else if (status == 0)
+      break;
+
+    offset += (size_t) status;
+  }
+
+  pf->buffer[offset] = 0;
+  return ((ssize_t) offset);
+} /* }}} ssize_t procfs_pread_all */
+
+procfs_file_t *procfs_open (char const *path) /* {{{ */
+{
+  procfs_file_t *pf;
+
+  pf = calloc (1, sizeof (*pf));
+  if (pf == NULL)
+    return (NULL);
+  pf->fd = -1;
+
+  pf->path = strdup (path);
+  pf->buffer_size = PROCFS_BUFFER_INITIAL_SIZE;
+  pf->buffer = malloc (pf->buffer_size);
+  if ((pf->path == NULL) || (pf->buffer == NULL)
+      || (procfs_reopen (pf) != 0))
+  {
+    int saved_errno = errno;
+    procfs_close (pf);
+    errno = saved_errno;
+    return (NULL);
+  }
+
+  return (pf);
+} /* }}} procfs_file_t *procfs_open */
+
+char *procfs_read (procfs_file_t *pf, size_t *ret_size) /* {{{ */
+{
+  ssize_t size;
+
+  if (pf == NULL)
+  {
+    errno = EINVAL;
+    return (NULL);
+  }
+
+  size = procfs_pread_all (pf);
+  /* Some files can't be read again through the same descriptor, for example
+   * after the device behind them has been replaced. Try once more with a new
+   * descriptor. */
+  if ((size < 0) && (errno != ENOMEM))
+  {
+    if (procfs_reopen (pf) == 0)
+      size = procfs_pread_all (pf);
+  }
+  if (size < 0)
+    return (NULL);
+
+  if (ret_size != NULL)
+    *ret_size = (size_t) size;
+  return (pf->buffer);
+} /* }}} char *procfs_read */
+
+void procfs_close (procfs_file_t *pf) /* {{{ */
+{
+  if (pf == NULL)
+    return;
+
+  if (pf->fd >= 0)
+    close (pf->fd);
+  sfree (pf->path);
+  sfree (pf->buffer);
+  sfree (pf);
+} /* }}} void procfs_close */
+
+char *procfs_next_line (char **cursor) /* {{{ */
+{
+  char *line = *cursor;
+  char *end;
+
+  if ((line == NULL) || (*line == 0))
+    return (NULL);
+
+  end = strchr (line, '\n');
+  if (end != NULL)
+  {
+    *end = 0;
+    *cursor = end + 1;
+  }
+  else
+  {
+    *cursor = line + strlen (line);
+  }
+
+  return (line);
+} /* }}} char *procfs_next_line */
+
+/* Returns the snapshot of `path', creating it if necessary. */
+static procfs_snapshot_t *procfs_snapshot_get (char const *path) /* {{{ */
+{
+  procfs_snapshot_t *ps;
+
+  pthread_mutex_lock (&snapshots_lock);
+  for (ps = snapshots; ps != NULL; ps = ps->next)
+    if (strcmp (ps->pf->path, path) == 0)
+      break;
+
+  if (ps == NULL)
+  {
+    ps = calloc (1, sizeof (*ps));
+    if (ps == NULL)
+    {
+      pthread_mutex_unlock (&snapshots_lock);
+      errno = ENOMEM;
+      return (NULL);
+    }
+
+    ps->pf = procfs_open (path);
+    if (ps->pf == NULL)
+    {
+      int saved_errno = errno;
+      pthread_mutex_unlock (&snapshots_lock);
+      sfree (ps);
+      errno = saved_errno;
+      return (NULL);
+    }
+    pthread_mutex_init (&ps->lock, /* attr = */ NULL);
+
+    ps->next = snapshots;
+    snapshots = ps;
+  }
+  pthread_mutex_unlock (&snapshots_lock);
+
+  return (ps);
+} /* }}} procfs_snapshot_t *procfs_snapshot_get */
+
+/* Returns how old a snapshot may be to be used by the calling plugin. */
+static cdtime_t procfs_snapshot_max_age (void) /* {{{ */
+{
+  plugin_ctx_t ctx = plugin_get_ctx ();
+
+  if (ctx.min_interval != 0)
+    return (ctx.min_interval / 2);
+  if (ctx.interval != 0)
+    return (ctx.interval / 2);
+  return (plugin_get_interval () / 2);
+} /* }}} cdtime_t procfs_snapshot_max_age */
+
+/* Returns the reader entry of the calling plugin, creating it if necessary.
+ * The caller must hold the lock of `ps'. */
+static procfs_reader_t *procfs_snapshot_reader (procfs_snapshot_t *ps) /* {{{ */
+{
+  char const *name = plugin_get_ctx ().name;
+  procfs_reader_t *r;
+
+  if (name == NULL)
+    name = "";
+
+  for (r = ps->readers; r != NULL; r = r->next)
+    if (strcmp (r->name, name) == 0)
+      return (r);
+
+  r = calloc (1, sizeof (*r));
+  if (r == NULL)
+    return (NULL);
+  r->name = strdup (name);
+  if (r->name == NULL)
+  {
+    sfree (r);
+    return (NULL);
+  }
+
+  r->next = ps->readers;
+  ps->readers = r;
+  return (r);
+} /* }}} procfs_reader_t *procfs_snapshot_reader */
+
+char *procfs_snapshot (char const *path, /* {{{ */
+    size_t *ret_size, cdtime_t *ret_time)
+{
+  procfs_snapshot_t *ps;
+  procfs_reader_t *r;
+  cdtime_t now;
+  char *copy;
+
+  ps = procfs_snapshot_get (path);
+  if (ps == NULL)
+    return (NULL);
+
+  now = cdtime ();
+
+  pthread_mutex_lock (&ps->lock);
+
+  r = procfs_snapshot_reader (ps);
+  if (r == NULL)
+  {
+    pthread_mutex_unlock (&ps->lock);
+    errno = ENOMEM;
+    return (NULL);
+  }
+
+  /* A plugin must never get the same snapshot twice: it would dispatch its
+   * values with the same time again, and the cache would reject them. */
+  if ((ps->data == NULL) || (ps->time > now) || (ps->time <= r->time)
+      || ((now - ps->time) > procfs_snapshot_max_age ()))
+  {
+    ps->data = procfs_read (ps->pf, &ps->size);
+    if (ps->data == NULL)
+    {
+      int saved_errno = errno;
+      pthread_mutex_unlock (&ps->lock);
+      errno = saved_errno;
+      return (NULL);
+    }
+
+    /* Keep the times increasing even if the clock doesn't. */
+    ps->time = (now > r->time) ? now : r->time + 1;
+  }
+
+  copy = malloc (ps->size + 1);
+  if (copy == NULL)
+  {
+    pthread_mutex_unlock (&ps->lock);
+    errno = ENOMEM;
+    return (NULL);
+  }
+  memcpy (copy, ps->data, ps->size + 1);
+
+  r->time = ps->time;
+  if (ret_size != NULL)
+    *ret_size = ps->size;
+  if (ret_time != NULL)
+    *ret_time = ps->time;
+  pthread_mutex_unlock (&ps->lock);
+
+  return (copy);
+} /* }}} char *procfs_snapshot */
+
+void procfs_snapshot_shutdown (void) /* {{{ */
+{
+  procfs_snapshot_t *ps;
+
+  pthread_mutex_lock (&snapshots_lock);
+  ps = snapshots;
+  snapshots = NULL;
+  pthread_mutex_unlock (&snapshots_lock);
+
+  while (ps != NULL)
+  {
+    procfs_snapshot_t *next = ps->next;
+
+    while (ps->readers != NULL)
+    {
+      procfs_reader_t *r = ps->readers;
+
+      ps->readers = r->next;
+      sfree (r->name);
+      sfree (r);
+    }
+
+    procfs_close (ps->pf);
+    pthread_mutex_destroy (&ps->lock);
+    sfree (ps);
+
+    ps = next;
+  }
+} /* }}} void procfs_snapshot_shutdown */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,79 @@
+/**
+ * collectd - src/utils_procfs.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_PROCFS_H
+#define UTILS_PROCFS_H 1
+
+#include "utils_time.h"
+
+#include <stddef.h>
+
+/*
+ * Files in /proc which are read repeatedly. The file is kept open and read
+ * with pread(2) from offset zero, which makes the kernel generate the
+ * contents again, so short intervals don't cost an open(2) and close(2) each
+ * time. The contents are read into a buffer which is reused by the next read.
+ */
+struct procfs_file_s;
+typedef struct procfs_file_s procfs_file_t;
+
+/* Opens `path'. Returns NULL and sets errno on failure. */
+procfs_file_t *procfs_open (char const *path);
+
+/* Reads the current contents of the file. Returns a null-terminated buffer,
+ * which is valid and may be modified until the next call, or NULL and sets
+ * errno on failure. If `ret_size' is not NULL, the size of the contents is
+ * stored there. */
+char *procfs_read (procfs_file_t *pf, size_t *ret_size);
+
+void procfs_close (procfs_file_t *pf);
+
+/* Returns the line at `*cursor' and advances `*cursor' to the next line, or
+ * returns NULL at the end of the buffer. The newline is replaced by a null
+ * byte. */
+char *procfs_next_line (char **cursor);
+
+/*
+ * Shared snapshots of files read by several plugins, for example /proc/stat,
+ * which is read by the cpu, contextswitch, processes and swap plugins. Each
+ * file is kept open and read at most once per "tick", i.e. a snapshot is
+ * reused as long as it is younger than half the read interval of the calling
+ * plugin. Plugins should use the time of the snapshot as the time of the
+ * values they parse from it, so that values read from the same snapshot have
+ * the same time and rates are computed correctly.
+ *
+ * A plugin never gets the same snapshot twice. If the current snapshot is
+ * not newer than the one last returned to the calling plugin, the file is
+ * read again, so every read dispatches its values with a new time.
+ */
+
+/* Returns a copy of the current snapshot of `path', which must be freed by
+ * the caller, or NULL and sets errno on failure. The size of the contents is
+ * stored in `ret_size' and the time of the snapshot in `ret_time', if they
+ * are not NULL. The time is later than that of any snapshot of `path'
+ * returned to the calling plugin before. */
+char *procfs_snapshot (char const *path, size_t *ret_size, cdtime_t *ret_time);
+
+/* Closes the files of all snapshots. */
+void procfs_snapshot_shutdown (void);
+
+#endif /* UTILS_PROCFS_H */
+/* vim: set sw=2 sts=2 et : */
@@ -0,0 +1,436 @@
+/**
+ * collectd - src/utils_profile.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "plugin.h"
+#include "utils_profile.h"
+
+#include <pthread.h>
+
+#define PROFILE_TABLE_INITIAL_SIZE 32
+
+/* Statistics of one callback. Slots with an empty name are unused. */
+struct profile_entry_s
+{
+  char name[DATA_MAX_NAME_LEN];
+  int kind;
+  uint32_t hash;
+
+  uint64_t calls;
+  cdtime_t time;
+  uint64_t values;
+};
+typedef struct profile_entry_s profile_entry_t;
+
+/* Hash table of entries using open addressing. `size' is a power of two. */
+struct profile_table_s
+{
+  profile_entry_t *entries;
+  size_t size;
+  size_t num;
+};
+typedef struct profile_table_s profile_table_t;
+
+/* Statistics of one thread. The lock is only contended while profile_read()
+ * collects the statistics. */
+struct profile_thread_s;
+typedef struct profile_thread_s profile_thread_t;
+struct profile_thread_s
+{
+  pthread_mutex_t lock;
+  profile_table_t table;
+  profile_thread_t *next;
+};
+
+static char const *profile_kind_names[] = { "read", "write", "match",
+  "target", "dispatch" };
+
+/* Protects the state of profiling. It is switched by the unixsock thread
+ * while other threads check it. */
+static pthread_mutex_t profile_enabled_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool profile_enabled = 0;
+static _Bool profile_registered = 0;
+
+static pthread_once_t profile_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profile_key;
+
+/* Protects the list of threads and the statistics of exited threads. */
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static profile_thread_t *profile_threads = NULL;
+static profile_table_t profile_retired = { NULL, 0, 0 };
+
+/* Totals reported by the previous profile_read(), used for averages. */
+static profile_table_t profile_last = { NULL, 0, 0 };
+
+/*
+ * Tables
+ */
+static uint32_t profile_hash (int kind, char const *name) /* {{{ */
+{
+  uint32_t hash = 2166136261U;
+
+  hash = (hash ^ (uint32_t) kind) * 16777619U;
+  while (*name != 0)
+  {
+    hash = (hash ^ (uint32_t) (unsigned char) *name) * 16777619U;
+    name++;
+  }
+
+  return (hash);
+} /* }}} uint32_t profile_hash */
+
+static profile_entry_t *profile_table_find (profile_table_t *t, /* {{{ */
+    int kind, char const *name, uint32_t hash)
+{
+  size_t i;
+
+  if (t->size == 0)
+    return (NULL);
+
+  for (i = hash & (t->size - 1); t->entries[i].name[0] != 0;
+      i = (i + 1) & (t->size - 1))
+  {
+    profile_entry_t *e = t->entries + i;
+
+    if ((e->hash == hash) && (e->kind == kind)
+        && (strcmp (e->name, name) == 0))
+      return (e);
+  }
+
+  /* Return the free slot, so that the caller can fill it. */
+  return (t->entries + i);
+} /* }}} profile_entry_t *profile_table_find */
+
+static int profile_table_grow (profile_table_t *t) /* {{{ */
+{
+  profile_table_t new = { NULL, 0, t->num };
+  size_t i;
+
+  new.size = (t->size == 0) ? PROFILE_TABLE_INITIAL_SIZE : (2 * t->size);
+  new.entries = calloc (new.size, sizeof (*new.entries));
+  if (new.entries == NULL)
+    return (ENOMEM);
+
+  for (i = 0; i < t->size; i++)
+  {
+    profile_entry_t *e = t->entries + i;
+
+    if (e->name[0] == 0)
+      continue;
+    memcpy (profile_table_find (&new, e->kind, e->name, e->hash), e,
+        sizeof (*e));
+  }
+
+  free (t->entries);
+  *t = new;
+  return (0);
+} /* }}} int profile_table_grow */
+
+/* Returns the entry for `name', creating it if necessary. */
+static profile_entry_t *profile_table_get (profile_table_t *t, /* {{{ */
+    int kind, char const *name, uint32_t hash)
+{
+  profile_entry_t *e;
+
+  if ((2 * (t->num + 1)) > t->size)
+  {
+    if (profile_table_grow (t) != 0)
+      return (NULL);
+  }
+
+  e = profile_table_find (t, kind, name, hash);
+  if (e->name[0] == 0)
+  {
+    sstrncpy (e->name, name, sizeof (e->name));
+    e->kind = kind;
+    e->hash = hash;
+    t->num++;
+  }
+
+  return (e);
+} /* }}} profile_entry_t *profile_table_get */
+
+static void profile_table_merge (profile_table_t *dst, /* {{{ */
+    profile_table_t const *src)
+{
+  size_t i;
+
+  for (i = 0; i < src->size; i++)
+  {
+    profile_entry_t const *s = src->entries + i;
+    profile_entry_t *d;
+
+    if (s->name[0] == 0)
+      continue;
+
+    d = profile_table_get (dst, s->kind, s->name, s->hash);
+    if (d == NULL)
+      continue;
+
+    d->calls += s->calls;
+    d->time += s->time;
+    d->values += s->values;
+  }
+} /* }}} void profile_table_merge */
+
+/*
+ * Threads
+ */
+/* Called when a thread exits. Its statistics are kept, so that the reported
+ * totals don't decrease. */
+static void profile_thread_destroy (void *arg) /* {{{ */
+{
+  profile_thread_t *pt = arg;
+  profile_thread_t **prev;
+
+  pthread_mutex_lock (&profile_lock);
+  for (prev = &profile_threads; *prev != NULL; prev = &(*prev)->next)
+  {
+    if (*prev == pt)
+    {
+      *prev = pt->next;
+      break;
+    }
+  }
+  profile_table_merge (&profile_retired, &pt->table);
+  pthread_mutex_unlock (&profile_lock);
+
+  pthread_mutex_destroy (&pt->lock);
+  free (pt->table.entries);
+  free (pt);
+} /* }}} void profile_thread_destroy */
+
+static void profile_init_key (void) /* {{{ */
+{
+  pthread_key_create (&profile_key, profile_thread_destroy);
+} /* }}} void profile_init_key */
+
+static profile_thread_t *profile_thread_get (void) /* {{{ */
+{
+  profile_thread_t *pt;
+
+  pthread_once (&profile_once, profile_init_key);
+
+  pt = pthread_getspecific (profile_key);
+  if (pt != NULL)
+    return (pt);
+
+  pt = calloc (1, sizeof (*pt));
+  if (pt == NULL)
+    return (NULL);
+  pthread_mutex_init (&pt->lock, /* attr = */ NULL);
+
+  pthread_mutex_lock (&profile_lock);
+  pt->next = profile_threads;
+  profile_threads = pt;
+  pthread_mutex_unlock (&profile_lock);
+
+  pthread_setspecific (profile_key, pt);
+  return (pt);
+} /* }}} profile_thread_t *profile_thread_get */
+
+/*
+ * Reporting
+ */
+static void profile_submit (char const *plugin_instance, /* {{{ */
+    char const *type, char const *type_instance, value_t value)
+{
+  value_list_t vl = VALUE_LIST_INIT;
+
+  vl.values = &value;
+  vl.values_len = 1;
+  sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+  sstrncpy (vl.plugin, "collectd", sizeof (vl.plugin));
+  sstrncpy (vl.plugin_instance, plugin_instance, sizeof (vl.plugin_instance));
+  sstrncpy (vl.type, type, sizeof (vl.type));
+  sstrncpy (vl.type_instance, type_instance, sizeof (vl.type_instance));
+
+  plugin_dispatch_values (&vl);
+} /* }}} void profile_submit */
+
+static void profile_submit_entry (profile_entry_t const *e, /* {{{ */
+    profile_entry_t const *last)
+{
+  char const *kind = profile_kind_names[e->kind];
+  value_t value;
+
+  if (e->kind == PROFILE_DISPATCH)
+  {
+    value.derive = (derive_t) e->values;
+    profile_submit (kind, "total_values", e->name, value);
+    return;
+  }
+
+  value.derive = (derive_t) CDTIME_T_TO_MS (e->time);
+  profile_submit (kind, "total_time_in_ms", e->name, value);
+
+  value.derive = (derive_t) e->calls;
+  profile_submit (kind, "invocations", e->name, value);
+
+  /* Average run time of the calls since the last report. */
+  if ((last != NULL) && (e->calls > last->calls))
+  {
+    value.gauge = CDTIME_T_TO_DOUBLE (e->time - last->time)
+      / ((double) (e->calls - last->calls));
+    profile_submit (kind, "duration", e->name, value);
+  }
+} /* }}} void profile_submit_entry */
+
+/* Read callback dispatching the statistics of all threads. Does nothing
+ * while profiling is disabled. */
+static int profile_read (void) /* {{{ */
+{
+  profile_table_t sum = { NULL, 0, 0 };
+  profile_thread_t *pt;
+  size_t i;
+
+  if (!profile_is_enabled ())
+    return (0);
+
+  pthread_mutex_lock (&profile_lock);
+  profile_table_merge (&sum, &profile_retired);
+  for (pt = profile_threads; pt != NULL; pt = pt->next)
+  {
+    pthread_mutex_lock (&pt->lock);
+    profile_table_merge (&sum, &pt->table);
+    pthread_mutex_unlock (&pt->lock);
+  }
+  pthread_mutex_unlock (&profile_lock);
+
+  for (i = 0; i < sum.size; i++)
+  {
+    profile_entry_t const *e = sum.entries + i;
+    profile_entry_t *last;
+
+    if (e->name[0] == 0)
+      continue;
+
+    last = profile_table_find (&profile_last, e->kind, e->name, e->hash);
+    if ((last != NULL) && (last->name[0] == 0))
+      last = NULL;
+
+    profile_submit_entry (e, last);
+  }
+
+  free (profile_last.entries);
+  profile_last = sum;
+
+  return (0);
+} /* }}} int profile_read */
+
+/* Registers profile_read() as a callback of the daemon rather than of the
+ * plugin whose thread enables profiling. */
+static int profile_register_read (void) /* {{{ */
+{
+  plugin_ctx_t ctx;
+  plugin_ctx_t old_ctx;
+  int status;
+
+  memset (&ctx, 0, sizeof (ctx));
+  old_ctx = plugin_set_ctx (ctx);
+  status = plugin_register_read ("collectd", profile_read);
+  plugin_set_ctx (old_ctx);
+
+  return (status);
+} /* }}} int profile_register_read */
+
+/*
+ * Public functions
+ */
+_Bool profile_is_enabled (void) /* {{{ */
+{
+  _Bool enabled;
+
+  pthread_mutex_lock (&profile_enabled_lock);
+  enabled = profile_enabled;
+  pthread_mutex_unlock (&profile_enabled_lock);
+
+  return (enabled);
+} /* }}} _Bool profile_is_enabled */
+
+void profile_set_enabled (_Bool enabled) /* {{{ */
+{
+  _Bool do_register;
+
+  pthread_mutex_lock (&profile_enabled_lock);
+  if (profile_enabled == enabled)
+  {
+    pthread_mutex_unlock (&profile_enabled_lock);
+    return;
+  }
+
+  profile_enabled = enabled;
+  do_register = enabled && !profile_registered;
+  if (do_register)
+    profile_registered = 1;
+  pthread_mutex_unlock (&profile_enabled_lock);
+
+  /* Register without holding `profile_enabled_lock', so that it is never
+   * nested with the locks plugin_register_read() takes. */
+  if (do_register && (profile_register_read () != 0))
+  {
+    ERROR ("collectd: Registering the profiling read callback failed.");
+    pthread_mutex_lock (&profile_enabled_lock);
+    profile_registered = 0;
+    pthread_mutex_unlock (&profile_enabled_lock);
+  }
+
+  INFO ("collectd: Profiling has been %s.", enabled ? "enabled" : "disabled");
+} /* }}} void profile_set_enabled */
+
+cdtime_t profile_clock (void) /* {{{ */
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+    return (TIMESPEC_TO_CDTIME_T (&ts));
+#endif
+
+  return (cdtime ());
+} /* }}} cdtime_t profile_clock */
+
+void profile_record (int kind, char const *name, /* {{{ */
+    cdtime_t duration, uint64_t values)
+{
+  profile_thread_t *pt;
+  profile_entry_t *e;
+
+  if ((name == NULL) || (name[0] == 0))
+    return;
+
+  pt = profile_thread_get ();
+  if (pt == NULL)
+    return;
+
+  pthread_mutex_lock (&pt->lock);
+  e = profile_table_get (&pt->table, kind, name, profile_hash (kind, name));
+  if (e != NULL)
+  {
+    e->calls++;
+    e->time += duration;
+    e->values += values;
+  }
+  pthread_mutex_unlock (&pt->lock);
+} /* }}} void profile_record */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
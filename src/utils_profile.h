@@ -0,0 +1,58 @@
+/**
+ * collectd - src/utils_profile.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_PROFILE_H
+#define UTILS_PROFILE_H 1
+
+#include "utils_time.h"
+
+#include <stdint.h>
+
+/*
+ * Self-profiling of the daemon. When enabled, the time spent in read, write,
+ * match and target callbacks and the number of values dispatched by each
+ * plugin are accumulated per thread and reported as metrics of the
+ * "collectd" plugin.
+ */
+#define PROFILE_READ     0
+#define PROFILE_WRITE    1
+#define PROFILE_MATCH    2
+#define PROFILE_TARGET   3
+#define PROFILE_DISPATCH 4
+
+/* Checked before taking any timestamps. */
+_Bool profile_is_enabled (void);
+
+/* Switches profiling on or off. The read callback dispatching the statistics
+ * is registered when profiling is enabled for the first time. */
+void profile_set_enabled (_Bool enabled);
+
+/* Returns a monotonic timestamp for measuring durations. */
+cdtime_t profile_clock (void);
+
+/* Adds one call of the callback `name' taking `duration' and handling
+ * `values' values to the statistics of the calling thread. */
+void profile_record (int kind, char const *name, cdtime_t duration,
+    uint64_t values);
+
+
+#endif /* UTILS_PROFILE_H */
+/* vim: set sw=2 sts=2 et : */
@@ -0,0 +1,1420 @@
+/**
+ * collectd - src/utils_regex_set.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "utils_regex_set.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <regex.h>
+
+/*
+ * Patterns are parsed into a syntax tree, which is then compiled into a
+ * Thompson NFA shared by all patterns of the set. Matching simulates the DFA
+ * corresponding to that NFA, computing (and caching) DFA states on demand.
+ * Each DFA state is the set of NFA nodes the automaton may be in. Since
+ * patterns are not anchored, the start nodes of all patterns are added after
+ * every byte.
+ *
+ * Anything the parser does not understand, e.g. back-references, word
+ * boundaries or collating elements, causes the pattern to be matched with
+ * regexec(3). The same happens if the current locale uses multi-byte
+ * characters, because the automaton works on bytes.
+ */
+
+/* Upper bound for the number of NFA nodes of one set. */
+#define RS_NODES_MAX 65536
+/* Upper bound for the `m' and `n' in bounds, i.e. "{m,n}". */
+#define RS_REPEAT_MAX 255
+/* Maximum nesting depth of parentheses. */
+#define RS_DEPTH_MAX 64
+/* Number of cached DFA states. When the cache is full, it is cleared. */
+#define RS_STATES_MAX 1024
+#define RS_TABLE_SIZE (2 * RS_STATES_MAX)
+
+/*
+ * Types
+ */
+struct rs_charset_s
+{
+  uint32_t bits[8];
+};
+typedef struct rs_charset_s rs_charset_t;
+
+/* Syntax tree */
+#define RS_AST_SET    0
+#define RS_AST_CAT    1
+#define RS_AST_ALT    2
+#define RS_AST_STAR   3
+#define RS_AST_PLUS   4
+#define RS_AST_QUEST  5
+#define RS_AST_REPEAT 6
+#define RS_AST_BOL    7
+#define RS_AST_EOL    8
+#define RS_AST_EMPTY  9
+
+struct rs_ast_s
+{
+  int type;
+  int left;
+  int right;
+  int min;
+  int max; /* negative for "no upper bound" */
+  rs_charset_t cs;
+};
+typedef struct rs_ast_s rs_ast_t;
+
+struct rs_parser_s
+{
+  char const *str;
+  size_t pos;
+  int depth;
+
+  rs_ast_t *ast;
+  size_t ast_num;
+  size_t ast_size;
+};
+typedef struct rs_parser_s rs_parser_t;
+
+/* NFA */
+#define RS_NODE_CHAR  0
+#define RS_NODE_SPLIT 1
+#define RS_NODE_BOL   2
+#define RS_NODE_EOL   3
+#define RS_NODE_MATCH 4
+
+struct rs_node_s
+{
+  int type;
+  int out;
+  int out1;
+  int arg; /* charset index for RS_NODE_CHAR, pattern for RS_NODE_MATCH */
+};
+typedef struct rs_node_s rs_node_t;
+
+/* DFA */
+struct rs_state_s
+{
+  int *nodes;
+  size_t nodes_num;
+  int bol;
+  uint32_t hash;
+
+  int *next; /* per byte class; negative if not yet computed */
+  unsigned char *matches; /* bitmap; NULL if no pattern matches */
+  unsigned char *eol_matches; /* bitmap; patterns matching at the end */
+};
+typedef struct rs_state_s rs_state_t;
+
+struct rs_pattern_s
+{
+  regex_t re;
+  int compiled; /* non-zero if the pattern is part of the automaton */
+  char *exact; /* the only matching string, if any */
+};
+typedef struct rs_pattern_s rs_pattern_t;
+
+struct regex_set_s
+{
+  pthread_mutex_t lock;
+
+  rs_pattern_t *patterns;
+  size_t patterns_num;
+  size_t fallback_num;
+
+  rs_node_t *nodes;
+  size_t nodes_num;
+  rs_charset_t *charsets;
+  size_t charsets_num;
+  int *starts;
+  size_t starts_num;
+
+  /* Everything below is derived from the above when matching. */
+  int dirty;
+  unsigned char byte_class[256];
+  int class_rep[256];
+  int classes_num;
+
+  rs_state_t **states;
+  size_t states_num;
+  int *table;
+  int initial;
+
+  int *seeds;
+  int *closure;
+  int *stack;
+  unsigned int *mark;
+  unsigned int mark_gen;
+  unsigned char *acc;
+};
+
+/*
+ * Character sets
+ */
+static void rs_charset_add (rs_charset_t *cs, int c) /* {{{ */
+{
+  cs->bits[c / 32] |= ((uint32_t) 1) << (c % 32);
+} /* }}} void rs_charset_add */
+
+static int rs_charset_has (rs_charset_t const *cs, int c) /* {{{ */
+{
+  return ((cs->bits[c / 32] >> (c % 32)) & 1);
+} /* }}} int rs_charset_has */
+
+static int rs_charset_add_class (rs_charset_t *cs, /* {{{ */
+    char const *name, size_t name_len)
+{
+  struct
+  {
+    char const *name;
+    int (*func) (int);
+  } classes[] = {
+    { "alpha",  isalpha  },
+    { "digit",  isdigit  },
+    { "alnum",  isalnum  },
+    { "upper",  isupper  },
+    { "lower",  islower  },
+    { "space",  isspace  },
+    { "blank",  isblank  },
+    { "punct",  ispunct  },
+    { "print",  isprint  },
+    { "graph",  isgraph  },
+    { "cntrl",  iscntrl  },
+    { "xdigit", isxdigit }
+  };
+  size_t i;
+  int c;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (classes); i++)
+  {
+    if ((strlen (classes[i].name) != name_len)
+        || (strncmp (classes[i].name, name, name_len) != 0))
+      continue;
+
+    for (c = 1; c < 256; c++)
+      if (classes[i].func (c))
+        rs_charset_add (cs, c);
+    return (0);
+  }
+
+  return (-1);
+} /* }}} int rs_charset_add_class */
+
+/*
+ * Parser
+ *
+ * All parser functions return the index of the created syntax tree node or
+ * -1 if the pattern cannot be handled. Since regcomp(3) has accepted the
+ * pattern already, -1 usually means "not supported".
+ */
+static int rs_parse_regex (rs_parser_t *p);
+
+static int rs_ast_new (rs_parser_t *p, int type, int left, int right) /* {{{ */
+{
+  rs_ast_t *a;
+
+  if (p->ast_num >= p->ast_size)
+  {
+    size_t new_size = (p->ast_size == 0) ? 16 : 2 * p->ast_size;
+    rs_ast_t *tmp;
+
+    tmp = realloc (p->ast, new_size * sizeof (*p->ast));
+    if (tmp == NULL)
+      return (-1);
+    p->ast = tmp;
+    p->ast_size = new_size;
+  }
+
+  a = p->ast + p->ast_num;
+  memset (a, 0, sizeof (*a));
+  a->type = type;
+  a->left = left;
+  a->right = right;
+
+  return ((int) p->ast_num++);
+} /* }}} int rs_ast_new */
+
+static int rs_ast_new_set (rs_parser_t *p, rs_charset_t const *cs) /* {{{ */
+{
+  int n;
+
+  n = rs_ast_new (p, RS_AST_SET, -1, -1);
+  if (n < 0)
+    return (-1);
+  memcpy (&p->ast[n].cs, cs, sizeof (*cs));
+
+  return (n);
+} /* }}} int rs_ast_new_set */
+
+/* Parses a bracket expression, e.g. "[^a-z[:digit:]]". */
+static int rs_parse_bracket (rs_parser_t *p) /* {{{ */
+{
+  char const *s = p->str;
+  size_t pos = p->pos + 1;
+  rs_charset_t cs;
+  int negate = 0;
+  int first = 1;
+  int i;
+
+  memset (&cs, 0, sizeof (cs));
+
+  if (s[pos] == '^')
+  {
+    negate = 1;
+    pos++;
+  }
+
+  while (42)
+  {
+    unsigned char lo = (unsigned char) s[pos];
+    unsigned char hi;
+
+    if (lo == 0)
+      return (-1);
+    if ((lo == ']') && !first)
+    {
+      pos++;
+      break;
+    }
+    first = 0;
+
+    if ((lo == '[') && (s[pos + 1] == ':'))
+    {
+      char const *end = strstr (s + pos + 2, ":]");
+
+      if (end == NULL)
+        return (-1);
+      if (rs_charset_add_class (&cs, s + pos + 2,
+            (size_t) (end - (s + pos + 2))) != 0)
+        return (-1);
+      pos = (size_t) (end - s) + 2;
+      continue;
+    }
+    else if ((lo == '[') && ((s[pos + 1] == '=') || (s[pos + 1] == '.')))
+      return (-1);
+
+    pos++;
+    if ((s[pos] == '-') && (s[pos + 1] != ']') && (s[pos + 1] != 0))
+    {
+      hi = (unsigned char) s[pos + 1];
+      if ((hi == '[') || (hi < lo))
+        return (-1);
+      pos += 2;
+    }
+    else
+    {
+      hi = lo;
+    }
+
+    for (i = lo; i <= hi; i++)
+      rs_charset_add (&cs, i);
+  }
+
+  if (negate)
+    for (i = 0; i < 8; i++)
+      cs.bits[i] = ~cs.bits[i];
+  /* Strings never contain the null byte. */
+  cs.bits[0] &= ~((uint32_t) 1);
+
+  p->pos = pos;
+  return (rs_ast_new_set (p, &cs));
+} /* }}} int rs_parse_bracket */
+
+static int rs_parse_escape (rs_parser_t *p) /* {{{ */
+{
+  unsigned char c = (unsigned char) p->str[p->pos + 1];
+  rs_charset_t cs;
+  int i;
+
+  memset (&cs, 0, sizeof (cs));
+
+  switch (c)
+  {
+    case 'w':
+    case 'W':
+      rs_charset_add_class (&cs, "alnum", strlen ("alnum"));
+      rs_charset_add (&cs, '_');
+      break;
+
+    case 's':
+    case 'S':
+      rs_charset_add_class (&cs, "space", strlen ("space"));
+      break;
+
+    default:
+      /* Back-references, word boundaries and friends are not supported. */
+      if ((c == 0) || isalnum (c))
+        return (-1);
+      rs_charset_add (&cs, c);
+  }
+
+  if ((c == 'W') || (c == 'S'))
+  {
+    for (i = 0; i < 8; i++)
+      cs.bits[i] = ~cs.bits[i];
+    cs.bits[0] &= ~((uint32_t) 1);
+  }
+
+  p->pos += 2;
+  return (rs_ast_new_set (p, &cs));
+} /* }}} int rs_parse_escape */
+
+static int rs_parse_atom (rs_parser_t *p) /* {{{ */
+{
+  unsigned char c = (unsigned char) p->str[p->pos];
+  rs_charset_t cs;
+  int n;
+  int i;
+
+  memset (&cs, 0, sizeof (cs));
+
+  switch (c)
+  {
+    case '(':
+      if (p->depth >= RS_DEPTH_MAX)
+        return (-1);
+      p->pos++;
+      p->depth++;
+      n = rs_parse_regex (p);
+      p->depth--;
+      if ((n < 0) || (p->str[p->pos] != ')'))
+        return (-1);
+      p->pos++;
+      return (n);
+
+    case '.':
+      for (i = 1; i < 256; i++)
+        rs_charset_add (&cs, i);
+      p->pos++;
+      return (rs_ast_new_set (p, &cs));
+
+    case '^':
+      p->pos++;
+      return (rs_ast_new (p, RS_AST_BOL, -1, -1));
+
+    case '$':
+      p->pos++;
+      return (rs_ast_new (p, RS_AST_EOL, -1, -1));
+
+    case '[':
+      return (rs_parse_bracket (p));
+
+    case '\\':
+      return (rs_parse_escape (p));
+
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '|':
+    case ')':
+      return (-1);
+
+    default:
+      rs_charset_add (&cs, c);
+      p->pos++;
+      return (rs_ast_new_set (p, &cs));
+  }
+} /* }}} int rs_parse_atom */
+
+static int rs_parse_number (rs_parser_t *p, int *ret) /* {{{ */
+{
+  int n = 0;
+
+  if (!isdigit ((unsigned char) p->str[p->pos]))
+    return (-1);
+
+  while (isdigit ((unsigned char) p->str[p->pos]))
+  {
+    n = 10 * n + (p->str[p->pos] - '0');
+    if (n > RS_REPEAT_MAX)
+      return (-1);
+    p->pos++;
+  }
+
+  *ret = n;
+  return (0);
+} /* }}} int rs_parse_number */
+
+static int rs_ast_has_anchor (rs_parser_t const *p, int n) /* {{{ */
+{
+  rs_ast_t const *a;
+
+  if (n < 0)
+    return (0);
+
+  a = p->ast + n;
+  if ((a->type == RS_AST_BOL) || (a->type == RS_AST_EOL))
+    return (1);
+  return (rs_ast_has_anchor (p, a->left) || rs_ast_has_anchor (p, a->right));
+} /* }}} int rs_ast_has_anchor */
+
+static int rs_parse_piece (rs_parser_t *p) /* {{{ */
+{
+  int n;
+
+  n = rs_parse_atom (p);
+  while (n >= 0)
+  {
+    char c = p->str[p->pos];
+    int min;
+    int max;
+
+    if ((c != '*') && (c != '+') && (c != '?') && (c != '{'))
+      break;
+
+    /* regexec(3) treats anchors inside repeated expressions inconsistently,
+     * e.g. "(^a){2}" matches "aa". Leave these to regexec(3). */
+    if (rs_ast_has_anchor (p, n))
+      return (-1);
+
+    p->pos++;
+    if (c == '*')
+      n = rs_ast_new (p, RS_AST_STAR, n, -1);
+    else if (c == '+')
+      n = rs_ast_new (p, RS_AST_PLUS, n, -1);
+    else if (c == '?')
+      n = rs_ast_new (p, RS_AST_QUEST, n, -1);
+    else /* if (c == '{') */
+    {
+      if (rs_parse_number (p, &min) != 0)
+        return (-1);
+      max = min;
+      if (p->str[p->pos] == ',')
+      {
+        p->pos++;
+        max = -1;
+        if ((p->str[p->pos] != '}') && (rs_parse_number (p, &max) != 0))
+          return (-1);
+      }
+      if ((p->str[p->pos] != '}') || ((max >= 0) && (max < min)))
+        return (-1);
+      p->pos++;
+
+      n = rs_ast_new (p, RS_AST_REPEAT, n, -1);
+      if (n >= 0)
+      {
+        p->ast[n].min = min;
+        p->ast[n].max = max;
+      }
+    }
+  }
+
+  return (n);
+} /* }}} int rs_parse_piece */
+
+static int rs_parse_branch (rs_parser_t *p) /* {{{ */
+{
+  int n = -1;
+  int have_piece = 0;
+
+  while ((p->str[p->pos] != 0)
+      && (p->str[p->pos] != '|')
+      && (p->str[p->pos] != ')'))
+  {
+    int piece = rs_parse_piece (p);
+
+    if (piece < 0)
+      return (-1);
+
+    if (have_piece)
+      n = rs_ast_new (p, RS_AST_CAT, n, piece);
+    else
+      n = piece;
+    have_piece = 1;
+
+    if (n < 0)
+      return (-1);
+  }
+
+  if (!have_piece)
+    n = rs_ast_new (p, RS_AST_EMPTY, -1, -1);
+
+  return (n);
+} /* }}} int rs_parse_branch */
+
+static int rs_parse_regex (rs_parser_t *p) /* {{{ */
+{
+  int n;
+
+  n = rs_parse_branch (p);
+  while ((n >= 0) && (p->str[p->pos] == '|'))
+  {
+    int right;
+
+    p->pos++;
+    right = rs_parse_branch (p);
+    if (right < 0)
+      return (-1);
+
+    n = rs_ast_new (p, RS_AST_ALT, n, right);
+  }
+
+  return (n);
+} /* }}} int rs_parse_regex */
+
+/*
+ * NFA construction
+ *
+ * Nodes are emitted back to front: rs_emit compiles the syntax tree `ast' so
+ * that it continues with node `next' and returns the node to start with.
+ */
+static int rs_node_new (regex_set_t *set, int type, /* {{{ */
+    int out, int out1, int arg)
+{
+  rs_node_t *n;
+
+  if (set->nodes_num >= RS_NODES_MAX)
+    return (-1);
+
+  if ((set->nodes_num & (set->nodes_num - 1)) == 0)
+  {
+    size_t new_size = (set->nodes_num == 0) ? 16 : 2 * set->nodes_num;
+    rs_node_t *tmp;
+
+    tmp = realloc (set->nodes, new_size * sizeof (*set->nodes));
+    if (tmp == NULL)
+      return (-1);
+    set->nodes = tmp;
+  }
+
+  n = set->nodes + set->nodes_num;
+  n->type = type;
+  n->out = out;
+  n->out1 = out1;
+  n->arg = arg;
+
+  return ((int) set->nodes_num++);
+} /* }}} int rs_node_new */
+
+static int rs_charset_new (regex_set_t *set, /* {{{ */
+    rs_charset_t const *cs)
+{
+  if ((set->charsets_num & (set->charsets_num - 1)) == 0)
+  {
+    size_t new_size = (set->charsets_num == 0) ? 16 : 2 * set->charsets_num;
+    rs_charset_t *tmp;
+
+    tmp = realloc (set->charsets, new_size * sizeof (*set->charsets));
+    if (tmp == NULL)
+      return (-1);
+    set->charsets = tmp;
+  }
+
+  memcpy (set->charsets + set->charsets_num, cs, sizeof (*cs));
+  return ((int) set->charsets_num++);
+} /* }}} int rs_charset_new */
+
+/* Emits a loop around `ast': `ast' may be repeated any number of times before
+ * continuing with `next'. Returns the loop's split node and stores the start
+ * of the body in `ret_body'. */
+static int rs_emit (regex_set_t *set, rs_parser_t const *p, int ast, int next);
+
+static int rs_emit_loop (regex_set_t *set, /* {{{ */
+    rs_parser_t const *p, int ast, int next, int *ret_body)
+{
+  int split;
+  int body;
+
+  split = rs_node_new (set, RS_NODE_SPLIT, -1, next, 0);
+  if (split < 0)
+    return (-1);
+
+  body = rs_emit (set, p, ast, split);
+  if (body < 0)
+    return (-1);
+  set->nodes[split].out = body;
+
+  if (ret_body != NULL)
+    *ret_body = body;
+  return (split);
+} /* }}} int rs_emit_loop */
+
+static int rs_emit (regex_set_t *set, rs_parser_t const *p, /* {{{ */
+    int ast, int next)
+{
+  rs_ast_t const *a = p->ast + ast;
+  int n;
+  int i;
+
+  switch (a->type)
+  {
+    case RS_AST_SET:
+      n = rs_charset_new (set, &a->cs);
+      if (n < 0)
+        return (-1);
+      return (rs_node_new (set, RS_NODE_CHAR, next, -1, n));
+
+    case RS_AST_CAT:
+      n = rs_emit (set, p, a->right, next);
+      if (n < 0)
+        return (-1);
+      return (rs_emit (set, p, a->left, n));
+
+    case RS_AST_ALT:
+    {
+      int left;
+      int right;
+
+      left = rs_emit (set, p, a->left, next);
+      if (left < 0)
+        return (-1);
+      right = rs_emit (set, p, a->right, next);
+      if (right < 0)
+        return (-1);
+      return (rs_node_new (set, RS_NODE_SPLIT, left, right, 0));
+    }
+
+    case RS_AST_QUEST:
+      n = rs_emit (set, p, a->left, next);
+      if (n < 0)
+        return (-1);
+      return (rs_node_new (set, RS_NODE_SPLIT, n, next, 0));
+
+    case RS_AST_STAR:
+      return (rs_emit_loop (set, p, a->left, next, NULL));
+
+    case RS_AST_PLUS:
+      if (rs_emit_loop (set, p, a->left, next, &n) < 0)
+        return (-1);
+      return (n);
+
+    case RS_AST_REPEAT:
+      n = next;
+      if (a->max < 0)
+      {
+        n = rs_emit_loop (set, p, a->left, next, NULL);
+        if (n < 0)
+          return (-1);
+      }
+      else
+      {
+        /* "a{2,4}" is compiled like "aa(a(a)?)?". */
+        for (i = a->min; i < a->max; i++)
+        {
+          n = rs_emit (set, p, a->left, n);
+          if (n < 0)
+            return (-1);
+          n = rs_node_new (set, RS_NODE_SPLIT, n, next, 0);
+          if (n < 0)
+            return (-1);
+        }
+      }
+      for (i = 0; i < a->min; i++)
+      {
+        n = rs_emit (set, p, a->left, n);
+        if (n < 0)
+          return (-1);
+      }
+      return (n);
+
+    case RS_AST_BOL:
+      return (rs_node_new (set, RS_NODE_BOL, next, -1, 0));
+
+    case RS_AST_EOL:
+      return (rs_node_new (set, RS_NODE_EOL, next, -1, 0));
+
+    case RS_AST_EMPTY:
+      return (next);
+  }
+
+  return (-1);
+} /* }}} int rs_emit */
+
+/* Adds pattern `index' to the automaton. On failure, the automaton is left
+ * unchanged. */
+static int rs_compile (regex_set_t *set, char const *pattern, /* {{{ */
+    int index)
+{
+  rs_parser_t p;
+  size_t nodes_num = set->nodes_num;
+  size_t charsets_num = set->charsets_num;
+  int *tmp;
+  int root;
+  int start = -1;
+
+  if (MB_CUR_MAX > 1)
+    return (-1);
+
+  memset (&p, 0, sizeof (p));
+  p.str = pattern;
+
+  root = rs_parse_regex (&p);
+  if ((root >= 0) && (pattern[p.pos] == 0))
+  {
+    start = rs_node_new (set, RS_NODE_MATCH, -1, -1, index);
+    if (start >= 0)
+      start = rs_emit (set, &p, root, start);
+  }
+  free (p.ast);
+
+  if (start >= 0)
+  {
+    tmp = realloc (set->starts, (set->starts_num + 1) * sizeof (*tmp));
+    if (tmp != NULL)
+    {
+      set->starts = tmp;
+      set->starts[set->starts_num] = start;
+      set->starts_num++;
+      return (0);
+    }
+  }
+
+  set->nodes_num = nodes_num;
+  set->charsets_num = charsets_num;
+  return (-1);
+} /* }}} int rs_compile */
+
+/* Returns the string matched by `pattern' if it is an anchored literal, e.g.
+ * "^foo\.bar$", or NULL otherwise. */
+static char *rs_exact_string (char const *pattern) /* {{{ */
+{
+  size_t len = strlen (pattern);
+  char *ret;
+  size_t i;
+  size_t j = 0;
+
+  if ((len < 2) || (pattern[0] != '^') || (pattern[len - 1] != '$'))
+    return (NULL);
+
+  ret = malloc (len);
+  if (ret == NULL)
+    return (NULL);
+
+  for (i = 1; i < len - 1; i++)
+  {
+    char c = pattern[i];
+
+    if (c == '\\')
+    {
+      i++;
+      c = pattern[i];
+      /* The last '$' is escaped or the escape sequence has a special
+       * meaning. */
+      if ((i >= len - 1) || isalnum ((unsigned char) c))
+      {
+        free (ret);
+        return (NULL);
+      }
+    }
+    else if (strchr (".[]()*+?{}|^$", c) != NULL)
+    {
+      free (ret);
+      return (NULL);
+    }
+
+    ret[j++] = c;
+  }
+
+  ret[j] = 0;
+  return (ret);
+} /* }}} char *rs_exact_string */
+
+/*
+ * DFA
+ */
+/* Computes the set of nodes reachable from `seeds' without consuming input.
+ * Only RS_NODE_CHAR, RS_NODE_MATCH and (unless `eol' is set) RS_NODE_EOL nodes
+ * are stored in `set->closure'. The result is sorted. */
+static int rs_int_compare (void const *a, void const *b) /* {{{ */
+{
+  int i = *((int const *) a);
+  int j = *((int const *) b);
+
+  return ((i > j) - (i < j));
+} /* }}} int rs_int_compare */
+
+static size_t rs_closure (regex_set_t *set, /* {{{ */
+    int const *seeds, size_t seeds_num, int bol, int eol)
+{
+  size_t stack_num = 0;
+  size_t num = 0;
+  size_t i;
+
+  set->mark_gen++;
+  if (set->mark_gen == 0)
+  {
+    memset (set->mark, 0, set->nodes_num * sizeof (*set->mark));
+    set->mark_gen = 1;
+  }
+
+  for (i = seeds_num; i > 0; i--)
+    set->stack[stack_num++] = seeds[i - 1];
+
+  while (stack_num > 0)
+  {
+    int n = set->stack[--stack_num];
+    rs_node_t const *node = set->nodes + n;
+
+    if (set->mark[n] == set->mark_gen)
+      continue;
+    set->mark[n] = set->mark_gen;
+
+    switch (node->type)
+    {
+      case RS_NODE_SPLIT:
+        set->stack[stack_num++] = node->out1;
+        set->stack[stack_num++] = node->out;
+        break;
+
+      case RS_NODE_BOL:
+        if (bol)
+          set->stack[stack_num++] = node->out;
+        break;
+
+      case RS_NODE_EOL:
+        if (eol)
+          set->stack[stack_num++] = node->out;
+        else
+          set->closure[num++] = n;
+        break;
+
+      default:
+        set->closure[num++] = n;
+    }
+  }
+
+  qsort (set->closure, num, sizeof (*set->closure), rs_int_compare);
+  return (num);
+} /* }}} size_t rs_closure */
+
+static void rs_state_free (rs_state_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  sfree (s->nodes);
+  sfree (s->next);
+  sfree (s->matches);
+  sfree (s->eol_matches);
+  sfree (s);
+} /* }}} void rs_state_free */
+
+static void rs_states_reset (regex_set_t *set) /* {{{ */
+{
+  size_t i;
+
+  for (i = 0; i < set->states_num; i++)
+  {
+    rs_state_free (set->states[i]);
+    set->states[i] = NULL;
+  }
+  set->states_num = 0;
+  set->initial = -1;
+
+  for (i = 0; i < RS_TABLE_SIZE; i++)
+    set->table[i] = -1;
+} /* }}} void rs_states_reset */
+
+/* Returns a bitmap of the patterns whose match nodes are in `set->closure'. */
+static unsigned char *rs_match_bitmap (regex_set_t *set, /* {{{ */
+    size_t closure_num, int *ret_error)
+{
+  unsigned char *bitmap = NULL;
+  size_t i;
+
+  for (i = 0; i < closure_num; i++)
+  {
+    rs_node_t const *n = set->nodes + set->closure[i];
+
+    if (n->type != RS_NODE_MATCH)
+      continue;
+
+    if (bitmap == NULL)
+    {
+      bitmap = calloc ((set->patterns_num + 7) / 8, 1);
+      if (bitmap == NULL)
+      {
+        *ret_error = 1;
+        return (NULL);
+      }
+    }
+    bitmap[n->arg / 8] |= (unsigned char) (1 << (n->arg % 8));
+  }
+
+  return (bitmap);
+} /* }}} unsigned char *rs_match_bitmap */
+
+/* Returns the index of the state reached from `seeds', creating it if
+ * necessary. `seeds' may point to `set->seeds'. */
+static int rs_state_get (regex_set_t *set, /* {{{ */
+    int const *seeds, size_t seeds_num, int bol)
+{
+  rs_state_t *s;
+  size_t num;
+  uint32_t hash = 2166136261U;
+  size_t slot;
+  size_t eol_num;
+  int error = 0;
+  size_t i;
+
+  num = rs_closure (set, seeds, seeds_num, bol, /* eol = */ 0);
+
+  hash = (hash ^ (uint32_t) bol) * 16777619U;
+  for (i = 0; i < num; i++)
+    hash = (hash ^ (uint32_t) set->closure[i]) * 16777619U;
+
+  slot = hash & (RS_TABLE_SIZE - 1);
+  while (set->table[slot] >= 0)
+  {
+    s = set->states[set->table[slot]];
+    if ((s->hash == hash) && (s->bol == bol) && (s->nodes_num == num)
+        && (memcmp (s->nodes, set->closure, num * sizeof (int)) == 0))
+      return (set->table[slot]);
+    slot = (slot + 1) & (RS_TABLE_SIZE - 1);
+  }
+
+  if (set->states_num >= RS_STATES_MAX)
+    return (-1);
+
+  s = calloc (1, sizeof (*s));
+  if (s == NULL)
+    return (-1);
+  s->bol = bol;
+  s->hash = hash;
+  s->nodes_num = num;
+  s->nodes = malloc ((num + 1) * sizeof (*s->nodes));
+  s->next = malloc (set->classes_num * sizeof (*s->next));
+  if ((s->nodes == NULL) || (s->next == NULL))
+  {
+    rs_state_free (s);
+    return (-1);
+  }
+  memcpy (s->nodes, set->closure, num * sizeof (*s->nodes));
+  for (i = 0; i < (size_t) set->classes_num; i++)
+    s->next[i] = -1;
+
+  s->matches = rs_match_bitmap (set, num, &error);
+
+  /* Patterns matching if the string ends here: follow the "$" nodes. */
+  eol_num = 0;
+  for (i = 0; i < num; i++)
+    if (set->nodes[s->nodes[i]].type == RS_NODE_EOL)
+      set->seeds[eol_num++] = set->nodes[s->nodes[i]].out;
+  if (eol_num > 0)
+  {
+    num = rs_closure (set, set->seeds, eol_num, bol, /* eol = */ 1);
+    s->eol_matches = rs_match_bitmap (set, num, &error);
+  }
+
+  if (error)
+  {
+    rs_state_free (s);
+    return (-1);
+  }
+
+  set->table[slot] = (int) set->states_num;
+  set->states[set->states_num] = s;
+  return ((int) set->states_num++);
+} /* }}} int rs_state_get */
+
+/* Computes the transition of state `from' for byte class `class'. */
+static int rs_transition (regex_set_t *set, int from, int class) /* {{{ */
+{
+  rs_state_t *s;
+  size_t seeds_num = 0;
+  int c = set->class_rep[class];
+  int to;
+  size_t i;
+
+  if (set->states_num >= RS_STATES_MAX)
+  {
+    /* Start over, keeping only the current state. */
+    int bol;
+
+    s = set->states[from];
+    memcpy (set->seeds, s->nodes, s->nodes_num * sizeof (*set->seeds));
+    seeds_num = s->nodes_num;
+    bol = s->bol;
+
+    rs_states_reset (set);
+    from = rs_state_get (set, set->seeds, seeds_num, bol);
+    if (from < 0)
+      return (-1);
+    seeds_num = 0;
+  }
+
+  s = set->states[from];
+  for (i = 0; i < s->nodes_num; i++)
+  {
+    rs_node_t const *n = set->nodes + s->nodes[i];
+
+    if ((n->type == RS_NODE_CHAR)
+        && rs_charset_has (set->charsets + n->arg, c))
+      set->seeds[seeds_num++] = n->out;
+  }
+  memcpy (set->seeds + seeds_num, set->starts,
+      set->starts_num * sizeof (*set->seeds));
+  seeds_num += set->starts_num;
+
+  to = rs_state_get (set, set->seeds, seeds_num, /* bol = */ 0);
+  if (to < 0)
+    return (-1);
+
+  s->next[class] = to;
+  return (to);
+} /* }}} int rs_transition */
+
+/* Partitions the bytes into classes which no pattern distinguishes, so that
+ * DFA states only need one transition per class. */
+static void rs_compute_classes (regex_set_t *set) /* {{{ */
+{
+  int map[512];
+  size_t i;
+  int c;
+
+  memset (set->byte_class, 0, sizeof (set->byte_class));
+  set->classes_num = 1;
+
+  for (i = 0; i < set->charsets_num; i++)
+  {
+    int classes_num = 0;
+
+    for (c = 0; c < 2 * set->classes_num; c++)
+      map[c] = -1;
+
+    for (c = 0; c < 256; c++)
+    {
+      int key = 2 * set->byte_class[c]
+        + rs_charset_has (set->charsets + i, c);
+
+      if (map[key] < 0)
+        map[key] = classes_num++;
+      set->byte_class[c] = (unsigned char) map[key];
+    }
+    set->classes_num = classes_num;
+  }
+
+  for (c = 255; c >= 0; c--)
+    set->class_rep[set->byte_class[c]] = c;
+} /* }}} void rs_compute_classes */
+
+/* Brings the derived data up to date after patterns have been added. */
+static int rs_prepare (regex_set_t *set) /* {{{ */
+{
+  size_t seeds_size = set->nodes_num + set->starts_num + 1;
+  size_t stack_size = seeds_size + 2 * set->nodes_num;
+  void *tmp;
+
+#define RS_REALLOC(ptr, num) do { \
+  tmp = realloc ((ptr), (num) * sizeof (*(ptr))); \
+  if (tmp == NULL) \
+    return (-1); \
+  (ptr) = tmp; \
+} while (0)
+
+  RS_REALLOC (set->seeds, seeds_size);
+  RS_REALLOC (set->closure, set->nodes_num + 1);
+  RS_REALLOC (set->stack, stack_size);
+  RS_REALLOC (set->mark, set->nodes_num + 1);
+  RS_REALLOC (set->acc, (set->patterns_num + 7) / 8 + 1);
+
+#undef RS_REALLOC
+
+  memset (set->mark, 0, (set->nodes_num + 1) * sizeof (*set->mark));
+  set->mark_gen = 0;
+
+  if (set->states == NULL)
+  {
+    set->states = calloc (RS_STATES_MAX, sizeof (*set->states));
+    set->table = malloc (RS_TABLE_SIZE * sizeof (*set->table));
+    if ((set->states == NULL) || (set->table == NULL))
+      return (-1);
+  }
+
+  rs_compute_classes (set);
+  rs_states_reset (set);
+
+  set->dirty = 0;
+  return (0);
+} /* }}} int rs_prepare */
+
+/* Runs the automaton on `str'. The lock must be held. If `acc' is NULL,
+ * returns one as soon as any pattern matches. Otherwise the matching patterns
+ * are set in the bitmap `acc'. Returns a negative value on error. */
+static int rs_run (regex_set_t *set, char const *str, /* {{{ */
+    unsigned char *acc)
+{
+  size_t bytes = (set->patterns_num + 7) / 8;
+  rs_state_t *s;
+  int current;
+  size_t i;
+
+  if (set->starts_num == 0)
+    return (0);
+
+  if (set->dirty && (rs_prepare (set) != 0))
+    return (-1);
+
+  if (set->initial < 0)
+  {
+    memcpy (set->seeds, set->starts, set->starts_num * sizeof (*set->seeds));
+    set->initial = rs_state_get (set, set->seeds, set->starts_num,
+        /* bol = */ 1);
+    if (set->initial < 0)
+      return (-1);
+  }
+
+  current = set->initial;
+  s = set->states[current];
+  while (42)
+  {
+    unsigned char c = (unsigned char) *str;
+    int class;
+    int next;
+
+    if (s->matches != NULL)
+    {
+      if (acc == NULL)
+        return (1);
+      for (i = 0; i < bytes; i++)
+        acc[i] |= s->matches[i];
+    }
+
+    if (c == 0)
+      break;
+    str++;
+
+    class = set->byte_class[c];
+    next = s->next[class];
+    if (next < 0)
+    {
+      next = rs_transition (set, current, class);
+      if (next < 0)
+        return (-1);
+    }
+    current = next;
+    s = set->states[current];
+  }
+
+  if (s->eol_matches != NULL)
+  {
+    if (acc == NULL)
+      return (1);
+    for (i = 0; i < bytes; i++)
+      acc[i] |= s->eol_matches[i];
+  }
+
+  return (0);
+} /* }}} int rs_run */
+
+/*
+ * Public functions
+ */
+regex_set_t *regex_set_create (void) /* {{{ */
+{
+  regex_set_t *set;
+
+  set = calloc (1, sizeof (*set));
+  if (set == NULL)
+    return (NULL);
+
+  pthread_mutex_init (&set->lock, /* attr = */ NULL);
+  set->initial = -1;
+
+  return (set);
+} /* }}} regex_set_t *regex_set_create */
+
+void regex_set_destroy (regex_set_t *set) /* {{{ */
+{
+  size_t i;
+
+  if (set == NULL)
+    return;
+
+  for (i = 0; i < set->patterns_num; i++)
+  {
+    regfree (&set->patterns[i].re);
+    sfree (set->patterns[i].exact);
+  }
+  sfree (set->patterns);
+
+  if (set->states != NULL)
+    for (i = 0; i < set->states_num; i++)
+      rs_state_free (set->states[i]);
+  sfree (set->states);
+  sfree (set->table);
+
+  sfree (set->nodes);
+  sfree (set->charsets);
+  sfree (set->starts);
+  sfree (set->seeds);
+  sfree (set->closure);
+  sfree (set->stack);
+  sfree (set->mark);
+  sfree (set->acc);
+
+  pthread_mutex_destroy (&set->lock);
+  sfree (set);
+} /* }}} void regex_set_destroy */
+
+int regex_set_add (regex_set_t *set, char const *pattern, /* {{{ */
+    char *errbuf, size_t errbuf_size)
+{
+  rs_pattern_t *tmp;
+  rs_pattern_t *p;
+  int index;
+  int status;
+
+  if ((set == NULL) || (pattern == NULL))
+    return (-EINVAL);
+
+  pthread_mutex_lock (&set->lock);
+
+  tmp = realloc (set->patterns,
+      (set->patterns_num + 1) * sizeof (*set->patterns));
+  if (tmp == NULL)
+  {
+    pthread_mutex_unlock (&set->lock);
+    if (errbuf != NULL)
+      snprintf (errbuf, errbuf_size, "realloc failed");
+    return (-ENOMEM);
+  }
+  set->patterns = tmp;
+
+  index = (int) set->patterns_num;
+  p = set->patterns + index;
+  memset (p, 0, sizeof (*p));
+
+  /* regcomp(3) is the authority on which patterns are valid. It is also
+   * used for matching patterns the automaton doesn't support. */
+  status = regcomp (&p->re, pattern, REG_EXTENDED | REG_NOSUB);
+  if (status != 0)
+  {
+    if (errbuf != NULL)
+      regerror (status, &p->re, errbuf, errbuf_size);
+    pthread_mutex_unlock (&set->lock);
+    return (-EINVAL);
+  }
+
+  p->compiled = (rs_compile (set, pattern, index) == 0);
+  p->exact = rs_exact_string (pattern);
+  if (!p->compiled)
+    set->fallback_num++;
+  set->patterns_num++;
+  set->dirty = 1;
+
+  pthread_mutex_unlock (&set->lock);
+  return (index);
+} /* }}} int regex_set_add */
+
+size_t regex_set_size (regex_set_t const *set) /* {{{ */
+{
+  if (set == NULL)
+    return (0);
+  return (set->patterns_num);
+} /* }}} size_t regex_set_size */
+
+char const *regex_set_exact_string (regex_set_t const *set, /* {{{ */
+    size_t index)
+{
+  if ((set == NULL) || (index >= set->patterns_num))
+    return (NULL);
+  return (set->patterns[index].exact);
+} /* }}} char const *regex_set_exact_string */
+
+int regex_set_match_any (regex_set_t *set, char const *str) /* {{{ */
+{
+  size_t patterns_num;
+  int status;
+  size_t i;
+
+  if ((set == NULL) || (str == NULL))
+    return (0);
+
+  pthread_mutex_lock (&set->lock);
+  patterns_num = set->patterns_num;
+  status = rs_run (set, str, /* acc = */ NULL);
+  pthread_mutex_unlock (&set->lock);
+
+  if (status > 0)
+    return (1);
+  else if ((status == 0) && (set->fallback_num == 0))
+    return (0);
+
+  /* regexec(3) is thread-safe, so the remaining patterns can be checked
+   * without holding the lock. */
+  for (i = 0; i < patterns_num; i++)
+  {
+    rs_pattern_t *p = set->patterns + i;
+
+    if (p->compiled && (status == 0))
+      continue;
+    if (regexec (&p->re, str, /* nmatch = */ 0, /* pmatch = */ NULL,
+          /* eflags = */ 0) == 0)
+      return (1);
+  }
+
+  return (0);
+} /* }}} int regex_set_match_any */
+
+size_t regex_set_match (regex_set_t *set, char const *str, /* {{{ */
+    char *matches)
+{
+  size_t patterns_num;
+  size_t count = 0;
+  int status;
+  size_t i;
+
+  if ((set == NULL) || (str == NULL))
+    return (0);
+
+  pthread_mutex_lock (&set->lock);
+  patterns_num = set->patterns_num;
+  if (set->dirty && (rs_prepare (set) != 0))
+    status = -1;
+  else
+  {
+    memset (set->acc, 0, (patterns_num + 7) / 8);
+    status = rs_run (set, str, set->acc);
+  }
+
+  for (i = 0; i < patterns_num; i++)
+  {
+    char m = 0;
+
+    if ((status == 0) && set->patterns[i].compiled)
+      m = (set->acc[i / 8] >> (i % 8)) & 1;
+    else
+      m = (regexec (&set->patterns[i].re, str, /* nmatch = */ 0,
+            /* pmatch = */ NULL, /* eflags = */ 0) == 0);
+
+    if (matches != NULL)
+      matches[i] = m;
+    if (m)
+      count++;
+  }
+  pthread_mutex_unlock (&set->lock);
+
+  return (count);
+} /* }}} size_t regex_set_match */
+
+int regex_set_match_all (regex_set_t *set, char const *str) /* {{{ */
+{
+  if (set == NULL)
+    return (1);
+
+  return (regex_set_match (set, str, /* matches = */ NULL)
+      == regex_set_size (set));
+} /* }}} int regex_set_match_all */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,92 @@
+/**
+ * collectd - src/utils_regex_set.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_REGEX_SET_H
+#define UTILS_REGEX_SET_H 1
+
+#include <stddef.h>
+
+/*
+ * A set of POSIX extended regular expressions (see regex(7)) which are
+ * matched against a string in a single pass.
+ *
+ * All patterns of a set are compiled into one non-deterministic automaton,
+ * which is turned into a deterministic automaton lazily, while matching. The
+ * cost of a match is therefore linear in the length of the string and
+ * (mostly) independent of the number of patterns. Patterns using features the
+ * automaton does not implement, e.g. back-references, are matched with
+ * regexec(3) instead.
+ *
+ * Only whether a pattern matches is reported, not where. Matching is
+ * thread-safe; patterns must be added before the set is shared between
+ * threads, e.g. while reading the configuration.
+ */
+struct regex_set_s;
+typedef struct regex_set_s regex_set_t;
+
+regex_set_t *regex_set_create (void);
+void regex_set_destroy (regex_set_t *set);
+
+/*
+ * NAME
+ *   regex_set_add
+ *
+ * DESCRIPTION
+ *   Adds `pattern' to the set. The pattern is checked with regcomp(3) using
+ *   the REG_EXTENDED flag. If that fails and `errbuf' is not NULL, the error
+ *   message is copied to `errbuf'.
+ *
+ * RETURN VALUE
+ *   The index of the pattern, counting from zero, or a negative value on
+ *   failure.
+ */
+int regex_set_add (regex_set_t *set, char const *pattern,
+    char *errbuf, size_t errbuf_size);
+
+/* Returns the number of patterns in the set. */
+size_t regex_set_size (regex_set_t const *set);
+
+/* If the pattern with index `index' only matches one exact string, e.g.
+ * "^cpu$", returns that string. Returns NULL otherwise. */
+char const *regex_set_exact_string (regex_set_t const *set, size_t index);
+
+/* Returns non-zero if at least one pattern matches `str'. */
+int regex_set_match_any (regex_set_t *set, char const *str);
+
+/* Returns non-zero if all patterns match `str'. An empty set matches. */
+int regex_set_match_all (regex_set_t *set, char const *str);
+
+/*
+ * NAME
+ *   regex_set_match
+ *
+ * DESCRIPTION
+ *   Matches all patterns against `str'. If `matches' is not NULL, it must
+ *   hold regex_set_size() elements; element `i' is set to non-zero if the
+ *   pattern with index `i' matches and to zero otherwise.
+ *
+ * RETURN VALUE
+ *   The number of matching patterns.
+ */
+size_t regex_set_match (regex_set_t *set, char const *str, char *matches);
+
+#endif /* UTILS_REGEX_SET_H */
+/* vim: set sw=2 sts=2 et : */
@@ -0,0 +1,386 @@
+/**
+ * collectd - src/utils_regex_set_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Compares the results of regex sets with regexec(3). Run with "-b" to
+ * benchmark a set of ignorelist-like patterns against a regexec loop.
+ */
+
+#include "collectd.h"
+#include "common.h"
+#include "utils_regex_set.h"
+
+#include <regex.h>
+#include <time.h>
+
+static int failures = 0;
+
+static int regexec_matches (char const *pattern, char const *str) /* {{{ */
+{
+  regex_t re;
+  int status;
+
+  status = regcomp (&re, pattern, REG_EXTENDED | REG_NOSUB);
+  assert (status == 0);
+  status = regexec (&re, str, 0, NULL, 0);
+  regfree (&re);
+
+  return (status == 0);
+} /* }}} int regexec_matches */
+
+/* Checks every pattern of `set' against regexec(3), individually and using
+ * regex_set_match_any(). */
+static void check_set (regex_set_t *set, char const **patterns, /* {{{ */
+    size_t patterns_num, char const *str)
+{
+  char matches[patterns_num];
+  int any = 0;
+  size_t count;
+  size_t i;
+
+  count = regex_set_match (set, str, matches);
+  for (i = 0; i < patterns_num; i++)
+  {
+    int expect = regexec_matches (patterns[i], str);
+
+    if (expect)
+      any = 1;
+    if (expect == matches[i])
+      continue;
+
+    printf ("pattern \"%s\", string \"%s\": expected %s, got %s\n",
+        patterns[i], str, expect ? "match" : "no match",
+        matches[i] ? "match" : "no match");
+    failures++;
+  }
+
+  if ((count > 0) != any)
+  {
+    printf ("string \"%s\": regex_set_match returned %zu\n", str, count);
+    failures++;
+  }
+
+  if (regex_set_match_any (set, str) != any)
+  {
+    printf ("string \"%s\": regex_set_match_any returned %i\n",
+        str, !any);
+    failures++;
+  }
+} /* }}} void check_set */
+
+static void test_fixed (void) /* {{{ */
+{
+  char const *patterns[] = {
+    "", "a", "abc", "^abc$", "^a", "c$", "a|b", "^(foo|bar)$", "(ab)+c",
+    "a*", "^a*$", "^a+$", "^a?b$", "^a{2}$", "^a{2,}$", "^a{1,3}$",
+    "^(a|b){0,2}c", "x{0}y", "[abc]", "[^abc]", "^[a-c]+$", "[]a]",
+    "[^]a]", "[a-]", "[[:digit:]]+", "^[[:alpha:]_][[:alnum:]_]*$",
+    "[[:space:]]", "\\.", "^sd[a-z]+[0-9]*$", "^(sd|hd)[a-z]$", "a.c",
+    "^.*$", "a$|^b", "(^a|b$)", "^$", "a^b", "a$b", "()", "(a|)b",
+    "\\w+", "\\W", "\\s", "\\S+", "(a)\\1", "\\bfoo", "[[=a=]]",
+    "a{,2}", "((a*)*)*b", "(a|b|c|d)*e", "^/var/(log|tmp)/", "}", "]",
+    "[.]", "^[0-9]{1,3}(\\.[0-9]{1,3}){3}$"
+  };
+  char const *strings[] = {
+    "", "a", "b", "c", "ab", "abc", "abcd", "aabc", "foo", "bar",
+    "foobar", "aa", "aaa", "aaaa", "ac", "abbc", "xyz", "y", "]",
+    "-", "sda", "sda1", "hda", "sdb12x", "a.c", "a c", "1234", "_id9",
+    "9id", "a\nb", "ba", "b", "e", "abcde", "/var/log/x", "/usr/var/log",
+    "{", "}", "aa{", "192.168.0.1", "1.2.3", "\\", "a\tb", "\xc3\xa4"
+  };
+  regex_set_t *set;
+  size_t i;
+  size_t j;
+
+  /* All patterns in one set. */
+  set = regex_set_create ();
+  assert (set != NULL);
+  for (i = 0; i < STATIC_ARRAY_SIZE (patterns); i++)
+  {
+    char errbuf[256];
+    int status = regex_set_add (set, patterns[i], errbuf, sizeof (errbuf));
+    assert (status == (int) i);
+  }
+  assert (regex_set_size (set) == STATIC_ARRAY_SIZE (patterns));
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (strings); i++)
+    check_set (set, patterns, STATIC_ARRAY_SIZE (patterns), strings[i]);
+  regex_set_destroy (set);
+
+  /* Each pattern on its own. */
+  for (i = 0; i < STATIC_ARRAY_SIZE (patterns); i++)
+  {
+    set = regex_set_create ();
+    assert (set != NULL);
+    regex_set_add (set, patterns[i], NULL, 0);
+    for (j = 0; j < STATIC_ARRAY_SIZE (strings); j++)
+      check_set (set, patterns + i, 1, strings[j]);
+    regex_set_destroy (set);
+  }
+} /* }}} void test_fixed */
+
+static void test_errors (void) /* {{{ */
+{
+  regex_set_t *set;
+  char errbuf[256] = "";
+
+  set = regex_set_create ();
+  assert (set != NULL);
+
+  if (regex_set_add (set, "a(b", errbuf, sizeof (errbuf)) >= 0)
+  {
+    printf ("regex_set_add (\"a(b\") succeeded unexpectedly\n");
+    failures++;
+  }
+  if (errbuf[0] == 0)
+  {
+    printf ("regex_set_add (\"a(b\") did not set an error message\n");
+    failures++;
+  }
+  if (regex_set_size (set) != 0)
+  {
+    printf ("regex_set_size returned %zu, expected 0\n",
+        regex_set_size (set));
+    failures++;
+  }
+  if (!regex_set_match_all (set, "foo") || regex_set_match_any (set, "foo"))
+  {
+    printf ("the empty set behaves unexpectedly\n");
+    failures++;
+  }
+
+  regex_set_add (set, "^f", NULL, 0);
+  regex_set_add (set, "o$", NULL, 0);
+  if (!regex_set_match_all (set, "foo") || regex_set_match_all (set, "fob"))
+  {
+    printf ("regex_set_match_all returned an unexpected result\n");
+    failures++;
+  }
+
+  regex_set_destroy (set);
+} /* }}} void test_errors */
+
+static void test_exact (void) /* {{{ */
+{
+  struct
+  {
+    char const *pattern;
+    char const *exact;
+  } cases[] = {
+    { "^cpu$",         "cpu" },
+    { "^$",            "" },
+    { "^eth0\\.1$",    "eth0.1" },
+    { "^a\\$",         NULL },
+    { "^a\\w$",        NULL },
+    { "cpu",           NULL },
+    { "^cpu",          NULL },
+    { "^c.u$",         NULL },
+    { "^(cpu)$",       NULL },
+    { "^cpu|mem$",     NULL }
+  };
+  regex_set_t *set;
+  size_t i;
+
+  set = regex_set_create ();
+  assert (set != NULL);
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (cases); i++)
+  {
+    char const *exact;
+
+    regex_set_add (set, cases[i].pattern, NULL, 0);
+    exact = regex_set_exact_string (set, i);
+    if ((exact == NULL) != (cases[i].exact == NULL)
+        || ((exact != NULL) && (strcmp (exact, cases[i].exact) != 0)))
+    {
+      printf ("regex_set_exact_string (\"%s\") = \"%s\", expected \"%s\"\n",
+          cases[i].pattern, (exact != NULL) ? exact : "(null)",
+          (cases[i].exact != NULL) ? cases[i].exact : "(null)");
+      failures++;
+    }
+  }
+
+  regex_set_destroy (set);
+} /* }}} void test_exact */
+
+/* Appends a random pattern over a small alphabet to `buffer'. */
+static void random_pattern (char *buffer, size_t size, int depth) /* {{{ */
+{
+  char const *atoms[] = { "a", "b", "c", ".", "[ab]", "[^a]", "^", "$" };
+  char const *quants[] = { "", "", "", "*", "+", "?", "{2}", "{0,2}",
+    "{1,}" };
+  int n = 1 + rand () % 4;
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    char const *atom;
+    char const *quant = quants[rand () % STATIC_ARRAY_SIZE (quants)];
+
+    if ((depth < 3) && (rand () % 5 == 0))
+    {
+      strncat (buffer, "(", size - strlen (buffer) - 1);
+      random_pattern (buffer, size, depth + 1);
+      if (rand () % 2)
+      {
+        strncat (buffer, "|", size - strlen (buffer) - 1);
+        random_pattern (buffer, size, depth + 1);
+      }
+      strncat (buffer, ")", size - strlen (buffer) - 1);
+    }
+    else
+    {
+      atom = atoms[rand () % STATIC_ARRAY_SIZE (atoms)];
+      strncat (buffer, atom, size - strlen (buffer) - 1);
+      if ((atom[0] == '^') || (atom[0] == '$'))
+        quant = "";
+    }
+    strncat (buffer, quant, size - strlen (buffer) - 1);
+  }
+} /* }}} void random_pattern */
+
+static void test_random (void) /* {{{ */
+{
+  int round;
+
+  srand (42);
+
+  for (round = 0; round < 50; round++)
+  {
+    char patterns_buffer[40][128];
+    char const *patterns[40];
+    size_t patterns_num = 0;
+    regex_set_t *set;
+    int i;
+
+    set = regex_set_create ();
+    assert (set != NULL);
+
+    while (patterns_num < STATIC_ARRAY_SIZE (patterns))
+    {
+      char *p = patterns_buffer[patterns_num];
+
+      p[0] = 0;
+      random_pattern (p, sizeof (patterns_buffer[0]), 0);
+      if (regex_set_add (set, p, NULL, 0) < 0)
+        continue;
+      patterns[patterns_num] = p;
+      patterns_num++;
+    }
+
+    for (i = 0; i < 200; i++)
+    {
+      char str[16];
+      int len = rand () % 10;
+      int j;
+
+      for (j = 0; j < len; j++)
+        str[j] = "abcd"[rand () % 4];
+      str[len] = 0;
+
+      check_set (set, patterns, patterns_num, str);
+    }
+
+    regex_set_destroy (set);
+  }
+} /* }}} void test_random */
+
+#define BENCH_PATTERNS 200
+#define BENCH_ROUNDS 20000
+
+static double bench_now (void) /* {{{ */
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1e9);
+} /* }}} double bench_now */
+
+static void benchmark (void) /* {{{ */
+{
+  char const *strings[] = { "sda", "sdb1", "eth0", "loop3", "dm-12",
+    "md127", "nvme0n1p2", "vethf00ba4" };
+  regex_t res[BENCH_PATTERNS];
+  regex_set_t *set;
+  double t;
+  int hits = 0;
+  int r;
+  int i;
+  size_t j;
+
+  set = regex_set_create ();
+  assert (set != NULL);
+  for (i = 0; i < BENCH_PATTERNS; i++)
+  {
+    char pattern[64];
+
+    snprintf (pattern, sizeof (pattern), "^dev%i[a-z]+[0-9]*$", i);
+    regex_set_add (set, pattern, NULL, 0);
+    regcomp (res + i, pattern, REG_EXTENDED | REG_NOSUB);
+  }
+
+  t = bench_now ();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (j = 0; j < STATIC_ARRAY_SIZE (strings); j++)
+      for (i = 0; i < BENCH_PATTERNS; i++)
+        if (regexec (res + i, strings[j], 0, NULL, 0) == 0)
+        {
+          hits++;
+          break;
+        }
+  t = bench_now () - t;
+  printf ("%-20s %8.3f s  %12.0f strings/s\n", "regexec loop", t,
+      (double) BENCH_ROUNDS * STATIC_ARRAY_SIZE (strings) / t);
+
+  t = bench_now ();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (j = 0; j < STATIC_ARRAY_SIZE (strings); j++)
+      hits += regex_set_match_any (set, strings[j]);
+  t = bench_now () - t;
+  printf ("%-20s %8.3f s  %12.0f strings/s\n", "regex set", t,
+      (double) BENCH_ROUNDS * STATIC_ARRAY_SIZE (strings) / t);
+
+  assert (hits == 0);
+
+  for (i = 0; i < BENCH_PATTERNS; i++)
+    regfree (res + i);
+  regex_set_destroy (set);
+} /* }}} void benchmark */
+
+int main (int argc, char **argv) /* {{{ */
+{
+  test_fixed ();
+  test_errors ();
+  test_exact ();
+  test_random ();
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  if ((argc > 1) && (strcmp ("-b", argv[1]) == 0))
+    benchmark ();
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
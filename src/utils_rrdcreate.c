@@ -189,10 +189,14 @@ static int rra_get (char ***ret, const value_list_t *vl, /* {{{ */
     return (-1);
   }
 
+  /* RRD files have a resolution of one second, so sub-second intervals use
+   * a step size of one second. */
   if (cfg->stepsize > 0)
     ss = cfg->stepsize;
   else
     ss = (int) CDTIME_T_TO_TIME_T (vl->interval);
+  if ((ss <= 0) && (vl->interval > 0))
+    ss = 1;
   if (ss <= 0)
   {
     *ret = NULL;
@@ -332,6 +336,8 @@ static int ds_get (char ***ret, /* {{{ */
         d->name, type,
         (cfg->heartbeat > 0)
         ? cfg->heartbeat
+        : (vl->interval < TIME_T_TO_CDTIME_T (1))
+        ? 2
         : (int) CDTIME_T_TO_TIME_T (2 * vl->interval),
         min, max);
     if ((status < 1) || ((size_t) status >= sizeof (buffer)))
@@ -692,6 +698,8 @@ int cu_rrd_create_file (const char *filename, /* {{{ */
     stepsize = cfg->stepsize;
   else
     stepsize = (unsigned long) CDTIME_T_TO_TIME_T (vl->interval);
+  if (stepsize == 0)
+    stepsize = 1;
 
   if (cfg->async)
   {
@@ -0,0 +1,389 @@
+/**
+ * collectd - src/utils_sketch.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "utils_sketch.h"
+
+#include <float.h>
+#include <math.h>
+
+/* Number of buckets allocated when the first value is added to a store. The
+ * array grows up to `max_buckets' as the range of values widens. */
+#define SKETCH_INITIAL_BUCKETS 32
+
+/* Counts of the values with the same sign. Bucket `i' counts the values `v'
+ * with gamma^(i-1) < |v| <= gamma^i and is stored in counts[i - offset].
+ * Buckets lo .. hi are in use. */
+struct sketch_store_s
+{
+  uint64_t *counts;
+  size_t counts_num;
+  int offset;
+  int lo;
+  int hi;
+  uint64_t total;
+};
+typedef struct sketch_store_s sketch_store_t;
+
+struct sketch_s
+{
+  double gamma;
+  double log_gamma;
+  size_t max_buckets;
+
+  sketch_store_t positive;
+  sketch_store_t negative;
+  uint64_t zero_count;
+
+  double min;
+  double max;
+};
+
+/*
+ * Stores
+ */
+/* Moves the window of `st' so that it covers the buckets `new_lo' to `new_hi'.
+ * Buckets below `new_lo' are added to bucket `new_lo'. */
+static int store_reframe (sketch_store_t *st, size_t max_buckets, /* {{{ */
+    int new_lo, int new_hi)
+{
+  size_t width = (size_t) (new_hi - new_lo) + 1;
+  uint64_t carry = 0;
+  int i;
+
+  /* Collapse the lowest buckets. */
+  if (new_lo > st->lo)
+  {
+    int end = (st->hi < new_lo) ? st->hi : (new_lo - 1);
+
+    for (i = st->lo; i <= end; i++)
+    {
+      carry += st->counts[i - st->offset];
+      st->counts[i - st->offset] = 0;
+    }
+    st->lo = new_lo;
+  }
+
+  if ((new_lo < st->offset)
+      || (new_hi >= st->offset + (int) st->counts_num))
+  {
+    int new_offset;
+
+    if (st->counts_num < width)
+    {
+      size_t new_num = 2 * st->counts_num;
+      uint64_t *tmp;
+
+      if (new_num > max_buckets)
+        new_num = max_buckets;
+      if (new_num < width)
+        new_num = width;
+
+      tmp = realloc (st->counts, new_num * sizeof (*tmp));
+      if (tmp == NULL)
+        return (ENOMEM);
+      memset (tmp + st->counts_num, 0,
+          (new_num - st->counts_num) * sizeof (*tmp));
+
+      st->counts = tmp;
+      st->counts_num = new_num;
+    }
+
+    /* Leave the same amount of room on both sides. */
+    new_offset = new_lo - (int) ((st->counts_num - width) / 2);
+
+    if (st->lo <= st->hi)
+    {
+      size_t len = (size_t) (st->hi - st->lo) + 1;
+      size_t src = (size_t) (st->lo - st->offset);
+      size_t dst = (size_t) (st->lo - new_offset);
+
+      memmove (st->counts + dst, st->counts + src, len * sizeof (uint64_t));
+      memset (st->counts, 0, dst * sizeof (uint64_t));
+      memset (st->counts + dst + len, 0,
+          (st->counts_num - (dst + len)) * sizeof (uint64_t));
+    }
+    else
+    {
+      memset (st->counts, 0, st->counts_num * sizeof (*st->counts));
+    }
+
+    st->offset = new_offset;
+  }
+
+  st->counts[new_lo - st->offset] += carry;
+  st->lo = new_lo;
+  st->hi = new_hi;
+
+  return (0);
+} /* }}} int store_reframe */
+
+static int store_add (sketch_store_t *st, size_t max_buckets, /* {{{ */
+    int index, uint64_t count)
+{
+  int new_lo;
+  int new_hi;
+
+  if (st->total == 0)
+  {
+    if (st->counts == NULL)
+    {
+      st->counts_num = (max_buckets < SKETCH_INITIAL_BUCKETS)
+        ? max_buckets : SKETCH_INITIAL_BUCKETS;
+      st->counts = calloc (st->counts_num, sizeof (*st->counts));
+      if (st->counts == NULL)
+      {
+        st->counts_num = 0;
+        return (ENOMEM);
+      }
+    }
+
+    st->offset = index - (int) (st->counts_num / 2);
+    st->lo = index;
+    st->hi = index;
+  }
+
+  new_lo = (index < st->lo) ? index : st->lo;
+  new_hi = (index > st->hi) ? index : st->hi;
+
+  if ((size_t) (new_hi - new_lo) >= max_buckets)
+  {
+    new_lo = new_hi - (int) max_buckets + 1;
+    if (index < new_lo)
+      index = new_lo;
+  }
+
+  if ((new_lo != st->lo) || (new_hi != st->hi))
+  {
+    int status = store_reframe (st, max_buckets, new_lo, new_hi);
+    if (status != 0)
+      return (status);
+  }
+
+  st->counts[index - st->offset] += count;
+  st->total += count;
+
+  return (0);
+} /* }}} int store_add */
+
+static void store_reset (sketch_store_t *st) /* {{{ */
+{
+  if (st->counts != NULL)
+    memset (st->counts, 0, st->counts_num * sizeof (*st->counts));
+  st->lo = 0;
+  st->hi = -1;
+  st->total = 0;
+} /* }}} void store_reset */
+
+/*
+ * Public functions
+ */
+sketch_t *sketch_create (double relative_accuracy, /* {{{ */
+    size_t max_buckets)
+{
+  sketch_t *s;
+
+  if ((relative_accuracy <= 0.0) || (relative_accuracy >= 1.0)
+      || (max_buckets < 1))
+    return (NULL);
+
+  s = calloc (1, sizeof (*s));
+  if (s == NULL)
+    return (NULL);
+
+  s->gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+  s->log_gamma = log (s->gamma);
+  s->max_buckets = max_buckets;
+
+  sketch_reset (s);
+
+  return (s);
+} /* }}} sketch_t *sketch_create */
+
+void sketch_destroy (sketch_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  sfree (s->positive.counts);
+  sfree (s->negative.counts);
+  sfree (s);
+} /* }}} void sketch_destroy */
+
+void sketch_reset (sketch_t *s) /* {{{ */
+{
+  store_reset (&s->positive);
+  store_reset (&s->negative);
+  s->zero_count = 0;
+  s->min = NAN;
+  s->max = NAN;
+} /* }}} void sketch_reset */
+
+int sketch_add (sketch_t *s, double value) /* {{{ */
+{
+  int status;
+
+  if (!isfinite (value))
+    return (EINVAL);
+
+  if (fabs (value) < DBL_MIN)
+  {
+    s->zero_count++;
+    status = 0;
+  }
+  else
+  {
+    int index = (int) ceil (log (fabs (value)) / s->log_gamma);
+
+    if (value > 0.0)
+      status = store_add (&s->positive, s->max_buckets, index, 1);
+    else
+      status = store_add (&s->negative, s->max_buckets, index, 1);
+  }
+
+  if (status != 0)
+    return (status);
+
+  if (isnan (s->min) || (s->min > value))
+    s->min = value;
+  if (isnan (s->max) || (s->max < value))
+    s->max = value;
+
+  return (0);
+} /* }}} int sketch_add */
+
+int sketch_merge (sketch_t *dst, sketch_t const *src) /* {{{ */
+{
+  sketch_store_t *dst_stores[2] = { &dst->positive, &dst->negative };
+  sketch_store_t const *src_stores[2] = { &src->positive, &src->negative };
+  size_t i;
+
+  if (dst->gamma != src->gamma)
+    return (EINVAL);
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (src_stores); i++)
+  {
+    sketch_store_t const *st = src_stores[i];
+    int j;
+
+    if (st->total == 0)
+      continue;
+
+    /* Start with the highest bucket, so that the range is only extended
+     * downwards. */
+    for (j = st->hi; j >= st->lo; j--)
+    {
+      uint64_t count = st->counts[j - st->offset];
+      int status;
+
+      if (count == 0)
+        continue;
+
+      status = store_add (dst_stores[i], dst->max_buckets, j, count);
+      if (status != 0)
+        return (status);
+    }
+  }
+
+  dst->zero_count += src->zero_count;
+
+  if (isnan (dst->min) || (dst->min > src->min))
+    dst->min = src->min;
+  if (isnan (dst->max) || (dst->max < src->max))
+    dst->max = src->max;
+
+  return (0);
+} /* }}} int sketch_merge */
+
+uint64_t sketch_count (sketch_t const *s) /* {{{ */
+{
+  return (s->positive.total + s->negative.total + s->zero_count);
+} /* }}} uint64_t sketch_count */
+
+/* Returns the value representing bucket `index', which is within the relative
+ * accuracy of all values counted in that bucket. */
+static double sketch_bucket_value (sketch_t const *s, int index) /* {{{ */
+{
+  return (2.0 * exp (((double) index) * s->log_gamma) / (1.0 + s->gamma));
+} /* }}} double sketch_bucket_value */
+
+double sketch_quantile (sketch_t const *s, double q) /* {{{ */
+{
+  uint64_t count = sketch_count (s);
+  double rank;
+  double cumulative;
+  double value = NAN;
+  int i;
+
+  if ((count == 0) || (q < 0.0) || (q > 1.0))
+    return (NAN);
+
+  rank = q * ((double) (count - 1));
+  cumulative = 0.0;
+
+  /* Negative values, starting with the largest absolute value. */
+  for (i = s->negative.hi; i >= s->negative.lo; i--)
+  {
+    cumulative += (double) s->negative.counts[i - s->negative.offset];
+    if (cumulative > rank)
+    {
+      value = -sketch_bucket_value (s, i);
+      break;
+    }
+  }
+
+  if (isnan (value))
+  {
+    cumulative += (double) s->zero_count;
+    if (cumulative > rank)
+      value = 0.0;
+  }
+
+  if (isnan (value))
+  {
+    for (i = s->positive.lo; i <= s->positive.hi; i++)
+    {
+      cumulative += (double) s->positive.counts[i - s->positive.offset];
+      if (cumulative > rank)
+      {
+        value = sketch_bucket_value (s, i);
+        break;
+      }
+    }
+  }
+
+  /* The exact extremes are known; don't return anything outside. */
+  if (isnan (value) || (value > s->max))
+    value = s->max;
+  if (value < s->min)
+    value = s->min;
+
+  return (value);
+} /* }}} double sketch_quantile */
+
+size_t sketch_memory (sketch_t const *s) /* {{{ */
+{
+  return (sizeof (*s)
+      + (s->positive.counts_num + s->negative.counts_num) * sizeof (uint64_t));
+} /* }}} size_t sketch_memory */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
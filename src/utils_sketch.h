@@ -0,0 +1,69 @@
+/**
+ * collectd - src/utils_sketch.h
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+#ifndef UTILS_SKETCH_H
+#define UTILS_SKETCH_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A quantile sketch with relative error guarantees (see "DDSketch: A fast
+ * and fully-mergeable quantile sketch with relative-error guarantees",
+ * Masson et al., 2019).
+ *
+ * Values are counted in logarithmically sized buckets, so that every quantile
+ * is returned with a relative error of at most `relative_accuracy'. At most
+ * `max_buckets' buckets are kept for positive and negative values each; if
+ * the values span a larger range, the buckets holding the smallest absolute
+ * values are combined, i.e. only the lowest quantiles lose accuracy. Sketches
+ * created with the same parameters can be merged without additional error.
+ *
+ * Sketches are not thread-safe.
+ */
+struct sketch_s;
+typedef struct sketch_s sketch_t;
+
+sketch_t *sketch_create (double relative_accuracy, size_t max_buckets);
+void sketch_destroy (sketch_t *s);
+
+/* Removes all values from the sketch, keeping the allocated memory. */
+void sketch_reset (sketch_t *s);
+
+/* Adds one value. Returns EINVAL if the value is not finite. */
+int sketch_add (sketch_t *s, double value);
+
+/* Adds all values of `src' to `dst'. Both sketches must have been created
+ * with the same parameters. */
+int sketch_merge (sketch_t *dst, sketch_t const *src);
+
+/* Returns the number of values in the sketch. */
+uint64_t sketch_count (sketch_t const *s);
+
+/* Returns the value at quantile `q', which must be in [0, 1], or NAN if the
+ * sketch is empty. */
+double sketch_quantile (sketch_t const *s, double q);
+
+/* Returns the number of bytes currently allocated by the sketch. */
+size_t sketch_memory (sketch_t const *s);
+
+#endif /* UTILS_SKETCH_H */
+/* vim: set sw=2 sts=2 et : */
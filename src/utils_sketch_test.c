@@ -0,0 +1,328 @@
+/**
+ * collectd - src/utils_sketch_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Compares the quantiles returned by sketches with the exact quantiles of
+ * random data. Run with "-b" to print accuracy and memory usage for
+ * different parameters.
+ */
+
+#include "collectd.h"
+#include "common.h"
+#include "utils_sketch.h"
+
+#include <math.h>
+#include <time.h>
+
+static int failures = 0;
+
+static double const quantiles[] = { 0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 0.999,
+  1.0 };
+
+static int compare_double (void const *a, void const *b) /* {{{ */
+{
+  double x = *((double const *) a);
+  double y = *((double const *) b);
+
+  return ((x > y) - (x < y));
+} /* }}} int compare_double */
+
+/* Returns a log-normally distributed random number, similar to latencies. */
+static double random_lognormal (void) /* {{{ */
+{
+  double u1 = (((double) rand ()) + 1.0) / (((double) RAND_MAX) + 2.0);
+  double u2 = (((double) rand ()) + 1.0) / (((double) RAND_MAX) + 2.0);
+
+  return (exp (sqrt (-2.0 * log (u1)) * cos (2.0 * M_PI * u2)));
+} /* }}} double random_lognormal */
+
+/* Returns the relative error of `value' compared to the exact quantile `q' of
+ * the sorted array `values'. */
+static double relative_error (double const *values, size_t values_num, /* {{{ */
+    double q, double value)
+{
+  double exact = values[(size_t) (q * ((double) (values_num - 1)))];
+
+  if (exact == value)
+    return (0.0);
+
+  return (fabs (value - exact) / fabs (exact));
+} /* }}} double relative_error */
+
+/* Checks all `quantiles' of `s' against the sorted array `values'. Only
+ * quantiles of at least `min_q' are checked. */
+static void check_quantiles (char const *name, sketch_t *s, /* {{{ */
+    double *values, size_t values_num, double accuracy, double min_q)
+{
+  size_t i;
+
+  qsort (values, values_num, sizeof (*values), compare_double);
+
+  if (sketch_count (s) != values_num)
+  {
+    printf ("%s: count = %llu, expected %zu\n", name,
+        (unsigned long long) sketch_count (s), values_num);
+    failures++;
+  }
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (quantiles); i++)
+  {
+    double value = sketch_quantile (s, quantiles[i]);
+    double error;
+
+    if (quantiles[i] < min_q)
+      continue;
+
+    error = relative_error (values, values_num, quantiles[i], value);
+    if (error > accuracy * (1.0 + 1e-9))
+    {
+      printf ("%s: quantile %g = %g, relative error %g exceeds %g\n",
+          name, quantiles[i], value, error, accuracy);
+      failures++;
+    }
+  }
+} /* }}} void check_quantiles */
+
+static void test_empty (void) /* {{{ */
+{
+  sketch_t *s = sketch_create (0.01, 128);
+
+  assert (s != NULL);
+  if (!isnan (sketch_quantile (s, 0.5)) || (sketch_count (s) != 0))
+  {
+    printf ("empty sketch: expected NAN\n");
+    failures++;
+  }
+
+  if (sketch_add (s, NAN) != EINVAL)
+  {
+    printf ("sketch_add (NAN) succeeded\n");
+    failures++;
+  }
+
+  sketch_destroy (s);
+
+  assert (sketch_create (0.0, 128) == NULL);
+  assert (sketch_create (0.01, 0) == NULL);
+} /* }}} void test_empty */
+
+#define TEST_VALUES 20000
+
+static void test_accuracy (void) /* {{{ */
+{
+  double accuracies[] = { 0.05, 0.01, 0.001 };
+  double values[TEST_VALUES];
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (accuracies); i++)
+  {
+    sketch_t *s = sketch_create (accuracies[i], 16384);
+    assert (s != NULL);
+
+    /* Positive, negative and zero values. */
+    for (j = 0; j < TEST_VALUES; j++)
+    {
+      values[j] = random_lognormal () * 1000.0;
+      if ((j % 3) == 0)
+        values[j] = -values[j];
+      else if ((j % 17) == 0)
+        values[j] = 0.0;
+      sketch_add (s, values[j]);
+    }
+
+    check_quantiles ("accuracy", s, values, TEST_VALUES, accuracies[i], 0.0);
+
+    /* Reuse after a reset. */
+    sketch_reset (s);
+    for (j = 0; j < TEST_VALUES; j++)
+    {
+      values[j] = (double) (j + 1);
+      sketch_add (s, values[j]);
+    }
+    check_quantiles ("reset", s, values, TEST_VALUES, accuracies[i], 0.0);
+
+    sketch_destroy (s);
+  }
+} /* }}} void test_accuracy */
+
+static void test_merge (void) /* {{{ */
+{
+  sketch_t *parts[4];
+  sketch_t *merged;
+  sketch_t *single;
+  double values[TEST_VALUES];
+  size_t i;
+
+  single = sketch_create (0.01, 1024);
+  merged = sketch_create (0.01, 1024);
+  assert ((single != NULL) && (merged != NULL));
+  for (i = 0; i < STATIC_ARRAY_SIZE (parts); i++)
+  {
+    parts[i] = sketch_create (0.01, 1024);
+    assert (parts[i] != NULL);
+  }
+
+  /* Every part sees a different range of values. */
+  for (i = 0; i < TEST_VALUES; i++)
+  {
+    size_t part = i % STATIC_ARRAY_SIZE (parts);
+
+    values[i] = random_lognormal () * pow (100.0, (double) part);
+    sketch_add (parts[part], values[i]);
+    sketch_add (single, values[i]);
+  }
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (parts); i++)
+  {
+    sketch_merge (merged, parts[i]);
+    sketch_destroy (parts[i]);
+  }
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (quantiles); i++)
+  {
+    double a = sketch_quantile (merged, quantiles[i]);
+    double b = sketch_quantile (single, quantiles[i]);
+
+    if (a != b)
+    {
+      printf ("merge: quantile %g = %g, expected %g\n", quantiles[i], a, b);
+      failures++;
+    }
+  }
+  check_quantiles ("merge", merged, values, TEST_VALUES, 0.01, 0.0);
+
+  sketch_destroy (merged);
+  sketch_destroy (single);
+} /* }}} void test_merge */
+
+/* With too few buckets, the lowest buckets are combined. The high quantiles
+ * must stay accurate and the memory must stay bounded. */
+static void test_collapse (void) /* {{{ */
+{
+  sketch_t *s = sketch_create (0.01, 64);
+  double values[TEST_VALUES];
+  size_t i;
+
+  assert (s != NULL);
+  for (i = 0; i < TEST_VALUES; i++)
+  {
+    /* Spans about twelve orders of magnitude. */
+    values[i] = pow (10.0, 12.0 * ((double) rand ()) / ((double) RAND_MAX));
+    sketch_add (s, values[i]);
+  }
+
+  check_quantiles ("collapse", s, values, TEST_VALUES, 0.01, 0.99);
+
+  if (sketch_memory (s) > 4096)
+  {
+    printf ("collapse: sketch uses %zu bytes\n", sketch_memory (s));
+    failures++;
+  }
+
+  sketch_destroy (s);
+} /* }}} void test_collapse */
+
+#define BENCH_VALUES 1000000
+
+static double bench_now (void) /* {{{ */
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1e9);
+} /* }}} double bench_now */
+
+static void benchmark (void) /* {{{ */
+{
+  double accuracies[] = { 0.05, 0.02, 0.01, 0.005, 0.001 };
+  size_t max_buckets[] = { 64, 256, 1024, 4096 };
+  double *values;
+  double *sorted;
+  size_t i;
+  size_t j;
+  size_t k;
+
+  values = malloc (BENCH_VALUES * sizeof (*values));
+  sorted = malloc (BENCH_VALUES * sizeof (*sorted));
+  assert ((values != NULL) && (sorted != NULL));
+  for (i = 0; i < BENCH_VALUES; i++)
+    values[i] = random_lognormal () * 1000.0;
+
+  memcpy (sorted, values, BENCH_VALUES * sizeof (*sorted));
+  qsort (sorted, BENCH_VALUES, sizeof (*sorted), compare_double);
+
+  printf ("%-9s %-8s %8s %10s %10s %10s %12s\n", "accuracy", "buckets",
+      "bytes", "err p50", "err p99", "err p99.9", "values/s");
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (accuracies); i++)
+    for (j = 0; j < STATIC_ARRAY_SIZE (max_buckets); j++)
+    {
+      sketch_t *s = sketch_create (accuracies[i], max_buckets[j]);
+      double errors[3];
+      double t;
+
+      assert (s != NULL);
+
+      t = bench_now ();
+      for (k = 0; k < BENCH_VALUES; k++)
+        sketch_add (s, values[k]);
+      t = bench_now () - t;
+
+      errors[0] = relative_error (sorted, BENCH_VALUES, 0.5,
+          sketch_quantile (s, 0.5));
+      errors[1] = relative_error (sorted, BENCH_VALUES, 0.99,
+          sketch_quantile (s, 0.99));
+      errors[2] = relative_error (sorted, BENCH_VALUES, 0.999,
+          sketch_quantile (s, 0.999));
+
+      printf ("%-9g %-8zu %8zu %10.5f %10.5f %10.5f %12.0f\n",
+          accuracies[i], max_buckets[j], sketch_memory (s),
+          errors[0], errors[1], errors[2], ((double) BENCH_VALUES) / t);
+
+      sketch_destroy (s);
+    }
+
+  sfree (values);
+  sfree (sorted);
+} /* }}} void benchmark */
+
+int main (int argc, char **argv) /* {{{ */
+{
+  srand (42);
+
+  test_empty ();
+  test_accuracy ();
+  test_merge ();
+  test_collapse ();
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  if ((argc > 1) && (strcmp ("-b", argv[1]) == 0))
+    benchmark ();
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -26,11 +26,12 @@
 
 #include "collectd.h"
 
-#include <regex.h>
-
 #include "common.h"
 #include "utils_vl_lookup.h"
 #include "utils_avltree.h"
+#include "utils_regex_set.h"
+
+#include <pthread.h>
 
 #if BUILD_TEST
 # define sstrncpy strncpy
@@ -47,7 +48,7 @@
 struct part_match_s
 {
   char str[DATA_MAX_NAME_LEN];
-  regex_t regex;
+  regex_set_t *regex;
   _Bool is_regex;
 };
 typedef struct part_match_s part_match_t;
@@ -80,8 +81,10 @@ struct user_obj_s
 {
   void *user_obj;
   identifier_t ident;
+  uint32_t hash; /* hash of the grouped fields, see lu_group_hash() */
 
   user_obj_t *next;
+  user_obj_t *hash_next;
 };
 
 struct user_class_s
@@ -89,6 +92,13 @@ struct user_class_s
   void *user_class;
   identifier_match_t match;
   user_obj_t *user_obj_list; /* list of user_obj */
+
+  /* Hash table of the user objects, keyed by the grouped fields. The size is
+   * a power of two. `lock' protects the list and the table. */
+  user_obj_t **user_obj_table;
+  size_t user_obj_table_size;
+  size_t user_obj_num;
+  pthread_mutex_t lock;
 };
 typedef struct user_class_s user_class_t;
 
@@ -119,13 +129,7 @@ static _Bool lu_part_matches (part_match_t const *match, /* {{{ */
     if (strcmp (".*", match->str) == 0)
       return (1);
 
-    int status = regexec (&match->regex, str,
-        /* nmatch = */ 0, /* pmatch = */ NULL,
-        /* flags = */ 0);
-    if (status == 0)
-      return (1);
-    else
-      return (0);
+    return (regex_set_match_any (match->regex, str) ? 1 : 0);
   }
   else if (strcmp (match->str, str) == 0)
     return (1);
@@ -137,6 +141,7 @@ static int lu_copy_ident_to_match_part (part_match_t *match_part, /* {{{ */
     char const *ident_part)
 {
   size_t len = strlen (ident_part);
+  char errbuf[1024] = "";
   int status;
 
   if ((len < 3) || (ident_part[0] != '/') || (ident_part[len - 1] != '/'))
@@ -152,14 +157,21 @@ static int lu_copy_ident_to_match_part (part_match_t *match_part, /* {{{ */
   /* strip trailing slash */
   match_part->str[len - 2] = 0;
   
-  status = regcomp (&match_part->regex, match_part->str,
-      /* flags = */ REG_EXTENDED);
-  if (status != 0)
+  match_part->regex = regex_set_create ();
+  if (match_part->regex == NULL)
+  {
+    ERROR ("utils_vl_lookup: regex_set_create failed.");
+    return (ENOMEM);
+  }
+
+  status = regex_set_add (match_part->regex, match_part->str,
+      errbuf, sizeof (errbuf));
+  if (status < 0)
   {
-    char errbuf[1024];
-    regerror (status, &match_part->regex, errbuf, sizeof (errbuf));
     ERROR ("utils_vl_lookup: Compiling regular expression \"%s\" failed: %s",
         match_part->str, errbuf);
+    regex_set_destroy (match_part->regex);
+    match_part->regex = NULL;
     return (EINVAL);
   }
   match_part->is_regex = 1;
@@ -191,9 +203,106 @@ static int lu_copy_ident_to_match (identifier_match_t *match, /* {{{ */
   return (0);
 } /* }}} int lu_copy_ident_to_match */
 
+static void lu_free_match (identifier_match_t *match) /* {{{ */
+{
+  regex_set_destroy (match->host.regex);
+  regex_set_destroy (match->plugin.regex);
+  regex_set_destroy (match->plugin_instance.regex);
+  regex_set_destroy (match->type.regex);
+  regex_set_destroy (match->type_instance.regex);
+  memset (match, 0, sizeof (*match));
+} /* }}} void lu_free_match */
+
+#define LU_GROUPED(user_class, field, group_mask) \
+  ((user_class)->match.field.is_regex \
+   && (((user_class)->match.group_by & (group_mask)) != 0))
+
+static uint32_t lu_hash_str (uint32_t hash, char const *str) /* {{{ */
+{
+  /* FNV-1a, including the terminating null byte as a separator. */
+  do
+  {
+    hash ^= (uint32_t) ((unsigned char) *str);
+    hash *= 16777619U;
+  } while (*(str++) != 0);
+
+  return (hash);
+} /* }}} uint32_t lu_hash_str */
+
+/* Hashes the fields of `vl' the user class groups by. Only fields with a
+ * regular expression can differ between value lists of the same group. */
+static uint32_t lu_group_hash (user_class_t const *user_class, /* {{{ */
+    value_list_t const *vl)
+{
+  uint32_t hash = 2166136261U;
+
+  if (LU_GROUPED (user_class, host, LU_GROUP_BY_HOST))
+    hash = lu_hash_str (hash, vl->host);
+  if (LU_GROUPED (user_class, plugin, LU_GROUP_BY_PLUGIN))
+    hash = lu_hash_str (hash, vl->plugin);
+  if (LU_GROUPED (user_class, plugin_instance, LU_GROUP_BY_PLUGIN_INSTANCE))
+    hash = lu_hash_str (hash, vl->plugin_instance);
+  if (LU_GROUPED (user_class, type_instance, LU_GROUP_BY_TYPE_INSTANCE))
+    hash = lu_hash_str (hash, vl->type_instance);
+
+  return (hash);
+} /* }}} uint32_t lu_group_hash */
+
+/* Inserts `user_obj' into the hash table of `user_class', growing the table
+ * when it holds as many objects as it has slots. */
+static int lu_table_insert (user_class_t *user_class, /* {{{ */
+    user_obj_t *user_obj)
+{
+  size_t index;
+
+  if (user_class->user_obj_num >= user_class->user_obj_table_size)
+  {
+    size_t new_size = 2 * user_class->user_obj_table_size;
+    user_obj_t **new_table;
+    size_t i;
+
+    if (new_size < 16)
+      new_size = 16;
+
+    new_table = calloc (new_size, sizeof (*new_table));
+    if (new_table == NULL)
+    {
+      ERROR ("utils_vl_lookup: calloc failed.");
+      return (ENOMEM);
+    }
+
+    for (i = 0; i < user_class->user_obj_table_size; i++)
+    {
+      user_obj_t *ptr = user_class->user_obj_table[i];
+
+      while (ptr != NULL)
+      {
+        user_obj_t *next = ptr->hash_next;
+
+        index = ptr->hash & (new_size - 1);
+        ptr->hash_next = new_table[index];
+        new_table[index] = ptr;
+
+        ptr = next;
+      }
+    }
+
+    sfree (user_class->user_obj_table);
+    user_class->user_obj_table = new_table;
+    user_class->user_obj_table_size = new_size;
+  }
+
+  index = user_obj->hash & (user_class->user_obj_table_size - 1);
+  user_obj->hash_next = user_class->user_obj_table[index];
+  user_class->user_obj_table[index] = user_obj;
+  user_class->user_obj_num++;
+
+  return (0);
+} /* }}} int lu_table_insert */
+
 static void *lu_create_user_obj (lookup_t *obj, /* {{{ */
     data_set_t const *ds, value_list_t const *vl,
-    user_class_t *user_class)
+    user_class_t *user_class, uint32_t hash)
 {
   user_obj_t *user_obj;
 
@@ -205,6 +314,7 @@ static void *lu_create_user_obj (lookup_t *obj, /* {{{ */
   }
   memset (user_obj, 0, sizeof (*user_obj));
   user_obj->next = NULL;
+  user_obj->hash = hash;
 
   user_obj->user_obj = obj->cb_user_class (ds, vl, user_class->user_class);
   if (user_obj->user_obj == NULL)
@@ -230,44 +340,45 @@ static void *lu_create_user_obj (lookup_t *obj, /* {{{ */
 
 #undef COPY_FIELD
 
-  if (user_class->user_obj_list == NULL)
+  if (lu_table_insert (user_class, user_obj) != 0)
   {
-    user_class->user_obj_list = user_obj;
-  }
-  else
-  {
-    user_obj_t *last = user_class->user_obj_list;
-    while (last->next != NULL)
-      last = last->next;
-    last->next = user_obj;
+    if (obj->cb_free_obj != NULL)
+      obj->cb_free_obj (user_obj->user_obj);
+    sfree (user_obj);
+    return (NULL);
   }
 
+  user_obj->next = user_class->user_obj_list;
+  user_class->user_obj_list = user_obj;
+
   return (user_obj);
 } /* }}} void *lu_create_user_obj */
 
 static user_obj_t *lu_find_user_obj (user_class_t *user_class, /* {{{ */
-    value_list_t const *vl)
+    value_list_t const *vl, uint32_t hash)
 {
   user_obj_t *ptr;
 
-  for (ptr = user_class->user_obj_list;
+  if (user_class->user_obj_table_size == 0)
+    return (NULL);
+
+  for (ptr = user_class->user_obj_table[hash
+        & (user_class->user_obj_table_size - 1)];
       ptr != NULL;
-      ptr = ptr->next)
+      ptr = ptr->hash_next)
   {
-    if (user_class->match.host.is_regex
-        && (user_class->match.group_by & LU_GROUP_BY_HOST)
+    if (ptr->hash != hash)
+      continue;
+    if (LU_GROUPED (user_class, host, LU_GROUP_BY_HOST)
         && (strcmp (vl->host, ptr->ident.host) != 0))
       continue;
-    if (user_class->match.plugin.is_regex
-        && (user_class->match.group_by & LU_GROUP_BY_PLUGIN)
+    if (LU_GROUPED (user_class, plugin, LU_GROUP_BY_PLUGIN)
         && (strcmp (vl->plugin, ptr->ident.plugin) != 0))
       continue;
-    if (user_class->match.plugin_instance.is_regex
-        && (user_class->match.group_by & LU_GROUP_BY_PLUGIN_INSTANCE)
+    if (LU_GROUPED (user_class, plugin_instance, LU_GROUP_BY_PLUGIN_INSTANCE)
         && (strcmp (vl->plugin_instance, ptr->ident.plugin_instance) != 0))
       continue;
-    if (user_class->match.type_instance.is_regex
-        && (user_class->match.group_by & LU_GROUP_BY_TYPE_INSTANCE)
+    if (LU_GROUPED (user_class, type_instance, LU_GROUP_BY_TYPE_INSTANCE)
         && (strcmp (vl->type_instance, ptr->ident.type_instance) != 0))
       continue;
 
@@ -282,6 +393,7 @@ static int lu_handle_user_class (lookup_t *obj, /* {{{ */
     user_class_t *user_class)
 {
   user_obj_t *user_obj;
+  uint32_t hash;
   int status;
 
   assert (strcmp (vl->type, user_class->match.type.str) == 0);
@@ -294,14 +406,21 @@ static int lu_handle_user_class (lookup_t *obj, /* {{{ */
       || !lu_part_matches (&user_class->match.host, vl->host))
     return (1);
 
-  user_obj = lu_find_user_obj (user_class, vl);
+  hash = lu_group_hash (user_class, vl);
+
+  pthread_mutex_lock (&user_class->lock);
+  user_obj = lu_find_user_obj (user_class, vl, hash);
   if (user_obj == NULL)
   {
     /* call lookup_class_callback_t() and insert into the list of user objects. */
-    user_obj = lu_create_user_obj (obj, ds, vl, user_class);
+    user_obj = lu_create_user_obj (obj, ds, vl, user_class, hash);
     if (user_obj == NULL)
+    {
+      pthread_mutex_unlock (&user_class->lock);
       return (-1);
+    }
   }
+  pthread_mutex_unlock (&user_class->lock);
 
   status = obj->cb_user_obj (ds, vl,
       user_class->user_class, user_obj->user_obj);
@@ -487,6 +606,9 @@ static void lu_destroy_user_class_list (lookup_t *obj, /* {{{ */
 
     lu_destroy_user_obj (obj, user_class_list->entry.user_obj_list);
     user_class_list->entry.user_obj_list = NULL;
+    sfree (user_class_list->entry.user_obj_table);
+    pthread_mutex_destroy (&user_class_list->entry.lock);
+    lu_free_match (&user_class_list->entry.match);
 
     sfree (user_class_list);
     user_class_list = next;
@@ -602,6 +724,8 @@ int lookup_add (lookup_t *obj, /* {{{ */
   user_class_obj->entry.user_class = user_class;
   lu_copy_ident_to_match (&user_class_obj->entry.match, ident, group_by);
   user_class_obj->entry.user_obj_list = NULL;
+  user_class_obj->entry.user_obj_table = NULL;
+  pthread_mutex_init (&user_class_obj->entry.lock, /* attr = */ NULL);
   user_class_obj->next = NULL;
 
   return (lu_add_by_plugin (by_type, user_class_obj));
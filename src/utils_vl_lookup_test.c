@@ -27,6 +27,8 @@
 #include "collectd.h"
 #include "utils_vl_lookup.h"
 
+#include <time.h>
+
 static _Bool expect_new_obj = 0;
 static _Bool have_new_obj = 0;
 
@@ -234,11 +236,82 @@ static void testcase3 (void)
   lookup_destroy (obj);
 }
 
+/* Many groups: every host must get exactly one object, no matter how many
+ * other hosts have been seen. */
+static void testcase4 (void)
+{
+  lookup_t *obj = checked_lookup_create ();
+  char host[DATA_MAX_NAME_LEN];
+  int pass;
+  int i;
+
+  checked_lookup_add (obj, "/.*/", "cpu", "/.*/", "cpu", "/.*/",
+      LU_GROUP_BY_HOST | LU_GROUP_BY_TYPE_INSTANCE);
+
+  for (pass = 0; pass < 2; pass++)
+    for (i = 0; i < 1000; i++)
+    {
+      snprintf (host, sizeof (host), "host%i.example.com", i);
+      checked_lookup_search (obj, host, "cpu", "0", "cpu", "user",
+          /* expect new = */ (pass == 0));
+      checked_lookup_search (obj, host, "cpu", "1", "cpu", "user",
+          /* expect new = */ 0);
+      assert (strcmp (last_obj_ident.host, host) == 0);
+      assert (strcmp (last_obj_ident.type_instance, "user") == 0);
+    }
+
+  lookup_destroy (obj);
+}
+
+#define BENCH_HOSTS 20000
+#define BENCH_ROUNDS 50
+
+static double bench_now (void) /* {{{ */
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1e9);
+} /* }}} double bench_now */
+
+/* Dispatches values of BENCH_HOSTS hosts to an aggregation grouped by host,
+ * like "GroupBy Host" in the aggregation plugin. */
+static void benchmark (void) /* {{{ */
+{
+  lookup_t *obj = checked_lookup_create ();
+  char host[DATA_MAX_NAME_LEN];
+  double t;
+  int r;
+  int i;
+
+  checked_lookup_add (obj, "/.*/", "cpu", "/.*/", "cpu", "idle",
+      LU_GROUP_BY_HOST);
+
+  t = bench_now ();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_HOSTS; i++)
+    {
+      snprintf (host, sizeof (host), "host%i.example.com", i);
+      checked_lookup_search (obj, host, "cpu", "0", "cpu", "idle",
+          /* expect new = */ (r == 0));
+    }
+  t = bench_now () - t;
+
+  printf ("%i groups: %8.3f s  %12.0f lookups/s\n", BENCH_HOSTS, t,
+      ((double) BENCH_ROUNDS) * BENCH_HOSTS / t);
+
+  lookup_destroy (obj);
+} /* }}} void benchmark */
+
 int main (int argc, char **argv) /* {{{ */
 {
   testcase0 ();
   testcase1 ();
   testcase2 ();
   testcase3 ();
+  testcase4 ();
+
+  if ((argc > 1) && (strcmp ("-b", argv[1]) == 0))
+    benchmark ();
+
   return (EXIT_SUCCESS);
 } /* }}} int main */
@@ -22,6 +22,7 @@
 #include "collectd.h"
 #include "common.h"
 #include "plugin.h"
+#include "utils_procfs.h"
 
 #if KERNEL_LINUX
 static const char *config_keys[] =
@@ -37,13 +38,16 @@ static int verbose_output = 0;
 # error "No applicable input method."
 #endif /* HAVE_LIBSTATGRAB */
 
+/* If `value_time' is zero, the current time is used. */
 static void submit (const char *plugin_instance, const char *type,
-    const char *type_instance, value_t *values, int values_len)
+    const char *type_instance, value_t *values, int values_len,
+    cdtime_t value_time)
 {
   value_list_t vl = VALUE_LIST_INIT;
 
   vl.values = values;
   vl.values_len = values_len;
+  vl.time = value_time;
 
   sstrncpy (vl.host, hostname_g, sizeof (vl.host));
   sstrncpy (vl.plugin, "vmem", sizeof (vl.plugin));
@@ -57,20 +61,21 @@ static void submit (const char *plugin_instance, const char *type,
 } /* void vmem_submit */
 
 static void submit_two (const char *plugin_instance, const char *type,
-    const char *type_instance, derive_t c0, derive_t c1)
+    const char *type_instance, derive_t c0, derive_t c1,
+    cdtime_t value_time)
 {
   value_t values[2];
 
   values[0].derive = c0;
   values[1].derive = c1;
 
-  submit (plugin_instance, type, type_instance, values, 2);
+  submit (plugin_instance, type, type_instance, values, 2, value_time);
 } /* void submit_one */
 
 static void submit_one (const char *plugin_instance, const char *type,
-    const char *type_instance, value_t value)
+    const char *type_instance, value_t value, cdtime_t value_time)
 {
-  submit (plugin_instance, type, type_instance, &value, 1);
+  submit (plugin_instance, type, type_instance, &value, 1, value_time);
 } /* void submit_one */
 
 static int vmem_config (const char *key, const char *value)
@@ -105,19 +110,23 @@ static int vmem_read (void)
   derive_t pgmajfault = 0;
   int pgfaultvalid = 0;
 
-  FILE *fh;
-  char buffer[1024];
+  char *snapshot;
+  char *cursor;
+  char *buffer;
 
-  fh = fopen ("/proc/vmstat", "r");
-  if (fh == NULL)
+  cdtime_t value_time = 0;
+
+  snapshot = procfs_snapshot ("/proc/vmstat", NULL, &value_time);
+  if (snapshot == NULL)
   {
     char errbuf[1024];
-    ERROR ("vmem plugin: fopen (/proc/vmstat) failed: %s",
+    ERROR ("vmem plugin: Reading /proc/vmstat failed: %s",
 	sstrerror (errno, errbuf, sizeof (errbuf)));
     return (-1);
   }
 
-  while (fgets (buffer, sizeof (buffer), fh) != NULL)
+  cursor = snapshot;
+  while ((buffer = procfs_next_line (&cursor)) != NULL)
   {
     char *fields[4];
     int fields_num;
@@ -151,7 +160,7 @@ static int vmem_read (void)
     {
       char *inst = key + strlen ("nr_");
       value_t value = { .gauge = gauge };
-      submit_one (NULL, "vmpage_number", inst, value);
+      submit_one (NULL, "vmpage_number", inst, value, value_time);
     }
 
     /* 
@@ -206,31 +215,31 @@ static int vmem_read (void)
     {
       char *inst = key + strlen ("pgalloc_");
       value_t value  = { .derive = counter };
-      submit_one (inst, "vmpage_action", "alloc", value);
+      submit_one (inst, "vmpage_action", "alloc", value, value_time);
     }
     else if (strncmp ("pgrefill_", key, strlen ("pgrefill_")) == 0)
     {
       char *inst = key + strlen ("pgrefill_");
       value_t value  = { .derive = counter };
-      submit_one (inst, "vmpage_action", "refill", value);
+      submit_one (inst, "vmpage_action", "refill", value, value_time);
     }
     else if (strncmp ("pgsteal_", key, strlen ("pgsteal_")) == 0)
     {
       char *inst = key + strlen ("pgsteal_");
       value_t value  = { .derive = counter };
-      submit_one (inst, "vmpage_action", "steal", value);
+      submit_one (inst, "vmpage_action", "steal", value, value_time);
     }
     else if (strncmp ("pgscan_kswapd_", key, strlen ("pgscan_kswapd_")) == 0)
     {
       char *inst = key + strlen ("pgscan_kswapd_");
       value_t value  = { .derive = counter };
-      submit_one (inst, "vmpage_action", "scan_kswapd", value);
+      submit_one (inst, "vmpage_action", "scan_kswapd", value, value_time);
     }
     else if (strncmp ("pgscan_direct_", key, strlen ("pgscan_direct_")) == 0)
     {
       char *inst = key + strlen ("pgscan_direct_");
       value_t value  = { .derive = counter };
-      submit_one (inst, "vmpage_action", "scan_direct", value);
+      submit_one (inst, "vmpage_action", "scan_direct", value, value_time);
     }
 
     /*
@@ -242,31 +251,30 @@ static int vmem_read (void)
     else if (strcmp ("pgfree", key) == 0)
     {
       value_t value  = { .derive = counter };
-      submit_one (NULL, "vmpage_action", "free", value);
+      submit_one (NULL, "vmpage_action", "free", value, value_time);
     }
     else if (strcmp ("pgactivate", key) == 0)
     {
       value_t value  = { .derive = counter };
-      submit_one (NULL, "vmpage_action", "activate", value);
+      submit_one (NULL, "vmpage_action", "activate", value, value_time);
     }
     else if (strcmp ("pgdeactivate", key) == 0)
     {
       value_t value  = { .derive = counter };
-      submit_one (NULL, "vmpage_action", "deactivate", value);
+      submit_one (NULL, "vmpage_action", "deactivate", value, value_time);
     }
-  } /* while (fgets) */
+  } /* while (procfs_next_line) */
 
-  fclose (fh);
-  fh = NULL;
+  sfree (snapshot);
 
   if (pgfaultvalid == 0x03)
-    submit_two (NULL, "vmpage_faults", NULL, pgfault, pgmajfault);
+    submit_two (NULL, "vmpage_faults", NULL, pgfault, pgmajfault, value_time);
 
   if (pgpgvalid == 0x03)
-    submit_two (NULL, "vmpage_io", "memory", pgpgin, pgpgout);
+    submit_two (NULL, "vmpage_io", "memory", pgpgin, pgpgout, value_time);
 
   if (pswpvalid == 0x03)
-    submit_two (NULL, "vmpage_io", "swap", pswpin, pswpout);
+    submit_two (NULL, "vmpage_io", "swap", pswpin, pswpout, value_time);
 #endif /* KERNEL_LINUX */
 
   return (0);
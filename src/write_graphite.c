@@ -49,12 +49,14 @@
 #include "utils_complain.h"
 #include "utils_parse_option.h"
 #include "utils_format_graphite.h"
+#include "utils_md5.h"
 
 /* Folks without pthread will need to disable this plugin. */
 #include <pthread.h>
 
 #include <sys/socket.h>
 #include <netdb.h>
+#include <poll.h>
 
 #ifndef WG_DEFAULT_NODE
 # define WG_DEFAULT_NODE "localhost"
@@ -73,12 +75,42 @@
 # define WG_SEND_BUF_SIZE 1428
 #endif
 
+/* Amount of data kept in memory while Carbon is unreachable. */
+#ifndef WG_DEFAULT_QUEUE_LIMIT
+# define WG_DEFAULT_QUEUE_LIMIT (1024 * 1024)
+#endif
+
+/* Timeout (in milliseconds) for connecting and for a stalled send. */
+#ifndef WG_IO_TIMEOUT
+# define WG_IO_TIMEOUT 10000
+#endif
+
+#define WG_RECONNECT_INTERVAL_MIN TIME_T_TO_CDTIME_T (1)
+#define WG_RECONNECT_INTERVAL_MAX TIME_T_TO_CDTIME_T (60)
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
 /*
  * Private variables
  */
+/* A filled send buffer, waiting to be sent by the I/O thread. */
+struct wg_chunk
+{
+    struct wg_chunk *next;
+    size_t size;
+    char data[];
+};
+
 struct wg_callback
 {
+    /* Only used by the I/O thread. */
     int      sock_fd;
+    cdtime_t reconnect_interval;
+    cdtime_t next_reconnect;
+    /* Successful calls of wg_send_chunks() since connecting. */
+    int      sock_sends;
 
     char    *name;
 
@@ -90,13 +122,31 @@ struct wg_callback
 
     unsigned int format_flags;
 
+    /* Write threads only append to `send_buf'. Once it is full (or flushed)
+     * its content is moved to the queue and sent by the I/O thread, so a slow
+     * Carbon server doesn't block the write threads. */
     char     send_buf[WG_SEND_BUF_SIZE];
     size_t   send_buf_free;
     size_t   send_buf_fill;
     cdtime_t send_buf_init_time;
 
+    struct wg_chunk *queue_head;
+    struct wg_chunk *queue_tail;
+    size_t   queue_size;
+    /* Size of the chunks taken from the queue by the I/O thread and not sent
+     * yet. They count against `queue_limit', too. */
+    size_t   sending_size;
+    size_t   queue_limit;
+    cdtime_t reconnect_interval_max;
+
+    pthread_t io_thread;
+    _Bool     io_thread_running;
+    _Bool     io_thread_shutdown;
+    pthread_cond_t io_cond;
+
     pthread_mutex_t send_lock;
     c_complain_t init_complaint;
+    c_complain_t queue_complaint;
 };
 
 
@@ -111,23 +161,132 @@ static void wg_reset_buffer (struct wg_callback *cb)
     cb->send_buf_init_time = cdtime ();
 }
 
-static int wg_send_buffer (struct wg_callback *cb)
+static void wg_free_chunks (struct wg_chunk *chunk)
+{
+    while (chunk != NULL)
+    {
+        struct wg_chunk *next = chunk->next;
+        sfree (chunk);
+        chunk = next;
+    }
+}
+
+/* Drops the oldest queued chunks until the queue and the chunks being sent
+ * fit into `queue_limit'.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static void wg_queue_trim_nolock (struct wg_callback *cb)
 {
-    ssize_t status = 0;
+    size_t dropped = 0;
 
-    status = swrite (cb->sock_fd, cb->send_buf, strlen (cb->send_buf));
-    if (status < 0)
+    while (((cb->queue_size + cb->sending_size) > cb->queue_limit)
+            && (cb->queue_head != NULL))
     {
-        char errbuf[1024];
-        ERROR ("write_graphite plugin: send failed with status %zi (%s)",
-                status, sstrerror (errno, errbuf, sizeof (errbuf)));
+        struct wg_chunk *chunk = cb->queue_head;
+
+        cb->queue_head = chunk->next;
+        if (cb->queue_head == NULL)
+            cb->queue_tail = NULL;
+
+        cb->queue_size -= chunk->size;
+        dropped += chunk->size;
+        sfree (chunk);
+    }
+
+    if (dropped > 0)
+        c_complain (LOG_WARNING, &cb->queue_complaint,
+                "write_graphite plugin: The send queue of [%s]:%s is full. "
+                "Dropped %zu bytes of the oldest data.",
+                cb->node != NULL ? cb->node : WG_DEFAULT_NODE,
+                cb->service != NULL ? cb->service : WG_DEFAULT_SERVICE,
+                dropped);
+    else if ((cb->queue_size + cb->sending_size) == 0)
+        c_release (LOG_INFO, &cb->queue_complaint,
+                "write_graphite plugin: The send queue of [%s]:%s "
+                "has been drained.",
+                cb->node != NULL ? cb->node : WG_DEFAULT_NODE,
+                cb->service != NULL ? cb->service : WG_DEFAULT_SERVICE);
+}
 
+/* Moves the content of the send buffer to the queue and wakes up the I/O
+ * thread.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_enqueue_nolock (struct wg_callback *cb)
+{
+    struct wg_chunk *chunk;
 
-        close (cb->sock_fd);
-        cb->sock_fd = -1;
+    if (cb->send_buf_fill == 0)
+        return (0);
 
+    chunk = malloc (sizeof (*chunk) + cb->send_buf_fill);
+    if (chunk == NULL)
+    {
+        ERROR ("write_graphite plugin: malloc failed.");
         return (-1);
     }
+    chunk->next = NULL;
+    chunk->size = cb->send_buf_fill;
+    memcpy (chunk->data, cb->send_buf, cb->send_buf_fill);
+
+    if (cb->queue_tail == NULL)
+        cb->queue_head = chunk;
+    else
+        cb->queue_tail->next = chunk;
+    cb->queue_tail = chunk;
+    cb->queue_size += chunk->size;
+
+    wg_queue_trim_nolock (cb);
+    wg_reset_buffer (cb);
+
+    pthread_cond_signal (&cb->io_cond);
+    return (0);
+}
+
+static int wg_send_buffer (struct wg_callback *cb,
+        const char *buffer, size_t buffer_size)
+{
+    while (buffer_size > 0)
+    {
+        struct pollfd pfd;
+        ssize_t status;
+        char errbuf[1024];
+
+        status = send (cb->sock_fd, buffer, buffer_size, MSG_NOSIGNAL);
+        if (status >= 0)
+        {
+            buffer += status;
+            buffer_size -= (size_t) status;
+            continue;
+        }
+
+        if (errno == EINTR)
+            continue;
+
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        {
+            ERROR ("write_graphite plugin: send failed with status %zi (%s)",
+                    status, sstrerror (errno, errbuf, sizeof (errbuf)));
+            return (-1);
+        }
+
+        memset (&pfd, 0, sizeof (pfd));
+        pfd.fd = cb->sock_fd;
+        pfd.events = POLLOUT;
+
+        status = poll (&pfd, 1, WG_IO_TIMEOUT);
+        if ((status < 0) && (errno != EINTR))
+        {
+            ERROR ("write_graphite plugin: poll failed: %s",
+                    sstrerror (errno, errbuf, sizeof (errbuf)));
+            return (-1);
+        }
+        else if (status == 0)
+        {
+            ERROR ("write_graphite plugin: Sending to [%s]:%s timed out.",
+                    cb->node != NULL ? cb->node : WG_DEFAULT_NODE,
+                    cb->service != NULL ? cb->service : WG_DEFAULT_SERVICE);
+            return (-1);
+        }
+    }
 
     return (0);
 }
@@ -135,8 +294,6 @@ static int wg_send_buffer (struct wg_callback *cb)
 /* NOTE: You must hold cb->send_lock when calling this function! */
 static int wg_flush_nolock (cdtime_t timeout, struct wg_callback *cb)
 {
-    int status;
-
     DEBUG ("write_graphite plugin: wg_flush_nolock: timeout = %.3f; "
             "send_buf_fill = %zu;",
             (double)timeout,
@@ -158,10 +315,61 @@ static int wg_flush_nolock (cdtime_t timeout, struct wg_callback *cb)
         return (0);
     }
 
-    status = wg_send_buffer (cb);
-    wg_reset_buffer (cb);
+    return (wg_enqueue_nolock (cb));
+}
 
-    return (status);
+/* Connects a non-blocking socket to `ai', waiting at most WG_IO_TIMEOUT
+ * milliseconds. Returns the file descriptor or -1. */
+static int wg_connect (struct addrinfo *ai)
+{
+    struct pollfd pfd;
+    int fd;
+    int flags;
+    int status;
+    int so_error = 0;
+    socklen_t so_error_len = sizeof (so_error);
+
+    fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0)
+        return (-1);
+
+    flags = fcntl (fd, F_GETFL);
+    if ((flags < 0) || (fcntl (fd, F_SETFL, flags | O_NONBLOCK) != 0))
+    {
+        close (fd);
+        return (-1);
+    }
+
+    status = connect (fd, ai->ai_addr, ai->ai_addrlen);
+    if (status == 0)
+        return (fd);
+    if (errno != EINPROGRESS)
+    {
+        close (fd);
+        return (-1);
+    }
+
+    memset (&pfd, 0, sizeof (pfd));
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+
+    do
+        status = poll (&pfd, 1, WG_IO_TIMEOUT);
+    while ((status < 0) && (errno == EINTR));
+
+    if (status == 0)
+        errno = ETIMEDOUT;
+    else if ((status > 0)
+            && (getsockopt (fd, SOL_SOCKET, SO_ERROR,
+                    &so_error, &so_error_len) == 0))
+    {
+        if (so_error == 0)
+            return (fd);
+        errno = so_error;
+    }
+
+    close (fd);
+    return (-1);
 }
 
 static int wg_callback_init (struct wg_callback *cb)
@@ -197,20 +405,9 @@ static int wg_callback_init (struct wg_callback *cb)
     assert (ai_list != NULL);
     for (ai_ptr = ai_list; ai_ptr != NULL; ai_ptr = ai_ptr->ai_next)
     {
-        cb->sock_fd = socket (ai_ptr->ai_family, ai_ptr->ai_socktype,
-                ai_ptr->ai_protocol);
-        if (cb->sock_fd < 0)
-            continue;
-
-        status = connect (cb->sock_fd, ai_ptr->ai_addr, ai_ptr->ai_addrlen);
-        if (status != 0)
-        {
-            close (cb->sock_fd);
-            cb->sock_fd = -1;
-            continue;
-        }
-
-        break;
+        cb->sock_fd = wg_connect (ai_ptr);
+        if (cb->sock_fd >= 0)
+            break;
     }
 
     freeaddrinfo (ai_list);
@@ -222,7 +419,6 @@ static int wg_callback_init (struct wg_callback *cb)
                 "write_graphite plugin: Connecting to %s:%s failed. "
                 "The last error was: %s", node, service,
                 sstrerror (errno, errbuf, sizeof (errbuf)));
-        close (cb->sock_fd);
         return (-1);
     }
     else
@@ -232,8 +428,171 @@ static int wg_callback_init (struct wg_callback *cb)
                 node, service);
     }
 
-    wg_reset_buffer (cb);
+    return (0);
+}
+
+/* Schedules the next connection attempt. The interval doubles with every
+ * failed connection attempt or send, so a dead or failing Carbon server isn't
+ * hammered with connections. */
+static void wg_backoff (struct wg_callback *cb, cdtime_t now)
+{
+    cb->next_reconnect = now + cb->reconnect_interval;
+    cb->reconnect_interval *= 2;
+    if (cb->reconnect_interval > cb->reconnect_interval_max)
+        cb->reconnect_interval = cb->reconnect_interval_max;
+}
+
+/* Sends the chunks in `*list', freeing every chunk that has been sent
+ * completely. Upon failure, the unsent chunks are left in `*list'. */
+static int wg_send_chunks (struct wg_callback *cb, struct wg_chunk **list)
+{
+    cdtime_t now = cdtime ();
+
+    if (cb->sock_fd < 0)
+    {
+        if (now < cb->next_reconnect)
+            return (-1);
 
+        if (wg_callback_init (cb) != 0)
+        {
+            wg_backoff (cb, now);
+            return (-1);
+        }
+
+        cb->next_reconnect = 0;
+        cb->sock_sends = 0;
+    }
+
+    while (*list != NULL)
+    {
+        struct wg_chunk *chunk = *list;
+
+        if (wg_send_buffer (cb, chunk->data, chunk->size) != 0)
+        {
+            /* The chunk may have been sent partially. It is re-sent as a
+             * whole after reconnecting, so no line is cut in half. */
+            close (cb->sock_fd);
+            cb->sock_fd = -1;
+            wg_backoff (cb, now);
+            return (-1);
+        }
+
+        *list = chunk->next;
+
+        pthread_mutex_lock (&cb->send_lock);
+        cb->sending_size -= chunk->size;
+        pthread_mutex_unlock (&cb->send_lock);
+        sfree (chunk);
+    }
+
+    /* The first send on a new connection usually succeeds even if the
+     * server closes it right away, so the back-off is only reset once a
+     * later send has succeeded, too. */
+    cb->sock_sends++;
+    if (cb->sock_sends > 1)
+        cb->reconnect_interval = WG_RECONNECT_INTERVAL_MIN;
+    return (0);
+}
+
+static void *wg_io_thread (void *arg)
+{
+    struct wg_callback *cb = arg;
+
+    pthread_mutex_lock (&cb->send_lock);
+    while (42)
+    {
+        struct wg_chunk *list;
+        struct wg_chunk *last;
+        int status;
+
+        while ((cb->queue_head == NULL) && !cb->io_thread_shutdown)
+            pthread_cond_wait (&cb->io_cond, &cb->send_lock);
+
+        if (cb->queue_head == NULL)
+            break;
+
+        /* Take the whole queue, so write threads can continue to append
+         * while we're sending. */
+        list = cb->queue_head;
+        cb->queue_head = cb->queue_tail = NULL;
+        cb->sending_size = cb->queue_size;
+        cb->queue_size = 0;
+        pthread_mutex_unlock (&cb->send_lock);
+
+        status = wg_send_chunks (cb, &list);
+
+        pthread_mutex_lock (&cb->send_lock);
+        if (status == 0)
+        {
+            wg_queue_trim_nolock (cb);
+            continue;
+        }
+
+        if (cb->io_thread_shutdown)
+        {
+            size_t lost = 0;
+            for (last = list; last != NULL; last = last->next)
+                lost += last->size;
+            for (last = cb->queue_head; last != NULL; last = last->next)
+                lost += last->size;
+            ERROR ("write_graphite plugin: Shutting down with %zu bytes "
+                    "not sent to [%s]:%s.", lost,
+                    cb->node != NULL ? cb->node : WG_DEFAULT_NODE,
+                    cb->service != NULL ? cb->service : WG_DEFAULT_SERVICE);
+            wg_free_chunks (list);
+            cb->sending_size = 0;
+            break;
+        }
+
+        /* Put the unsent chunks back in front of the queue. */
+        for (last = list; last->next != NULL; last = last->next)
+            /* find the last chunk */;
+        cb->queue_size += cb->sending_size;
+        cb->sending_size = 0;
+        last->next = cb->queue_head;
+        if (cb->queue_tail == NULL)
+            cb->queue_tail = last;
+        cb->queue_head = list;
+        wg_queue_trim_nolock (cb);
+
+        /* Wait until the next connection attempt is due. */
+        while (!cb->io_thread_shutdown && (cdtime () < cb->next_reconnect))
+        {
+            struct timespec ts;
+
+            CDTIME_T_TO_TIMESPEC (cb->next_reconnect, &ts);
+            pthread_cond_timedwait (&cb->io_cond, &cb->send_lock, &ts);
+        }
+    }
+
+    wg_free_chunks (cb->queue_head);
+    cb->queue_head = cb->queue_tail = NULL;
+    cb->queue_size = 0;
+    pthread_mutex_unlock (&cb->send_lock);
+
+    return ((void *) 0);
+}
+
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_start_io_thread_nolock (struct wg_callback *cb)
+{
+    int status;
+
+    if (cb->io_thread_running)
+        return (0);
+
+    cb->io_thread_shutdown = 0;
+    status = plugin_thread_create (&cb->io_thread, /* attr = */ NULL,
+            wg_io_thread, cb);
+    if (status != 0)
+    {
+        char errbuf[1024];
+        ERROR ("write_graphite plugin: Starting the I/O thread failed: %s",
+                sstrerror (errno, errbuf, sizeof (errbuf)));
+        return (-1);
+    }
+
+    cb->io_thread_running = 1;
     return (0);
 }
 
@@ -250,15 +609,30 @@ static void wg_callback_free (void *data)
 
     wg_flush_nolock (/* timeout = */ 0, cb);
 
-    close(cb->sock_fd);
+    cb->io_thread_shutdown = 1;
+    pthread_cond_broadcast (&cb->io_cond);
+    pthread_mutex_unlock (&cb->send_lock);
+
+    /* The I/O thread sends the remaining data before exiting. */
+    if (cb->io_thread_running)
+    {
+        pthread_join (cb->io_thread, NULL);
+        cb->io_thread_running = 0;
+    }
+
+    if (cb->sock_fd >= 0)
+        close(cb->sock_fd);
     cb->sock_fd = -1;
 
+    wg_free_chunks (cb->queue_head);
+
     sfree(cb->name);
     sfree(cb->node);
     sfree(cb->service);
     sfree(cb->prefix);
     sfree(cb->postfix);
 
+    pthread_cond_destroy (&cb->io_cond);
     pthread_mutex_destroy (&cb->send_lock);
 
     sfree(cb);
@@ -278,18 +652,10 @@ static int wg_flush (cdtime_t timeout,
 
     pthread_mutex_lock (&cb->send_lock);
 
-    if (cb->sock_fd < 0)
-    {
-        status = wg_callback_init (cb);
-        if (status != 0)
-        {
-            /* An error message has already been printed. */
-            pthread_mutex_unlock (&cb->send_lock);
-            return (-1);
-        }
-    }
+    status = wg_start_io_thread_nolock (cb);
+    if (status == 0)
+        status = wg_flush_nolock (timeout, cb);
 
-    status = wg_flush_nolock (timeout, cb);
     pthread_mutex_unlock (&cb->send_lock);
 
     return (status);
@@ -304,15 +670,12 @@ static int wg_send_message (char const *message, struct wg_callback *cb)
 
     pthread_mutex_lock (&cb->send_lock);
 
-    if (cb->sock_fd < 0)
+    status = wg_start_io_thread_nolock (cb);
+    if (status != 0)
     {
-        status = wg_callback_init (cb);
-        if (status != 0)
-        {
-            /* An error message has already been printed. */
-            pthread_mutex_unlock (&cb->send_lock);
-            return (-1);
-        }
+        /* An error message has already been printed. */
+        pthread_mutex_unlock (&cb->send_lock);
+        return (-1);
     }
 
     if (message_len >= cb->send_buf_free)
@@ -393,6 +756,274 @@ static int wg_write (const data_set_t *ds, const value_list_t *vl,
     return (status);
 }
 
+/*
+ * Clusters
+ *
+ * A cluster is a set of Carbon destinations forming a consistent hashing ring.
+ * Each metric is sent to `replication_factor' destinations only. The ring is
+ * built like the "ConsistentHashRing" of Carbon 1.0 and later, so metrics end
+ * up on the same instance a carbon-relay using the consistent-hashing method
+ * would send them to. (Carbon 0.9 kept colliding positions twice instead of
+ * moving them, so rings with collisions differ slightly from those.)
+ */
+#define WG_RING_REPLICAS 100
+
+struct wg_ring_entry
+{
+    /* Positions taken by an earlier entry are moved up, possibly beyond the
+     * range of the hash. */
+    uint32_t position;
+    size_t   destination;
+};
+
+struct wg_cluster
+{
+    char *name;
+
+    /* Holds the format options; never connected. */
+    struct wg_callback *settings;
+
+    struct wg_callback **destinations;
+    char  **instances;
+    size_t  destinations_num;
+
+    struct wg_ring_entry *ring;
+    size_t ring_num;
+
+    int replication_factor;
+};
+
+static uint16_t wg_ring_position (char const *key, size_t key_len)
+{
+    uint8_t digest[16];
+
+    /* Carbon uses the first four hex digits of the MD5 sum. */
+    md5_digest (key, key_len, digest);
+    return ((uint16_t) ((digest[0] << 8) | digest[1]));
+}
+
+/* Returns the index of the first of the `ring_num' entries of `ring' whose
+ * position is not less than `position' (Python's bisect_left). */
+static size_t wg_ring_bisect (struct wg_ring_entry const *ring,
+        size_t ring_num, uint32_t position)
+{
+    size_t lo = 0;
+    size_t hi = ring_num;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ring[mid].position < position)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return (lo);
+}
+
+static int wg_ring_build (struct wg_cluster *cl)
+{
+    size_t i;
+    int j;
+
+    cl->ring_num = 0;
+    cl->ring = calloc (cl->destinations_num * WG_RING_REPLICAS,
+            sizeof (*cl->ring));
+    if (cl->ring == NULL)
+    {
+        ERROR ("write_graphite plugin: calloc failed.");
+        return (-1);
+    }
+
+    /* Entries are inserted in the same order as Carbon does, because that
+     * order decides which entry is moved on a collision. */
+    for (i = 0; i < cl->destinations_num; i++)
+    {
+        for (j = 0; j < WG_RING_REPLICAS; j++)
+        {
+            char key[2 * DATA_MAX_NAME_LEN + 32];
+            int key_len;
+            uint32_t position;
+            size_t index;
+
+            /* Python's "%s:%d" % ((server, instance), i) */
+            if (cl->instances[i] == NULL)
+                key_len = ssnprintf (key, sizeof (key), "('%s', None):%i",
+                        cl->destinations[i]->node, j);
+            else
+                key_len = ssnprintf (key, sizeof (key), "('%s', '%s'):%i",
+                        cl->destinations[i]->node, cl->instances[i], j);
+            if ((key_len < 0) || ((size_t) key_len >= sizeof (key)))
+                key_len = (int) strlen (key);
+
+            position = wg_ring_position (key, (size_t) key_len);
+            index = wg_ring_bisect (cl->ring, cl->ring_num, position);
+
+            /* Carbon moves a position taken by another entry up by one. */
+            while ((index < cl->ring_num)
+                    && (cl->ring[index].position == position))
+            {
+                position++;
+                index++;
+            }
+
+            memmove (cl->ring + index + 1, cl->ring + index,
+                    (cl->ring_num - index) * sizeof (*cl->ring));
+            cl->ring[index].position = position;
+            cl->ring[index].destination = i;
+            cl->ring_num++;
+        }
+    }
+
+    return (0);
+}
+
+/* Returns the ring index of the first replica responsible for `key'. */
+static size_t wg_ring_lookup (struct wg_cluster const *cl,
+        char const *key, size_t key_len)
+{
+    uint16_t position = wg_ring_position (key, key_len);
+
+    return (wg_ring_bisect (cl->ring, cl->ring_num, position) % cl->ring_num);
+}
+
+static int wg_cluster_send_line (struct wg_cluster *cl, char const *line)
+{
+    _Bool *used;
+    size_t key_len;
+    size_t index;
+    size_t n;
+    int sent = 0;
+    int status = 0;
+
+    used = calloc (cl->destinations_num, sizeof (*used));
+    if (used == NULL)
+    {
+        ERROR ("write_graphite plugin: calloc failed.");
+        return (-1);
+    }
+
+    key_len = strcspn (line, " ");
+    index = wg_ring_lookup (cl, line, key_len);
+
+    for (n = 0; (n < cl->ring_num) && (sent < cl->replication_factor); n++)
+    {
+        size_t d = cl->ring[(index + n) % cl->ring_num].destination;
+
+        if (used[d])
+            continue;
+        used[d] = 1;
+        sent++;
+
+        if (wg_send_message (line, cl->destinations[d]) != 0)
+            status = -1;
+    }
+
+    sfree (used);
+    return (status);
+}
+
+static int wg_cluster_write (const data_set_t *ds, const value_list_t *vl,
+        user_data_t *user_data)
+{
+    struct wg_cluster *cl;
+    struct wg_callback *settings;
+    char buffer[WG_SEND_BUF_SIZE];
+    char line[WG_SEND_BUF_SIZE];
+    char *ptr;
+    int status;
+
+    if (user_data == NULL)
+        return (EINVAL);
+
+    cl = user_data->data;
+    settings = cl->settings;
+
+    if (0 != strcmp (ds->type, vl->type))
+    {
+        ERROR ("write_graphite plugin: DS type does not match "
+                "value list type");
+        return -1;
+    }
+
+    memset (buffer, 0, sizeof (buffer));
+    status = format_graphite (buffer, sizeof (buffer), ds, vl,
+            settings->prefix, settings->postfix, settings->escape_char,
+            settings->format_flags);
+    if (status != 0) /* error message has been printed already. */
+        return (status);
+
+    /* Each data source has its own line and may end up on a different
+     * destination. */
+    ptr = buffer;
+    while (*ptr != 0)
+    {
+        size_t line_len = strcspn (ptr, "\n");
+
+        if (ptr[line_len] == '\n')
+            line_len++;
+
+        memcpy (line, ptr, line_len);
+        line[line_len] = 0;
+        ptr += line_len;
+
+        if (wg_cluster_send_line (cl, line) != 0)
+            status = -1;
+    }
+
+    return (status);
+}
+
+static int wg_cluster_flush (cdtime_t timeout,
+        const char *identifier,
+        user_data_t *user_data)
+{
+    struct wg_cluster *cl;
+    size_t i;
+    int status = 0;
+
+    if (user_data == NULL)
+        return (-EINVAL);
+
+    cl = user_data->data;
+
+    for (i = 0; i < cl->destinations_num; i++)
+    {
+        user_data_t ud = { cl->destinations[i], NULL };
+
+        if (wg_flush (timeout, identifier, &ud) != 0)
+            status = -1;
+    }
+
+    return (status);
+}
+
+static void wg_cluster_free (void *data)
+{
+    struct wg_cluster *cl = data;
+    size_t i;
+
+    if (cl == NULL)
+        return;
+
+    for (i = 0; i < cl->destinations_num; i++)
+    {
+        wg_callback_free (cl->destinations[i]);
+        sfree (cl->instances[i]);
+    }
+    sfree (cl->destinations);
+    sfree (cl->instances);
+    sfree (cl->ring);
+
+    wg_callback_free (cl->settings);
+    sfree (cl->name);
+    sfree (cl);
+}
+
+/*
+ * Configuration
+ */
 static int config_set_char (char *dest,
         oconfig_item_t *ci)
 {
@@ -424,18 +1055,15 @@ static int config_set_char (char *dest,
     return (0);
 }
 
-static int wg_config_node (oconfig_item_t *ci)
+static struct wg_callback *wg_callback_create (void)
 {
     struct wg_callback *cb;
-    user_data_t user_data;
-    char callback_name[DATA_MAX_NAME_LEN];
-    int i;
 
     cb = malloc (sizeof (*cb));
     if (cb == NULL)
     {
         ERROR ("write_graphite plugin: malloc failed.");
-        return (-1);
+        return (NULL);
     }
     memset (cb, 0, sizeof (*cb));
     cb->sock_fd = -1;
@@ -446,6 +1074,69 @@ static int wg_config_node (oconfig_item_t *ci)
     cb->postfix = NULL;
     cb->escape_char = WG_DEFAULT_ESCAPE;
     cb->format_flags = GRAPHITE_STORE_RATES;
+    cb->queue_limit = WG_DEFAULT_QUEUE_LIMIT;
+    cb->reconnect_interval = WG_RECONNECT_INTERVAL_MIN;
+    cb->reconnect_interval_max = WG_RECONNECT_INTERVAL_MAX;
+    wg_reset_buffer (cb);
+
+    pthread_mutex_init (&cb->send_lock, /* attr = */ NULL);
+    pthread_cond_init (&cb->io_cond, /* attr = */ NULL);
+    C_COMPLAIN_INIT (&cb->init_complaint);
+    C_COMPLAIN_INIT (&cb->queue_complaint);
+
+    return (cb);
+}
+
+/* Handles the options shared by <Node> and <Cluster> blocks. Returns zero if
+ * the option has been handled. */
+static int wg_config_common (oconfig_item_t *child, struct wg_callback *cb)
+{
+    if (strcasecmp ("Prefix", child->key) == 0)
+        cf_util_get_string (child, &cb->prefix);
+    else if (strcasecmp ("Postfix", child->key) == 0)
+        cf_util_get_string (child, &cb->postfix);
+    else if (strcasecmp ("StoreRates", child->key) == 0)
+        cf_util_get_flag (child, &cb->format_flags,
+                GRAPHITE_STORE_RATES);
+    else if (strcasecmp ("SeparateInstances", child->key) == 0)
+        cf_util_get_flag (child, &cb->format_flags,
+                GRAPHITE_SEPARATE_INSTANCES);
+    else if (strcasecmp ("AlwaysAppendDS", child->key) == 0)
+        cf_util_get_flag (child, &cb->format_flags,
+                GRAPHITE_ALWAYS_APPEND_DS);
+    else if (strcasecmp ("EscapeCharacter", child->key) == 0)
+        config_set_char (&cb->escape_char, child);
+    else if (strcasecmp ("SpillQueueSize", child->key) == 0)
+    {
+        int tmp = (int) cb->queue_limit;
+        if ((cf_util_get_int (child, &tmp) == 0) && (tmp >= 0))
+            cb->queue_limit = (size_t) tmp;
+        else
+            ERROR ("write_graphite plugin: \"SpillQueueSize\" must be "
+                    "a non-negative number of bytes.");
+    }
+    else if (strcasecmp ("MaxReconnectInterval", child->key) == 0)
+    {
+        cf_util_get_cdtime (child, &cb->reconnect_interval_max);
+        if (cb->reconnect_interval_max < WG_RECONNECT_INTERVAL_MIN)
+            cb->reconnect_interval_max = WG_RECONNECT_INTERVAL_MIN;
+    }
+    else
+        return (-1);
+
+    return (0);
+}
+
+static int wg_config_node (oconfig_item_t *ci)
+{
+    struct wg_callback *cb;
+    user_data_t user_data;
+    char callback_name[DATA_MAX_NAME_LEN];
+    int i;
+
+    cb = wg_callback_create ();
+    if (cb == NULL)
+        return (-1);
 
     /* FIXME: Legacy configuration syntax. */
     if (strcasecmp ("Carbon", ci->key) != 0)
@@ -458,9 +1149,6 @@ static int wg_config_node (oconfig_item_t *ci)
         }
     }
 
-    pthread_mutex_init (&cb->send_lock, /* attr = */ NULL);
-    C_COMPLAIN_INIT (&cb->init_complaint);
-
     for (i = 0; i < ci->children_num; i++)
     {
         oconfig_item_t *child = ci->children + i;
@@ -469,21 +1157,8 @@ static int wg_config_node (oconfig_item_t *ci)
             cf_util_get_string (child, &cb->node);
         else if (strcasecmp ("Port", child->key) == 0)
             cf_util_get_service (child, &cb->service);
-        else if (strcasecmp ("Prefix", child->key) == 0)
-            cf_util_get_string (child, &cb->prefix);
-        else if (strcasecmp ("Postfix", child->key) == 0)
-            cf_util_get_string (child, &cb->postfix);
-        else if (strcasecmp ("StoreRates", child->key) == 0)
-            cf_util_get_flag (child, &cb->format_flags,
-                    GRAPHITE_STORE_RATES);
-        else if (strcasecmp ("SeparateInstances", child->key) == 0)
-            cf_util_get_flag (child, &cb->format_flags,
-                    GRAPHITE_SEPARATE_INSTANCES);
-        else if (strcasecmp ("AlwaysAppendDS", child->key) == 0)
-            cf_util_get_flag (child, &cb->format_flags,
-                    GRAPHITE_ALWAYS_APPEND_DS);
-        else if (strcasecmp ("EscapeCharacter", child->key) == 0)
-            config_set_char (&cb->escape_char, child);
+        else if (wg_config_common (child, cb) == 0)
+            continue;
         else
         {
             ERROR ("write_graphite plugin: Invalid configuration "
@@ -511,6 +1186,162 @@ static int wg_config_node (oconfig_item_t *ci)
     return (0);
 }
 
+/* Destination "host" "port" ["instance"] */
+static int wg_config_destination (oconfig_item_t *ci, struct wg_cluster *cl)
+{
+    struct wg_callback *cb;
+    struct wg_callback **tmp_dest;
+    char **tmp_inst;
+    char port[16];
+    int i;
+
+    if ((ci->values_num < 2) || (ci->values_num > 3))
+    {
+        ERROR ("write_graphite plugin: The \"Destination\" option requires "
+                "a host, a port and an optional instance name.");
+        return (-1);
+    }
+
+    for (i = 0; i < ci->values_num; i++)
+    {
+        if ((ci->values[i].type != OCONFIG_TYPE_STRING)
+                && ((i != 1) || (ci->values[i].type != OCONFIG_TYPE_NUMBER)))
+        {
+            ERROR ("write_graphite plugin: The arguments of the "
+                    "\"Destination\" option must be strings.");
+            return (-1);
+        }
+    }
+
+    if (ci->values[1].type == OCONFIG_TYPE_NUMBER)
+        ssnprintf (port, sizeof (port), "%i",
+                (int) (ci->values[1].value.number + 0.5));
+    else
+        sstrncpy (port, ci->values[1].value.string, sizeof (port));
+
+    tmp_dest = realloc (cl->destinations,
+            (cl->destinations_num + 1) * sizeof (*cl->destinations));
+    if (tmp_dest == NULL)
+        return (-1);
+    cl->destinations = tmp_dest;
+
+    tmp_inst = realloc (cl->instances,
+            (cl->destinations_num + 1) * sizeof (*cl->instances));
+    if (tmp_inst == NULL)
+        return (-1);
+    cl->instances = tmp_inst;
+
+    cb = wg_callback_create ();
+    if (cb == NULL)
+        return (-1);
+
+    cb->node = strdup (ci->values[0].value.string);
+    cb->service = strdup (port);
+    cl->instances[cl->destinations_num] = (ci->values_num == 3)
+        ? strdup (ci->values[2].value.string) : NULL;
+    if ((cb->node == NULL) || (cb->service == NULL)
+            || ((ci->values_num == 3)
+                && (cl->instances[cl->destinations_num] == NULL)))
+    {
+        ERROR ("write_graphite plugin: strdup failed.");
+        sfree (cl->instances[cl->destinations_num]);
+        wg_callback_free (cb);
+        return (-1);
+    }
+
+    cl->destinations[cl->destinations_num] = cb;
+    cl->destinations_num++;
+
+    return (0);
+}
+
+static int wg_config_cluster (oconfig_item_t *ci)
+{
+    struct wg_cluster *cl;
+    user_data_t user_data;
+    char callback_name[DATA_MAX_NAME_LEN];
+    size_t j;
+    int i;
+
+    cl = malloc (sizeof (*cl));
+    if (cl == NULL)
+    {
+        ERROR ("write_graphite plugin: malloc failed.");
+        return (-1);
+    }
+    memset (cl, 0, sizeof (*cl));
+    cl->replication_factor = 1;
+
+    cl->settings = wg_callback_create ();
+    if ((cl->settings == NULL) || (cf_util_get_string (ci, &cl->name) != 0))
+    {
+        wg_cluster_free (cl);
+        return (-1);
+    }
+
+    for (i = 0; i < ci->children_num; i++)
+    {
+        oconfig_item_t *child = ci->children + i;
+
+        if (strcasecmp ("Destination", child->key) == 0)
+            wg_config_destination (child, cl);
+        else if (strcasecmp ("ReplicationFactor", child->key) == 0)
+            cf_util_get_int (child, &cl->replication_factor);
+        else if (wg_config_common (child, cl->settings) == 0)
+            continue;
+        else
+        {
+            ERROR ("write_graphite plugin: Invalid configuration "
+                        "option: %s.", child->key);
+        }
+    }
+
+    if (cl->destinations_num == 0)
+    {
+        ERROR ("write_graphite plugin: Cluster \"%s\" has no destinations.",
+                cl->name);
+        wg_cluster_free (cl);
+        return (-1);
+    }
+
+    if (cl->replication_factor < 1)
+        cl->replication_factor = 1;
+    if ((size_t) cl->replication_factor > cl->destinations_num)
+    {
+        WARNING ("write_graphite plugin: Cluster \"%s\": The replication "
+                "factor (%i) is larger than the number of destinations "
+                "(%zu).", cl->name, cl->replication_factor,
+                cl->destinations_num);
+        cl->replication_factor = (int) cl->destinations_num;
+    }
+
+    for (j = 0; j < cl->destinations_num; j++)
+    {
+        cl->destinations[j]->queue_limit = cl->settings->queue_limit;
+        cl->destinations[j]->reconnect_interval_max =
+            cl->settings->reconnect_interval_max;
+    }
+
+    if (wg_ring_build (cl) != 0)
+    {
+        wg_cluster_free (cl);
+        return (-1);
+    }
+
+    ssnprintf (callback_name, sizeof (callback_name), "write_graphite/%s",
+            cl->name);
+
+    memset (&user_data, 0, sizeof (user_data));
+    user_data.data = cl;
+    user_data.free_func = wg_cluster_free;
+    plugin_register_write (callback_name, wg_cluster_write, &user_data);
+
+    user_data.free_func = NULL;
+    plugin_register_flush (callback_name, wg_cluster_flush, &user_data);
+
+    return (0);
+}
+
 static int wg_config (oconfig_item_t *ci)
 {
     int i;
@@ -521,6 +1352,8 @@ static int wg_config (oconfig_item_t *ci)
 
         if (strcasecmp ("Node", child->key) == 0)
             wg_config_node (child);
+        else if (strcasecmp ("Cluster", child->key) == 0)
+            wg_config_cluster (child);
         /* FIXME: Remove this legacy mode in version 6. */
         else if (strcasecmp ("Carbon", child->key) == 0)
             wg_config_node (child);
@@ -0,0 +1,295 @@
+/**
+ * collectd - src/write_graphite_test.c
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   agent <agent at local>
+ **/
+
+/*
+ * Checks the consistent hashing ring of the write_graphite plugin against
+ * Carbon's "ConsistentHashRing". The expected values below were computed with
+ * Carbon's implementation: the first four hex digits of the MD5 sum of
+ * "('server', 'instance'):replica", 100 replicas per node and bisect_left to
+ * look up keys.
+ */
+
+#include "write_graphite.c"
+
+static int failures = 0;
+
+/*
+ * Stubs for the daemon functions used by the plugin. Only the ring is
+ * tested, so the registration and configuration functions are never called.
+ */
+void plugin_log (int level, const char *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  printf ("[severity %i] ", level);
+  va_start (ap, format);
+  vprintf (format, ap);
+  va_end (ap);
+  printf ("\n");
+} /* }}} void plugin_log */
+
+int plugin_register_complex_config (const char *type,
+    int (*callback) (oconfig_item_t *))
+{
+  return (-1);
+}
+
+int plugin_register_write (const char *name,
+    plugin_write_cb callback, user_data_t *user_data)
+{
+  return (-1);
+}
+
+int plugin_register_flush (const char *name,
+    plugin_flush_cb callback, user_data_t *user_data)
+{
+  return (-1);
+}
+
+int plugin_thread_create (pthread_t *thread, const pthread_attr_t *attr,
+    void *(*start_routine) (void *), void *arg)
+{
+  return (-1);
+}
+
+cdtime_t plugin_get_interval (void)
+{
+  return (TIME_T_TO_CDTIME_T (10));
+}
+
+gauge_t *uc_get_rate (const data_set_t *ds, const value_list_t *vl)
+{
+  return (NULL);
+}
+
+int cf_util_get_string (const oconfig_item_t *ci, char **ret_string)
+{
+  return (-1);
+}
+
+int cf_util_get_string_buffer (const oconfig_item_t *ci, char *buffer,
+    size_t buffer_size)
+{
+  return (-1);
+}
+
+int cf_util_get_int (const oconfig_item_t *ci, int *ret_value)
+{
+  return (-1);
+}
+
+int cf_util_get_flag (const oconfig_item_t *ci,
+    unsigned int *ret_value, unsigned int flag)
+{
+  return (-1);
+}
+
+int cf_util_get_service (const oconfig_item_t *ci, char **ret_string)
+{
+  return (-1);
+}
+
+int cf_util_get_cdtime (const oconfig_item_t *ci, cdtime_t *ret_value)
+{
+  return (-1);
+}
+
+/*
+ * Test data
+ */
+static char *nodes[] = { "127.0.0.1", "127.0.0.1", "carbon.example.com" };
+static char *instances[] = { "a", "b", NULL };
+
+/* The ring of the nodes above, as (position, node index). Two replicas of
+ * the third node hash to 52062; the one added later is moved to 52063. */
+static struct wg_ring_entry expected_ring[] = {
+  {   398, 0 }, {   474, 0 }, {  1167, 2 }, {  1884, 1 }, {  2138, 1 },
+  {  2153, 0 }, {  2318, 1 }, {  2404, 1 }, {  3044, 2 }, {  3127, 1 },
+  {  3584, 0 }, {  3722, 2 }, {  4012, 2 }, {  4101, 1 }, {  4181, 0 },
+  {  4205, 0 }, {  4243, 0 }, {  4618, 0 }, {  4740, 1 }, {  5453, 0 },
+  {  5563, 2 }, {  5983, 2 }, {  6435, 1 }, {  6544, 1 }, {  6861, 1 },
+  {  7292, 2 }, {  7721, 0 }, {  7885, 0 }, {  8119, 2 }, {  8240, 2 },
+  {  8248, 1 }, {  9364, 2 }, {  9559, 0 }, {  9560, 2 }, {  9579, 1 },
+  {  9657, 2 }, {  9847, 0 }, {  9871, 1 }, {  9899, 2 }, { 10004, 0 },
+  { 10113, 1 }, { 10226, 0 }, { 10302, 0 }, { 10339, 0 }, { 10357, 1 },
+  { 10428, 2 }, { 10461, 1 }, { 10481, 1 }, { 11022, 0 }, { 11439, 1 },
+  { 11521, 0 }, { 11585, 2 }, { 12225, 1 }, { 12295, 1 }, { 12657, 1 },
+  { 13246, 2 }, { 13306, 2 }, { 13744, 2 }, { 13779, 0 }, { 14290, 2 },
+  { 14314, 1 }, { 14809, 0 }, { 14844, 2 }, { 15006, 2 }, { 15597, 0 },
+  { 15617, 1 }, { 15715, 0 }, { 15938, 1 }, { 15981, 1 }, { 16152, 1 },
+  { 16176, 0 }, { 16355, 1 }, { 16495, 2 }, { 16592, 0 }, { 16743, 0 },
+  { 16828, 0 }, { 16850, 2 }, { 16875, 2 }, { 18225, 1 }, { 18416, 2 },
+  { 18448, 0 }, { 18527, 2 }, { 18887, 1 }, { 19006, 1 }, { 19096, 0 },
+  { 19432, 1 }, { 19446, 2 }, { 19835, 0 }, { 20014, 2 }, { 20261, 0 },
+  { 20366, 2 }, { 20516, 1 }, { 20746, 0 }, { 21313, 0 }, { 21974, 2 },
+  { 22029, 0 }, { 22191, 2 }, { 23339, 1 }, { 23349, 0 }, { 23632, 0 },
+  { 23846, 1 }, { 24043, 0 }, { 24325, 1 }, { 25354, 1 }, { 26244, 1 },
+  { 26406, 0 }, { 26471, 2 }, { 27588, 0 }, { 27669, 2 }, { 28388, 2 },
+  { 28614, 2 }, { 28762, 1 }, { 29033, 2 }, { 29161, 2 }, { 29304, 0 },
+  { 29652, 1 }, { 29897, 2 }, { 29899, 1 }, { 29904, 0 }, { 29961, 0 },
+  { 30018, 1 }, { 30043, 0 }, { 30045, 2 }, { 30232, 1 }, { 30567, 0 },
+  { 30784, 1 }, { 30885, 2 }, { 30940, 2 }, { 30951, 1 }, { 30989, 2 },
+  { 31786, 2 }, { 31805, 1 }, { 32216, 0 }, { 32388, 1 }, { 32578, 2 },
+  { 32804, 1 }, { 32987, 2 }, { 33006, 0 }, { 33141, 2 }, { 33191, 1 },
+  { 33260, 2 }, { 33406, 0 }, { 33780, 2 }, { 34053, 2 }, { 34142, 0 },
+  { 34576, 0 }, { 35290, 0 }, { 35514, 0 }, { 36091, 0 }, { 36187, 2 },
+  { 36526, 0 }, { 37733, 1 }, { 37759, 0 }, { 37931, 2 }, { 37949, 2 },
+  { 38420, 0 }, { 38845, 1 }, { 38951, 2 }, { 39163, 1 }, { 39517, 2 },
+  { 39718, 1 }, { 39735, 1 }, { 39809, 1 }, { 39844, 2 }, { 39860, 1 },
+  { 40292, 0 }, { 40613, 2 }, { 40673, 2 }, { 40973, 0 }, { 40999, 2 },
+  { 41114, 1 }, { 41165, 2 }, { 41319, 1 }, { 41453, 1 }, { 41723, 0 },
+  { 42234, 1 }, { 42275, 0 }, { 42343, 2 }, { 42439, 2 }, { 42603, 0 },
+  { 43028, 2 }, { 43140, 2 }, { 43402, 0 }, { 43816, 1 }, { 43938, 1 },
+  { 44055, 2 }, { 44262, 2 }, { 44453, 2 }, { 45034, 0 }, { 45424, 0 },
+  { 45492, 0 }, { 45573, 0 }, { 45819, 1 }, { 45837, 0 }, { 45933, 2 },
+  { 46713, 0 }, { 47083, 0 }, { 47257, 0 }, { 47601, 0 }, { 47767, 1 },
+  { 47941, 1 }, { 47943, 0 }, { 48759, 1 }, { 48782, 1 }, { 48983, 2 },
+  { 49002, 2 }, { 49162, 1 }, { 49203, 0 }, { 49293, 2 }, { 49385, 0 },
+  { 49570, 2 }, { 49728, 2 }, { 49940, 1 }, { 51064, 1 }, { 51149, 0 },
+  { 51375, 2 }, { 51404, 0 }, { 51553, 1 }, { 51597, 1 }, { 51751, 2 },
+  { 52062, 2 }, { 52063, 2 }, { 52089, 0 }, { 52355, 0 }, { 52553, 1 },
+  { 52721, 1 }, { 52912, 1 }, { 53096, 2 }, { 53111, 1 }, { 53220, 1 },
+  { 53312, 0 }, { 53463, 0 }, { 53613, 2 }, { 53619, 2 }, { 53727, 0 },
+  { 53803, 2 }, { 53840, 0 }, { 53860, 1 }, { 53970, 2 }, { 54295, 1 },
+  { 54378, 2 }, { 54495, 0 }, { 54850, 0 }, { 54883, 2 }, { 55183, 0 },
+  { 55276, 0 }, { 55811, 1 }, { 56236, 2 }, { 56470, 1 }, { 56507, 1 },
+  { 56671, 1 }, { 56743, 1 }, { 56784, 2 }, { 56869, 1 }, { 56882, 1 },
+  { 56921, 2 }, { 57030, 2 }, { 57312, 1 }, { 57433, 1 }, { 57494, 1 },
+  { 57511, 1 }, { 57767, 0 }, { 57807, 0 }, { 57902, 0 }, { 58033, 0 },
+  { 58084, 0 }, { 58214, 2 }, { 58380, 0 }, { 58421, 0 }, { 59133, 2 },
+  { 59285, 1 }, { 59327, 1 }, { 60038, 1 }, { 60041, 2 }, { 60123, 2 },
+  { 60755, 1 }, { 60791, 2 }, { 60935, 1 }, { 61291, 2 }, { 61299, 2 },
+  { 61577, 1 }, { 62218, 0 }, { 62302, 2 }, { 62486, 1 }, { 62581, 2 },
+  { 62938, 0 }, { 62946, 1 }, { 63106, 0 }, { 63219, 0 }, { 63454, 1 },
+  { 63549, 0 }, { 63687, 2 }, { 64095, 0 }, { 64102, 0 }, { 64116, 0 },
+  { 64190, 1 }, { 64202, 2 }, { 64408, 1 }, { 64989, 2 }, { 65151, 2 }
+};
+
+/* Keys and the node Carbon maps them to. */
+static struct
+{
+  char const *key;
+  uint16_t position;
+  size_t index;
+  size_t node;
+} expected_keys[] = {
+  { "collectd.example_com.load.load.shortterm", 17152,  78, 1 },
+  { "collectd.example_com.cpu-0.cpu-idle",      11858,  52, 1 },
+  { "collectd.example_com.memory.memory-used",  24315, 102, 1 },
+  { "foo",                                      44221, 186, 2 },
+  { "bar.baz",                                  13582,  57, 2 },
+  { "a",                                         3265,  10, 0 },
+  /* Same position as a ring entry: the entry itself is used. */
+  { "tie.134",                                   4618,  17, 0 },
+  /* Beyond the last ring entry: wraps around to the first one. */
+  { "wrap.315",                                 65249,   0, 0 }
+};
+
+static void test_ring (void) /* {{{ */
+{
+  struct wg_callback destinations[STATIC_ARRAY_SIZE (nodes)];
+  struct wg_callback *destination_ptrs[STATIC_ARRAY_SIZE (nodes)];
+  struct wg_cluster cl;
+  size_t i;
+
+  memset (destinations, 0, sizeof (destinations));
+  memset (&cl, 0, sizeof (cl));
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (nodes); i++)
+  {
+    destinations[i].node = nodes[i];
+    destination_ptrs[i] = destinations + i;
+  }
+
+  cl.destinations = destination_ptrs;
+  cl.instances = instances;
+  cl.destinations_num = STATIC_ARRAY_SIZE (nodes);
+
+  if (wg_ring_build (&cl) != 0)
+  {
+    printf ("wg_ring_build failed\n");
+    failures++;
+    return;
+  }
+
+  if (cl.ring_num != STATIC_ARRAY_SIZE (expected_ring))
+  {
+    printf ("ring holds %zu entries, expected %zu\n",
+        cl.ring_num, STATIC_ARRAY_SIZE (expected_ring));
+    failures++;
+  }
+
+  for (i = 0; (i < cl.ring_num) && (i < STATIC_ARRAY_SIZE (expected_ring)); i++)
+  {
+    if ((cl.ring[i].position == expected_ring[i].position)
+        && (cl.ring[i].destination == expected_ring[i].destination))
+      continue;
+
+    printf ("ring entry %zu is (%"PRIu32", %zu), expected (%"PRIu32", %zu)\n",
+        i, cl.ring[i].position, cl.ring[i].destination,
+        expected_ring[i].position, expected_ring[i].destination);
+    failures++;
+  }
+
+  for (i = 0; i < STATIC_ARRAY_SIZE (expected_keys); i++)
+  {
+    char const *key = expected_keys[i].key;
+    uint16_t position = wg_ring_position (key, strlen (key));
+    size_t index = wg_ring_lookup (&cl, key, strlen (key));
+
+    if (position != expected_keys[i].position)
+    {
+      printf ("\"%s\": position %"PRIu16", expected %"PRIu16"\n",
+          key, position, expected_keys[i].position);
+      failures++;
+    }
+
+    if (index != expected_keys[i].index)
+    {
+      printf ("\"%s\": ring index %zu, expected %zu\n",
+          key, index, expected_keys[i].index);
+      failures++;
+    }
+    else if (cl.ring[index].destination != expected_keys[i].node)
+    {
+      printf ("\"%s\": node %zu, expected %zu\n",
+          key, cl.ring[index].destination, expected_keys[i].node);
+      failures++;
+    }
+  }
+
+  sfree (cl.ring);
+} /* }}} void test_ring */
+
+int main (void) /* {{{ */
+{
+  test_ring ();
+
+  if (failures != 0)
+  {
+    printf ("%i checks failed.\n", failures);
+    return (EXIT_FAILURE);
+  }
+
+  return (EXIT_SUCCESS);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -3,6 +3,7 @@
  * Copyright (C) 2009       Paul Sadauskas
  * Copyright (C) 2009       Doug MacEachern
  * Copyright (C) 2007-2009  Florian octo Forster
+ * Copyright (C) 2026       agent
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
@@ -21,12 +22,14 @@
  *   Florian octo Forster <octo at verplant.org>
  *   Doug MacEachern <dougm@hyperic.com>
  *   Paul Sadauskas <psadauskas@gmail.com>
+ *   agent <agent at local>
  **/
 
 #include "collectd.h"
 #include "plugin.h"
 #include "common.h"
 #include "utils_cache.h"
+#include "utils_complain.h"
 #include "utils_parse_option.h"
 #include "utils_format_json.h"
 
@@ -34,11 +37,68 @@
 # include <pthread.h>
 #endif
 
+#if HAVE_LIBZ
+# include <zlib.h>
+#endif
+
 #include <curl/curl.h>
+#include <poll.h>
+
+/* curl_multi_wait() has been added in libcurl 7.28.0. Older versions perform
+ * the requests one after another with curl_easy_perform(). */
+#if LIBCURL_VERSION_NUM >= 0x071c00
+# define WH_HAVE_MULTI_WAIT 1
+#else
+# define WH_HAVE_MULTI_WAIT 0
+#endif
+
+#ifndef WH_DEFAULT_BUFFER_SIZE
+# define WH_DEFAULT_BUFFER_SIZE 4096
+#endif
+
+#ifndef WH_DEFAULT_MAX_REQUESTS
+# define WH_DEFAULT_MAX_REQUESTS 4
+#endif
+
+#ifndef WH_DEFAULT_BACKLOG_LIMIT
+# define WH_DEFAULT_BACKLOG_LIMIT (1024 * 1024)
+#endif
+
+#ifndef WH_DEFAULT_MAX_RETRIES
+# define WH_DEFAULT_MAX_RETRIES 5
+#endif
+
+#define WH_RETRY_INTERVAL_MIN TIME_T_TO_CDTIME_T (1)
+#define WH_RETRY_INTERVAL_MAX TIME_T_TO_CDTIME_T (60)
+
+/* Time the event thread waits for outstanding requests on shutdown. */
+#define WH_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T (10)
 
 /*
  * Private variables
  */
+
+/* A batch is one complete (and possibly compressed) request body. */
+struct wh_batch_s;
+typedef struct wh_batch_s wh_batch_t;
+struct wh_batch_s
+{
+        wh_batch_t *next;
+        int retries;
+        cdtime_t not_before;
+
+        size_t size;
+        char data[];
+};
+
+struct wh_request_s
+{
+        CURL *curl;
+        wh_batch_t *batch; /* NULL if the handle is idle */
+        char curl_errbuf[CURL_ERROR_SIZE];
+};
+typedef struct wh_request_s wh_request_t;
+
 struct wh_callback_s
 {
         char *location;
@@ -50,27 +110,52 @@ struct wh_callback_s
         int   verify_host;
         char *cacert;
         int   store_rates;
+        int   compress;
 
 #define WH_FORMAT_COMMAND 0
 #define WH_FORMAT_JSON    1
         int format;
 
-        CURL *curl;
-        char curl_errbuf[CURL_ERROR_SIZE];
+        /* Owned by the event thread once it has been started. */
+        CURLM *multi;
+        struct curl_slist *headers;
+        wh_request_t *requests;
+        int requests_num;
 
-        char   send_buffer[4096];
+        int max_retries;
+
+        char  *send_buffer;
+        size_t send_buffer_size;
         size_t send_buffer_free;
         size_t send_buffer_fill;
         cdtime_t send_buffer_init_time;
 
+        /* Batches waiting for a free request handle. Retried batches are put
+         * back at the head, so the queue is roughly in order. Batches whose
+         * retry time hasn't come yet are skipped, so they don't hold up newer
+         * batches. */
+        wh_batch_t *queue_head;
+        wh_batch_t *queue_tail;
+        size_t queue_size;
+        size_t queue_limit;
+
+        pthread_t event_thread;
+        _Bool event_thread_running;
+        _Bool event_thread_shutdown;
+        /* Written to by write threads to wake up the event thread. */
+        int wakeup_pipe[2];
+
+        c_complain_t init_complaint;
+        c_complain_t queue_complaint;
+
         pthread_mutex_t send_lock;
 };
 typedef struct wh_callback_s wh_callback_t;
 
 static void wh_reset_buffer (wh_callback_t *cb)  /* {{{ */
 {
-        memset (cb->send_buffer, 0, sizeof (cb->send_buffer));
-        cb->send_buffer_free = sizeof (cb->send_buffer);
+        memset (cb->send_buffer, 0, cb->send_buffer_size);
+        cb->send_buffer_free = cb->send_buffer_size;
         cb->send_buffer_fill = 0;
         cb->send_buffer_init_time = cdtime ();
 
@@ -82,51 +167,477 @@ static void wh_reset_buffer (wh_callback_t *cb)  /* {{{ */
         }
 } /* }}} wh_reset_buffer */
 
+static void wh_wakeup (wh_callback_t *cb) /* {{{ */
+{
+        char c = 0;
+
+        /* If the pipe is full, the event thread is going to wake up anyway. */
+        if (write (cb->wakeup_pipe[1], &c, sizeof (c)) < 0)
+        {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                {
+                        char errbuf[1024];
+                        ERROR ("write_http plugin: write(2) to the wakeup "
+                                        "pipe failed: %s",
+                                        sstrerror (errno, errbuf, sizeof (errbuf)));
+                }
+        }
+} /* }}} void wh_wakeup */
+
+static void wh_free_batches (wh_batch_t *b) /* {{{ */
+{
+        while (b != NULL)
+        {
+                wh_batch_t *next = b->next;
+                sfree (b);
+                b = next;
+        }
+} /* }}} void wh_free_batches */
+
+/* Drops the oldest batches until the backlog is within its limit. */
+static void wh_queue_trim_nolock (wh_callback_t *cb) /* {{{ */
+{
+        size_t dropped = 0;
+
+        while ((cb->queue_size > cb->queue_limit) && (cb->queue_head != NULL))
+        {
+                wh_batch_t *b = cb->queue_head;
+
+                cb->queue_head = b->next;
+                if (cb->queue_head == NULL)
+                        cb->queue_tail = NULL;
+                cb->queue_size -= b->size;
+                dropped += b->size;
+                sfree (b);
+        }
+
+        if (dropped > 0)
+                c_complain (LOG_WARNING, &cb->queue_complaint,
+                                "write_http plugin: <%s>: The backlog is "
+                                "full; dropping the oldest data (%zu bytes).",
+                                cb->location, dropped);
+} /* }}} void wh_queue_trim_nolock */
+
+#if HAVE_LIBZ
+static wh_batch_t *wh_batch_create_gzip (char const *data, /* {{{ */
+                size_t size)
+{
+        wh_batch_t *b;
+        z_stream z;
+        size_t bound;
+        int status;
+
+        memset (&z, 0, sizeof (z));
+        /* windowBits + 16 produces a gzip header instead of a zlib header. */
+        status = deflateInit2 (&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        /* windowBits = */ 15 + 16, /* memLevel = */ 8,
+                        Z_DEFAULT_STRATEGY);
+        if (status != Z_OK)
+        {
+                ERROR ("write_http plugin: deflateInit2 failed with status %i.",
+                                status);
+                return (NULL);
+        }
+
+        /* deflateBound() does not account for the gzip header and trailer. */
+        bound = deflateBound (&z, (uLong) size) + 18;
+        b = malloc (sizeof (*b) + bound);
+        if (b == NULL)
+        {
+                deflateEnd (&z);
+                return (NULL);
+        }
+        memset (b, 0, sizeof (*b));
+
+        z.next_in = (Bytef *) data;
+        z.avail_in = (uInt) size;
+        z.next_out = (Bytef *) b->data;
+        z.avail_out = (uInt) bound;
+
+        status = deflate (&z, Z_FINISH);
+        if (status != Z_STREAM_END)
+        {
+                ERROR ("write_http plugin: deflate failed with status %i.",
+                                status);
+                deflateEnd (&z);
+                sfree (b);
+                return (NULL);
+        }
+
+        b->size = bound - z.avail_out;
+        deflateEnd (&z);
+
+        return (b);
+} /* }}} wh_batch_t *wh_batch_create_gzip */
+#endif
+
+/* Moves the contents of the send buffer into a new batch at the end of the
+ * queue. The event thread picks it up from there. */
 static int wh_send_buffer (wh_callback_t *cb) /* {{{ */
 {
-        int status = 0;
+        wh_batch_t *b;
 
-        curl_easy_setopt (cb->curl, CURLOPT_POSTFIELDS, cb->send_buffer);
-        status = curl_easy_perform (cb->curl);
-        if (status != 0)
+#if HAVE_LIBZ
+        if (cb->compress)
+                b = wh_batch_create_gzip (cb->send_buffer,
+                                cb->send_buffer_fill);
+        else
+#endif
         {
-                ERROR ("write_http plugin: curl_easy_perform failed with "
-                                "status %i: %s",
-                                status, cb->curl_errbuf);
+                b = malloc (sizeof (*b) + cb->send_buffer_fill);
+                if (b != NULL)
+                {
+                        memset (b, 0, sizeof (*b));
+                        memcpy (b->data, cb->send_buffer, cb->send_buffer_fill);
+                        b->size = cb->send_buffer_fill;
+                }
         }
-        return (status);
+
+        if (b == NULL)
+        {
+                ERROR ("write_http plugin: Creating a batch of %zu bytes "
+                                "failed.", cb->send_buffer_fill);
+                return (-1);
+        }
+
+        if (cb->queue_tail == NULL)
+                cb->queue_head = b;
+        else
+                cb->queue_tail->next = b;
+        cb->queue_tail = b;
+        cb->queue_size += b->size;
+
+        wh_queue_trim_nolock (cb);
+        wh_wakeup (cb);
+
+        return (0);
 } /* }}} wh_send_buffer */
 
-static int wh_callback_init (wh_callback_t *cb) /* {{{ */
+/* Returns non-zero if a request with the given result should be retried. */
+static _Bool wh_should_retry (CURLcode result, long response_code) /* {{{ */
 {
-        struct curl_slist *headers;
+        if (result != CURLE_OK)
+                return (1);
+
+        /* Server errors, "Request Timeout" and "Too Many Requests" are
+         * temporary. Other client errors are not going to go away. */
+        return ((response_code >= 500)
+                        || (response_code == 408)
+                        || (response_code == 429));
+} /* }}} _Bool wh_should_retry */
+
+static void wh_request_done (wh_callback_t *cb, /* {{{ */
+                wh_request_t *req, CURLcode result)
+{
+        wh_batch_t *b = req->batch;
+        long response_code = 0;
 
-        if (cb->curl != NULL)
-                return (0);
+#if WH_HAVE_MULTI_WAIT
+        curl_multi_remove_handle (cb->multi, req->curl);
+#endif
+        req->batch = NULL;
 
-        cb->curl = curl_easy_init ();
-        if (cb->curl == NULL)
+        if (result == CURLE_OK)
         {
-                ERROR ("curl plugin: curl_easy_init failed.");
-                return (-1);
+                curl_easy_getinfo (req->curl, CURLINFO_RESPONSE_CODE,
+                                &response_code);
+                if ((response_code >= 200) && (response_code < 300))
+                {
+                        sfree (b);
+                        return;
+                }
+        }
+
+        pthread_mutex_lock (&cb->send_lock);
+
+        if (!wh_should_retry (result, response_code)
+                        || (b->retries >= cb->max_retries)
+                        || cb->event_thread_shutdown)
+        {
+                if (result != CURLE_OK)
+                        ERROR ("write_http plugin: <%s>: Dropping %zu bytes "
+                                        "after %i attempt(s): %s",
+                                        cb->location, b->size, b->retries + 1,
+                                        req->curl_errbuf);
+                else
+                        ERROR ("write_http plugin: <%s>: Dropping %zu bytes "
+                                        "after %i attempt(s): Server "
+                                        "responded with status %li.",
+                                        cb->location, b->size, b->retries + 1,
+                                        response_code);
+                pthread_mutex_unlock (&cb->send_lock);
+                sfree (b);
+                return;
         }
 
-        curl_easy_setopt (cb->curl, CURLOPT_NOSIGNAL, 1L);
-        curl_easy_setopt (cb->curl, CURLOPT_USERAGENT, PACKAGE_NAME"/"PACKAGE_VERSION);
+        /* Exponential backoff: 1, 2, 4, ... seconds. */
+        b->not_before = cdtime () + ((b->retries < 6)
+                        ? (WH_RETRY_INTERVAL_MIN << b->retries)
+                        : WH_RETRY_INTERVAL_MAX);
+        b->retries++;
+
+        if (result != CURLE_OK)
+                WARNING ("write_http plugin: <%s>: Request failed, will "
+                                "retry (attempt %i of %i): %s",
+                                cb->location, b->retries, cb->max_retries,
+                                req->curl_errbuf);
+        else
+                WARNING ("write_http plugin: <%s>: Server responded with "
+                                "status %li, will retry (attempt %i of %i).",
+                                cb->location, response_code,
+                                b->retries, cb->max_retries);
+
+        b->next = cb->queue_head;
+        cb->queue_head = b;
+        if (cb->queue_tail == NULL)
+                cb->queue_tail = b;
+        cb->queue_size += b->size;
+        wh_queue_trim_nolock (cb);
 
-        headers = NULL;
-        headers = curl_slist_append (headers, "Accept:  */*");
-        if (cb->format == WH_FORMAT_JSON)
-                headers = curl_slist_append (headers, "Content-Type: application/json");
+        pthread_mutex_unlock (&cb->send_lock);
+} /* }}} void wh_request_done */
+
+/* Removes the oldest batch which may be sent at `now' from the queue. Returns
+ * NULL if all batches are waiting for their retry time. */
+static wh_batch_t *wh_queue_take_nolock (wh_callback_t *cb, /* {{{ */
+                cdtime_t now)
+{
+        wh_batch_t *prev = NULL;
+        wh_batch_t *b;
+
+        for (b = cb->queue_head; b != NULL; prev = b, b = b->next)
+                if (b->not_before <= now)
+                        break;
+
+        if (b == NULL)
+                return (NULL);
+
+        if (prev == NULL)
+                cb->queue_head = b->next;
         else
-                headers = curl_slist_append (headers, "Content-Type: text/plain");
-        headers = curl_slist_append (headers, "Expect:");
-        curl_easy_setopt (cb->curl, CURLOPT_HTTPHEADER, headers);
+                prev->next = b->next;
+        if (cb->queue_tail == b)
+                cb->queue_tail = prev;
+        cb->queue_size -= b->size;
+        b->next = NULL;
+
+        return (b);
+} /* }}} wh_batch_t *wh_queue_take_nolock */
+
+/* Returns the earliest time at which a queued batch may be sent, or zero if
+ * the queue is empty. */
+static cdtime_t wh_queue_next_nolock (wh_callback_t *cb) /* {{{ */
+{
+        cdtime_t next = 0;
+        wh_batch_t *b;
+
+        for (b = cb->queue_head; b != NULL; b = b->next)
+                if ((next == 0) || (b->not_before < next))
+                        next = b->not_before;
+
+        return (next);
+} /* }}} cdtime_t wh_queue_next_nolock */
+
+/* Hands queued batches to idle request handles. Returns the number of
+ * requests that are in flight afterwards. */
+static int wh_start_requests_nolock (wh_callback_t *cb, /* {{{ */
+                cdtime_t now)
+{
+        int busy = 0;
+        int i;
+
+        for (i = 0; i < cb->requests_num; i++)
+        {
+                wh_request_t *req = cb->requests + i;
+                wh_batch_t *b;
+
+                if (req->batch != NULL)
+                {
+                        busy++;
+                        continue;
+                }
+
+                b = wh_queue_take_nolock (cb, now);
+                if (b == NULL)
+                        continue;
+
+                req->batch = b;
+                req->curl_errbuf[0] = 0;
+                curl_easy_setopt (req->curl, CURLOPT_POSTFIELDS, (char *) b->data);
+                curl_easy_setopt (req->curl, CURLOPT_POSTFIELDSIZE,
+                                (long) b->size);
+#if WH_HAVE_MULTI_WAIT
+                curl_multi_add_handle (cb->multi, req->curl);
+#endif
+                busy++;
+        }
 
-        curl_easy_setopt (cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-        curl_easy_setopt (cb->curl, CURLOPT_URL, cb->location);
+        return (busy);
+} /* }}} int wh_start_requests_nolock */
 
-        if (cb->user != NULL)
+#if WH_HAVE_MULTI_WAIT
+/* Runs the started requests until one of them finishes, the event thread is
+ * woken up or `timeout_ms' have passed. */
+static void wh_perform (wh_callback_t *cb, long timeout_ms) /* {{{ */
+{
+        struct curl_waitfd wfd;
+        CURLMsg *msg;
+        int running = 0;
+        int msgs_left;
+
+        curl_multi_perform (cb->multi, &running);
+        while ((msg = curl_multi_info_read (cb->multi, &msgs_left)) != NULL)
+        {
+                wh_request_t *req = NULL;
+
+                if (msg->msg != CURLMSG_DONE)
+                        continue;
+
+                curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE,
+                                (char **) &req);
+                /* `msg' is invalidated by removing the handle. */
+                wh_request_done (cb, req, msg->data.result);
+        }
+
+        if (running > 0)
+        {
+                long curl_timeout = -1;
+
+                curl_multi_timeout (cb->multi, &curl_timeout);
+                if ((curl_timeout >= 0) && (curl_timeout < timeout_ms))
+                        timeout_ms = curl_timeout;
+        }
+
+        memset (&wfd, 0, sizeof (wfd));
+        wfd.fd = cb->wakeup_pipe[0];
+        wfd.events = CURL_WAIT_POLLIN;
+        curl_multi_wait (cb->multi, &wfd, 1, (int) timeout_ms, NULL);
+} /* }}} void wh_perform */
+#else
+/* Performs the started requests one after another. If there are none, waits
+ * until the event thread is woken up or `timeout_ms' have passed. */
+static void wh_perform (wh_callback_t *cb, long timeout_ms) /* {{{ */
+{
+        struct pollfd pfd;
+        int performed = 0;
+        int i;
+
+        for (i = 0; i < cb->requests_num; i++)
+        {
+                wh_request_t *req = cb->requests + i;
+
+                if (req->batch == NULL)
+                        continue;
+
+                wh_request_done (cb, req, curl_easy_perform (req->curl));
+                performed++;
+        }
+
+        if (performed > 0)
+                return;
+
+        memset (&pfd, 0, sizeof (pfd));
+        pfd.fd = cb->wakeup_pipe[0];
+        pfd.events = POLLIN;
+        poll (&pfd, 1, (int) timeout_ms);
+} /* }}} void wh_perform */
+#endif
+
+static void *wh_event_thread (void *arg) /* {{{ */
+{
+        wh_callback_t *cb = arg;
+        cdtime_t shutdown_deadline = 0;
+
+        pthread_mutex_lock (&cb->send_lock);
+        while (42)
+        {
+                cdtime_t now = cdtime ();
+                cdtime_t next;
+                long timeout_ms = 1000;
+                int busy;
+                char drain[64];
+
+                busy = wh_start_requests_nolock (cb, now);
+                next = wh_queue_next_nolock (cb);
+
+                if (cb->event_thread_shutdown)
+                {
+                        if (shutdown_deadline == 0)
+                                shutdown_deadline = now + WH_SHUTDOWN_TIMEOUT;
+
+                        /* Retried batches are not sent when shutting down,
+                         * so an empty queue and no requests means we're
+                         * done. */
+                        if ((busy == 0) && ((next == 0) || (next > now)))
+                                break;
+
+                        if (now >= shutdown_deadline)
+                        {
+                                WARNING ("write_http plugin: <%s>: Giving up "
+                                                "on %i outstanding request(s) "
+                                                "on shutdown.",
+                                                cb->location, busy);
+                                break;
+                        }
+                }
+
+                /* Sleep until the first retry is due. */
+                if ((busy < cb->requests_num) && (next != 0))
+                {
+                        cdtime_t delay = (next > now) ? next - now : 0;
+                        if (CDTIME_T_TO_MS (delay) < timeout_ms)
+                                timeout_ms = (long) CDTIME_T_TO_MS (delay);
+                }
+                pthread_mutex_unlock (&cb->send_lock);
+
+                wh_perform (cb, timeout_ms);
+
+                while (read (cb->wakeup_pipe[0], drain, sizeof (drain)) > 0)
+                        /* drain */;
+
+                pthread_mutex_lock (&cb->send_lock);
+        }
+        pthread_mutex_unlock (&cb->send_lock);
+
+        return ((void *) 0);
+} /* }}} void *wh_event_thread */
+
+static int wh_callback_init (wh_callback_t *cb) /* {{{ */
+{
+        int status;
+        int i;
+
+        if (cb->event_thread_running)
+                return (0);
+
+        if (cb->multi == NULL)
+        {
+                cb->multi = curl_multi_init ();
+                if (cb->multi == NULL)
+                {
+                        c_complain (LOG_ERR, &cb->init_complaint,
+                                        "write_http plugin: "
+                                        "curl_multi_init failed.");
+                        return (-1);
+                }
+        }
+
+        if (cb->headers == NULL)
+        {
+                cb->headers = curl_slist_append (cb->headers, "Accept:  */*");
+                if (cb->format == WH_FORMAT_JSON)
+                        cb->headers = curl_slist_append (cb->headers,
+                                        "Content-Type: application/json");
+                else
+                        cb->headers = curl_slist_append (cb->headers,
+                                        "Content-Type: text/plain");
+                if (cb->compress)
+                        cb->headers = curl_slist_append (cb->headers,
+                                        "Content-Encoding: gzip");
+                cb->headers = curl_slist_append (cb->headers, "Expect:");
+        }
+
+        if ((cb->user != NULL) && (cb->credentials == NULL))
         {
                 size_t credentials_size;
 
@@ -137,23 +648,69 @@ static int wh_callback_init (wh_callback_t *cb) /* {{{ */
                 cb->credentials = (char *) malloc (credentials_size);
                 if (cb->credentials == NULL)
                 {
-                        ERROR ("curl plugin: malloc failed.");
+                        ERROR ("write_http plugin: malloc failed.");
                         return (-1);
                 }
 
                 ssnprintf (cb->credentials, credentials_size, "%s:%s",
                                 cb->user, (cb->pass == NULL) ? "" : cb->pass);
-                curl_easy_setopt (cb->curl, CURLOPT_USERPWD, cb->credentials);
-                curl_easy_setopt (cb->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
         }
 
-        curl_easy_setopt (cb->curl, CURLOPT_SSL_VERIFYPEER, (long) cb->verify_peer);
-        curl_easy_setopt (cb->curl, CURLOPT_SSL_VERIFYHOST,
-                        cb->verify_host ? 2L : 0L);
-        if (cb->cacert != NULL)
-                curl_easy_setopt (cb->curl, CURLOPT_CAINFO, cb->cacert);
+        for (i = 0; i < cb->requests_num; i++)
+        {
+                wh_request_t *req = cb->requests + i;
+                CURL *curl;
+
+                if (req->curl != NULL)
+                        continue;
 
-        wh_reset_buffer (cb);
+                curl = curl_easy_init ();
+                if (curl == NULL)
+                {
+                        c_complain (LOG_ERR, &cb->init_complaint,
+                                        "write_http plugin: "
+                                        "curl_easy_init failed.");
+                        return (-1);
+                }
+
+                curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
+                curl_easy_setopt (curl, CURLOPT_USERAGENT, PACKAGE_NAME"/"PACKAGE_VERSION);
+                curl_easy_setopt (curl, CURLOPT_HTTPHEADER, cb->headers);
+                curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, req->curl_errbuf);
+                curl_easy_setopt (curl, CURLOPT_URL, cb->location);
+                curl_easy_setopt (curl, CURLOPT_PRIVATE, (char *) req);
+
+                if (cb->credentials != NULL)
+                {
+                        curl_easy_setopt (curl, CURLOPT_USERPWD, cb->credentials);
+                        curl_easy_setopt (curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+                }
+
+                curl_easy_setopt (curl, CURLOPT_SSL_VERIFYPEER, (long) cb->verify_peer);
+                curl_easy_setopt (curl, CURLOPT_SSL_VERIFYHOST,
+                                cb->verify_host ? 2L : 0L);
+                if (cb->cacert != NULL)
+                        curl_easy_setopt (curl, CURLOPT_CAINFO, cb->cacert);
+
+                req->curl = curl;
+        }
+
+        status = plugin_thread_create (&cb->event_thread, /* attr = */ NULL,
+                        wh_event_thread, cb);
+        if (status != 0)
+        {
+                char errbuf[1024];
+                c_complain (LOG_ERR, &cb->init_complaint,
+                                "write_http plugin: Starting the event thread "
+                                "failed: %s",
+                                sstrerror (errno, errbuf, sizeof (errbuf)));
+                return (-1);
+        }
+        cb->event_thread_running = 1;
+
+        c_release (LOG_INFO, &cb->init_complaint,
+                        "write_http plugin: <%s>: Successfully initialized.",
+                        cb->location);
 
         return (0);
 } /* }}} int wh_callback_init */
@@ -235,7 +792,7 @@ static int wh_flush (cdtime_t timeout, /* {{{ */
 
         pthread_mutex_lock (&cb->send_lock);
 
-        if (cb->curl == NULL)
+        if (!cb->event_thread_running)
         {
                 status = wh_callback_init (cb);
                 if (status != 0)
@@ -255,21 +812,63 @@ static int wh_flush (cdtime_t timeout, /* {{{ */
 static void wh_callback_free (void *data) /* {{{ */
 {
         wh_callback_t *cb;
+        int i;
 
         if (data == NULL)
                 return;
 
         cb = data;
 
-        wh_flush_nolock (/* timeout = */ 0, cb);
+        pthread_mutex_lock (&cb->send_lock);
+        if (cb->event_thread_running)
+                wh_flush_nolock (/* timeout = */ 0, cb);
+        cb->event_thread_shutdown = 1;
+        pthread_mutex_unlock (&cb->send_lock);
+
+        /* The event thread sends the remaining batches before exiting. */
+        if (cb->event_thread_running)
+        {
+                wh_wakeup (cb);
+                pthread_join (cb->event_thread, NULL);
+                cb->event_thread_running = 0;
+        }
+
+        for (i = 0; (cb->requests != NULL) && (i < cb->requests_num); i++)
+        {
+                wh_request_t *req = cb->requests + i;
+
+                if (req->curl == NULL)
+                        continue;
+
+#if WH_HAVE_MULTI_WAIT
+                if (req->batch != NULL)
+                        curl_multi_remove_handle (cb->multi, req->curl);
+#endif
+                curl_easy_cleanup (req->curl);
+                sfree (req->batch);
+        }
+        sfree (cb->requests);
+
+        if (cb->multi != NULL)
+                curl_multi_cleanup (cb->multi);
+        curl_slist_free_all (cb->headers);
+
+        wh_free_batches (cb->queue_head);
 
-        curl_easy_cleanup (cb->curl);
+        if (cb->wakeup_pipe[0] >= 0)
+                close (cb->wakeup_pipe[0]);
+        if (cb->wakeup_pipe[1] >= 0)
+                close (cb->wakeup_pipe[1]);
+
+        sfree (cb->send_buffer);
         sfree (cb->location);
         sfree (cb->user);
         sfree (cb->pass);
         sfree (cb->credentials);
         sfree (cb->cacert);
 
+        pthread_mutex_destroy (&cb->send_lock);
+
         sfree (cb);
 } /* }}} void wh_callback_free */
 
@@ -319,7 +918,7 @@ static int wh_write_command (const data_set_t *ds, const value_list_t *vl, /* {{
 
         pthread_mutex_lock (&cb->send_lock);
 
-        if (cb->curl == NULL)
+        if (!cb->event_thread_running)
         {
                 status = wh_callback_init (cb);
                 if (status != 0)
@@ -350,8 +949,8 @@ static int wh_write_command (const data_set_t *ds, const value_list_t *vl, /* {{
 
         DEBUG ("write_http plugin: <%s> buffer %zu/%zu (%g%%) \"%s\"",
                         cb->location,
-                        cb->send_buffer_fill, sizeof (cb->send_buffer),
-                        100.0 * ((double) cb->send_buffer_fill) / ((double) sizeof (cb->send_buffer)),
+                        cb->send_buffer_fill, cb->send_buffer_size,
+                        100.0 * ((double) cb->send_buffer_fill) / ((double) cb->send_buffer_size),
                         command);
 
         /* Check if we have enough space for this command. */
@@ -367,7 +966,7 @@ static int wh_write_json (const data_set_t *ds, const value_list_t *vl, /* {{{ *
 
         pthread_mutex_lock (&cb->send_lock);
 
-        if (cb->curl == NULL)
+        if (!cb->event_thread_running)
         {
                 status = wh_callback_init (cb);
                 if (status != 0)
@@ -405,8 +1004,8 @@ static int wh_write_json (const data_set_t *ds, const value_list_t *vl, /* {{{ *
 
         DEBUG ("write_http plugin: <%s> buffer %zu/%zu (%g%%)",
                         cb->location,
-                        cb->send_buffer_fill, sizeof (cb->send_buffer),
-                        100.0 * ((double) cb->send_buffer_fill) / ((double) sizeof (cb->send_buffer)));
+                        cb->send_buffer_fill, cb->send_buffer_size,
+                        100.0 * ((double) cb->send_buffer_fill) / ((double) cb->send_buffer_size));
 
         /* Check if we have enough space for this command. */
         pthread_mutex_unlock (&cb->send_lock);
@@ -523,13 +1122,24 @@ static int wh_config_url (oconfig_item_t *ci) /* {{{ */
         cb->verify_host = 1;
         cb->cacert = NULL;
         cb->format = WH_FORMAT_COMMAND;
-        cb->curl = NULL;
+        cb->multi = NULL;
+        cb->requests_num = WH_DEFAULT_MAX_REQUESTS;
+        cb->max_retries = WH_DEFAULT_MAX_RETRIES;
+        cb->send_buffer_size = WH_DEFAULT_BUFFER_SIZE;
+        cb->queue_limit = WH_DEFAULT_BACKLOG_LIMIT;
+        cb->wakeup_pipe[0] = -1;
+        cb->wakeup_pipe[1] = -1;
 
         pthread_mutex_init (&cb->send_lock, /* attr = */ NULL);
+        C_COMPLAIN_INIT (&cb->init_complaint);
+        C_COMPLAIN_INIT (&cb->queue_complaint);
 
         config_set_string (&cb->location, ci);
         if (cb->location == NULL)
+        {
+                wh_callback_free (cb);
                 return (-1);
+        }
 
         for (i = 0; i < ci->children_num; i++)
         {
@@ -549,6 +1159,31 @@ static int wh_config_url (oconfig_item_t *ci) /* {{{ */
                         config_set_format (cb, child);
                 else if (strcasecmp ("StoreRates", child->key) == 0)
                         config_set_boolean (&cb->store_rates, child);
+                else if (strcasecmp ("Compress", child->key) == 0)
+                        config_set_boolean (&cb->compress, child);
+                else if (strcasecmp ("MaxConcurrentRequests", child->key) == 0)
+                        cf_util_get_int (child, &cb->requests_num);
+                else if (strcasecmp ("MaxRetries", child->key) == 0)
+                        cf_util_get_int (child, &cb->max_retries);
+                else if (strcasecmp ("BufferSize", child->key) == 0)
+                {
+                        int tmp = (int) cb->send_buffer_size;
+                        if ((cf_util_get_int (child, &tmp) == 0) && (tmp >= 1024))
+                                cb->send_buffer_size = (size_t) tmp;
+                        else
+                                ERROR ("write_http plugin: \"BufferSize\" "
+                                                "must be at least 1024 bytes.");
+                }
+                else if (strcasecmp ("MaxBacklogSize", child->key) == 0)
+                {
+                        int tmp = (int) cb->queue_limit;
+                        if ((cf_util_get_int (child, &tmp) == 0) && (tmp >= 0))
+                                cb->queue_limit = (size_t) tmp;
+                        else
+                                ERROR ("write_http plugin: \"MaxBacklogSize\" "
+                                                "must be a non-negative "
+                                                "number of bytes.");
+                }
                 else
                 {
                         ERROR ("write_http plugin: Invalid configuration "
@@ -556,6 +1191,45 @@ static int wh_config_url (oconfig_item_t *ci) /* {{{ */
                 }
         }
 
+#if !HAVE_LIBZ
+        if (cb->compress)
+        {
+                WARNING ("write_http plugin: <%s>: \"Compress\" is not "
+                                "available because zlib was not found at "
+                                "compile time.", cb->location);
+                cb->compress = 0;
+        }
+#endif
+
+        if (cb->requests_num < 1)
+                cb->requests_num = 1;
+        if (cb->max_retries < 0)
+                cb->max_retries = 0;
+
+        cb->requests = calloc ((size_t) cb->requests_num,
+                        sizeof (*cb->requests));
+        cb->send_buffer = malloc (cb->send_buffer_size);
+        if ((cb->requests == NULL) || (cb->send_buffer == NULL))
+        {
+                ERROR ("write_http plugin: malloc failed.");
+                wh_callback_free (cb);
+                return (-1);
+        }
+        wh_reset_buffer (cb);
+
+        if (pipe (cb->wakeup_pipe) != 0)
+        {
+                char errbuf[1024];
+                ERROR ("write_http plugin: pipe(2) failed: %s",
+                                sstrerror (errno, errbuf, sizeof (errbuf)));
+                wh_callback_free (cb);
+                return (-1);
+        }
+        fcntl (cb->wakeup_pipe[0], F_SETFL,
+                        fcntl (cb->wakeup_pipe[0], F_GETFL) | O_NONBLOCK);
+        fcntl (cb->wakeup_pipe[1], F_SETFL,
+                        fcntl (cb->wakeup_pipe[1], F_GETFL) | O_NONBLOCK);
+
         DEBUG ("write_http: Registering write callback with URL %s",
                         cb->location);
 
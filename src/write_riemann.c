@@ -293,7 +293,7 @@ static Event *riemann_value_to_protobuf (struct riemann_host const *host, /* {{{
 	event->host = strdup (vl->host);
 	event->time = CDTIME_T_TO_TIME_T (vl->time);
 	event->has_time = 1;
-	event->ttl = CDTIME_T_TO_TIME_T (2 * vl->interval);
+	event->ttl = CDTIME_T_TO_DOUBLE (2 * vl->interval);
 	event->has_ttl = 1;
 
 	riemann_event_add_tag (event, "plugin:%s", vl->plugin);